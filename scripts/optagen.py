@@ -20,6 +20,7 @@ parser.add_argument('--roc', type=float, required=False, default=0.9, help='if t
 parser.add_argument('--ckp_s', type=str, required=False, default="", help='start from this scene (e.g., bedroom).')
 parser.add_argument('--ckp_i', type=int, required=False, default=0, help='start from this index (e.g., bedroom_<ckp_i>.npy, bedroom_<ckp_i + 1>.npy, ...).')
 parser.add_argument('--device', type=int, required=False, default=0)
+parser.add_argument('--mem_budget', type=int, required=False, default=0, help='skip scenes whose planned GPU memory in MB exceeds this (0: no limit).')
 args = parser.parse_args()
 
 assert os.path.isfile(args.exe), 'EXE is not a valid executable file.'
@@ -35,7 +36,9 @@ gt_dir = path.join(args.save, 'gt')
 if not os.path.isdir(gt_dir):
     os.mkdir(gt_dir)
 assert args.num >= 10, 'NUM < 10.'
-assert args.spp >= 1 and args.spp <= 32, 'SPP < 1 or SPP > 32. CUDA memory error might occur.'
+assert args.spp >= 1, 'SPP < 1.'
+# With --mem_budget OptaGen checks the memory of every scene before rendering, without it only the old guard applies.
+assert args.mem_budget > 0 or args.spp <= 32, 'SPP > 32 without --mem_budget. CUDA memory error might occur.'
 assert args.mspp >= args.spp and args.mspp <= 1000000, 'MSPP < 1000 or MSPP > 1000000.'
 assert args.roc > 0.0 and args.roc < 1.0, 'ROC <= 0.0 or ROC >= 1.0.'
 
@@ -44,7 +47,7 @@ assert args.roc > 0.0 and args.roc < 1.0, 'ROC <= 0.0 or ROC >= 1.0.'
 scenes = []
 for root, dirs, files in os.walk(args.root, topdown=True):
     for name in files:
-        if '.scene' in name:
+        if name.endswith('.scene'):
             scenes.append(path.join(root, name))
 patches_per_scenes = (args.num + len(scenes) - 1) // len(scenes)
 if args.ckp_s != "":
@@ -91,7 +94,8 @@ for scene in scenes:
             '-r', str(args.roc),
             '-w', "640",
             '-v', "0",
-            '--device', str(args.device)
+            '--device', str(args.device),
+            '--mem-budget', str(args.mem_budget)
         ]
     
     i += 1
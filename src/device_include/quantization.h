@@ -0,0 +1,204 @@
+/* 
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <optixu/optixu_math_namespace.h>
+
+#ifndef __CUDACC__
+#  include <cstring>
+#endif
+
+//------------------------------------------------------------------------------
+//
+// Compact vertex attributes, see QuantizedMesh in sutil/Mesh.h
+//
+// Error bounds of a decoded attribute against the float it was encoded from:
+//   position  (3 x 16 bit over the mesh bbox)  |dp| <= extent / 131070 per axis, plus a few
+//                                              float ulps of |p| from the decode
+//   normal    (octahedral, 2 x 16 bit snorm)   angle <= 0.0025 degrees (4.4e-5 rad)
+//   texcoord  (2 x half float)                 |duv| <= |uv| * 2^-11 for |uv| >= 2^-14,
+//                                              2^-25 below, and |uv| up to 65504 only
+// Shared vertices decode to identical positions, so meshes stay watertight.
+//
+//------------------------------------------------------------------------------
+
+static __host__ __device__ __inline__ float quantization_int_as_float( unsigned int bits )
+{
+#ifdef __CUDACC__
+  return __int_as_float( static_cast<int>( bits ) );
+#else
+  float f;
+  memcpy( &f, &bits, sizeof( f ) );
+  return f;
+#endif
+}
+
+
+static __host__ __device__ __inline__ unsigned int quantization_float_as_int( float f )
+{
+#ifdef __CUDACC__
+  return static_cast<unsigned int>( __float_as_int( f ) );
+#else
+  unsigned int bits;
+  memcpy( &bits, &f, sizeof( bits ) );
+  return bits;
+#endif
+}
+
+
+// Position relative to the bbox: p = origin + q * scale with scale = extent / 65535
+static __host__ __device__ __inline__ optix::float3 decode_position( const optix::ushort4& q, const optix::float3& origin, const optix::float3& scale )
+{
+  return origin + optix::make_float3( q.x, q.y, q.z ) * scale;
+}
+
+
+// Rounds to the nearest of the 65536 steps, inv_scale is 65535 / extent (0 for flat axes)
+static __host__ __device__ __inline__ unsigned short encode_position( float p, float origin, float inv_scale )
+{
+  const float q = ( p - origin ) * inv_scale + 0.5f;
+  return static_cast<unsigned short>( q <= 0.0f ? 0.0f : q >= 65535.0f ? 65535.0f : q );
+}
+
+
+static __host__ __device__ __inline__ optix::float3 decode_octahedral_normal( unsigned int code )
+{
+  const float x = optix::clamp( static_cast<short>( code & 0xffffu ) / 32767.0f, -1.0f, 1.0f );
+  const float y = optix::clamp( static_cast<short>( code >> 16 ) / 32767.0f, -1.0f, 1.0f );
+  optix::float3 n = optix::make_float3( x, y, 1.0f - fabsf( x ) - fabsf( y ) );
+  const float t = n.z < 0.0f ? -n.z : 0.0f;
+  n.x += n.x >= 0.0f ? -t : t;
+  n.y += n.y >= 0.0f ? -t : t;
+  return optix::normalize( n );
+}
+
+
+// Picks the rounding of the two coordinates that decodes closest to n, which
+// halves the error of plain rounding.  n does not need to be normalized.
+static __host__ __device__ __inline__ unsigned int encode_octahedral_normal( const optix::float3& n )
+{
+  const float sum = fabsf( n.x ) + fabsf( n.y ) + fabsf( n.z );
+  if( !( sum > 0.0f ) )
+    return 0x7fffu << 16;   // (0, 1, 0) for zero or NaN normals
+
+  float x = n.x / sum;
+  float y = n.y / sum;
+  if( n.z < 0.0f )
+  {
+    const float fx = ( 1.0f - fabsf( y ) ) * ( x >= 0.0f ? 1.0f : -1.0f );
+    const float fy = ( 1.0f - fabsf( x ) ) * ( y >= 0.0f ? 1.0f : -1.0f );
+    x = fx;
+    y = fy;
+  }
+
+  const optix::float3 dir = optix::normalize( n );
+  const float qx = floorf( optix::clamp( x, -1.0f, 1.0f ) * 32767.0f );
+  const float qy = floorf( optix::clamp( y, -1.0f, 1.0f ) * 32767.0f );
+  unsigned int best = 0;
+  float best_error = 8.0f;
+  for( int i = 0; i < 4; ++i )
+  {
+    const int cx = static_cast<int>( qx ) + ( i & 1 );
+    const int cy = static_cast<int>( qy ) + ( i >> 1 );
+    if( cx > 32767 || cy > 32767 )
+      continue;
+    const unsigned int code = ( static_cast<unsigned int>( cx ) & 0xffffu ) | ( static_cast<unsigned int>( cy ) << 16 );
+    // Distance rather than dot product, which has no precision left near 1
+    const optix::float3 d = decode_octahedral_normal( code ) - dir;
+    const float error = optix::dot( d, d );
+    if( error < best_error )
+    {
+      best_error = error;
+      best = code;
+    }
+  }
+  return best;
+}
+
+
+static __host__ __device__ __inline__ float half_to_float( unsigned short h )
+{
+  const unsigned int sign     = static_cast<unsigned int>( h & 0x8000u ) << 16;
+  const unsigned int exponent = ( h >> 10 ) & 0x1fu;
+  const unsigned int mantissa = h & 0x3ffu;
+  if( exponent == 0 )
+  {
+    const float f = mantissa * 5.9604645e-8f;   // 2^-24
+    return sign ? -f : f;
+  }
+  if( exponent == 31 )
+    return quantization_int_as_float( sign | 0x7f800000u | ( mantissa << 13 ) );
+  return quantization_int_as_float( sign | ( ( exponent + 112 ) << 23 ) | ( mantissa << 13 ) );
+}
+
+
+// Round to nearest even, overflows to infinity
+static __host__ __device__ __inline__ unsigned short float_to_half( float f )
+{
+  unsigned int x = quantization_float_as_int( f );
+  const unsigned short sign = static_cast<unsigned short>( ( x >> 16 ) & 0x8000u );
+  x &= 0x7fffffffu;
+
+  if( x >= 0x7f800000u )                      // inf, nan
+    return sign | 0x7c00u | ( x > 0x7f800000u ? 0x200u : 0u );
+  if( x >= 0x477ff000u )                      // 65520 and up
+    return sign | 0x7c00u;
+  if( x < 0x38800000u )                       // below 2^-14, denormal
+  {
+    if( x < 0x33000000u )                     // below 2^-25
+      return sign;
+    const unsigned int shift    = 126 - ( x >> 23 );
+    const unsigned int mantissa = ( x & 0x7fffffu ) | 0x800000u;
+    unsigned int h = mantissa >> shift;
+    const unsigned int rest = mantissa & ( ( 1u << shift ) - 1 );
+    const unsigned int half = 1u << ( shift - 1 );
+    if( rest > half || ( rest == half && ( h & 1 ) ) )
+      ++h;
+    return static_cast<unsigned short>( sign | h );
+  }
+
+  unsigned int h = ( x - 0x38000000u ) >> 13;
+  const unsigned int rest = x & 0x1fffu;
+  if( rest > 0x1000u || ( rest == 0x1000u && ( h & 1 ) ) )
+    ++h;
+  return static_cast<unsigned short>( sign | h );
+}
+
+
+static __host__ __device__ __inline__ optix::float2 decode_texcoord( unsigned int code )
+{
+  return optix::make_float2( half_to_float( static_cast<unsigned short>( code & 0xffffu ) ),
+                             half_to_float( static_cast<unsigned short>( code >> 16 ) ) );
+}
+
+
+static __host__ __device__ __inline__ unsigned int encode_texcoord( float u, float v )
+{
+  return static_cast<unsigned int>( float_to_half( u ) ) | ( static_cast<unsigned int>( float_to_half( v ) ) << 16 );
+}
@@ -0,0 +1,130 @@
+#include "AliasTable.h"
+
+#include <algorithm>
+
+
+AliasTable::AliasTable()
+	: m_sum(0.0f)
+{
+}
+
+
+void AliasTable::clear()
+{
+	m_probability.clear();
+	m_alias.clear();
+	m_weights.clear();
+	m_sum = 0.0f;
+}
+
+
+bool AliasTable::build(const std::vector<float>& weights)
+{
+	clear();
+
+	// Accumulate in double, the tables can have millions of entries.
+	double sum = 0.0;
+	for (float w : weights)
+	{
+		if (w > 0.0f)
+			sum += w;
+	}
+	if (!(sum > 0.0))
+		return false;
+
+	const size_t n = weights.size();
+	m_sum = static_cast<float>(sum);
+	m_probability.resize(n);
+	m_alias.resize(n);
+	m_weights.resize(n);
+
+	std::vector<double> scaled(n);
+	std::vector<uint32_t> small, large;
+	for (size_t i = 0; i < n; ++i)
+	{
+		const double w = weights[i] > 0.0f ? weights[i] : 0.0;
+		m_weights[i] = static_cast<float>(w / sum);
+		scaled[i] = w / sum * n;
+		if (scaled[i] < 1.0)
+			small.push_back(static_cast<uint32_t>(i));
+		else
+			large.push_back(static_cast<uint32_t>(i));
+	}
+
+	while (!small.empty() && !large.empty())
+	{
+		const uint32_t s = small.back();
+		small.pop_back();
+		const uint32_t l = large.back();
+
+		m_probability[s] = static_cast<float>(scaled[s]);
+		m_alias[s] = l;
+
+		scaled[l] -= 1.0 - scaled[s];
+		if (scaled[l] < 1.0)
+		{
+			large.pop_back();
+			small.push_back(l);
+		}
+	}
+
+	// Leftovers are 1 up to rounding.
+	for (uint32_t i : large)
+	{
+		m_probability[i] = 1.0f;
+		m_alias[i] = i;
+	}
+	for (uint32_t i : small)
+	{
+		m_probability[i] = 1.0f;
+		m_alias[i] = i;
+	}
+
+	return true;
+}
+
+
+// One uniform for the bin and one for the coin. The fraction of a single float times millions of bins leaves no bits
+// for the coin.
+unsigned int AliasTable::sample(float uBin, float uCoin) const
+{
+	const unsigned int n = size();
+	const unsigned int i = std::min(static_cast<unsigned int>(static_cast<double>(uBin) * n), n - 1);
+	return uCoin < m_probability[i] ? i : m_alias[i];
+}
+
+
+float AliasTable::pdf(unsigned int index) const
+{
+	return m_weights[index];
+}
+
+
+float AliasTable::getProbability(unsigned int index) const
+{
+	return m_probability[index];
+}
+
+
+unsigned int AliasTable::getAlias(unsigned int index) const
+{
+	return m_alias[index];
+}
+
+
+bool AliasTable::empty() const
+{
+	return m_probability.empty();
+}
+
+
+unsigned int AliasTable::size() const
+{
+	return static_cast<unsigned int>(m_probability.size());
+}
+
+
+float AliasTable::getSum() const
+{
+	return m_sum;
+}
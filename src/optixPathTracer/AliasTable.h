@@ -0,0 +1,38 @@
+#pragma once
+
+#ifndef ALIAS_TABLE_H
+#define ALIAS_TABLE_H
+
+#include <stdint.h>
+#include <vector>
+
+/*
+	Walker/Vose alias table for drawing indices proportional to non-negative weights in O(1).
+*/
+class AliasTable
+{
+public:
+	AliasTable();
+
+	bool build(const std::vector<float>& weights);	/* false if no weight is positive */
+	void clear();
+
+	unsigned int sample(float uBin, float uCoin) const;	/* independent uniforms in [0, 1) */
+	float pdf(unsigned int index) const;			/* probability of index */
+
+	// The table itself, for copies on the device: bin i keeps i with getProbability(i), else takes getAlias(i).
+	float getProbability(unsigned int index) const;
+	unsigned int getAlias(unsigned int index) const;
+
+	bool empty() const;
+	unsigned int size() const;
+	float getSum() const;
+
+private:
+	std::vector<float>    m_probability;	/* of keeping the bin instead of taking its alias */
+	std::vector<uint32_t> m_alias;
+	std::vector<float>    m_weights;		/* normalized */
+	float                 m_sum;
+};
+
+#endif
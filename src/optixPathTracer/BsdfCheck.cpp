@@ -0,0 +1,420 @@
+#include "BsdfCheck.h"
+#include "bsdf.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <random>
+
+using namespace optix;
+
+namespace
+{
+
+const int   THETA_BINS = 10;		/* equal area in cos theta */
+const int   PHI_BINS = 20;
+const int   BIN_SUBDIVISION = 64;	/* pdf evaluations per bin and axis */
+const int   CHI2_SAMPLES = 200000;
+const float CHI2_MIN_EXPECTED = 5.0f;	/* bins below are pooled */
+const double CHI2_SIGNIFICANCE = 1e-3;
+
+const int   FURNACE_SAMPLES = 200000;
+const double FURNACE_TOLERANCE = 0.01;	/* on top of four standard deviations */
+
+const int   RECIPROCITY_PAIRS = 4096;
+const float RECIPROCITY_TOLERANCE = 1e-3f;	/* relative */
+
+const float INCIDENT_COS[] = { 0.95f, 0.6f, 0.25f };
+
+
+struct Setup
+{
+	MaterialParameter mat;
+	State             state;
+};
+
+
+Setup makeSetup(const MaterialParameter& mat)
+{
+	Setup setup;
+	setup.mat = mat;
+	setup.state.fhp = make_float3(0.0f);
+	setup.state.bhp = make_float3(0.0f);
+	setup.state.normal = make_float3(0.0f, 0.0f, 1.0f);
+	setup.state.ffnormal = setup.state.normal;
+	return setup;
+}
+
+
+PerRayData_radiance makePrd(const float3& wo, unsigned int seed)
+{
+	PerRayData_radiance prd;
+	memset(&prd, 0, sizeof(prd));
+	prd.sampler.type = SAMPLER_RANDOM;	/* independent samples */
+	prd.sampler.seed = seed;
+	prd.wo = wo;
+	return prd;
+}
+
+
+float3 incidentDirection(float cosTheta)
+{
+	return make_float3(sqrtf(fmaxf(0.0f, 1.0f - cosTheta * cosTheta)), 0.0f, cosTheta);
+}
+
+
+float3 sphericalDirection(float cosTheta, float phi)
+{
+	const float sinTheta = sqrtf(fmaxf(0.0f, 1.0f - cosTheta * cosTheta));
+	return make_float3(sinTheta * cosf(phi), sinTheta * sinf(phi), cosTheta);
+}
+
+
+bool isFinite(const float3& v)
+{
+	return std::isfinite(v.x) && std::isfinite(v.y) && std::isfinite(v.z);
+}
+
+
+float pdf(const Setup& setup, const float3& wo, const float3& wi)
+{
+	PerRayData_radiance prd = makePrd(wo, 0);
+	prd.bsdfDir = wi;
+	bsdfPdf(setup.mat, setup.state, prd);
+	return prd.pdf;
+}
+
+
+float3 eval(const Setup& setup, const float3& wo, const float3& wi)
+{
+	PerRayData_radiance prd = makePrd(wo, 0);
+	prd.bsdfDir = wi;
+	return bsdfEval(setup.mat, setup.state, prd);
+}
+
+
+// The pdf only matters where f is not zero, elsewhere it never weights a path (Lambert and Disney return |cos| / pi
+// below the surface, where nothing is sampled).
+bool inSupport(const Setup& setup, const float3& wo, const float3& wi)
+{
+	const float3 f = eval(setup, wo, wi);
+	return f.x > 0.0f || f.y > 0.0f || f.z > 0.0f;
+}
+
+
+// Regularized upper incomplete gamma function Q(a, x), Numerical Recipes 6.2.
+double gammaQ(double a, double x)
+{
+	if (x <= 0.0)
+		return 1.0;
+
+	const double gln = std::lgamma(a);
+	if (x < a + 1.0)
+	{
+		double ap = a, sum = 1.0 / a, del = sum;
+		for (int n = 0; n < 1000 && fabs(del) > fabs(sum) * 1e-15; ++n)
+		{
+			ap += 1.0;
+			del *= x / ap;
+			sum += del;
+		}
+		return 1.0 - sum * exp(-x + a * log(x) - gln);
+	}
+
+	const double tiny = 1e-300;
+	double b = x + 1.0 - a, c = 1.0 / tiny, d = 1.0 / b, h = d;
+	for (int i = 1; i < 1000; ++i)
+	{
+		const double an = -i * (i - a);
+		b += 2.0;
+		d = an * d + b;
+		if (fabs(d) < tiny)
+			d = tiny;
+		c = b + an / c;
+		if (fabs(c) < tiny)
+			c = tiny;
+		d = 1.0 / d;
+		const double del = d * c;
+		h *= del;
+		if (fabs(del - 1.0) < 1e-15)
+			break;
+	}
+	return exp(-x + a * log(x) - gln) * h;
+}
+
+
+int binIndex(const float3& dir)
+{
+	const float cosTheta = clamp(dir.z, -1.0f, 1.0f);
+	float phi = atan2f(dir.y, dir.x);
+	if (phi < 0.0f)
+		phi += 2.0f * M_PIf;
+	const int t = std::min(static_cast<int>((cosTheta + 1.0f) * 0.5f * THETA_BINS), THETA_BINS - 1);
+	const int p = std::min(static_cast<int>(phi * (0.5f * M_1_PIf) * PHI_BINS), PHI_BINS - 1);
+	return t * PHI_BINS + p;
+}
+
+
+// Sampled directions against the pdf integrated over the bins, both on the whole sphere and where f is not zero.
+bool checkChiSquare(const Setup& setup, const float3& wo, unsigned int seed, std::ostream& log)
+{
+	std::vector<double> observed(THETA_BINS * PHI_BINS, 0.0);
+	int invalid = 0;
+	for (int i = 0; i < CHI2_SAMPLES; ++i)
+	{
+		PerRayData_radiance prd = makePrd(wo, seed);
+		bsdfSample(setup.mat, setup.state, prd);
+		seed = prd.sampler.seed;
+		if (prd.done)
+			continue;
+		if (!isFinite(prd.bsdfDir) || fabsf(length(prd.bsdfDir) - 1.0f) > 1e-3f)
+		{
+			++invalid;
+			continue;
+		}
+		if (inSupport(setup, wo, prd.bsdfDir))
+			observed[binIndex(prd.bsdfDir)] += 1.0;
+	}
+
+	// Midpoint rule, the solid angle of a bin is dcos(theta) * dphi.
+	std::vector<double> expected(THETA_BINS * PHI_BINS, 0.0);
+	const double cell = (2.0 / THETA_BINS) * (2.0 * M_PI / PHI_BINS) / (BIN_SUBDIVISION * BIN_SUBDIVISION);
+	for (int t = 0; t < THETA_BINS; ++t)
+	{
+		for (int p = 0; p < PHI_BINS; ++p)
+		{
+			double sum = 0.0;
+			for (int u = 0; u < BIN_SUBDIVISION; ++u)
+			{
+				const float cosTheta = -1.0f + 2.0f * (t + (u + 0.5f) / BIN_SUBDIVISION) / THETA_BINS;
+				for (int v = 0; v < BIN_SUBDIVISION; ++v)
+				{
+					const float phi = 2.0f * M_PIf * (p + (v + 0.5f) / BIN_SUBDIVISION) / PHI_BINS;
+					const float3 wi = sphericalDirection(cosTheta, phi);
+					const float density = inSupport(setup, wo, wi) ? pdf(setup, wo, wi) : 0.0f;
+					if (std::isfinite(density))
+						sum += density;
+				}
+			}
+			expected[t * PHI_BINS + p] = sum * cell * CHI2_SAMPLES;
+		}
+	}
+
+	// Bins with too few expected samples are pooled into one.
+	double chi2 = 0.0, pooledObserved = 0.0, pooledExpected = 0.0;
+	int bins = 0;
+	for (size_t i = 0; i < expected.size(); ++i)
+	{
+		if (expected[i] < CHI2_MIN_EXPECTED)
+		{
+			pooledObserved += observed[i];
+			pooledExpected += expected[i];
+			continue;
+		}
+		chi2 += (observed[i] - expected[i]) * (observed[i] - expected[i]) / expected[i];
+		++bins;
+	}
+	bool zeroPdf = false;
+	if (pooledExpected > 0.0)
+	{
+		chi2 += (pooledObserved - pooledExpected) * (pooledObserved - pooledExpected) / pooledExpected;
+		++bins;
+	}
+	else if (pooledObserved > 0.0)
+		zeroPdf = true;
+
+	const double pValue = bins > 1 ? gammaQ(0.5 * (bins - 1), 0.5 * chi2) : 1.0;
+	const bool passed = invalid == 0 && !zeroPdf && pValue >= CHI2_SIGNIFICANCE;
+	log << "    chi-square     cos " << wo.z << ": chi2 " << chi2 << ", " << bins - 1 << " dof, p " << pValue;
+	if (invalid > 0)
+		log << ", " << invalid << " invalid directions";
+	if (zeroPdf)
+		log << ", samples where the pdf is zero";
+	log << (passed ? "" : "  FAILED") << std::endl;
+	return passed;
+}
+
+
+// White material: E[f cos / pdf] over the sampled directions is the albedo and must not exceed one.
+// The same integral with uniform sphere samples catches Eval and Sample/Pdf disagreeing.
+bool checkFurnace(const Setup& setup, const float3& wo, bool delta, float maxAlbedo, unsigned int seed, std::ostream& log)
+{
+	double sum = 0.0, sumSqr = 0.0;
+	int invalid = 0;
+	for (int i = 0; i < FURNACE_SAMPLES; ++i)
+	{
+		PerRayData_radiance prd = makePrd(wo, seed);
+		bsdfSample(setup.mat, setup.state, prd);
+		bsdfPdf(setup.mat, setup.state, prd);
+		const float3 f = bsdfEval(setup.mat, setup.state, prd);
+		seed = prd.sampler.seed;
+
+		double weight = 0.0;
+		if (prd.pdf > 0.0f)
+			weight = f.x / prd.pdf;
+		if (!std::isfinite(weight) || weight < 0.0)
+		{
+			++invalid;
+			continue;
+		}
+		sum += weight;
+		sumSqr += weight * weight;
+	}
+	const double albedo = sum / FURNACE_SAMPLES;
+	const double error = sqrt(std::max(0.0, sumSqr / FURNACE_SAMPLES - albedo * albedo) / FURNACE_SAMPLES);
+
+	bool passed = invalid == 0 && albedo <= maxAlbedo + 4.0 * error + FURNACE_TOLERANCE;
+	log << "    white furnace  cos " << wo.z << ": albedo " << albedo << " +- " << error;
+
+	if (!delta)
+	{
+		std::mt19937 rng(seed);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		double uniformSum = 0.0, uniformSumSqr = 0.0;
+		for (int i = 0; i < FURNACE_SAMPLES; ++i)
+		{
+			const float3 wi = sphericalDirection(1.0f - 2.0f * unit(rng), 2.0f * M_PIf * unit(rng));
+			const double weight = eval(setup, wo, wi).x * 4.0 * M_PI;
+			if (std::isfinite(weight))
+			{
+				uniformSum += weight;
+				uniformSumSqr += weight * weight;
+			}
+		}
+		const double uniform = uniformSum / FURNACE_SAMPLES;
+		const double uniformError = sqrt(std::max(0.0, uniformSumSqr / FURNACE_SAMPLES - uniform * uniform) / FURNACE_SAMPLES);
+		const double allowed = 4.0 * sqrt(error * error + uniformError * uniformError) + FURNACE_TOLERANCE;
+		if (fabs(albedo - uniform) > allowed)
+			passed = false;
+		log << ", uniform " << uniform << " +- " << uniformError;
+	}
+	if (invalid > 0)
+		log << ", " << invalid << " invalid weights";
+	log << (passed ? "" : "  FAILED") << std::endl;
+	return passed;
+}
+
+
+// Eval returns f * |cos| of the outgoing direction.
+bool checkReciprocity(const Setup& setup, unsigned int seed, std::ostream& log)
+{
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	int violations = 0;
+	float worst = 0.0f;
+	for (int i = 0; i < RECIPROCITY_PAIRS; ++i)
+	{
+		const float3 a = sphericalDirection(0.05f + 0.95f * unit(rng), 2.0f * M_PIf * unit(rng));
+		const float3 b = sphericalDirection(0.05f + 0.95f * unit(rng), 2.0f * M_PIf * unit(rng));
+		const float3 fab = eval(setup, a, b) / b.z;
+		const float3 fba = eval(setup, b, a) / a.z;
+		const float scale = fmaxf(fmaxf(fmaxf(fab.x, fab.y), fmaxf(fab.z, fba.x)), fmaxf(fmaxf(fba.y, fba.z), 1e-4f));
+		const float3 diff = fab - fba;
+		const float error = fmaxf(fabsf(diff.x), fmaxf(fabsf(diff.y), fabsf(diff.z))) / scale;
+		if (!(error <= RECIPROCITY_TOLERANCE))
+			++violations;
+		if (error > worst || !std::isfinite(error))
+			worst = error;
+	}
+
+	const bool passed = violations == 0;
+	log << "    reciprocity    " << RECIPROCITY_PAIRS << " pairs: largest relative difference " << worst;
+	if (violations > 0)
+		log << ", " << violations << " above " << RECIPROCITY_TOLERANCE;
+	log << (passed ? "" : "  FAILED") << std::endl;
+	return passed;
+}
+
+
+BsdfCase makeCase(const std::string& name, BrdfType brdf)
+{
+	BsdfCase bsdfCase;
+	bsdfCase.name = name;
+	bsdfCase.mat.brdf = brdf;
+	bsdfCase.mat.color = make_float3(0.8f, 0.6f, 0.4f);
+	bsdfCase.delta = brdf == GLASS;
+	bsdfCase.reciprocal = brdf == DISNEY || brdf == LAMBERT || brdf == ROUGHDIELECTRIC;
+	bsdfCase.maxAlbedo = 1.0f;
+	return bsdfCase;
+}
+
+} // namespace
+
+
+std::vector<BsdfCase> getBsdfCases()
+{
+	std::vector<BsdfCase> cases;
+
+	cases.push_back(makeCase("lambert", LAMBERT));
+
+	// The Disney diffuse lobe is not energy conserving by design, its retro-reflection and sheen gain up to about a
+	// third at grazing angles.
+	cases.push_back(makeCase("disney.diffuse", DISNEY));
+	cases.back().maxAlbedo = 1.1f;
+
+	cases.push_back(makeCase("disney.rough", DISNEY));
+	cases.back().mat.roughness = 1.0f;
+	cases.back().mat.subsurface = 0.5f;
+	cases.back().mat.sheen = 1.0f;
+	cases.back().maxAlbedo = 1.4f;
+
+	cases.push_back(makeCase("disney.metal", DISNEY));
+	cases.back().mat.metallic = 1.0f;
+	cases.back().mat.roughness = 0.3f;
+
+	cases.push_back(makeCase("disney.clearcoat", DISNEY));
+	cases.back().mat.metallic = 0.5f;
+	cases.back().mat.roughness = 0.4f;
+	cases.back().mat.clearcoat = 1.0f;
+	cases.back().mat.clearcoatGloss = 0.5f;
+
+	const DistType dists[] = { GGX, Beckmann, Phong };
+	const char* const distNames[] = { "ggx", "beckmann", "phong" };
+	for (int i = 0; i < 3; ++i)
+	{
+		cases.push_back(makeCase(std::string("roughdielectric.") + distNames[i], ROUGHDIELECTRIC));
+		cases.back().mat.roughness = 0.3f;
+		cases.back().mat.dist = dists[i];
+	}
+
+	cases.push_back(makeCase("glass", GLASS));
+
+	return cases;
+}
+
+
+int checkBsdf(const BsdfCase& bsdfCase, std::ostream& log)
+{
+	const std::ios::fmtflags flags = log.flags();
+	const std::streamsize precision = log.precision();
+	log << std::setprecision(4);
+	log << "[BSDF] " << bsdfCase.name << std::endl;
+
+	const Setup setup = makeSetup(bsdfCase.mat);
+	MaterialParameter white = bsdfCase.mat;
+	white.color = make_float3(1.0f);
+	const Setup whiteSetup = makeSetup(white);
+
+	// The dielectrics are also hit from the inside.
+	std::vector<float> incident(INCIDENT_COS, INCIDENT_COS + sizeof(INCIDENT_COS) / sizeof(INCIDENT_COS[0]));
+	if (bsdfCase.mat.brdf == GLASS || bsdfCase.mat.brdf == ROUGHDIELECTRIC)
+		incident.push_back(-0.6f);
+
+	int failures = 0;
+	unsigned int seed = 1234;
+	for (size_t i = 0; i < incident.size(); ++i)
+	{
+		const float3 wo = incidentDirection(incident[i]);
+		if (!bsdfCase.delta && !checkChiSquare(setup, wo, seed += 7919, log))
+			++failures;
+		if (!checkFurnace(whiteSetup, wo, bsdfCase.delta, bsdfCase.maxAlbedo, seed += 7919, log))
+			++failures;
+	}
+	if (bsdfCase.reciprocal && !checkReciprocity(setup, seed += 7919, log))
+		++failures;
+
+	log.flags(flags);
+	log.precision(precision);
+	return failures;
+}
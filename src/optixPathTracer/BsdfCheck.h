@@ -0,0 +1,36 @@
+#pragma once
+
+#ifndef BSDF_CHECK_H
+#define BSDF_CHECK_H
+
+#include <optixu/optixu_math_namespace.h>
+#include "material_parameters.h"
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+// A material the checks and benchmarks of OptaBench run on.
+struct BsdfCase
+{
+	std::string       name;
+	MaterialParameter mat;
+	bool              delta;		/* glass, only the white furnace applies */
+	bool              reciprocal;	/* reflection is checked for f(i, o) == f(o, i) */
+	float             maxAlbedo;	/* white furnace limit, one unless the model gains energy by design */
+};
+
+// Lambert, several Disney lobes, rough dielectrics with each microfacet distribution and glass.
+std::vector<BsdfCase> getBsdfCases();
+
+/*
+	Host checks of bsdfSample/bsdfPdf/bsdfEval (bsdf.h) for a few incident directions:
+	- chi-square: histogram of sampled directions against the integral of the pdf over the same bins,
+	- white furnace: the albedo E[f cos / pdf] for a white material must not exceed one, and for non-delta BSDFs it has
+	  to match a uniform sphere estimate of the integral of f cos (Sample and Eval agree),
+	- reciprocity: f(i, o) == f(o, i) for reflections.
+	Returns the number of failed checks and logs every result.
+*/
+int checkBsdf(const BsdfCase& bsdfCase, std::ostream& log);
+
+#endif
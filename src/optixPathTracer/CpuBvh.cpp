@@ -0,0 +1,414 @@
+#include "CpuBvh.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+
+using namespace optix;
+
+#define BVH_NUM_BINS 16
+#define BVH_MAX_LEAF 4
+#define BVH_MAX_DEPTH 64 // Deeper nodes fall back to median splits, which keeps the traversal stack bounded.
+#define BVH_STACK_SIZE 128
+
+
+struct CpuBvh::BuildTask
+{
+	std::vector<Aabb>          primBounds;
+	std::vector<float3>        centroids;
+	std::atomic<unsigned int>  nodeCounter;
+};
+
+
+// Same test and barycentrics as optix::intersect_triangle() used by triangle_mesh.cu.
+static inline bool intersectTriangle(const float3& o, const float3& d, const float3& p0, const float3& p1, const float3& p2,
+	float tmin, float tmax, float& t, float& beta, float& gamma)
+{
+	const float3 e0 = p1 - p0;
+	const float3 e1 = p0 - p2;
+	const float3 n = cross(e1, e0);
+
+	const float3 e2 = (1.0f / dot(n, d)) * (p0 - o);
+	const float3 i = cross(d, e2);
+
+	beta = dot(i, e1);
+	gamma = dot(i, e0);
+	t = dot(n, e2);
+
+	return ((t < tmax) & (t > tmin) & (beta >= 0.0f) & (gamma >= 0.0f) & (beta + gamma <= 1.0f));
+}
+
+
+static inline bool intersectBox(const float3& bmin, const float3& bmax, const float3& o, const float3& invDir, float tmin, float tmax, float& tnear)
+{
+	const float3 t0 = (bmin - o) * invDir;
+	const float3 t1 = (bmax - o) * invDir;
+
+	const float3 tlo = fminf(t0, t1);
+	const float3 thi = fmaxf(t0, t1);
+
+	tnear = fmaxf(fmaxf(tlo.x, tlo.y), fmaxf(tlo.z, tmin));
+	const float tfar = fminf(fminf(thi.x, thi.y), fminf(thi.z, tmax));
+
+	return tnear <= tfar;
+}
+
+
+CpuBvh::CpuBvh()
+	: m_numNodes(0)
+{
+}
+
+
+void CpuBvh::clear()
+{
+	m_nodes.clear();
+	m_primIds.clear();
+	m_triangles.clear();
+	m_bounds.invalidate();
+	m_numNodes = 0;
+}
+
+
+void CpuBvh::build(const float3* vertices, const int3* indices, unsigned int numTriangles, unsigned int numThreads)
+{
+	clear();
+
+	BuildTask task;
+	task.primBounds.resize(numTriangles);
+	task.centroids.resize(numTriangles);
+	task.nodeCounter = 1; // The root is node 0.
+
+	m_primIds.reserve(numTriangles);
+
+	for (unsigned int i = 0; i < numTriangles; ++i)
+	{
+		const float3 v0 = vertices[indices[i].x];
+		const float3 v1 = vertices[indices[i].y];
+		const float3 v2 = vertices[indices[i].z];
+		const float area = length(cross(v1 - v0, v2 - v0));
+
+		if (!(area > 0.0f) || std::isinf(area))
+		{
+			continue; // The device bounds program invalidates these, so they are never hit.
+		}
+
+		task.primBounds[i].invalidate();
+		task.primBounds[i].include(fminf(fminf(v0, v1), v2), fmaxf(fmaxf(v0, v1), v2));
+		task.centroids[i] = task.primBounds[i].center();
+
+		m_bounds.include(task.primBounds[i]);
+		m_primIds.push_back(i);
+	}
+
+	const unsigned int count = static_cast<unsigned int>(m_primIds.size());
+	if (count == 0)
+	{
+		return;
+	}
+
+	m_nodes.resize(2 * count - 1);
+
+	if (numThreads == 0)
+	{
+		numThreads = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	// Every level of spawning doubles the number of builder threads.
+	int spawnDepth = 0;
+	while ((1u << spawnDepth) < numThreads)
+	{
+		++spawnDepth;
+	}
+
+	buildRecursive(task, 0, 0, count, 0, spawnDepth);
+
+	m_numNodes = task.nodeCounter;
+	m_nodes.resize(m_numNodes);
+
+	// Store the triangles in leaf order so that traversal touches contiguous memory.
+	m_triangles.resize(3 * count);
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		const int3 idx = indices[m_primIds[i]];
+		m_triangles[3 * i + 0] = vertices[idx.x];
+		m_triangles[3 * i + 1] = vertices[idx.y];
+		m_triangles[3 * i + 2] = vertices[idx.z];
+	}
+}
+
+
+void CpuBvh::buildRecursive(BuildTask& task, unsigned int nodeIndex, unsigned int begin, unsigned int end, int depth, int spawnDepth)
+{
+	Node& node = m_nodes[nodeIndex];
+
+	Aabb bounds;
+	Aabb centroidBounds;
+	for (unsigned int i = begin; i < end; ++i)
+	{
+		bounds.include(task.primBounds[m_primIds[i]]);
+		centroidBounds.include(task.centroids[m_primIds[i]]);
+	}
+
+	node.bmin = bounds.m_min;
+	node.bmax = bounds.m_max;
+
+	const unsigned int count = end - begin;
+	if (count <= BVH_MAX_LEAF)
+	{
+		node.offset = begin;
+		node.count = count;
+		return;
+	}
+
+	// Binned SAH over all three axes.
+	int bestAxis = -1;
+	int bestSplit = 0;
+	float bestCost = float(count) * bounds.area();
+
+	for (int axis = 0; axis < 3 && depth < BVH_MAX_DEPTH; ++axis)
+	{
+		const float cmin = getByIndex(centroidBounds.m_min, axis);
+		const float extent = getByIndex(centroidBounds.m_max, axis) - cmin;
+		if (!(extent > 0.0f))
+		{
+			continue;
+		}
+		const float scale = float(BVH_NUM_BINS) / extent;
+
+		Aabb binBounds[BVH_NUM_BINS];
+		unsigned int binCount[BVH_NUM_BINS] = { 0 };
+
+		for (unsigned int i = begin; i < end; ++i)
+		{
+			const unsigned int prim = m_primIds[i];
+			const int b = std::min(BVH_NUM_BINS - 1, int((getByIndex(task.centroids[prim], axis) - cmin) * scale));
+			binBounds[b].include(task.primBounds[prim]);
+			binCount[b]++;
+		}
+
+		// Sweep from the right to get the suffix areas, then from the left to evaluate the splits.
+		float rightArea[BVH_NUM_BINS];
+		unsigned int rightCount[BVH_NUM_BINS];
+		Aabb acc;
+		unsigned int n = 0;
+		for (int b = BVH_NUM_BINS - 1; b > 0; --b)
+		{
+			if (binCount[b])
+			{
+				acc.include(binBounds[b]);
+			}
+			n += binCount[b];
+			rightArea[b] = acc.valid() ? acc.area() : 0.0f;
+			rightCount[b] = n;
+		}
+
+		acc.invalidate();
+		n = 0;
+		for (int b = 0; b < BVH_NUM_BINS - 1; ++b)
+		{
+			if (binCount[b])
+			{
+				acc.include(binBounds[b]);
+			}
+			n += binCount[b];
+			if (n == 0 || rightCount[b + 1] == 0)
+			{
+				continue;
+			}
+			const float cost = float(n) * acc.area() + float(rightCount[b + 1]) * rightArea[b + 1];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = b;
+			}
+		}
+	}
+
+	unsigned int mid;
+	if (bestAxis >= 0)
+	{
+		const float cmin = getByIndex(centroidBounds.m_min, bestAxis);
+		const float scale = float(BVH_NUM_BINS) / (getByIndex(centroidBounds.m_max, bestAxis) - cmin);
+		unsigned int* first = m_primIds.data() + begin;
+		unsigned int* pivot = std::partition(first, m_primIds.data() + end, [&](unsigned int prim)
+		{
+			return std::min(BVH_NUM_BINS - 1, int((getByIndex(task.centroids[prim], bestAxis) - cmin) * scale)) <= bestSplit;
+		});
+		mid = begin + static_cast<unsigned int>(pivot - first);
+	}
+	else if (count <= 4 * BVH_MAX_LEAF && depth < BVH_MAX_DEPTH)
+	{
+		// Splitting does not pay off.
+		node.offset = begin;
+		node.count = count;
+		return;
+	}
+	else
+	{
+		// All centroids coincide, no split beats the leaf cost, or the tree got too deep: median split on the longest axis.
+		const int axis = bounds.longestAxis();
+		mid = (begin + end) / 2;
+		std::nth_element(m_primIds.begin() + begin, m_primIds.begin() + mid, m_primIds.begin() + end, [&](unsigned int a, unsigned int b)
+		{
+			return getByIndex(task.centroids[a], axis) < getByIndex(task.centroids[b], axis);
+		});
+	}
+
+	const unsigned int left = task.nodeCounter.fetch_add(2);
+	node.offset = left;
+	node.count = 0;
+
+	if (0 < spawnDepth && 1024 < count)
+	{
+		std::thread worker(&CpuBvh::buildRecursive, this, std::ref(task), left, begin, mid, depth + 1, spawnDepth - 1);
+		buildRecursive(task, left + 1, mid, end, depth + 1, spawnDepth - 1);
+		worker.join();
+	}
+	else
+	{
+		buildRecursive(task, left, begin, mid, depth + 1, 0);
+		buildRecursive(task, left + 1, mid, end, depth + 1, 0);
+	}
+}
+
+
+bool CpuBvh::intersect(const float3& origin, const float3& direction, float tmin, float tmax, BvhHit& hit) const
+{
+	if (m_numNodes == 0)
+	{
+		return false;
+	}
+
+	const float3 invDir = make_float3(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+
+	unsigned int stack[BVH_STACK_SIZE];
+	int top = 0;
+	stack[top++] = 0;
+
+	bool found = false;
+
+	while (top > 0)
+	{
+		const Node& node = m_nodes[stack[--top]];
+
+		float tnear;
+		if (!intersectBox(node.bmin, node.bmax, origin, invDir, tmin, tmax, tnear))
+		{
+			continue;
+		}
+
+		if (node.count != 0)
+		{
+			for (unsigned int i = node.offset; i < node.offset + node.count; ++i)
+			{
+				float t, beta, gamma;
+				if (intersectTriangle(origin, direction, m_triangles[3 * i], m_triangles[3 * i + 1], m_triangles[3 * i + 2], tmin, tmax, t, beta, gamma))
+				{
+					tmax = t;
+					hit.t = t;
+					hit.prim = m_primIds[i];
+					hit.beta = beta;
+					hit.gamma = gamma;
+					found = true;
+				}
+			}
+			continue;
+		}
+
+		// Visit the nearer child first.
+		const Node& a = m_nodes[node.offset];
+		const Node& b = m_nodes[node.offset + 1];
+		float ta, tb;
+		const bool hitA = intersectBox(a.bmin, a.bmax, origin, invDir, tmin, tmax, ta);
+		const bool hitB = intersectBox(b.bmin, b.bmax, origin, invDir, tmin, tmax, tb);
+
+		if (hitA && hitB)
+		{
+			if (ta <= tb)
+			{
+				stack[top++] = node.offset + 1;
+				stack[top++] = node.offset;
+			}
+			else
+			{
+				stack[top++] = node.offset;
+				stack[top++] = node.offset + 1;
+			}
+		}
+		else if (hitA)
+		{
+			stack[top++] = node.offset;
+		}
+		else if (hitB)
+		{
+			stack[top++] = node.offset + 1;
+		}
+	}
+
+	return found;
+}
+
+
+bool CpuBvh::occluded(const float3& origin, const float3& direction, float tmin, float tmax) const
+{
+	if (m_numNodes == 0)
+	{
+		return false;
+	}
+
+	const float3 invDir = make_float3(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+
+	unsigned int stack[BVH_STACK_SIZE];
+	int top = 0;
+	stack[top++] = 0;
+
+	while (top > 0)
+	{
+		const Node& node = m_nodes[stack[--top]];
+
+		float tnear;
+		if (!intersectBox(node.bmin, node.bmax, origin, invDir, tmin, tmax, tnear))
+		{
+			continue;
+		}
+
+		if (node.count != 0)
+		{
+			for (unsigned int i = node.offset; i < node.offset + node.count; ++i)
+			{
+				float t, beta, gamma;
+				if (intersectTriangle(origin, direction, m_triangles[3 * i], m_triangles[3 * i + 1], m_triangles[3 * i + 2], tmin, tmax, t, beta, gamma))
+				{
+					return true; // Any hit terminates like any_hit() in hit_program.cu.
+				}
+			}
+			continue;
+		}
+
+		stack[top++] = node.offset;
+		stack[top++] = node.offset + 1;
+	}
+
+	return false;
+}
+
+
+const Aabb& CpuBvh::getBounds() const
+{
+	return m_bounds;
+}
+
+
+unsigned int CpuBvh::getNumNodes() const
+{
+	return m_numNodes;
+}
+
+
+unsigned int CpuBvh::getNumTriangles() const
+{
+	return static_cast<unsigned int>(m_primIds.size());
+}
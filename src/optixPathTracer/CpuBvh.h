@@ -0,0 +1,60 @@
+#pragma once
+
+#ifndef CPU_BVH_H
+#define CPU_BVH_H
+
+#include <optixu/optixu_math_namespace.h>
+#include <optixu/optixu_aabb_namespace.h>
+
+#include <vector>
+
+struct BvhHit
+{
+	float t;
+	unsigned int prim;	/* index of the triangle as passed to build() */
+	float beta;			/* barycentrics as returned by optix::intersect_triangle */
+	float gamma;
+};
+
+/*
+	Bounding volume hierarchy over a triangle soup for the CPU backend.
+	Built with a binned SAH; the top levels are built in parallel.
+	Triangles with zero or infinite area are skipped like in mesh_bounds().
+*/
+class CpuBvh
+{
+public:
+	CpuBvh();
+
+	void build(const optix::float3* vertices, const optix::int3* indices, unsigned int numTriangles, unsigned int numThreads = 0);
+	void clear();
+
+	bool intersect(const optix::float3& origin, const optix::float3& direction, float tmin, float tmax, BvhHit& hit) const;
+	bool occluded(const optix::float3& origin, const optix::float3& direction, float tmin, float tmax) const;
+
+	const optix::Aabb& getBounds() const;
+	unsigned int getNumNodes() const;
+	unsigned int getNumTriangles() const;
+
+private:
+	struct Node
+	{
+		optix::float3 bmin;
+		unsigned int  offset;	/* first child (interior) or first triangle (leaf) */
+		optix::float3 bmax;
+		unsigned int  count;	/* number of triangles, 0 for interior nodes */
+	};
+
+	struct BuildTask;
+
+	void buildRecursive(BuildTask& task, unsigned int nodeIndex, unsigned int begin, unsigned int end, int depth, int spawnDepth);
+
+private:
+	std::vector<Node>          m_nodes;
+	std::vector<unsigned int>  m_primIds;	/* leaf order -> original triangle index */
+	std::vector<optix::float3> m_triangles;	/* p0, p1, p2 per triangle in leaf order */
+	optix::Aabb                m_bounds;
+	unsigned int               m_numNodes;
+};
+
+#endif
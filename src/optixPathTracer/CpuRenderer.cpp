@@ -0,0 +1,922 @@
+#include "CpuRenderer.h"
+
+#include <sutil.h>
+
+#include "sampler.h"
+#include "bsdf.h"
+#include "light_sample.h"
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <thread>
+
+using namespace optix;
+
+#ifndef M_PI
+#define M_PI  3.14159265358979323846264338327950288419716939937510
+#endif
+
+#define CPU_TILE_SIZE 16
+
+
+//------------------------------------------------------------------------------
+//
+// Host versions of the device helpers
+//
+//------------------------------------------------------------------------------
+
+// Same as helpers.h, which cannot be included in host code because of its device-only functions.
+static inline float powerHeuristic(float a, float b)
+{
+	float t = a * a;
+	return t / (b*b + t);
+}
+
+static inline float3 ToneMap(const float3& c, float limit)
+{
+	float luminance = 0.3f*c.x + 0.6f*c.y + 0.1f*c.z;
+
+	float3 col = c * 1.0f / (1.0f + luminance / limit);
+	return make_float3(col.x, col.y, col.z);
+}
+
+static inline float3 LinearToSrgb(const float3& c)
+{
+	const float kInvGamma = 1.0f / 2.2f;
+	return make_float3(powf(c.x, kInvGamma), powf(c.y, kInvGamma), powf(c.z, kInvGamma));
+}
+
+static inline float3 clip(const float3& c)
+{
+	return make_float3(
+		c.x < 0 ? 0 : c.x > 1.0 ? 1.0 : c.x,
+		c.y < 0 ? 0 : c.y > 1.0 ? 1.0 : c.y,
+		c.z < 0 ? 0 : c.z > 1.0 ? 1.0 : c.z
+		);
+}
+
+static inline int floatAsInt(float f)
+{
+	int i;
+	memcpy(&i, &f, sizeof(i));
+	return i;
+}
+
+static inline float intAsFloat(int i)
+{
+	float f;
+	memcpy(&f, &i, sizeof(f));
+	return f;
+}
+
+// offset() and refine_and_offset_hitpoint() from intersection_refinement.h.
+static float3 offset(const float3& hit_point, const float3& normal)
+{
+	const float epsilon = 1.0e-6f;
+	const float offset = 4096.0f*2.0f;
+
+	float3 offset_point = hit_point;
+	if ((floatAsInt(hit_point.x) & 0x7fffffff) < floatAsInt(epsilon)) {
+		offset_point.x += epsilon * normal.x;
+	}
+	else {
+		offset_point.x = intAsFloat(floatAsInt(offset_point.x) + int(copysignf(offset, hit_point.x)*normal.x));
+	}
+
+	if ((floatAsInt(hit_point.y) & 0x7fffffff) < floatAsInt(epsilon)) {
+		offset_point.y += epsilon * normal.y;
+	}
+	else {
+		offset_point.y = intAsFloat(floatAsInt(offset_point.y) + int(copysignf(offset, hit_point.y)*normal.y));
+	}
+
+	if ((floatAsInt(hit_point.z) & 0x7fffffff) < floatAsInt(epsilon)) {
+		offset_point.z += epsilon * normal.z;
+	}
+	else {
+		offset_point.z = intAsFloat(floatAsInt(offset_point.z) + int(copysignf(offset, hit_point.z)*normal.z));
+	}
+
+	return offset_point;
+}
+
+static void refine_and_offset_hitpoint(const float3& original_hit_point, const float3& direction,
+	const float3& normal, const float3& p,
+	float3& back_hit_point, float3& front_hit_point)
+{
+	float  refined_t = -(dot(normal, original_hit_point - p)) / dot(normal, direction);
+	float3 refined_hit_point = original_hit_point + refined_t*direction;
+
+	if (dot(direction, normal) > 0.0f) {
+		back_hit_point = offset(refined_hit_point, normal);
+		front_hit_point = offset(refined_hit_point, -normal);
+	}
+	else {
+		back_hit_point = offset(refined_hit_point, -normal);
+		front_hit_point = offset(refined_hit_point, normal);
+	}
+}
+
+// sphere_intersect_robust from sphere_intersect.cu. Returns the accepted root.
+static bool intersectSphere(const float3& origin, const float3& direction, const float3& center, float radius, float tmin, float tmax, float& t)
+{
+	float3 O = origin - center;
+	float3 D = direction;
+
+	float b = dot(O, D);
+	float c = dot(O, O) - radius*radius;
+	float disc = b*b - c;
+	if (disc > 0.0f) {
+		float sdisc = sqrtf(disc);
+		float root1 = (-b - sdisc);
+
+		bool do_refine = fabsf(root1) > 10.f * radius;
+		float root11 = 0.0f;
+
+		if (do_refine) {
+			float3 O1 = O + root1 * direction;
+			b = dot(O1, D);
+			c = dot(O1, O1) - radius*radius;
+			disc = b*b - c;
+
+			if (disc > 0.0f) {
+				sdisc = sqrtf(disc);
+				root11 = (-b - sdisc);
+			}
+		}
+
+		if (tmin < root1 + root11 && root1 + root11 < tmax) {
+			t = root1 + root11;
+			return true;
+		}
+
+		float root2 = (-b + sdisc) + (do_refine ? root1 : 0);
+		if (tmin < root2 && root2 < tmax) {
+			t = root2;
+			return true;
+		}
+	}
+	return false;
+}
+
+
+//------------------------------------------------------------------------------
+//
+// CpuRenderer
+//
+//------------------------------------------------------------------------------
+
+CpuRenderer::CpuRenderer(unsigned int width, unsigned int height, int maxDepth, int numFrames, unsigned int numThreads)
+	: m_width(width)
+	, m_height(height)
+	, m_maxDepth(maxDepth)
+	, m_numFrames(numFrames)
+	, m_numThreads(numThreads)
+	, m_currTime(static_cast<unsigned int>(time(0)))
+	, m_samplerType(SAMPLER_SOBOL)
+	, m_sceneEpsilon(1.e-3f)
+	, m_textures(nullptr)
+	, m_environment(nullptr)
+{
+	if (m_numThreads == 0)
+	{
+		m_numThreads = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	m_eye = make_float3(0.0f);
+	m_U = make_float3(1.0f, 0.0f, 0.0f);
+	m_V = make_float3(0.0f, 1.0f, 0.0f);
+	m_W = make_float3(0.0f, 0.0f, -1.0f);
+
+	m_accumBuffer.resize(m_width * m_height, make_float4(0.0f));
+	m_outputBuffer.resize(m_width * m_height, make_float4(0.0f));
+	m_pathFeatureBuffer.resize(size_t(m_width) * m_height * m_numFrames);
+
+	m_tilesX = (m_width + CPU_TILE_SIZE - 1) / CPU_TILE_SIZE;
+	m_numTiles = m_tilesX * ((m_height + CPU_TILE_SIZE - 1) / CPU_TILE_SIZE);
+	m_tileRanges.reset(new TileRange[m_numThreads]);
+
+	std::cerr << "CPU backend: " << m_numThreads << " thread(s)" << std::endl;
+}
+
+
+optix::Aabb CpuRenderer::createGeometry(const std::vector<MeshView>& meshes, const std::vector<int>& meshGeometry,
+	const std::vector<optix::Matrix4x4>& transforms)
+{
+	Aabb aabb;
+	int num_triangles = 0;
+
+	// Placements of the same mesh file are flattened into world space copies, the BVH is single level.
+	for (size_t i = 0; i < meshGeometry.size(); ++i)
+	{
+		const MeshView& mesh = meshes[meshGeometry[i]];
+		addMesh(mesh, transforms[i], static_cast<int>(i));
+		aabb.include(transformBounds(mesh.bbox_min, mesh.bbox_max, transforms[i]));
+		num_triangles += mesh.num_triangles;
+	}
+	std::cerr << "Total triangle count: " << num_triangles << " (" << meshes.size() << " mesh files, " << meshGeometry.size() << " placements)" << std::endl;
+
+	buildBvh();
+	return aabb;
+}
+
+
+void CpuRenderer::addMesh(const MeshView& mesh, const optix::Matrix4x4& transform, int meshIndex)
+{
+	const int base = static_cast<int>(m_vertices.size());
+	const size_t count = static_cast<size_t>(mesh.num_vertices);
+
+	m_vertices.resize(base + count);
+	transformPositions(mesh.positions, mesh.num_vertices, transform, &m_vertices[base]);
+
+	m_normals.resize(base + count, make_float3(0.0f));
+	if (mesh.normals)
+		transformNormals(mesh.normals, mesh.num_vertices, transform, &m_normals[base]);
+
+	if (mesh.texcoords)
+		m_texcoords.insert(m_texcoords.end(), mesh.texcoords, mesh.texcoords + count);
+	else
+		m_texcoords.resize(base + count, make_float2(0.0f));
+
+	for (int tri = 0; tri < mesh.num_triangles; ++tri)
+	{
+		const int3& index = mesh.indices[tri];
+		m_indices.push_back(make_int3(base + index.x, base + index.y, base + index.z));
+		m_triangleMaterials.push_back(meshIndex); // Every mesh gets the material with its own index, see createMaterial().
+	}
+
+	m_meshHasNormals.push_back(mesh.normals != NULL);
+	m_meshHasTexcoords.push_back(mesh.texcoords != NULL);
+}
+
+
+void CpuRenderer::buildBvh()
+{
+	const double startTime = sutil::currentTime();
+	m_bvh.build(m_vertices.data(), m_indices.data(), static_cast<unsigned int>(m_indices.size()), m_numThreads);
+	std::cerr << "CPU BVH: " << m_bvh.getNumNodes() << " nodes, " << sutil::currentTime() - startTime << "s" << std::endl;
+}
+
+
+void CpuRenderer::setMaterials(const std::vector<MaterialParameter>& materials)
+{
+	m_materials = materials;
+}
+
+
+void CpuRenderer::setTextures(const std::vector<Texture>* textures)
+{
+	m_textures = textures;
+}
+
+
+void CpuRenderer::setLights(const std::vector<LightParameter>& lights)
+{
+	m_lights = lights;
+
+	// Same setup as createQuad() and createSphere(). Environment lights have no geometry.
+	m_lightGeometry.clear();
+	for (size_t i = 0; i < m_lights.size(); ++i)
+	{
+		const LightParameter& light = m_lights[i];
+		LightGeometry geometry;
+		geometry.lightId = static_cast<int>(i);
+
+		if (light.lightType == QUAD)
+		{
+			float3 normal = normalize(cross(light.u, light.v));
+			geometry.plane = make_float4(normal, dot(normal, light.position));
+			geometry.v1 = light.u * (1.0f / dot(light.u, light.u));
+			geometry.v2 = light.v * (1.0f / dot(light.v, light.v));
+			m_lightGeometry.push_back(geometry);
+		}
+		else if (light.lightType == SPHERE)
+		{
+			m_lightGeometry.push_back(geometry);
+		}
+	}
+}
+
+
+void CpuRenderer::setEnvironment(Texture* environment)
+{
+	m_environment = environment;
+	m_environmentCDF_U.clear();
+	m_environmentCDF_V.clear();
+
+	if (m_environment != nullptr)
+	{
+		m_environment->calculateCDF(m_environmentCDF_U, m_environmentCDF_V);
+	}
+}
+
+
+void CpuRenderer::setCamera(const float3& eye, const float3& lookat, const float3& up, float vfov)
+{
+	// Same derivation as sutil::Camera::apply() without mouse rotation.
+	m_eye = eye;
+	sutil::calculateCameraVariables(eye, lookat, up, vfov, float(m_width) / float(m_height), m_U, m_V, m_W, true);
+}
+
+
+void CpuRenderer::setMaxDepth(int maxDepth)
+{
+	m_maxDepth = maxDepth;
+}
+
+
+void CpuRenderer::setSampler(SamplerType type)
+{
+	m_samplerType = type;
+}
+
+
+const std::vector<optix::float4>& CpuRenderer::getOutputBuffer() const
+{
+	return m_outputBuffer;
+}
+
+
+const std::vector<PathFeature>& CpuRenderer::getPathFeatureBuffer() const
+{
+	return m_pathFeatureBuffer;
+}
+
+
+const std::vector<float3>& CpuRenderer::getVertices() const
+{
+	return m_vertices;
+}
+
+
+const std::vector<int3>& CpuRenderer::getIndices() const
+{
+	return m_indices;
+}
+
+
+const std::vector<int>& CpuRenderer::getTriangleMaterials() const
+{
+	return m_triangleMaterials;
+}
+
+
+unsigned int CpuRenderer::getWidth() const
+{
+	return m_width;
+}
+
+
+unsigned int CpuRenderer::getHeight() const
+{
+	return m_height;
+}
+
+
+unsigned int CpuRenderer::getNumThreads() const
+{
+	return m_numThreads;
+}
+
+
+//------------------------------------------------------------------------------
+//
+// Ray casting
+//
+//------------------------------------------------------------------------------
+
+bool CpuRenderer::trace(const float3& origin, const float3& direction, Hit& hit) const
+{
+	const float tmin = m_sceneEpsilon;
+	float tmax = RT_DEFAULT_MAX;
+
+	BvhHit meshHit;
+	const bool hitMesh = m_bvh.intersect(origin, direction, tmin, tmax, meshHit);
+	if (hitMesh)
+	{
+		tmax = meshHit.t;
+	}
+
+	int hitLight = -1;
+	for (size_t i = 0; i < m_lightGeometry.size(); ++i)
+	{
+		const LightGeometry& geometry = m_lightGeometry[i];
+		const LightParameter& light = m_lights[geometry.lightId];
+		float t;
+
+		if (light.lightType == QUAD)
+		{
+			// intersect() from quad_intersect.cu
+			const float3 n = make_float3(geometry.plane);
+			const float dt = dot(direction, n);
+			t = (geometry.plane.w - dot(n, origin)) / dt;
+			if (t > tmin && t < tmax) {
+				const float3 vi = (origin + direction * t) - light.position;
+				const float a1 = dot(geometry.v1, vi);
+				const float a2 = dot(geometry.v2, vi);
+				if (a1 >= 0 && a1 <= 1 && a2 >= 0 && a2 <= 1) {
+					tmax = t;
+					hitLight = static_cast<int>(i);
+					hit.texcoord = make_float3(a1, a2, 0);
+				}
+			}
+		}
+		else if (intersectSphere(origin, direction, light.position, light.radius, tmin, tmax, t))
+		{
+			tmax = t;
+			hitLight = static_cast<int>(i);
+		}
+	}
+
+	if (hitLight >= 0)
+	{
+		const LightGeometry& geometry = m_lightGeometry[hitLight];
+		const LightParameter& light = m_lights[geometry.lightId];
+
+		hit.t = tmax;
+		hit.materialId = -1;
+		hit.lightId = geometry.lightId;
+
+		if (light.lightType == QUAD)
+		{
+			hit.geometricNormal = hit.shadingNormal = make_float3(geometry.plane);
+			refine_and_offset_hitpoint(origin + hit.t * direction, direction, hit.geometricNormal, light.position,
+				hit.backHitPoint, hit.frontHitPoint);
+		}
+		else
+		{
+			hit.geometricNormal = hit.shadingNormal = (origin - light.position + hit.t * direction) / light.radius;
+			hit.frontHitPoint = hit.backHitPoint = origin + hit.t * direction;
+		}
+		return true;
+	}
+
+	if (hitMesh)
+	{
+		// meshIntersect<true>() from triangle_mesh.cu
+		const int3 v_idx = m_indices[meshHit.prim];
+		const float3 p0 = m_vertices[v_idx.x];
+		const float3 p1 = m_vertices[v_idx.y];
+		const float3 p2 = m_vertices[v_idx.z];
+		const float beta = meshHit.beta;
+		const float gamma = meshHit.gamma;
+
+		hit.t = meshHit.t;
+		hit.materialId = m_triangleMaterials[meshHit.prim];
+		hit.lightId = -1;
+
+		hit.geometricNormal = normalize(cross(p0 - p2, p1 - p0));
+		if (!m_meshHasNormals[hit.materialId]) {
+			hit.shadingNormal = hit.geometricNormal;
+		}
+		else {
+			hit.shadingNormal = normalize(m_normals[v_idx.y] * beta + m_normals[v_idx.z] * gamma + m_normals[v_idx.x] * (1.0f - beta - gamma));
+		}
+
+		if (!m_meshHasTexcoords[hit.materialId]) {
+			hit.texcoord = make_float3(0.0f, 0.0f, 0.0f);
+		}
+		else {
+			hit.texcoord = make_float3(m_texcoords[v_idx.y] * beta + m_texcoords[v_idx.z] * gamma + m_texcoords[v_idx.x] * (1.0f - beta - gamma));
+		}
+
+		refine_and_offset_hitpoint(origin + hit.t * direction, direction, hit.geometricNormal, p0,
+			hit.backHitPoint, hit.frontHitPoint);
+		return true;
+	}
+
+	return false;
+}
+
+
+// Shadow rays only see the meshes. The light materials have no any hit program for ray type 1.
+bool CpuRenderer::occluded(const float3& origin, const float3& direction, float tmax) const
+{
+	return m_bvh.occluded(origin, direction, m_sceneEpsilon, tmax);
+}
+
+
+//------------------------------------------------------------------------------
+//
+// Programs
+//
+//------------------------------------------------------------------------------
+
+void CpuRenderer::sampleEnvironment(const LightParameter& light, Sampler& sampler, LightSample& lightSample) const
+{
+	// envmap_sample from light_sample.cu
+	const float r1 = rnd(sampler);
+	const float r2 = rnd(sampler);
+
+	const unsigned int sizeU = m_environment->getWidth() + 1;
+	const unsigned int sizeV = m_environment->getHeight() + 1;
+
+	unsigned int ilo = 0;
+	unsigned int ihi = sizeV - 1;
+
+	while (ilo != ihi - 1)
+	{
+		const unsigned int i = (ilo + ihi) >> 1;
+		const float cdf = m_environmentCDF_V[i];
+		if (r2 < cdf)
+		{
+			ihi = i;
+		}
+		else
+		{
+			ilo = i;
+		}
+	}
+
+	uint2 index;
+	index.y = ilo;
+
+	const float* cdfU = m_environmentCDF_U.data() + index.y * sizeU;
+
+	ilo = 0;
+	ihi = sizeU - 1;
+
+	while (ilo != ihi - 1)
+	{
+		index.x = (ilo + ihi) >> 1;
+		const float cdf = cdfU[index.x];
+		if (r1 < cdf)
+		{
+			ihi = index.x;
+		}
+		else
+		{
+			ilo = index.x;
+		}
+	}
+
+	index.x = ilo;
+
+	// Continuous sampling of the CDF.
+	const float cdfLowerU = cdfU[index.x];
+	const float cdfUpperU = cdfU[index.x + 1];
+	const float du = (r1 - cdfLowerU) / (cdfUpperU - cdfLowerU);
+
+	const float cdfLowerV = m_environmentCDF_V[index.y];
+	const float cdfUpperV = m_environmentCDF_V[index.y + 1];
+	const float dv = (r2 - cdfLowerV) / (cdfUpperV - cdfLowerV);
+
+	const float u = (float(index.x) + du) / float(sizeU - 1);
+	const float v = (float(index.y) + dv) / float(sizeV - 1);
+
+	const float phi = u * 2.0f * M_PIf;
+	const float theta = v * M_PIf;
+
+	const float sinTheta = sinf(theta);
+	lightSample.direction = make_float3(-sinf(phi) * sinTheta,
+		-cosf(theta),
+		cosf(phi) * sinTheta);
+
+	lightSample.distance = RT_DEFAULT_MAX;
+
+	const float3 emission = make_float3(m_environment->sampleHost(u, v, true));
+	lightSample.emission = emission / light.selectionPdf;
+	lightSample.pdf = 0.3333333333f * (emission.x + emission.y + emission.z) / light.environmentIntegral;
+}
+
+
+void CpuRenderer::sampleLight(const LightParameter& light, const float3& surfacePos, Sampler& sampler, LightSample& lightSample) const
+{
+	switch (light.lightType)
+	{
+	case ENVMAP:
+		sampleEnvironment(light, sampler, lightSample);
+		break;
+	case SPHERE:
+		sampleSphereLight(light, surfacePos, sampler, lightSample);
+		break;
+	case QUAD:
+		sampleQuadLight(light, surfacePos, sampler, lightSample);
+		break;
+	}
+}
+
+
+float3 CpuRenderer::directLight(MaterialParameter& mat, State& state, PerRayData_radiance& prd) const
+{
+	// DirectLight() from hit_program.cu
+	float3 L = make_float3(0.0f);
+
+	const int numberOfLights = static_cast<int>(m_lights.size());
+	if (numberOfLights == 0)
+	{
+		return L;
+	}
+
+	//Pick a light to sample
+	samplerStartDimension(prd.sampler, prd.depth, SAMPLER_LIGHT_DIMENSION);
+	int index = selectLight(m_lights, numberOfLights, rnd(prd.sampler));
+	const LightParameter& light = m_lights[index];
+	LightSample lightSample;
+
+	float3 surfacePos = state.fhp;
+
+	sampleLight(light, surfacePos, prd.sampler, lightSample);
+
+	if (0.0f < lightSample.pdf)
+	{
+		prd.bsdfDir = lightSample.direction;
+		bsdfPdf(mat, state, prd);
+		float3 f = bsdfEval(mat, state, prd);
+
+		if (0.0f < prd.pdf && (f.x != 0.0f || f.y != 0.0f || f.z != 0.0f))
+		{
+			if (!occluded(surfacePos, lightSample.direction, lightSample.distance - m_sceneEpsilon))
+			{
+				const float misWeight = powerHeuristic(lightSample.pdf, prd.pdf);
+				L = misWeight * prd.throughput * f * lightSample.emission / fmaxf(1e-3f, lightSample.pdf);
+			}
+		}
+	}
+
+	return L;
+}
+
+
+void CpuRenderer::closestHit(const Hit& hit, const float3& direction, PerRayData_radiance& prd) const
+{
+	// closest_hit() from hit_program.cu
+	const float3 world_shading_normal = normalize(hit.shadingNormal);
+	const float3 world_geometric_normal = normalize(hit.geometricNormal);
+	const float3 ffnormal = faceforward(world_shading_normal, -direction, world_geometric_normal);
+
+	MaterialParameter mat = m_materials[hit.materialId];
+
+	if (mat.albedoID != RT_TEXTURE_ID_NULL && m_textures != nullptr)
+	{
+		const float3 texColor = make_float3((*m_textures)[mat.albedoID - 1].sampleHost(hit.texcoord.x, hit.texcoord.y));
+		mat.color = make_float3(powf(texColor.x, 2.2f), powf(texColor.y, 2.2f), powf(texColor.z, 2.2f));
+	}
+
+	State state;
+	state.fhp = hit.frontHitPoint;
+	state.bhp = hit.backHitPoint;
+	state.normal = world_shading_normal;
+	state.ffnormal = ffnormal;
+	prd.wo = -direction;
+
+	// Emissive radiance
+	prd.radiance += mat.emission * prd.throughput;
+
+	prd.specularBounce = mat.brdf == GLASS || mat.brdf == ROUGHDIELECTRIC ? true : false;
+
+	// Direct light Sampling
+	if (!prd.specularBounce && prd.depth < m_maxDepth)
+		prd.radiance += directLight(mat, state, prd);
+
+	// BRDF Sampling
+	samplerStartDimension(prd.sampler, prd.depth, SAMPLER_BSDF_DIMENSION);
+	bsdfSample(mat, state, prd);
+	bsdfPdf(mat, state, prd);
+	float3 f = bsdfEval(mat, state, prd);
+
+	prd.albedo = mat.color;
+	prd.normal = ffnormal;
+
+	if (prd.pdf > 0.0f)
+	{
+		prd.throughput *= f / prd.pdf;
+	}
+	else
+	{
+		prd.done = true;
+	}
+}
+
+
+void CpuRenderer::lightClosestHit(const Hit& hit, const float3& direction, PerRayData_radiance& prd) const
+{
+	// closest_hit() from light_hit_program.cu
+	const float3 world_shading_normal = normalize(hit.shadingNormal);
+	const float3 world_geometric_normal = normalize(hit.geometricNormal);
+	const float3 ffnormal = faceforward(world_shading_normal, -direction, world_geometric_normal);
+
+	const LightParameter& light = m_lights[hit.lightId];
+	float cosTheta = 0.0f;
+	if (light.lightType == QUAD)
+	{
+		cosTheta = dot(-direction, light.normal);
+	}
+	else if (light.lightType == SPHERE)
+	{
+		const float3 lightNormal = normalize(hit.frontHitPoint - light.position);
+		cosTheta = dot(-direction, lightNormal);
+	}
+
+	if ((light.lightType == QUAD || light.lightType == SPHERE) && cosTheta > 0.0f)
+	{
+		if (prd.depth == 0 || prd.specularBounce)
+		{
+			prd.radiance += light.emission * prd.throughput;
+		}
+		else
+		{
+			float lightPdf = (hit.t * hit.t) / (light.area * clamp(cosTheta, 1.e-3f, 1.0f));
+			prd.radiance += powerHeuristic(prd.pdf, lightPdf) * light.emission * prd.throughput;
+		}
+
+		prd.albedo = LinearToSrgb(ToneMap(light.emission, 1.5));
+		prd.normal = ffnormal;
+	}
+	else
+	{
+		prd.albedo = make_float3(0.f);
+		prd.normal = ffnormal;
+	}
+
+	prd.done = true;
+}
+
+
+void CpuRenderer::miss(const float3& direction, PerRayData_radiance& prd) const
+{
+	// miss() from background.cu
+	if (m_environment == nullptr || m_lights.empty())
+	{
+		prd.albedo = make_float3(0.f);
+		prd.normal = make_float3(0.f);
+
+		prd.done = true;
+	}
+	else
+	{
+		const LightParameter& light = m_lights.back();
+
+		float3 dir = normalize(direction);
+		float theta = acosf(-dir.y);
+		float phi = (dir.x == 0.0f && dir.z == 0.0f) ? 0.0f : atan2f(dir.x, -dir.z);
+		float u = float((M_PI + phi) * (0.5f * M_1_PIf));
+		float v = theta * M_1_PIf;
+
+		const float3 emission = make_float3(m_environment->sampleHost(u, v, true));
+
+		float misWeight = 1.0f;
+		if (!prd.specularBounce && prd.depth != 0)
+		{
+			const float pdfLight = 0.3333333333f * (emission.x + emission.y + emission.z) / light.environmentIntegral;
+			misWeight = powerHeuristic(prd.pdf, pdfLight);
+		}
+
+		prd.radiance += misWeight * emission * prd.throughput;
+		prd.albedo = LinearToSrgb(ToneMap(emission, 1.5));
+		prd.normal = make_float3(0.f);
+
+		prd.done = true;
+	}
+}
+
+
+void CpuRenderer::renderPixel(unsigned int x, unsigned int y, unsigned int frame)
+{
+	// pinhole_camera() from path_trace_camera.cu
+	Sampler sampler = makeSampler(m_samplerType, x, y, m_width, frame, m_currTime);
+
+	float2 subpixel_jitter = frame == 0 ? make_float2(0.0f) : make_float2(rnd(sampler) - 0.5f, rnd(sampler) - 0.5f);
+
+	float2 d = (make_float2(float(x), float(y)) + subpixel_jitter) / make_float2(float(m_width), float(m_height)) * 2.f - 1.f;
+	float3 ray_origin = m_eye;
+	float3 ray_direction = normalize(d.x*m_U + d.y*m_V + m_W);
+
+	PerRayData_radiance prd;
+	prd.depth = 0;
+	prd.sampler = sampler;
+	prd.done = false;
+	prd.pdf = 0.0f;
+	prd.specularBounce = false;
+	prd.thpt_at_vtx = make_float3(0.0f);
+	prd.tag = DIFF;
+	prd.roughness = 0.0f;
+	prd.throughput = make_float3(1.0f);
+	prd.radiance = make_float3(0.0f);
+	prd.origin = make_float3(0.0f);
+	prd.bsdfDir = make_float3(0.0f);
+
+	float3 result = make_float3(0.0f);
+
+	PathFeature pf{
+		{ optix::make_float3(0.f) }, { DIFF }, { 0.0f }, // multi-bounce features
+		make_float3(0.f), make_float3(0.f), make_float3(0.f), // first-bounce features
+		1.0f // MC probability
+	};
+
+	for (;;) {
+		prd.wo = -ray_direction;
+
+		Hit hit;
+		if (!trace(ray_origin, ray_direction, hit))
+			miss(ray_direction, prd);
+		else if (hit.lightId >= 0)
+			lightClosestHit(hit, ray_direction, prd);
+		else
+			closestHit(hit, ray_direction, prd);
+
+		if (prd.depth == 0)
+		{
+			pf.albedo = clip(prd.albedo);
+			pf.normal = (prd.normal.x == 0.f && prd.normal.y == 0.f && prd.normal.z == 0.f) ?
+				prd.normal :
+				0.5f * normalize(prd.normal) + 0.5f;
+		}
+
+		if (prd.done)
+			break;
+
+		/* Path features */
+		pf.prob *= prd.pdf;
+		if (prd.depth < 6)
+		{
+			pf.throughput[prd.depth] = prd.thpt_at_vtx;
+			pf.tag[prd.depth] = (float)prd.tag;
+			pf.roughness[prd.depth] = prd.roughness;
+		}
+		else
+		{
+			pf.throughput[5] *= prd.thpt_at_vtx;
+		}
+
+		if (prd.done || prd.depth >= m_maxDepth)
+			break;
+
+		prd.depth++;
+
+		ray_origin = prd.origin;
+		ray_direction = prd.bsdfDir;
+	}
+
+	pf.radiance = prd.radiance;
+	result = prd.radiance;
+
+	const unsigned int pixel = m_width * y + x;
+
+	float4 acc_val = m_accumBuffer[pixel];
+	if (frame > 0) {
+		acc_val = lerp(acc_val, make_float4(result, 0.f), 1.0f / static_cast<float>(frame + 1));
+	}
+	else {
+		acc_val = make_float4(result, 0.f);
+	}
+
+	m_outputBuffer[pixel] = acc_val;
+	m_accumBuffer[pixel] = acc_val;
+	if (frame < static_cast<unsigned int>(m_numFrames))
+		m_pathFeatureBuffer[size_t(pixel) * m_numFrames + frame] = pf;
+}
+
+
+void CpuRenderer::renderTiles(unsigned int threadIndex, unsigned int frame)
+{
+	// Drain the own range first, then steal from the other threads in round robin order.
+	for (unsigned int k = 0; k < m_numThreads; ++k)
+	{
+		TileRange& range = m_tileRanges[(threadIndex + k) % m_numThreads];
+
+		for (;;)
+		{
+			const unsigned int tile = range.next.fetch_add(1);
+			if (tile >= range.end)
+				break;
+
+			const unsigned int x0 = (tile % m_tilesX) * CPU_TILE_SIZE;
+			const unsigned int y0 = (tile / m_tilesX) * CPU_TILE_SIZE;
+			const unsigned int x1 = std::min(x0 + CPU_TILE_SIZE, m_width);
+			const unsigned int y1 = std::min(y0 + CPU_TILE_SIZE, m_height);
+
+			for (unsigned int y = y0; y < y1; ++y)
+			{
+				for (unsigned int x = x0; x < x1; ++x)
+				{
+					renderPixel(x, y, frame);
+				}
+			}
+		}
+	}
+}
+
+
+void CpuRenderer::launch(unsigned int frame)
+{
+	for (unsigned int i = 0; i < m_numThreads; ++i)
+	{
+		m_tileRanges[i].next = (m_numTiles * i) / m_numThreads;
+		m_tileRanges[i].end = (m_numTiles * (i + 1)) / m_numThreads;
+	}
+
+	std::vector<std::thread> workers;
+	for (unsigned int i = 1; i < m_numThreads; ++i)
+	{
+		workers.emplace_back(&CpuRenderer::renderTiles, this, i, frame);
+	}
+	renderTiles(0, frame);
+
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+}
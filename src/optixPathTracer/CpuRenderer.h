@@ -0,0 +1,147 @@
+#pragma once
+
+#ifndef CPU_RENDERER_H
+#define CPU_RENDERER_H
+
+#include <optixu/optixu_math_namespace.h>
+#include <optixu/optixu_aabb_namespace.h>
+#include <optixu/optixu_matrix_namespace.h>
+
+#include "CpuBvh.h"
+#include "SceneBundle.h"
+#include "light_parameters.h"
+#include "material_parameters.h"
+#include "path.h"
+#include "prd.h"
+#include "state.h"
+#include "Texture.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+	Multi-threaded CPU implementation of the OptiX programs used by OptaGen.
+	pinhole_camera, closest_hit (hit_program.cu and light_hit_program.cu), miss and the light and BSDF callables
+	are mirrored on the host, so the output and path feature buffers have the same layout as the device buffers.
+	The image is split into tiles; every thread owns a contiguous range of tiles and steals from the others when done.
+*/
+class CpuRenderer
+{
+public:
+	CpuRenderer(unsigned int width, unsigned int height, int maxDepth, int numFrames, unsigned int numThreads = 0);
+
+	// meshes are the mesh files, placement i draws meshes[meshGeometry[i]] with transforms[i] and material i.
+	optix::Aabb createGeometry(const std::vector<MeshView>& meshes, const std::vector<int>& meshGeometry,
+		const std::vector<optix::Matrix4x4>& transforms);
+
+	void setMaterials(const std::vector<MaterialParameter>& materials);
+	void setTextures(const std::vector<Texture>* textures);	/* albedoID is a 1-based index into this list */
+	void setLights(const std::vector<LightParameter>& lights);
+	void setEnvironment(Texture* environment);				/* nullptr is the same as option == 0 in the miss program */
+	void setCamera(const optix::float3& eye, const optix::float3& lookat, const optix::float3& up, float vfov);
+	void setMaxDepth(int maxDepth);
+	void setSampler(SamplerType type);						/* sampler_type of pinhole_camera, SAMPLER_SOBOL by default */
+
+	void launch(unsigned int frame);
+
+	const std::vector<optix::float4>& getOutputBuffer() const;
+	const std::vector<PathFeature>& getPathFeatureBuffer() const;	/* width * height * numFrames, like mbpf_buffer */
+
+	const std::vector<optix::float3>& getVertices() const;	/* world space, all meshes */
+	const std::vector<optix::int3>& getIndices() const;
+	const std::vector<int>& getTriangleMaterials() const;	/* material and mesh index per triangle */
+
+	unsigned int getWidth() const;
+	unsigned int getHeight() const;
+	unsigned int getNumThreads() const;
+
+private:
+	struct Hit
+	{
+		float         t;
+		int           materialId;		/* mesh material, -1 for lights */
+		int           lightId;			/* index into the light parameters, -1 for meshes */
+		optix::float3 geometricNormal;
+		optix::float3 shadingNormal;
+		optix::float3 texcoord;
+		optix::float3 frontHitPoint;
+		optix::float3 backHitPoint;
+	};
+
+	struct LightGeometry
+	{
+		int           lightId;
+		optix::float4 plane;	/* quads */
+		optix::float3 v1;
+		optix::float3 v2;
+	};
+
+	void addMesh(const MeshView& mesh, const optix::Matrix4x4& transform, int meshIndex);
+	void buildBvh();
+
+	bool trace(const optix::float3& origin, const optix::float3& direction, Hit& hit) const;
+	bool occluded(const optix::float3& origin, const optix::float3& direction, float tmax) const;
+
+	void closestHit(const Hit& hit, const optix::float3& direction, PerRayData_radiance& prd) const;
+	void lightClosestHit(const Hit& hit, const optix::float3& direction, PerRayData_radiance& prd) const;
+	void miss(const optix::float3& direction, PerRayData_radiance& prd) const;
+
+	optix::float3 directLight(MaterialParameter& mat, State& state, PerRayData_radiance& prd) const;
+	void sampleLight(const LightParameter& light, const optix::float3& surfacePos, Sampler& sampler, LightSample& lightSample) const;
+	void sampleEnvironment(const LightParameter& light, Sampler& sampler, LightSample& lightSample) const;
+
+	void renderPixel(unsigned int x, unsigned int y, unsigned int frame);
+	void renderTiles(unsigned int threadIndex, unsigned int frame);
+
+private:
+	unsigned int m_width;
+	unsigned int m_height;
+	int          m_maxDepth;
+	int          m_numFrames;
+	unsigned int m_numThreads;
+	unsigned int m_currTime;
+	SamplerType  m_samplerType;
+	float        m_sceneEpsilon;
+
+	optix::float3 m_eye;
+	optix::float3 m_U;
+	optix::float3 m_V;
+	optix::float3 m_W;
+
+	// Geometry (world space triangle soup of all meshes)
+	CpuBvh                      m_bvh;
+	std::vector<optix::float3>  m_vertices;
+	std::vector<optix::float3>  m_normals;
+	std::vector<optix::float2>  m_texcoords;
+	std::vector<optix::int3>    m_indices;
+	std::vector<int>            m_triangleMaterials;
+	std::vector<char>           m_meshHasNormals;
+	std::vector<char>           m_meshHasTexcoords;
+
+	std::vector<MaterialParameter> m_materials;
+	std::vector<LightParameter>    m_lights;
+	std::vector<LightGeometry>     m_lightGeometry;
+	const std::vector<Texture>*    m_textures;
+
+	Texture*           m_environment;
+	std::vector<float> m_environmentCDF_U;
+	std::vector<float> m_environmentCDF_V;
+
+	std::vector<optix::float4> m_accumBuffer;
+	std::vector<optix::float4> m_outputBuffer;
+	std::vector<PathFeature>   m_pathFeatureBuffer;
+
+	struct TileRange
+	{
+		std::atomic<unsigned int> next;	/* next tile to render, shared with stealing threads */
+		unsigned int              end;
+		char                      padding[56];	/* keep the cursors on separate cache lines */
+	};
+	std::unique_ptr<TileRange[]> m_tileRanges;
+	unsigned int                 m_tilesX;
+	unsigned int                 m_numTiles;
+};
+
+#endif
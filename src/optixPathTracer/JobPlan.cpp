@@ -0,0 +1,625 @@
+#include "JobPlan.h"
+
+#include "sceneLoader.h"
+#include "SceneBundle.h"
+#include "path.h"
+
+#include <Mesh.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <iomanip>
+#include <sstream>
+
+// Not exposed by OptiX, measured Trbvh sizes are in this range including the triangle data it keeps.
+#define OPTIX_BVH_BYTES_PER_TRIANGLE 64
+// CpuBvh: about one 32 byte node per triangle (leaves of up to 4), the primitive id and the leaf order copy.
+#define CPU_BVH_BYTES_PER_TRIANGLE (32 + 4 + 36)
+#define NPY_HEADER_BYTES 128
+
+
+JobSettings::JobSettings()
+	: width(0)
+	, height(0)
+	, spp(1)
+	, ref_spp(1)
+	, patches(1)
+	, features(false)
+	, reference(false)
+	, cpu(false)
+	, random_cameras(false)
+	, quantized_meshes(false)
+	, occupancy_resolution(0)
+{
+}
+
+
+JobPlan::JobPlan()
+	: m_featureBytes(0)
+	, m_referenceBytes(0)
+	, m_triangles(0)
+	, m_cost(0.0)
+{
+}
+
+
+static bool endsWith(const std::string& s, const char* suffix)
+{
+	const size_t n = strlen(suffix);
+	if (s.size() < n)
+		return false;
+	for (size_t i = 0; i < n; ++i)
+	{
+		if (tolower(static_cast<unsigned char>(s[s.size() - n + i])) != suffix[i])
+			return false;
+	}
+	return true;
+}
+
+
+void JobPlan::estimate(const Scene& scene, const JobSettings& settings)
+{
+	m_settings = settings;
+	m_items.clear();
+	m_warnings.clear();
+
+	const uint64_t pixels = uint64_t(settings.width) * settings.height;
+	const uint64_t featureBytes = pixels * settings.spp * sizeof(PathFeature);
+	const uint64_t referenceBytes = pixels * 3 * sizeof(float);
+
+	// Frame buffers, see createContext() and CpuRenderer. Output buffers keep a host copy once they are mapped.
+	if (settings.cpu)
+	{
+		add("frame buffers", pixels * 2 * 4 * sizeof(float), 0, "output + accumulation");
+		add("path features", featureBytes, 0, std::to_string(settings.spp) + " x " + std::to_string(sizeof(PathFeature)) + " B per pixel");
+	}
+	else
+	{
+		add("frame buffers", pixels * 4 * sizeof(float), pixels * 2 * 4 * sizeof(float), "output + accumulation");
+		add("path features", settings.features ? featureBytes : 0, featureBytes,
+			std::to_string(settings.spp) + " x " + std::to_string(sizeof(PathFeature)) + " B per pixel");
+	}
+	add("npy staging", std::max(settings.features ? featureBytes : 0, settings.reference ? referenceBytes : 0), 0);
+
+	// Geometry, from the bundle or a scan of the mesh files.
+	std::vector<MeshCounts> counts(scene.geometry_names.size());
+	for (size_t g = 0; g < scene.geometry_names.size(); ++g)
+	{
+		MeshCounts& c = counts[g];
+		if (scene.bundle)
+		{
+			const MeshView& view = scene.bundle->getMeshes()[g];
+			c.num_vertices = view.num_vertices;
+			c.num_triangles = view.num_triangles;
+			c.has_normals = view.normals != NULL;
+			c.has_texcoords = view.texcoords != NULL;
+		}
+		else if (!scanMeshCounts(scene.geometry_names[g], c))
+		{
+			m_warnings.push_back("could not scan " + scene.geometry_names[g]);
+			memset(&c, 0, sizeof(c));
+		}
+	}
+
+	std::vector<int> placements(counts.size(), 0);
+	for (size_t i = 0; i < scene.mesh_geometry.size(); ++i)
+		++placements[scene.mesh_geometry[i]];
+
+	// Quantized meshes are staged in floats on the host, see MeshLoader::loadMesh(QuantizedMesh&).
+	const bool quantized = settings.quantized_meshes && !settings.cpu && !scene.bundle;
+	uint64_t uniqueVertexBytes = 0, uniqueTriangles = 0, largestMesh = 0, placedVertices = 0;
+	bool anyTexcoords = false;
+	m_triangles = 0;
+	for (size_t g = 0; g < counts.size(); ++g)
+	{
+		const MeshCounts& c = counts[g];
+		const uint64_t meshBytes = c.num_vertices * (12 + (c.has_normals ? 12 : 0) + (c.has_texcoords ? 8 : 0)) + c.num_triangles * (12 + 4);
+		const uint64_t quantizedBytes = c.num_vertices * (8 + (c.has_normals ? 4 : 0) + (c.has_texcoords ? 4 : 0)) + c.num_triangles * (12 + 4);
+		uniqueVertexBytes += quantized ? quantizedBytes : meshBytes;
+		uniqueTriangles += c.num_triangles;
+		largestMesh = std::max(largestMesh, quantized ? meshBytes + quantizedBytes : meshBytes);
+		placedVertices += c.num_vertices * placements[g];
+		m_triangles += c.num_triangles * placements[g];
+		anyTexcoords |= c.has_texcoords;
+	}
+
+	const std::string geometryNote = std::to_string(counts.size()) + " file(s), " + std::to_string(scene.mesh_geometry.size()) + " placement(s), " +
+		std::to_string(m_triangles) + " triangles" + (quantized ? ", quantized" : "");
+	if (settings.cpu)
+	{
+		// Every placement is flattened into world space.
+		add("geometry", placedVertices * (12 + 12 + (anyTexcoords ? 8 : 0)) + m_triangles * (12 + 4), 0, geometryNote);
+		add("acceleration", m_triangles * CPU_BVH_BYTES_PER_TRIANGLE, 0, "CpuBvh, estimate");
+	}
+	else
+	{
+		// Files are loaded one at a time and shared by their placements on the device.
+		add("geometry", largestMesh, uniqueVertexBytes, geometryNote);
+		add("acceleration", 0, uniqueTriangles * OPTIX_BVH_BYTES_PER_TRIANGLE, "Trbvh, estimate");
+	}
+	const uint64_t parameterBytes = scene.materials.size() * sizeof(MaterialParameter) + scene.lights.size() * sizeof(LightParameter);
+	add("materials and lights", settings.cpu ? parameterBytes : 0, settings.cpu ? 0 : parameterBytes);
+
+	if (settings.random_cameras)
+	{
+		const uint64_t res = settings.occupancy_resolution;
+		add("camera probe", placedVertices * 12 + m_triangles * (12 + 4 + 12 + CPU_BVH_BYTES_PER_TRIANGLE) + res * res * res * (1 + sizeof(float)), 0,
+			"host copy, surface alias table, occupancy grid");
+	}
+
+	// Textures are expanded to four channels, the CPU backend keeps float texels.
+	uint64_t textureHost = 0, textureDevice = 0, largestPicture = 0;
+	for (std::map<int, std::string>::const_iterator it = scene.texture_map.begin(); it != scene.texture_map.end(); ++it)
+	{
+		int w, h, bpc;
+		const std::string fn = scene.dir + it->second;
+		if (!readImageSize(fn, w, h, bpc))
+		{
+			m_warnings.push_back("could not read the size of " + fn);
+			continue;
+		}
+		const uint64_t texels = uint64_t(w) * h;
+		largestPicture = std::max(largestPicture, texels * 4 * bpc);
+		if (settings.cpu)
+			textureHost += texels * 4 * sizeof(float);
+		else
+			textureDevice += texels * 4 * bpc;
+	}
+	add("textures", textureHost + largestPicture, textureDevice, std::to_string(scene.texture_map.size()) + " file(s)");
+
+	// Environment map with its sampling CDFs. Batches draw one of the HDRIs per patch, the largest one is planned for.
+	std::vector<std::string> envmaps;
+	if (settings.patches > 1 && !settings.hdrs_dir.empty())
+	{
+		if (DIR* dir = opendir(settings.hdrs_dir.c_str()))
+		{
+			while (struct dirent* entry = readdir(dir))
+			{
+				if (endsWith(entry->d_name, ".hdr"))
+					envmaps.push_back(settings.hdrs_dir + entry->d_name);
+			}
+			closedir(dir);
+		}
+		else
+			m_warnings.push_back("could not open " + settings.hdrs_dir);
+	}
+	else if (!scene.properties.envmap_fn.empty())
+		envmaps.push_back(scene.properties.envmap_fn);
+
+	uint64_t envTexels = 0, envHeight = 0;
+	for (size_t i = 0; i < envmaps.size(); ++i)
+	{
+		int w, h, bpc;
+		if (!readImageSize(envmaps[i], w, h, bpc))
+		{
+			m_warnings.push_back("could not read the size of " + envmaps[i]);
+			continue;
+		}
+		if (uint64_t(w) * h > envTexels)
+		{
+			envTexels = uint64_t(w) * h;
+			envHeight = h;
+		}
+	}
+	if (!envmaps.empty())
+	{
+		const uint64_t texels = envTexels * 4 * sizeof(float);
+		const uint64_t cdfs = (envTexels + envHeight + envHeight + 1) * sizeof(float);
+		const std::string note = envmaps.size() > 1 ? "largest of " + std::to_string(envmaps.size()) + " HDRIs" : std::string();
+		if (settings.cpu)
+			add("environment map", texels + cdfs + texels, 0, note);
+		else
+			add("environment map", texels + texels, texels + cdfs, note);
+	}
+
+	m_featureBytes = settings.features ? NPY_HEADER_BYTES + featureBytes : 0;
+	m_referenceBytes = settings.reference ? NPY_HEADER_BYTES + referenceBytes : 0;
+
+	// Path samples times bounces times the depth of a balanced hierarchy over the placed triangles.
+	const double samples = double(pixels) * ((settings.features ? settings.spp : 0) + (settings.reference ? settings.ref_spp : 0));
+	m_cost = samples * scene.properties.max_depth * (1.0 + std::log2(1.0 + double(m_triangles))) * settings.patches * 1e-9;
+}
+
+
+void JobPlan::add(const std::string& name, uint64_t host, uint64_t device, const std::string& note)
+{
+	Item item = { name, host, device, note };
+	m_items.push_back(item);
+}
+
+
+static std::string megabytes(uint64_t bytes)
+{
+	std::ostringstream out;
+	out << std::fixed << std::setprecision(1) << bytes / (1024.0 * 1024.0);
+	return out.str();
+}
+
+
+void JobPlan::print(std::ostream& out) const
+{
+	out << "[Plan] " << m_settings.width << " x " << m_settings.height << ", spp " << m_settings.spp;
+	if (m_settings.reference)
+		out << ", mspp " << m_settings.ref_spp;
+	out << ", " << m_settings.patches << " patch(es), " << (m_settings.cpu ? "cpu" : "optix") << " backend\n";
+
+	out << "  " << std::left << std::setw(22) << "category" << std::right << std::setw(12) << "host MB" << std::setw(12) << "device MB" << "\n";
+	for (size_t i = 0; i < m_items.size(); ++i)
+	{
+		const Item& item = m_items[i];
+		out << "  " << std::left << std::setw(22) << item.name << std::right << std::setw(12) << megabytes(item.host) << std::setw(12) << megabytes(item.device);
+		if (!item.note.empty())
+			out << "  (" << item.note << ")";
+		out << "\n";
+	}
+	out << "  " << std::left << std::setw(22) << "total" << std::right << std::setw(12) << megabytes(getHostBytes()) << std::setw(12) << megabytes(getDeviceBytes()) << "\n";
+
+	out << "[Plan] output per patch: " << megabytes(getOutputBytesPerPatch()) << " MB (features " << megabytes(m_featureBytes)
+		<< " MB, reference " << megabytes(m_referenceBytes) << " MB), all patches " << megabytes(getOutputBytesPerPatch() * m_settings.patches) << " MB\n";
+	out << "[Plan] cost score: " << std::setprecision(3) << m_cost << "\n";
+
+	for (size_t i = 0; i < m_warnings.size(); ++i)
+		out << "[Plan] warning: " << m_warnings[i] << "\n";
+}
+
+
+uint64_t JobPlan::getHostBytes() const
+{
+	uint64_t bytes = 0;
+	for (size_t i = 0; i < m_items.size(); ++i)
+		bytes += m_items[i].host;
+	return bytes;
+}
+
+
+uint64_t JobPlan::getDeviceBytes() const
+{
+	uint64_t bytes = 0;
+	for (size_t i = 0; i < m_items.size(); ++i)
+		bytes += m_items[i].device;
+	return bytes;
+}
+
+
+uint64_t JobPlan::getOutputBytesPerPatch() const
+{
+	return m_featureBytes + m_referenceBytes;
+}
+
+
+double JobPlan::getCostScore() const
+{
+	return m_cost;
+}
+
+
+uint64_t JobPlan::getMeshBytes() const
+{
+	uint64_t bytes = 0;
+	for (size_t i = 0; i < m_items.size(); ++i)
+	{
+		if (m_items[i].name == "geometry" || m_items[i].name == "acceleration")
+			bytes += m_settings.cpu ? m_items[i].host : m_items[i].device;
+	}
+	return bytes;
+}
+
+
+uint64_t estimateMeshBytes(const MeshCounts& counts, const JobSettings& settings)
+{
+	const uint64_t indexBytes = counts.num_triangles * (12 + 4);
+	if (settings.cpu)
+		return counts.num_vertices * (12 + 12 + (counts.has_texcoords ? 8 : 0)) + indexBytes + counts.num_triangles * CPU_BVH_BYTES_PER_TRIANGLE;
+
+	const uint64_t vertexBytes = settings.quantized_meshes
+		? counts.num_vertices * (8 + (counts.has_normals ? 4 : 0) + (counts.has_texcoords ? 4 : 0))
+		: counts.num_vertices * (12 + (counts.has_normals ? 12 : 0) + (counts.has_texcoords ? 8 : 0));
+	return vertexBytes + indexBytes + counts.num_triangles * OPTIX_BVH_BYTES_PER_TRIANGLE;
+}
+
+
+//------------------------------------------------------------------------------
+//
+// Mesh and image headers
+//
+//------------------------------------------------------------------------------
+
+struct ObjCounts
+{
+	uint64_t v, vn, vt, triangles;
+};
+
+
+static void scanObjLine(const char* cur, const char* end, ObjCounts& counts)
+{
+	while (cur < end && (*cur == ' ' || *cur == '\t'))
+		++cur;
+	if (end - cur < 2)
+		return;
+
+	if (cur[0] == 'v')
+	{
+		if (cur[1] == ' ' || cur[1] == '\t')
+			++counts.v;
+		else if (cur[1] == 'n')
+			++counts.vn;
+		else if (cur[1] == 't')
+			++counts.vt;
+	}
+	else if (cur[0] == 'f' && (cur[1] == ' ' || cur[1] == '\t'))
+	{
+		// Polygons are triangulated as fans.
+		int corners = 0;
+		bool inToken = false;
+		for (++cur; cur < end; ++cur)
+		{
+			const bool space = isspace(static_cast<unsigned char>(*cur)) != 0;
+			if (!space && !inToken)
+				++corners;
+			inToken = !space;
+		}
+		if (corners >= 3)
+			counts.triangles += corners - 2;
+	}
+}
+
+
+static bool scanObj(const std::string& filename, MeshCounts& counts)
+{
+	FILE* file = fopen(filename.c_str(), "rb");
+	if (!file)
+		return false;
+
+	ObjCounts obj = { 0, 0, 0, 0 };
+	std::vector<char> buffer(1 << 20);
+	std::string carry;	// a line split between two reads
+	size_t n;
+	while ((n = fread(buffer.data(), 1, buffer.size(), file)) > 0)
+	{
+		const char* cur = buffer.data();
+		const char* end = cur + n;
+		while (cur < end)
+		{
+			const char* eol = static_cast<const char*>(memchr(cur, '\n', end - cur));
+			if (!eol)
+			{
+				carry.append(cur, end);
+				break;
+			}
+			if (carry.empty())
+				scanObjLine(cur, eol, obj);
+			else
+			{
+				carry.append(cur, eol);
+				scanObjLine(carry.data(), carry.data() + carry.size(), obj);
+				carry.clear();
+			}
+			cur = eol + 1;
+		}
+	}
+	scanObjLine(carry.data(), carry.data() + carry.size(), obj);
+	fclose(file);
+
+	counts.num_vertices = std::max(obj.v, std::max(obj.vn, obj.vt));
+	counts.num_triangles = obj.triangles;
+	counts.has_normals = obj.vn > 0;
+	counts.has_texcoords = obj.vt > 0;
+	return true;
+}
+
+
+// The header is ASCII for binary files too.
+static bool scanPly(const std::string& filename, MeshCounts& counts)
+{
+	FILE* file = fopen(filename.c_str(), "rb");
+	if (!file)
+		return false;
+
+	char line[1024];
+	std::string element;
+	bool ok = fgets(line, sizeof(line), file) && strncmp(line, "ply", 3) == 0;
+	memset(&counts, 0, sizeof(counts));
+	while (ok && fgets(line, sizeof(line), file))
+	{
+		char name[256];
+		unsigned long long count;
+		if (strncmp(line, "end_header", 10) == 0)
+			break;
+		if (sscanf(line, "element %255s %llu", name, &count) == 2)
+		{
+			element = name;
+			if (element == "vertex")
+				counts.num_vertices = count;
+			else if (element == "face")
+				counts.num_triangles = count;
+		}
+		else if (element == "vertex" && strncmp(line, "property", 8) == 0 && strstr(line, " nx"))
+			counts.has_normals = true;
+	}
+	fclose(file);
+	return ok;
+}
+
+
+// glTF headers are JSON, MeshLoader parses only the header and maps the buffers.
+static bool scanGltf(const std::string& filename, MeshCounts& counts)
+{
+	try
+	{
+		MeshLoader loader(filename, 0);
+		Mesh mesh;
+		loader.scanMesh(mesh);
+		counts.num_vertices = mesh.num_vertices;
+		counts.num_triangles = mesh.num_triangles;
+		counts.has_normals = mesh.has_normals;
+		counts.has_texcoords = mesh.has_texcoords;
+		return true;
+	}
+	catch (const std::exception&)
+	{
+		return false;
+	}
+}
+
+
+bool scanMeshCounts(const std::string& filename, MeshCounts& counts)
+{
+	if (endsWith(filename, ".obj"))
+		return scanObj(filename, counts);
+	if (endsWith(filename, ".ply"))
+		return scanPly(filename, counts);
+	if (endsWith(filename, ".glb") || endsWith(filename, ".gltf"))
+		return scanGltf(filename, counts);
+	return false;
+}
+
+
+static uint32_t readBE(const unsigned char* p, int bytes)
+{
+	uint32_t v = 0;
+	for (int i = 0; i < bytes; ++i)
+		v = (v << 8) | p[i];
+	return v;
+}
+
+
+static uint32_t readLE(const unsigned char* p, int bytes)
+{
+	uint32_t v = 0;
+	for (int i = bytes - 1; i >= 0; --i)
+		v = (v << 8) | p[i];
+	return v;
+}
+
+
+// Walks the markers up to the first start of frame.
+static bool readJpegSize(FILE* file, int& width, int& height)
+{
+	unsigned char b[8];
+	fseek(file, 2, SEEK_SET);
+	for (;;)
+	{
+		int c = fgetc(file);
+		if (c != 0xFF)
+			return false;
+		while (c == 0xFF)
+			c = fgetc(file);
+		if (c == EOF || fread(b, 1, 2, file) != 2)
+			return false;
+
+		const uint32_t len = readBE(b, 2);
+		if (c >= 0xC0 && c <= 0xCF && c != 0xC4 && c != 0xC8 && c != 0xCC)
+		{
+			if (fread(b, 1, 5, file) != 5)
+				return false;
+			height = static_cast<int>(readBE(b + 1, 2));
+			width = static_cast<int>(readBE(b + 3, 2));
+			return true;
+		}
+		if (len < 2 || fseek(file, len - 2, SEEK_CUR) != 0)
+			return false;
+	}
+}
+
+
+// Attribute list of the header: name, type, size, value.
+static bool readExrSize(FILE* file, int& width, int& height)
+{
+	fseek(file, 8, SEEK_SET);
+	for (;;)
+	{
+		std::string name, type;
+		int c;
+		while ((c = fgetc(file)) > 0)
+			name += static_cast<char>(c);
+		if (c == EOF || name.empty())
+			return false;
+		while ((c = fgetc(file)) > 0)
+			type += static_cast<char>(c);
+
+		unsigned char b[16];
+		if (c == EOF || fread(b, 1, 4, file) != 4)
+			return false;
+		const uint32_t size = readLE(b, 4);
+
+		if (name == "dataWindow" && type == "box2i" && size == 16)
+		{
+			if (fread(b, 1, 16, file) != 16)
+				return false;
+			width = static_cast<int>(readLE(b + 8, 4)) - static_cast<int>(readLE(b, 4)) + 1;
+			height = static_cast<int>(readLE(b + 12, 4)) - static_cast<int>(readLE(b + 4, 4)) + 1;
+			return true;
+		}
+		if (fseek(file, size, SEEK_CUR) != 0)
+			return false;
+	}
+}
+
+
+// Radiance header lines up to an empty line, then the resolution string.
+static bool readHdrSize(FILE* file, int& width, int& height)
+{
+	char line[256];
+	fseek(file, 0, SEEK_SET);
+	while (fgets(line, sizeof(line), file))
+	{
+		if (line[0] == '\n' || line[0] == '\r')
+		{
+			char y[3], x[3];
+			return fgets(line, sizeof(line), file) && sscanf(line, "%2s %d %2s %d", y, &height, x, &width) == 4;
+		}
+	}
+	return false;
+}
+
+
+bool readImageSize(const std::string& filename, int& width, int& height, int& bytesPerChannel)
+{
+	FILE* file = fopen(filename.c_str(), "rb");
+	if (!file)
+		return false;
+
+	unsigned char b[32];
+	const size_t n = fread(b, 1, sizeof(b), file);
+	bool ok = false;
+	bytesPerChannel = 1;
+
+	if (n >= 25 && memcmp(b, "\x89PNG", 4) == 0)
+	{
+		width = static_cast<int>(readBE(b + 16, 4));
+		height = static_cast<int>(readBE(b + 20, 4));
+		bytesPerChannel = b[24] == 16 ? 2 : 1;
+		ok = true;
+	}
+	else if (n >= 2 && b[0] == 0xFF && b[1] == 0xD8)
+		ok = readJpegSize(file, width, height);
+	else if (n >= 2 && b[0] == '#' && b[1] == '?')
+	{
+		ok = readHdrSize(file, width, height);
+		bytesPerChannel = sizeof(float);
+	}
+	else if (n >= 4 && readLE(b, 4) == 20000630)
+	{
+		ok = readExrSize(file, width, height);
+		bytesPerChannel = sizeof(float);
+	}
+	else if (n >= 26 && b[0] == 'B' && b[1] == 'M')
+	{
+		width = static_cast<int>(readLE(b + 18, 4));
+		height = std::abs(static_cast<int>(readLE(b + 22, 4)));
+		ok = true;
+	}
+	else if (n >= 18 && endsWith(filename, ".tga"))
+	{
+		width = static_cast<int>(readLE(b + 12, 2));
+		height = static_cast<int>(readLE(b + 14, 2));
+		ok = true;
+	}
+
+	fclose(file);
+	return ok && width > 0 && height > 0;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#ifndef JOB_PLAN_H
+#define JOB_PLAN_H
+
+#include <stdint.h>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct Scene;
+
+// Command line of a job, as far as it decides the allocations.
+struct JobSettings
+{
+	JobSettings();
+
+	int          width;
+	int          height;
+	int          spp;
+	int          ref_spp;			/* upper bound, the reference may stop earlier */
+	int          patches;
+	bool         features;
+	bool         reference;
+	bool         cpu;
+	bool         random_cameras;	/* the scene probe and the occupancy grid are built */
+	bool         quantized_meshes;	/* device meshes as QuantizedMesh */
+	unsigned int occupancy_resolution;
+	std::string  hdrs_dir;			/* environment maps are drawn from here per patch */
+};
+
+/*
+	Memory and cost estimate of a job before anything is allocated (--plan).
+	Mesh files are scanned for their counts only (or read from the compiled bundle), textures only for their header.
+	Byte counts follow the buffers OptaGen creates; acceleration structures and decoded images are estimates.
+*/
+class JobPlan
+{
+public:
+	JobPlan();
+
+	void estimate(const Scene& scene, const JobSettings& settings);
+	void print(std::ostream& out) const;
+
+	uint64_t getHostBytes() const;		/* sum of all categories, transient ones included */
+	uint64_t getDeviceBytes() const;
+	uint64_t getOutputBytesPerPatch() const;
+	double   getCostScore() const;		/* relative, giga (sample * bounce * traversal step) over all patches */
+	uint64_t getMeshBytes() const;		/* geometry and acceleration, device memory (host with the cpu backend) */
+
+private:
+	struct Item
+	{
+		std::string name;
+		uint64_t    host;
+		uint64_t    device;
+		std::string note;
+	};
+
+	void add(const std::string& name, uint64_t host, uint64_t device, const std::string& note = std::string());
+
+private:
+	JobSettings              m_settings;
+	std::vector<Item>        m_items;
+	std::vector<std::string> m_warnings;
+	uint64_t                 m_featureBytes;	/* per patch, .npy files */
+	uint64_t                 m_referenceBytes;
+	uint64_t                 m_triangles;		/* placed */
+	double                   m_cost;
+};
+
+struct MeshCounts
+{
+	uint64_t num_vertices;
+	uint64_t num_triangles;
+	bool     has_normals;
+	bool     has_texcoords;
+};
+
+// Counts of an .obj or .ply file without loading its arrays. OBJ vertex counts are estimated from the
+// longest of the v/vn/vt lists, the loader welds identical index triples.
+bool scanMeshCounts(const std::string& filename, MeshCounts& counts);
+
+// Memory one mesh file takes on the device (optix backend, once per file) or on the host (cpu backend, once per placement),
+// arrays and acceleration structure.
+uint64_t estimateMeshBytes(const MeshCounts& counts, const JobSettings& settings);
+
+// Size of a .png, .jpg, .hdr, .bmp, .tga or .exr image from its header.
+bool readImageSize(const std::string& filename, int& width, int& height, int& bytesPerChannel);
+
+#endif
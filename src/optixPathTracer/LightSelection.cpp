@@ -0,0 +1,30 @@
+#include "LightSelection.h"
+#include "AliasTable.h"
+
+
+float lightPower(const LightParameter& light)
+{
+	if (light.lightType == ENVMAP)
+		return light.environmentIntegral;
+
+	const float emission = (light.emission.x + light.emission.y + light.emission.z) / 3.0f;
+	return emission * light.area;
+}
+
+
+void buildLightSelection(std::vector<LightParameter>& lights)
+{
+	std::vector<float> powers(lights.size());
+	for (size_t i = 0; i < lights.size(); ++i)
+		powers[i] = lightPower(lights[i]);
+
+	AliasTable table;
+	const bool weighted = table.build(powers);
+	for (size_t i = 0; i < lights.size(); ++i)
+	{
+		LightParameter& light = lights[i];
+		light.selectionPdf = weighted ? table.pdf(static_cast<unsigned int>(i)) : 1.0f / lights.size();
+		light.aliasProbability = weighted ? table.getProbability(static_cast<unsigned int>(i)) : 1.0f;
+		light.aliasIndex = weighted ? static_cast<int>(table.getAlias(static_cast<unsigned int>(i))) : static_cast<int>(i);
+	}
+}
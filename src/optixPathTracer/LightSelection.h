@@ -0,0 +1,21 @@
+#pragma once
+
+#ifndef LIGHT_SELECTION_H
+#define LIGHT_SELECTION_H
+
+#include "light_parameters.h"
+
+#include <vector>
+
+// Power the lights are picked by: average emission times area for quads and spheres, environmentIntegral (the average
+// of the environment texels) for the environment.
+float lightPower(const LightParameter& light);
+
+/*
+	Fills selectionPdf, aliasProbability and aliasIndex of every light for selectLight() (light_sample.h) with an alias
+	table proportional to lightPower(). Lights without power are never picked; if no light has any, all of them are
+	picked uniformly.
+*/
+void buildLightSelection(std::vector<LightParameter>& lights);
+
+#endif
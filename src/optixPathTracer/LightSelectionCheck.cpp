@@ -0,0 +1,255 @@
+#include "LightSelectionCheck.h"
+#include "LightSelection.h"
+#include "light_sample.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace optix;
+
+namespace
+{
+
+const int    SELECTIONS = 1000000;
+const int    ESTIMATE_SAMPLES = 200000;
+const double SIGMAS = 5.0;
+
+const float3 RECEIVER_NORMAL = { 0.0f, 1.0f, 0.0f };	/* the receiver sits at the origin */
+
+
+struct LightSet
+{
+	std::string                 name;
+	std::vector<LightParameter> lights;
+	bool                        varied;		/* lights differ in power, the power selection has to win */
+};
+
+
+// Square quad of the given side centered at center, facing the origin.
+LightParameter makeQuad(const float3& center, float side, float emission)
+{
+	const float3 normal = normalize(-center);
+	const float3 helper = fabsf(normal.x) < 0.9f ? make_float3(1.0f, 0.0f, 0.0f) : make_float3(0.0f, 0.0f, 1.0f);
+	const float3 u = normalize(cross(helper, normal)) * side;
+	const float3 v = cross(normal, u);
+
+	LightParameter light;
+	memset(&light, 0, sizeof(light));
+	light.lightType = QUAD;
+	light.position = center - 0.5f * (u + v);
+	light.u = u;
+	light.v = v;
+	light.normal = normal;
+	light.area = side * side;
+	light.emission = make_float3(emission);
+	return light;
+}
+
+
+LightParameter makeSphere(const float3& center, float radius, float emission)
+{
+	LightParameter light;
+	memset(&light, 0, sizeof(light));
+	light.lightType = SPHERE;
+	light.position = center;
+	light.radius = radius;
+	light.area = 4.0f * M_PIf * radius * radius;
+	light.emission = make_float3(emission);
+	return light;
+}
+
+
+std::vector<LightSet> getLightSets()
+{
+	std::vector<LightSet> sets;
+
+	// One key light and dim fill lights, the case uniform selection handles worst.
+	LightSet fill = { "fill", {}, true };
+	fill.lights.push_back(makeQuad(make_float3(0.0f, 2.0f, 0.0f), 0.5f, 50.0f));
+	for (int i = 0; i < 7; ++i)
+	{
+		const float phi = 2.0f * M_PIf * i / 7.0f;
+		fill.lights.push_back(makeQuad(make_float3(3.0f * cosf(phi), 1.0f + 0.3f * i, 3.0f * sinf(phi)), 0.5f, 0.5f));
+	}
+	sets.push_back(fill);
+
+	// Spheres with log-uniform emission and random sizes in the upper hemisphere.
+	LightSet spheres = { "spheres", {}, true };
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	for (int i = 0; i < 16; ++i)
+	{
+		const float phi = 2.0f * M_PIf * unit(rng);
+		const float cosTheta = 0.2f + 0.8f * unit(rng);
+		const float sinTheta = sqrtf(1.0f - cosTheta * cosTheta);
+		const float distance = 2.0f + 3.0f * unit(rng);
+		const float3 center = distance * make_float3(sinTheta * cosf(phi), cosTheta, sinTheta * sinf(phi));
+		spheres.lights.push_back(makeSphere(center, 0.1f + 0.2f * unit(rng), powf(10.0f, -1.0f + 3.0f * unit(rng))));
+	}
+	sets.push_back(spheres);
+
+	// Identical lights, both selections are the same.
+	LightSet equal = { "equal", {}, false };
+	for (int i = 0; i < 8; ++i)
+	{
+		const float phi = 2.0f * M_PIf * i / 8.0f;
+		equal.lights.push_back(makeQuad(make_float3(2.0f * cosf(phi), 2.0f, 2.0f * sinf(phi)), 0.5f, 5.0f));
+	}
+	sets.push_back(equal);
+
+	// A light without emission next to lit ones.
+	LightSet dark = { "dark", {}, true };
+	dark.lights.push_back(makeQuad(make_float3(0.0f, 2.0f, 0.0f), 1.0f, 0.0f));
+	dark.lights.push_back(makeQuad(make_float3(1.0f, 2.0f, 0.0f), 0.5f, 10.0f));
+	dark.lights.push_back(makeSphere(make_float3(-1.0f, 2.0f, 1.0f), 0.2f, 20.0f));
+	sets.push_back(dark);
+
+	return sets;
+}
+
+
+std::vector<LightParameter> uniformSelection(std::vector<LightParameter> lights)
+{
+	for (size_t i = 0; i < lights.size(); ++i)
+	{
+		lights[i].selectionPdf = 1.0f / lights.size();
+		lights[i].aliasProbability = 1.0f;
+		lights[i].aliasIndex = static_cast<int>(i);
+	}
+	return lights;
+}
+
+
+// Picks per light against the selectionPdf, and no picks of lights without power.
+bool checkFrequencies(const std::vector<LightParameter>& lights, std::ostream& log)
+{
+	const int n = static_cast<int>(lights.size());
+	std::vector<int> counts(n, 0);
+	std::mt19937 rng(4321);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	for (int i = 0; i < SELECTIONS; ++i)
+		++counts[selectLight(lights, n, unit(rng))];
+
+	double worst = 0.0;
+	bool ok = true;
+	float pdfSum = 0.0f;
+	for (int i = 0; i < n; ++i)
+	{
+		const double expected = double(SELECTIONS) * lights[i].selectionPdf;
+		const double sigma = sqrt(expected * (1.0 - lights[i].selectionPdf)) + 1.0;
+		worst = std::max(worst, fabs(counts[i] - expected) / sigma);
+		if (lightPower(lights[i]) <= 0.0f && counts[i] != 0)
+			ok = false;
+		pdfSum += lights[i].selectionPdf;
+	}
+	ok = ok && worst <= SIGMAS && fabsf(pdfSum - 1.0f) < 1e-5f;
+
+	log << "    frequencies    " << SELECTIONS << " picks: largest deviation " << worst << " sigma, pdf sum " << pdfSum
+		<< (ok ? "" : ", FAILED") << std::endl;
+	return ok;
+}
+
+
+struct Estimate
+{
+	double mean;
+	double variance;	/* per sample */
+};
+
+
+// Direct lighting of a white diffuse receiver without occlusion, as DirectLight() estimates it.
+Estimate estimate(const std::vector<LightParameter>& lights, unsigned int seed)
+{
+	Sampler sampler;
+	sampler.type = SAMPLER_RANDOM;
+	sampler.seed = seed;
+
+	const int n = static_cast<int>(lights.size());
+	double sum = 0.0, squares = 0.0;
+	for (int i = 0; i < ESTIMATE_SAMPLES; ++i)
+	{
+		const LightParameter& light = lights[selectLight(lights, n, rnd(sampler))];
+		LightSample lightSample;
+		lightSample.pdf = 0.0f;
+		if (light.lightType == SPHERE)
+			sampleSphereLight(light, make_float3(0.0f), sampler, lightSample);
+		else
+			sampleQuadLight(light, make_float3(0.0f), sampler, lightSample);
+
+		double value = 0.0;
+		if (0.0f < lightSample.pdf)
+		{
+			const float cosTheta = fmaxf(0.0f, dot(lightSample.direction, RECEIVER_NORMAL));
+			value = (lightSample.emission.x + lightSample.emission.y + lightSample.emission.z) / 3.0f * cosTheta * M_1_PIf
+				/ lightSample.pdf;
+		}
+		sum += value;
+		squares += value * value;
+	}
+
+	Estimate result;
+	result.mean = sum / ESTIMATE_SAMPLES;
+	result.variance = squares / ESTIMATE_SAMPLES - result.mean * result.mean;
+	return result;
+}
+
+
+bool checkVariance(const LightSet& set, const std::vector<LightParameter>& lights, std::ostream& log)
+{
+	const Estimate uniform = estimate(uniformSelection(set.lights), 1234);
+	const Estimate power = estimate(lights, 5678);
+
+	const double sigma = sqrt((uniform.variance + power.variance) / ESTIMATE_SAMPLES);
+	const bool unbiased = fabs(uniform.mean - power.mean) <= SIGMAS * sigma;
+	const bool lower = !set.varied || power.variance < uniform.variance;
+
+	log << "    estimate       uniform " << uniform.mean << " (variance " << uniform.variance << "), power " << power.mean
+		<< " (variance " << power.variance << "), variance reduced " << uniform.variance / power.variance << "x"
+		<< (unbiased ? "" : ", BIASED") << (lower ? "" : ", NO REDUCTION") << std::endl;
+	return unbiased && lower;
+}
+
+} // namespace
+
+
+int checkLightSelection(std::ostream& log)
+{
+	const std::ios::fmtflags flags = log.flags();
+	const std::streamsize precision = log.precision();
+	log << std::setprecision(4);
+
+	int failures = 0;
+	const std::vector<LightSet> sets = getLightSets();
+	for (size_t s = 0; s < sets.size(); ++s)
+	{
+		log << "[Lights] " << sets[s].name << ", " << sets[s].lights.size() << " lights" << std::endl;
+
+		std::vector<LightParameter> lights = sets[s].lights;
+		buildLightSelection(lights);
+		if (!checkFrequencies(lights, log))
+			++failures;
+		if (!checkVariance(sets[s], lights, log))
+			++failures;
+	}
+
+	// Without any power the selection falls back to uniform.
+	std::vector<LightParameter> unlit = getLightSets()[0].lights;
+	for (size_t i = 0; i < unlit.size(); ++i)
+		unlit[i].emission = make_float3(0.0f);
+	buildLightSelection(unlit);
+	bool uniform = true;
+	for (size_t i = 0; i < unlit.size(); ++i)
+		uniform = uniform && unlit[i].selectionPdf == 1.0f / unlit.size() && unlit[i].aliasIndex == static_cast<int>(i);
+	log << "[Lights] unlit, " << unlit.size() << " lights: " << (uniform ? "uniform selection" : "NOT UNIFORM") << std::endl;
+	if (!uniform)
+		++failures;
+
+	log.flags(flags);
+	log.precision(precision);
+	return failures;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#ifndef LIGHT_SELECTION_CHECK_H
+#define LIGHT_SELECTION_CHECK_H
+
+#include <ostream>
+
+/*
+	Host checks of buildLightSelection() and selectLight() on synthetic light sets around a point facing up:
+	- every light is picked with its selectionPdf and lights without power never,
+	- the direct lighting estimates with power and with uniform selection agree, and the power selection has the lower
+	  variance where the lights differ in power.
+	Returns the number of failed checks and logs every result.
+*/
+int checkLightSelection(std::ostream& log);
+
+#endif
@@ -0,0 +1,198 @@
+#include "MeshLod.h"
+#include "JobPlan.h"
+#include "sceneLoader.h"
+
+#include <sutil.h>
+#include <Mesh.h>
+#include <ParallelFor.h>
+
+#include <cstdio>
+#include <mutex>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <vector>
+
+namespace
+{
+
+const int LOD_MAX_LEVEL = 8;
+const uint64_t LOD_MIN_TRIANGLES = 1024;	/* coarser levels are not worth the detail they lose */
+
+struct LodState
+{
+	MeshCounts counts;		/* of the original file */
+	uint64_t   placements;
+	int        level;
+	int        max_level;
+};
+
+
+std::string lodFilename(const std::string& filename, int level)
+{
+	return filename + ".lod" + std::to_string(level) + ".ply";
+}
+
+
+// A cached level is valid while it is newer than the file it was simplified from.
+bool isFresh(const std::string& lod, const std::string& source)
+{
+	struct stat lodStat, sourceStat;
+	if (stat(lod.c_str(), &lodStat) != 0 || stat(source.c_str(), &sourceStat) != 0)
+		return false;
+	return lodStat.st_mtime >= sourceStat.st_mtime;
+}
+
+
+uint64_t levelTriangles(const LodState& state, int level)
+{
+	return state.counts.num_triangles >> level;
+}
+
+
+// Vertices shrink about as fast as triangles under edge collapses.
+MeshCounts levelCounts(const LodState& state, int level)
+{
+	MeshCounts counts = state.counts;
+	counts.num_vertices >>= level;
+	counts.num_triangles >>= level;
+	return counts;
+}
+
+
+uint64_t levelBytes(const LodState& state, int level, const JobSettings& settings)
+{
+	// The cpu backend flattens every placement, the device shares one copy between them.
+	return estimateMeshBytes(levelCounts(state, level), settings) * (settings.cpu ? state.placements : 1);
+}
+
+} // namespace
+
+
+bool applyMeshLods(Scene& scene, const JobSettings& settings, const LodBudget& budget, std::ostream& log)
+{
+	if (scene.bundle)
+	{
+		log << "[LOD] Compiled scenes are not simplified." << std::endl;
+		return true;
+	}
+
+	const size_t num_geometries = scene.geometry_names.size();
+	std::vector<LodState> states(num_geometries);
+	for (size_t g = 0; g < num_geometries; ++g)
+	{
+		LodState& state = states[g];
+		if (!scanMeshCounts(scene.geometry_names[g], state.counts))
+			throw std::runtime_error("LOD: could not scan " + scene.geometry_names[g]);
+		state.placements = 0;
+		state.level = 0;
+		state.max_level = 0;
+		while (state.max_level < LOD_MAX_LEVEL && levelTriangles(state, state.max_level + 1) >= LOD_MIN_TRIANGLES)
+			++state.max_level;
+	}
+	for (size_t i = 0; i < scene.mesh_geometry.size(); ++i)
+		++states[scene.mesh_geometry[i]].placements;
+
+	uint64_t triangles = 0, bytes = 0;
+	for (size_t g = 0; g < num_geometries; ++g)
+	{
+		triangles += levelTriangles(states[g], 0) * states[g].placements;
+		bytes += levelBytes(states[g], 0, settings);
+	}
+
+	// Biggest offender first: the file costing the most in the exceeded budget goes down one level.
+	bool fits = true;
+	while ((budget.triangles > 0 && triangles > budget.triangles) || (budget.bytes > 0 && bytes > budget.bytes))
+	{
+		const bool byBytes = budget.bytes > 0 && bytes > budget.bytes;
+		int worst = -1;
+		uint64_t worstCost = 0;
+		for (size_t g = 0; g < num_geometries; ++g)
+		{
+			const LodState& state = states[g];
+			if (state.level == state.max_level)
+				continue;
+			const uint64_t cost = byBytes ? levelBytes(state, state.level, settings) : levelTriangles(state, state.level) * state.placements;
+			if (cost > worstCost)
+			{
+				worst = static_cast<int>(g);
+				worstCost = cost;
+			}
+		}
+		if (worst < 0)
+		{
+			fits = false;
+			break;
+		}
+
+		LodState& state = states[worst];
+		triangles -= (levelTriangles(state, state.level) - levelTriangles(state, state.level + 1)) * state.placements;
+		bytes -= levelBytes(state, state.level, settings) - levelBytes(state, state.level + 1, settings);
+		++state.level;
+	}
+
+	// Levels that are not cached yet, one mesh per thread.
+	std::vector<size_t> jobs;
+	for (size_t g = 0; g < num_geometries; ++g)
+	{
+		if (states[g].level > 0 && !isFresh(lodFilename(scene.geometry_names[g], states[g].level), scene.geometry_names[g]))
+			jobs.push_back(g);
+	}
+
+	std::mutex logMutex;
+	sutil::parallelFor(jobs.size(), [&](size_t job, unsigned int)
+	{
+		const size_t g = jobs[job];
+		LodState& state = states[g];
+		const std::string& source = scene.geometry_names[g];
+		const std::string lod = lodFilename(source, state.level);
+		const std::string temp = lod + ".tmp";
+
+		std::string error;
+		float rms = 0.0f;
+		int32_t before = 0, after = 0;
+		try
+		{
+			HostMesh mesh(source, 0, MESH_LOADER_CLEANUP);
+			before = mesh.num_triangles;
+			rms = simplifyMesh(mesh, static_cast<int32_t>(levelTriangles(state, state.level)));
+			after = mesh.num_triangles;
+			saveMeshPLY(temp, mesh);
+			std::remove(lod.c_str());
+			if (std::rename(temp.c_str(), lod.c_str()) != 0)
+				error = "could not rename " + temp;
+		}
+		catch (const std::exception& e)
+		{
+			error = e.what();
+		}
+
+		std::lock_guard<std::mutex> lock(logMutex);
+		if (!error.empty())
+		{
+			std::remove(temp.c_str());
+			log << "[LOD] warning: keeping " << source << " (" << error << ")" << std::endl;
+			state.level = 0;
+			return;
+		}
+		log << "[LOD] " << lod << ": " << before << " -> " << after << " triangles, RMS error " << rms << std::endl;
+	});
+
+	for (size_t g = 0; g < num_geometries; ++g)
+	{
+		if (states[g].level == 0)
+			continue;
+
+		const std::string lod = lodFilename(scene.geometry_names[g], states[g].level);
+		log << "[LOD] " << scene.geometry_names[g] << " x" << states[g].placements << ": level " << states[g].level
+			<< ", about " << levelTriangles(states[g], states[g].level) << " of " << states[g].counts.num_triangles << " triangles" << std::endl;
+		for (size_t i = 0; i < scene.mesh_geometry.size(); ++i)
+		{
+			if (scene.mesh_geometry[i] == static_cast<int>(g))
+				scene.mesh_names[i] = lod;
+		}
+		scene.geometry_names[g] = lod;
+	}
+
+	return fits;
+}
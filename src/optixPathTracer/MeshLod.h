@@ -0,0 +1,31 @@
+#pragma once
+
+#ifndef MESH_LOD_H
+#define MESH_LOD_H
+
+#include <stdint.h>
+#include <ostream>
+
+struct Scene;
+struct JobSettings;
+
+// Limits of the simplified scene, 0 is no limit.
+struct LodBudget
+{
+	LodBudget() : triangles(0), bytes(0) {}
+
+	uint64_t triangles;		/* placed triangles */
+	uint64_t bytes;			/* geometry and acceleration structures, in the memory the job is planned for (see JobPlan) */
+};
+
+/*
+	Level of detail selection for scenes over their budget (--lod, --lod-triangles).
+	Level k of a mesh file has about 1/2^k of its triangles. The file costing the most at its current level is taken down
+	one level until the scene fits, so small meshes keep their detail. Missing levels are simplified with simplifyMesh() in
+	parallel and cached as FILE.lod<k>.ply next to the mesh, they are reused while they are newer than FILE.
+	Replaces geometry_names and mesh_names of the simplified files. Compiled scenes are left alone.
+	Returns false if the scene does not fit even at the coarsest levels, the coarsest levels are applied anyway.
+*/
+bool applyMeshLods(Scene& scene, const JobSettings& settings, const LodBudget& budget, std::ostream& log);
+
+#endif
@@ -0,0 +1,226 @@
+#include "MeshOrderBench.h"
+#include "sceneLoader.h"
+#include "SceneBundle.h"
+#include "CpuBvh.h"
+
+#include <sutil.h>
+#include <Mesh.h>
+
+#include <iomanip>
+#include <stdint.h>
+#include <vector>
+
+using namespace optix;
+
+namespace
+{
+
+const int RAYS_PER_AXIS = 256;	/* orthographic grid per view, six views along the axes */
+const unsigned int CACHE_LINE = 64;
+
+// Set-associative cache with LRU replacement, counts the lines it has to fetch.
+class CacheModel
+{
+public:
+	CacheModel(unsigned int bytes, unsigned int ways)
+		: m_ways(ways), m_sets(bytes / (CACHE_LINE * ways)), m_tags(m_sets * ways, ~0ull), m_ages(m_sets * ways, 0),
+		m_clock(0), m_misses(0)
+	{
+	}
+
+	void access(uint64_t address, unsigned int size)
+	{
+		for (uint64_t line = address / CACHE_LINE; line <= (address + size - 1) / CACHE_LINE; ++line)
+			touch(line);
+	}
+
+	uint64_t getMisses() const { return m_misses; }
+
+private:
+	void touch(uint64_t line)
+	{
+		const size_t set = static_cast<size_t>(line % m_sets) * m_ways;
+		size_t victim = set;
+		for (size_t i = set; i < set + m_ways; ++i)
+		{
+			if (m_tags[i] == line)
+			{
+				m_ages[i] = ++m_clock;
+				return;
+			}
+			if (m_ages[i] < m_ages[victim])
+				victim = i;
+		}
+		m_tags[victim] = line;
+		m_ages[victim] = ++m_clock;
+		++m_misses;
+	}
+
+	unsigned int          m_ways;
+	unsigned int          m_sets;
+	std::vector<uint64_t> m_tags;
+	std::vector<uint64_t> m_ages;
+	uint64_t              m_clock;
+	uint64_t              m_misses;
+};
+
+struct LayoutResult
+{
+	double   buildTime;
+	double   traceTime;
+	double   gatherTime;
+	uint64_t hits;
+	uint64_t l1Misses;
+	uint64_t l2Misses;
+	float    checksum;	/* keeps the gather from being optimized away */
+};
+
+// Coherent rays in scanline order: an orthographic grid over the bounds from each side.
+void makeRays(const MeshView& mesh, std::vector<float3>& origins, std::vector<float3>& directions)
+{
+	const float3 extent = mesh.bbox_max - mesh.bbox_min;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		const int u = (axis + 1) % 3;
+		const int v = (axis + 2) % 3;
+		for (int side = 0; side < 2; ++side)
+		{
+			float3 direction = make_float3(0.0f);
+			(&direction.x)[axis] = side ? -1.0f : 1.0f;
+			for (int y = 0; y < RAYS_PER_AXIS; ++y)
+			{
+				for (int x = 0; x < RAYS_PER_AXIS; ++x)
+				{
+					float3 origin = mesh.bbox_min;
+					(&origin.x)[axis] += side ? (&extent.x)[axis] : 0.0f;
+					(&origin.x)[axis] -= (&direction.x)[axis] * 1e-3f * length(extent);
+					(&origin.x)[u] += (x + 0.5f) / RAYS_PER_AXIS * (&extent.x)[u];
+					(&origin.x)[v] += (y + 0.5f) / RAYS_PER_AXIS * (&extent.x)[v];
+					origins.push_back(origin);
+					directions.push_back(direction);
+				}
+			}
+		}
+	}
+}
+
+LayoutResult runLayout(const MeshView& mesh, unsigned int numThreads)
+{
+	LayoutResult result = LayoutResult();
+
+	double startTime = sutil::currentTime();
+	CpuBvh bvh;
+	bvh.build(mesh.positions, mesh.indices, mesh.num_triangles, numThreads);
+	result.buildTime = sutil::currentTime() - startTime;
+
+	std::vector<float3> origins, directions;
+	makeRays(mesh, origins, directions);
+
+	startTime = sutil::currentTime();
+	std::vector<unsigned int> hits;
+	std::vector<float2> barycentrics;
+	for (size_t i = 0; i < origins.size(); ++i)
+	{
+		BvhHit hit;
+		if (bvh.intersect(origins[i], directions[i], 0.0f, 1e34f, hit))
+		{
+			hits.push_back(hit.prim);
+			barycentrics.push_back(make_float2(hit.beta, hit.gamma));
+		}
+	}
+	result.traceTime = sutil::currentTime() - startTime;
+	result.hits = hits.size();
+
+	// Same fetches as the closest hit program of triangle_mesh.cu
+	startTime = sutil::currentTime();
+	float checksum = 0.0f;
+	for (size_t i = 0; i < hits.size(); ++i)
+	{
+		const int3 index = mesh.indices[hits[i]];
+		const float beta = barycentrics[i].x;
+		const float gamma = barycentrics[i].y;
+		const float alpha = 1.0f - beta - gamma;
+		float3 value = mesh.positions[index.x] * alpha + mesh.positions[index.y] * beta + mesh.positions[index.z] * gamma;
+		if (mesh.normals)
+			value += mesh.normals[index.x] * alpha + mesh.normals[index.y] * beta + mesh.normals[index.z] * gamma;
+		if (mesh.texcoords)
+		{
+			const float2 uv = mesh.texcoords[index.x] * alpha + mesh.texcoords[index.y] * beta + mesh.texcoords[index.z] * gamma;
+			value.x += uv.x;
+			value.y += uv.y;
+		}
+		checksum += value.x + value.y + value.z;
+	}
+	result.gatherTime = sutil::currentTime() - startTime;
+	result.checksum = checksum;
+
+	// Arrays as separate allocations, their addresses relative to the array start
+	const uint64_t INDICES = 0, POSITIONS = 1ull << 40, NORMALS = 2ull << 40, TEXCOORDS = 3ull << 40;
+	CacheModel l1(32 * 1024, 8);
+	CacheModel l2(2 * 1024 * 1024, 16);
+	for (size_t i = 0; i < hits.size(); ++i)
+	{
+		const int3 index = mesh.indices[hits[i]];
+		l1.access(INDICES + hits[i] * sizeof(int3), sizeof(int3));
+		l2.access(INDICES + hits[i] * sizeof(int3), sizeof(int3));
+		const int corners[3] = { index.x, index.y, index.z };
+		for (int k = 0; k < 3; ++k)
+		{
+			const uint64_t v = static_cast<uint64_t>(corners[k]);
+			l1.access(POSITIONS + v * sizeof(float3), sizeof(float3));
+			l2.access(POSITIONS + v * sizeof(float3), sizeof(float3));
+			if (mesh.normals)
+			{
+				l1.access(NORMALS + v * sizeof(float3), sizeof(float3));
+				l2.access(NORMALS + v * sizeof(float3), sizeof(float3));
+			}
+			if (mesh.texcoords)
+			{
+				l1.access(TEXCOORDS + v * sizeof(float2), sizeof(float2));
+				l2.access(TEXCOORDS + v * sizeof(float2), sizeof(float2));
+			}
+		}
+	}
+	result.l1Misses = l1.getMisses();
+	result.l2Misses = l2.getMisses();
+	return result;
+}
+
+void printLayout(std::ostream& out, const char* layout, const LayoutResult& result)
+{
+	const double hits = result.hits ? static_cast<double>(result.hits) : 1.0;
+	out << "  " << std::left << std::setw(10) << layout << std::right << std::fixed << std::setprecision(1)
+		<< std::setw(10) << result.buildTime * 1000.0 << std::setw(10) << result.traceTime * 1000.0
+		<< std::setw(11) << result.gatherTime * 1000.0 << std::setprecision(3)
+		<< std::setw(13) << result.l1Misses / hits << std::setw(13) << result.l2Misses / hits << "\n";
+	out.unsetf(std::ios::floatfield);
+}
+
+} // namespace
+
+
+void benchmarkMeshOrder(const Scene& scene, unsigned int numThreads, std::ostream& out)
+{
+	out << "[MeshOrder] " << 6 * RAYS_PER_AXIS * RAYS_PER_AXIS << " rays per mesh, cache model " << CACHE_LINE
+		<< " B lines, L1 32 KiB 8-way, L2 2 MiB 16-way\n";
+
+	for (size_t i = 0; i < scene.geometry_names.size(); ++i)
+	{
+		const std::string& name = scene.geometry_names[i];
+		HostMesh fileOrder(name);
+		HostMesh reordered(name, 0, MESH_LOADER_DEFAULT | MESH_LOADER_REORDER);
+
+		const LayoutResult before = runLayout(makeMeshView(fileOrder), numThreads);
+		const LayoutResult after = runLayout(makeMeshView(reordered), numThreads);
+
+		out << "[MeshOrder] " << name << ": " << fileOrder.num_triangles << " triangles, " << fileOrder.num_vertices << " vertices, "
+			<< before.hits << " hits\n";
+		out << "  " << std::left << std::setw(10) << "layout" << std::right << std::setw(10) << "build ms" << std::setw(10) << "trace ms"
+			<< std::setw(11) << "gather ms" << std::setw(13) << "L1 miss/hit" << std::setw(13) << "L2 miss/hit" << "\n";
+		printLayout(out, "file", before);
+		printLayout(out, "morton", after);
+		if (before.hits != after.hits)
+			out << "[MeshOrder] warning: " << after.hits << " hits after reordering\n";
+	}
+	out << std::flush;
+}
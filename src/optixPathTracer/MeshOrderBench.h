@@ -0,0 +1,18 @@
+#pragma once
+
+#ifndef MESH_ORDER_BENCH_H
+#define MESH_ORDER_BENCH_H
+
+#include <ostream>
+
+struct Scene;
+
+/*
+	Memory locality of the mesh layout (--bench-mesh-order).
+	Every mesh file of the scene is loaded in file order and reordered with reorderMesh(), and both layouts are timed for
+	the CpuBvh build, tracing and gathering the hit attributes. The index and vertex fetches of the hits also run through a
+	simulated set-associative LRU cache, so the miss counts do not depend on the host and its load.
+*/
+void benchmarkMeshOrder(const Scene& scene, unsigned int numThreads, std::ostream& out);
+
+#endif
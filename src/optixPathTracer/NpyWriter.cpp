@@ -0,0 +1,80 @@
+#include "NpyWriter.h"
+
+#include <vector>
+
+#include <HostMemory.h>
+#include <Trace.h>
+
+#include "cnpy.h"
+
+
+namespace
+{
+
+typedef std::vector<float, sutil::TrackedAllocator<float, sutil::HOST_MEMORY_OUTPUT> > StagingVector;
+
+} // namespace
+
+
+void writeDataToNpy(std::string filename, const float* data, size_t buffer_width, size_t buffer_height, bool ref, int num_of_frames, int feat_dim)
+{
+	sutil::TraceScope trace("writeDataToNpy", filename);
+
+	int width = static_cast<int>(buffer_width);
+	int height = static_cast<int>(buffer_height);
+
+	if (ref)
+	{
+		StagingVector pix(width * height * 3);
+		// this buffer is upside down
+		for (int j = height - 1; j >= 0; --j)
+		{
+			float* dst = &pix[0] + (3 * width*(height - 1 - j));
+			const float* src = data + 4 * width*j;
+			for (int i = 0; i < width; i++)
+			{
+				for (int elem = 0; elem < 3; ++elem)
+				{
+					*dst++ = *src++;
+				}
+
+				// skip alpha (padding)
+				src++;
+			}
+
+		}
+
+		cnpy::npy_save(
+			filename,
+			&pix[0],
+			{ buffer_width, buffer_height, 3 },
+			"w");
+	}
+	else
+	{
+		StagingVector pix(width * height * num_of_frames * feat_dim);
+		// this buffer is upside down
+		for (int j = height - 1; j >= 0; --j)
+		{
+			float* dst = &pix[0] + (num_of_frames * feat_dim * width*(height - 1 - j));
+			const float* src = data + num_of_frames * feat_dim * width*j;
+			for (int i = 0; i < width; i++)
+			{
+				for (int elem = 0; elem < num_of_frames * feat_dim; ++elem)
+				{
+					*dst++ = *src++;
+				}
+
+				// if spp % 4 == 0 ==> no need to pad
+			}
+		}
+
+		cnpy::npy_save(
+			filename,
+			&pix[0],
+			{ buffer_width, buffer_height,
+			(size_t)num_of_frames,
+			(size_t)feat_dim },
+			"w");
+	}
+}
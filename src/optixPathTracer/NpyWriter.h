@@ -0,0 +1,17 @@
+#pragma once
+
+#ifndef NPY_WRITER_H
+#define NPY_WRITER_H
+
+#include <stddef.h>
+#include <string>
+
+/*
+	Writes a frame buffer as .npy, shared by both backends and OptaBench. data is laid out like the OptiX buffers, bottom
+	row first, and is flipped to top row first.
+	ref: RGBA float4 pixels, written as width x height x 3 without the alpha.
+	Otherwise: num_of_frames * feat_dim floats per pixel, written as width x height x num_of_frames x feat_dim.
+*/
+void writeDataToNpy(std::string filename, const float* data, size_t buffer_width, size_t buffer_height, bool ref, int num_of_frames, int feat_dim);
+
+#endif
@@ -0,0 +1,489 @@
+#include "OccupancyGrid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <thread>
+
+using namespace optix;
+
+#define OCCUPANCY_MAGIC "OCCG"
+#define OCCUPANCY_VERSION 1
+#define OCCUPANCY_INF 1e20f
+
+
+// Splits [0, count) into contiguous ranges, one per thread.
+static void parallelFor(unsigned int count, unsigned int numThreads, const std::function<void(unsigned int, unsigned int)>& body)
+{
+	numThreads = std::max(1u, std::min(numThreads, count));
+
+	std::vector<std::thread> workers;
+	const unsigned int chunk = (count + numThreads - 1) / numThreads;
+	for (unsigned int t = 1; t < numThreads; ++t)
+	{
+		const unsigned int begin = std::min(count, t * chunk);
+		const unsigned int end = std::min(count, begin + chunk);
+		workers.emplace_back(body, begin, end);
+	}
+	body(0, std::min(count, chunk));
+
+	for (std::thread& worker : workers)
+		worker.join();
+}
+
+
+// Separating axis test of a triangle against an axis-aligned box (Akenine-Moeller).
+static bool triangleBoxOverlap(const float3& center, float halfSize, const float3& a, const float3& b, const float3& c)
+{
+	const float3 v[3] = { a - center, b - center, c - center };
+	const float3 e[3] = { v[1] - v[0], v[2] - v[1], v[0] - v[2] };
+	const float3 axes[3] = { make_float3(1.0f, 0.0f, 0.0f), make_float3(0.0f, 1.0f, 0.0f), make_float3(0.0f, 0.0f, 1.0f) };
+
+	// The box axes are covered by the voxel range of the triangle bounds.
+	for (int i = 0; i < 3; ++i)
+	{
+		for (int j = 0; j < 3; ++j)
+		{
+			const float3 axis = cross(e[i], axes[j]);
+			const float p0 = dot(v[0], axis), p1 = dot(v[1], axis), p2 = dot(v[2], axis);
+			const float r = halfSize * (fabsf(axis.x) + fabsf(axis.y) + fabsf(axis.z));
+			if (fminf(p0, fminf(p1, p2)) > r || fmaxf(p0, fmaxf(p1, p2)) < -r)
+				return false;
+		}
+	}
+
+	const float3 n = cross(e[0], e[1]);
+	const float r = halfSize * (fabsf(n.x) + fabsf(n.y) + fabsf(n.z));
+	return fabsf(dot(n, v[0])) <= r;
+}
+
+
+// 1D squared Euclidean distance transform of a sampled function (Felzenszwalb and Huttenlocher).
+static void distanceTransform1D(const float* f, int n, float* d, int* v, float* z)
+{
+	int k = 0;
+	v[0] = 0;
+	z[0] = -OCCUPANCY_INF;
+	z[1] = OCCUPANCY_INF;
+
+	for (int q = 1; q < n; ++q)
+	{
+		float s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2.0f * q - 2.0f * v[k]);
+		while (s <= z[k])
+		{
+			--k;
+			s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2.0f * q - 2.0f * v[k]);
+		}
+		++k;
+		v[k] = q;
+		z[k] = s;
+		z[k + 1] = OCCUPANCY_INF;
+	}
+
+	k = 0;
+	for (int q = 0; q < n; ++q)
+	{
+		while (z[k + 1] < q)
+			++k;
+		d[q] = (q - v[k]) * (q - v[k]) + f[v[k]];
+	}
+}
+
+
+OccupancyGrid::OccupancyGrid()
+	: m_voxelSize(0.0f)
+	, m_key(0)
+{
+	m_res[0] = m_res[1] = m_res[2] = 0;
+	m_brickRes[0] = m_brickRes[1] = m_brickRes[2] = 0;
+}
+
+
+size_t OccupancyGrid::voxelIndex(int x, int y, int z) const
+{
+	return (size_t(z) * m_res[1] + y) * m_res[0] + x;
+}
+
+
+size_t OccupancyGrid::brickIndex(int x, int y, int z) const
+{
+	return (size_t(z >> 2) * m_brickRes[1] + (y >> 2)) * m_brickRes[0] + (x >> 2);
+}
+
+
+void OccupancyGrid::build(const std::vector<float3>& vertices, const std::vector<int3>& indices,
+	const Aabb& bounds, unsigned int resolution, unsigned int numThreads)
+{
+	if (numThreads == 0)
+		numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+	m_brickOffsets.clear();
+	m_brickMasks.clear();
+	m_distance.clear();
+	m_freeRegion.clear();
+	m_candidates.clear();
+	m_res[0] = m_res[1] = m_res[2] = 0;
+
+	if (!bounds.valid() || resolution == 0)
+		return;
+
+	const float3 extent = bounds.extent();
+	m_voxelSize = fmaxf(extent.x, fmaxf(extent.y, extent.z)) / resolution;
+	for (int i = 0; i < 3; ++i)
+	{
+		m_res[i] = std::max(1, static_cast<int>(ceilf((&extent.x)[i] / m_voxelSize)));
+		m_brickRes[i] = (m_res[i] + 3) / 4;
+	}
+	m_bounds = Aabb(bounds.m_min, bounds.m_min + make_float3(float(m_res[0]), float(m_res[1]), float(m_res[2])) * m_voxelSize);
+
+	std::vector<uint8_t> dense;
+	voxelize(vertices, indices, dense, numThreads);
+
+	// Compact the occupied voxels into bricks.
+	m_brickOffsets.assign(size_t(m_brickRes[0]) * m_brickRes[1] * m_brickRes[2], -1);
+	for (int z = 0; z < m_res[2]; ++z)
+	{
+		for (int y = 0; y < m_res[1]; ++y)
+		{
+			for (int x = 0; x < m_res[0]; ++x)
+			{
+				if (!dense[voxelIndex(x, y, z)])
+					continue;
+
+				int32_t& offset = m_brickOffsets[brickIndex(x, y, z)];
+				if (offset < 0)
+				{
+					offset = static_cast<int32_t>(m_brickMasks.size());
+					m_brickMasks.push_back(0);
+				}
+				m_brickMasks[offset] |= uint64_t(1) << (((z & 3) << 4) | ((y & 3) << 2) | (x & 3));
+			}
+		}
+	}
+
+	computeDistance(dense, numThreads);
+	computeFreeRegion(dense);
+}
+
+
+void OccupancyGrid::voxelize(const std::vector<float3>& vertices, const std::vector<int3>& indices,
+	std::vector<uint8_t>& dense, unsigned int numThreads) const
+{
+	dense.assign(size_t(m_res[0]) * m_res[1] * m_res[2], 0);
+
+	const float halfSize = 0.5f * m_voxelSize;
+	const float invVoxelSize = 1.0f / m_voxelSize;
+
+	// Every thread owns a slab of z slices, so no two threads write the same voxel.
+	parallelFor(static_cast<unsigned int>(m_res[2]), numThreads, [&](unsigned int zBegin, unsigned int zEnd)
+	{
+		for (size_t i = 0; i < indices.size(); ++i)
+		{
+			const float3 a = vertices[indices[i].x];
+			const float3 b = vertices[indices[i].y];
+			const float3 c = vertices[indices[i].z];
+
+			const float3 lo = (fminf(fminf(a, b), c) - m_bounds.m_min) * invVoxelSize;
+			const float3 hi = (fmaxf(fmaxf(a, b), c) - m_bounds.m_min) * invVoxelSize;
+
+			const int z0 = std::max(static_cast<int>(zBegin), static_cast<int>(floorf(lo.z)));
+			const int z1 = std::min(static_cast<int>(zEnd) - 1, static_cast<int>(floorf(hi.z)));
+			if (z0 > z1)
+				continue;
+
+			const int x0 = std::max(0, static_cast<int>(floorf(lo.x))), x1 = std::min(m_res[0] - 1, static_cast<int>(floorf(hi.x)));
+			const int y0 = std::max(0, static_cast<int>(floorf(lo.y))), y1 = std::min(m_res[1] - 1, static_cast<int>(floorf(hi.y)));
+
+			for (int z = z0; z <= z1; ++z)
+			{
+				for (int y = y0; y <= y1; ++y)
+				{
+					for (int x = x0; x <= x1; ++x)
+					{
+						uint8_t& voxel = dense[voxelIndex(x, y, z)];
+						if (voxel)
+							continue;
+
+						const float3 center = m_bounds.m_min + (make_float3(float(x), float(y), float(z)) + 0.5f) * m_voxelSize;
+						if (triangleBoxOverlap(center, halfSize, a, b, c))
+							voxel = 1;
+					}
+				}
+			}
+		}
+	});
+}
+
+
+void OccupancyGrid::computeDistance(const std::vector<uint8_t>& dense, unsigned int numThreads)
+{
+	m_distance.resize(dense.size());
+	for (size_t i = 0; i < dense.size(); ++i)
+		m_distance[i] = dense[i] ? 0.0f : OCCUPANCY_INF;
+
+	// Separable passes along x, y and z. Lines of one pass are independent.
+	const size_t strides[3] = { 1, size_t(m_res[0]), size_t(m_res[0]) * m_res[1] };
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		const int n = m_res[axis];
+		const int u = (axis + 1) % 3, w = (axis + 2) % 3;
+		const unsigned int numLines = static_cast<unsigned int>(m_res[u] * m_res[w]);
+
+		parallelFor(numLines, numThreads, [&](unsigned int begin, unsigned int end)
+		{
+			std::vector<float> f(n), d(n), z(n + 1);
+			std::vector<int> v(n);
+
+			for (unsigned int line = begin; line < end; ++line)
+			{
+				const size_t base = (line % m_res[u]) * strides[u] + (line / m_res[u]) * strides[w];
+				for (int q = 0; q < n; ++q)
+					f[q] = m_distance[base + q * strides[axis]];
+
+				distanceTransform1D(f.data(), n, d.data(), v.data(), z.data());
+
+				for (int q = 0; q < n; ++q)
+					m_distance[base + q * strides[axis]] = d[q];
+			}
+		});
+	}
+
+	for (float& distance : m_distance)
+		distance = sqrtf(distance);
+}
+
+
+void OccupancyGrid::computeFreeRegion(const std::vector<uint8_t>& dense)
+{
+	// Label the 6-connected free regions. Interiors of closed objects end up in small regions of their own.
+	std::vector<int32_t> labels(dense.size(), -1);
+	std::vector<uint32_t> queue;
+	int32_t largest = -1;
+	size_t largestSize = 0;
+	int32_t numLabels = 0;
+
+	for (size_t seed = 0; seed < dense.size(); ++seed)
+	{
+		if (dense[seed] || labels[seed] >= 0)
+			continue;
+
+		const int32_t label = numLabels++;
+		queue.clear();
+		queue.push_back(static_cast<uint32_t>(seed));
+		labels[seed] = label;
+
+		for (size_t head = 0; head < queue.size(); ++head)
+		{
+			const uint32_t index = queue[head];
+			const int x = index % m_res[0];
+			const int y = (index / m_res[0]) % m_res[1];
+			const int z = index / (m_res[0] * m_res[1]);
+
+			const int neighbours[6][3] = { { x - 1, y, z }, { x + 1, y, z }, { x, y - 1, z }, { x, y + 1, z }, { x, y, z - 1 }, { x, y, z + 1 } };
+			for (int i = 0; i < 6; ++i)
+			{
+				const int nx = neighbours[i][0], ny = neighbours[i][1], nz = neighbours[i][2];
+				if (nx < 0 || ny < 0 || nz < 0 || nx >= m_res[0] || ny >= m_res[1] || nz >= m_res[2])
+					continue;
+
+				const size_t next = voxelIndex(nx, ny, nz);
+				if (dense[next] || labels[next] >= 0)
+					continue;
+
+				labels[next] = label;
+				queue.push_back(static_cast<uint32_t>(next));
+			}
+		}
+
+		if (queue.size() > largestSize)
+		{
+			largestSize = queue.size();
+			largest = label;
+		}
+	}
+
+	m_freeRegion.resize(dense.size());
+	for (size_t i = 0; i < dense.size(); ++i)
+		m_freeRegion[i] = labels[i] == largest ? 1 : 0;
+}
+
+
+void OccupancyGrid::setMinClearance(float clearance)
+{
+	m_candidates.clear();
+
+	// Distances are between voxel centres, half a voxel is lost to the extent of the occupied voxel.
+	const float minDistance = clearance / m_voxelSize + 0.5f;
+	for (size_t i = 0; i < m_distance.size(); ++i)
+	{
+		if (m_freeRegion[i] && m_distance[i] >= minDistance)
+			m_candidates.push_back(static_cast<uint32_t>(i));
+	}
+}
+
+
+bool OccupancyGrid::sampleFreePoint(float r0, float r1, float r2, float r3, float3& p) const
+{
+	if (m_candidates.empty())
+		return false;
+
+	const size_t n = m_candidates.size();
+	const uint32_t index = m_candidates[std::min(static_cast<size_t>(r0 * n), n - 1)];
+	const int x = index % m_res[0];
+	const int y = (index / m_res[0]) % m_res[1];
+	const int z = index / (m_res[0] * m_res[1]);
+
+	p = m_bounds.m_min + make_float3(x + r1, y + r2, z + r3) * m_voxelSize;
+	return true;
+}
+
+
+bool OccupancyGrid::isOccupied(int x, int y, int z) const
+{
+	if (x < 0 || y < 0 || z < 0 || x >= m_res[0] || y >= m_res[1] || z >= m_res[2])
+		return false;
+
+	const int32_t offset = m_brickOffsets[brickIndex(x, y, z)];
+	if (offset < 0)
+		return false;
+
+	return (m_brickMasks[offset] >> (((z & 3) << 4) | ((y & 3) << 2) | (x & 3))) & 1;
+}
+
+
+float OccupancyGrid::getDistance(const float3& p) const
+{
+	if (empty())
+		return OCCUPANCY_INF;
+
+	const float3 g = (p - m_bounds.m_min) / m_voxelSize;
+	const int x = std::min(std::max(static_cast<int>(floorf(g.x)), 0), m_res[0] - 1);
+	const int y = std::min(std::max(static_cast<int>(floorf(g.y)), 0), m_res[1] - 1);
+	const int z = std::min(std::max(static_cast<int>(floorf(g.z)), 0), m_res[2] - 1);
+
+	return m_distance[voxelIndex(x, y, z)] * m_voxelSize;
+}
+
+
+void OccupancyGrid::setKey(uint64_t key)
+{
+	m_key = key;
+}
+
+
+struct OccupancyGridHeader
+{
+	char     magic[4];
+	uint32_t version;
+	uint64_t key;
+	int32_t  res[3];
+	float    bmin[3];
+	float    voxelSize;
+	uint32_t numBricks;
+};
+
+
+bool OccupancyGrid::save(const std::string& filename) const
+{
+	FILE* file = fopen(filename.c_str(), "wb");
+	if (!file)
+		return false;
+
+	OccupancyGridHeader header;
+	memcpy(header.magic, OCCUPANCY_MAGIC, 4);
+	header.version = OCCUPANCY_VERSION;
+	header.key = m_key;
+	header.res[0] = m_res[0]; header.res[1] = m_res[1]; header.res[2] = m_res[2];
+	header.bmin[0] = m_bounds.m_min.x; header.bmin[1] = m_bounds.m_min.y; header.bmin[2] = m_bounds.m_min.z;
+	header.voxelSize = m_voxelSize;
+	header.numBricks = static_cast<uint32_t>(m_brickMasks.size());
+
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	ok = ok && fwrite(m_brickOffsets.data(), sizeof(int32_t), m_brickOffsets.size(), file) == m_brickOffsets.size();
+	ok = ok && fwrite(m_brickMasks.data(), sizeof(uint64_t), m_brickMasks.size(), file) == m_brickMasks.size();
+	ok = ok && fwrite(m_distance.data(), sizeof(float), m_distance.size(), file) == m_distance.size();
+	ok = ok && fwrite(m_freeRegion.data(), sizeof(uint8_t), m_freeRegion.size(), file) == m_freeRegion.size();
+
+	fclose(file);
+	return ok;
+}
+
+
+bool OccupancyGrid::load(const std::string& filename, uint64_t key)
+{
+	FILE* file = fopen(filename.c_str(), "rb");
+	if (!file)
+		return false;
+
+	OccupancyGridHeader header;
+	if (fread(&header, sizeof(header), 1, file) != 1 ||
+		memcmp(header.magic, OCCUPANCY_MAGIC, 4) != 0 || header.version != OCCUPANCY_VERSION || header.key != key ||
+		header.res[0] <= 0 || header.res[1] <= 0 || header.res[2] <= 0)
+	{
+		fclose(file);
+		return false;
+	}
+
+	m_key = key;
+	m_voxelSize = header.voxelSize;
+	for (int i = 0; i < 3; ++i)
+	{
+		m_res[i] = header.res[i];
+		m_brickRes[i] = (m_res[i] + 3) / 4;
+	}
+	const float3 bmin = make_float3(header.bmin[0], header.bmin[1], header.bmin[2]);
+	m_bounds = Aabb(bmin, bmin + make_float3(float(m_res[0]), float(m_res[1]), float(m_res[2])) * m_voxelSize);
+
+	const size_t numVoxels = size_t(m_res[0]) * m_res[1] * m_res[2];
+	m_brickOffsets.resize(size_t(m_brickRes[0]) * m_brickRes[1] * m_brickRes[2]);
+	m_brickMasks.resize(header.numBricks);
+	m_distance.resize(numVoxels);
+	m_freeRegion.resize(numVoxels);
+	m_candidates.clear();
+
+	bool ok = fread(m_brickOffsets.data(), sizeof(int32_t), m_brickOffsets.size(), file) == m_brickOffsets.size();
+	ok = ok && fread(m_brickMasks.data(), sizeof(uint64_t), m_brickMasks.size(), file) == m_brickMasks.size();
+	ok = ok && fread(m_distance.data(), sizeof(float), m_distance.size(), file) == m_distance.size();
+	ok = ok && fread(m_freeRegion.data(), sizeof(uint8_t), m_freeRegion.size(), file) == m_freeRegion.size();
+
+	fclose(file);
+
+	if (!ok)
+	{
+		m_res[0] = m_res[1] = m_res[2] = 0;
+		m_distance.clear();
+	}
+	return ok;
+}
+
+
+bool OccupancyGrid::empty() const
+{
+	return m_distance.empty();
+}
+
+
+const Aabb& OccupancyGrid::getBounds() const
+{
+	return m_bounds;
+}
+
+
+float OccupancyGrid::getVoxelSize() const
+{
+	return m_voxelSize;
+}
+
+
+size_t OccupancyGrid::getNumBricks() const
+{
+	return m_brickMasks.size();
+}
+
+
+size_t OccupancyGrid::getNumCandidates() const
+{
+	return m_candidates.size();
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#ifndef OCCUPANCY_GRID_H
+#define OCCUPANCY_GRID_H
+
+#include <optixu/optixu_math_namespace.h>
+#include <optixu/optixu_aabb_namespace.h>
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/*
+	Voxelized scene occupancy for sampling camera positions in free space.
+	Occupied voxels are stored sparsely in 4x4x4 bricks (one 64-bit mask per non-empty brick).
+	On top of that a dense distance-to-surface field and the largest connected free region are kept,
+	so points with a given clearance that are not inside closed objects can be drawn in O(1).
+	The grid can be cached in a sidecar file; the cache is keyed by a hash of the geometry and the grid setup.
+*/
+class OccupancyGrid
+{
+public:
+	OccupancyGrid();
+
+	void build(const std::vector<optix::float3>& vertices, const std::vector<optix::int3>& indices,
+		const optix::Aabb& bounds, unsigned int resolution, unsigned int numThreads = 0);
+
+	bool load(const std::string& filename, uint64_t key);	/* false if missing or built for other geometry */
+	bool save(const std::string& filename) const;
+
+	void setKey(uint64_t key);
+
+	bool isOccupied(int x, int y, int z) const;
+	float getDistance(const optix::float3& p) const;	/* to the nearest occupied voxel, in world units */
+
+	void setMinClearance(float clearance);				/* world units, selects the voxels sampleFreePoint() draws from */
+	bool sampleFreePoint(float r0, float r1, float r2, float r3, optix::float3& p) const;	/* r* uniform in [0, 1) */
+
+	bool empty() const;
+	const optix::Aabb& getBounds() const;
+	float getVoxelSize() const;
+	size_t getNumBricks() const;
+	size_t getNumCandidates() const;
+
+private:
+	size_t voxelIndex(int x, int y, int z) const;
+	size_t brickIndex(int x, int y, int z) const;
+
+	void voxelize(const std::vector<optix::float3>& vertices, const std::vector<optix::int3>& indices,
+		std::vector<uint8_t>& dense, unsigned int numThreads) const;
+	void computeDistance(const std::vector<uint8_t>& dense, unsigned int numThreads);
+	void computeFreeRegion(const std::vector<uint8_t>& dense);
+
+private:
+	optix::Aabb m_bounds;	/* cubic voxels, so this may be larger than the scene bounds */
+	float       m_voxelSize;
+	int         m_res[3];
+	int         m_brickRes[3];
+	uint64_t    m_key;
+
+	std::vector<int32_t>  m_brickOffsets;	/* per brick, -1 for empty bricks */
+	std::vector<uint64_t> m_brickMasks;
+	std::vector<float>    m_distance;		/* per voxel, in voxels */
+	std::vector<uint8_t>  m_freeRegion;		/* per voxel, 1 if part of the largest connected free region */
+	std::vector<uint32_t> m_candidates;		/* voxels of the free region with enough clearance */
+};
+
+#endif
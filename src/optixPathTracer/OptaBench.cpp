@@ -0,0 +1,1036 @@
+/*
+	OptaBench: throughput of the host code OptaGen runs around the renderer, the scene parser, the mesh, image and
+	texture loaders, the .npy writer, the BSDFs and the samplers. No OptiX context is created, so it runs on machines
+	without a GPU.
+
+	Every input is generated into a scratch directory with a fixed seed, so runs on the same machine are comparable.
+	Scene and mesh files report MB/s of the file, the .npy writer MB/s of the buffer, the image cases pixels (items/s)
+	and the BSDF and sampler cases evaluations (items/s). --check validates the BSDFs (BsdfCheck.h), the convergence of
+	the samplers (SamplerCheck.h) and the light selection (LightSelectionCheck.h) first and fails if one does not pass.
+	Each case runs --runs times and the fastest run is reported. --save writes the results as JSON, --baseline compares
+	against such a file and fails when a case got slower than --threshold percent.
+*/
+
+#include "sceneLoader.h"
+#include "Picture.h"
+#include "Texture.h"
+#include "NpyWriter.h"
+#include "BsdfCheck.h"
+#include "SamplerCheck.h"
+#include "LightSelectionCheck.h"
+#include "bsdf.h"
+#include "path.h"
+
+#include <sutil.h>
+#include <Mesh.h>
+#include <HDRLoader.h>
+#include <IL/il.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <regex>
+#include <sstream>
+#include <stdexcept>
+#include <stdint.h>
+#include <vector>
+
+#include <sys/stat.h>
+#if defined( _WIN32 )
+#  ifndef WIN32_LEAN_AND_MEAN
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+#  ifndef NOMINMAX
+#    define NOMINMAX
+#  endif
+#  include <windows.h>
+#  include <direct.h>
+#else
+#  include <unistd.h>
+#endif
+#include <dirent.h>
+
+namespace
+{
+
+const double MB = 1024.0 * 1024.0;
+
+struct BenchResult
+{
+	std::string name;
+	std::string unit;		/* MB/s or items/s */
+	double      value;		/* throughput of the fastest run */
+	double      seconds;	/* of the fastest run */
+};
+
+struct BenchOptions
+{
+	BenchOptions() : runs(5), scale(1.0), threshold(10.0), check(false) {}
+
+	int         runs;
+	double      scale;		/* multiplies the element count of every input */
+	double      threshold;	/* percent */
+	std::string filter;
+	std::string dir;
+	std::string baseline;
+	std::string save;
+	bool        check;		/* run the BSDF checks */
+};
+
+
+class Bench
+{
+public:
+	explicit Bench(const BenchOptions& options) : m_options(options) {}
+
+	bool enabled(const std::string& name) const
+	{
+		return m_options.filter.empty() || name.find(m_options.filter) != std::string::npos;
+	}
+
+	// amount is in bytes for MB/s and in items for items/s.
+	void run(const std::string& name, const char* unit, double amount, const std::function<void()>& body)
+	{
+		if (!enabled(name))
+			return;
+
+		double best = 0.0;
+		for (int i = 0; i < m_options.runs; ++i)
+		{
+			const double start = sutil::currentTime();
+			body();
+			const double elapsed = sutil::currentTime() - start;
+			if (i == 0 || elapsed < best)
+				best = elapsed;
+		}
+		best = std::max(best, 1e-9);
+
+		BenchResult result;
+		result.name = name;
+		result.unit = unit;
+		result.value = (result.unit == "MB/s" ? amount / MB : amount) / best;
+		result.seconds = best;
+		m_results.push_back(result);
+
+		std::cout << std::left << std::setw(36) << name << std::right << std::setw(18) << std::fixed << std::setprecision(2)
+			<< result.value << " " << std::left << std::setw(8) << unit << std::right << std::setw(10) << std::setprecision(3)
+			<< best * 1000.0 << " ms" << std::endl;
+	}
+
+	const std::vector<BenchResult>& getResults() const { return m_results; }
+
+private:
+	BenchOptions             m_options;
+	std::vector<BenchResult> m_results;
+};
+
+
+uint64_t fileSize(const std::string& filename)
+{
+	struct stat st;
+	if (stat(filename.c_str(), &st) != 0)
+		throw std::runtime_error("Cannot stat " + filename);
+	return static_cast<uint64_t>(st.st_size);
+}
+
+
+std::string tempDirectory()
+{
+#if defined( _WIN32 )
+	char path[MAX_PATH + 1];
+	const DWORD length = GetTempPathA(sizeof(path), path);
+	if (length == 0 || length > MAX_PATH)
+		return ".";
+	return std::string(path, length - 1);	// without the trailing backslash
+#else
+	const char* path = getenv("TMPDIR");
+	return path && *path ? path : "/tmp";
+#endif
+}
+
+
+bool makeDirectory(const std::string& path)
+{
+#if defined( _WIN32 )
+	return _mkdir(path.c_str()) == 0 || errno == EEXIST;
+#else
+	return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+#endif
+}
+
+
+// Creates the directory and its missing parents.
+void makeDirectories(const std::string& path)
+{
+	for (size_t i = 1; i <= path.size(); ++i)
+	{
+		if (i < path.size() && path[i] != '/' && path[i] != '\\')
+			continue;
+		const std::string parent = path.substr(0, i);
+		if (!makeDirectory(parent) && i == path.size())
+			throw std::runtime_error("Cannot create directory " + path);
+	}
+}
+
+
+// Deletes the directory with its files and subdirectories, errors are ignored.
+void removeDirectory(const std::string& path)
+{
+	if (DIR* dir = opendir(path.c_str()))
+	{
+		while (struct dirent* entry = readdir(dir))
+		{
+			const std::string name = entry->d_name;
+			if (name == "." || name == "..")
+				continue;
+			const std::string child = path + "/" + name;
+			struct stat st;
+			if (stat(child.c_str(), &st) == 0 && (st.st_mode & S_IFMT) == S_IFDIR)
+				removeDirectory(child);
+			else
+				std::remove(child.c_str());
+		}
+		closedir(dir);
+	}
+#if defined( _WIN32 )
+	_rmdir(path.c_str());
+#else
+	rmdir(path.c_str());
+#endif
+}
+
+
+// Wavy grid with normals and texcoords, two triangles per cell.
+void generateGrid(int side, Mesh& mesh)
+{
+	mesh.num_vertices = side * side;
+	mesh.num_triangles = 2 * (side - 1) * (side - 1);
+	mesh.has_normals = true;
+	mesh.has_texcoords = true;
+	mesh.num_materials = 1;
+	allocMesh(mesh);
+
+	const float step = 1.0f / (side - 1);
+	for (int y = 0; y < side; ++y)
+	{
+		for (int x = 0; x < side; ++x)
+		{
+			const int v = y * side + x;
+			const float u = x * step, w = y * step;
+			const float h = 0.05f * std::sin(20.0f * u) * std::cos(20.0f * w);
+			const float dx = std::cos(20.0f * u) * std::cos(20.0f * w), dy = -std::sin(20.0f * u) * std::sin(20.0f * w);
+			const float len = std::sqrt(dx * dx + dy * dy + 1.0f);
+
+			mesh.positions[3 * v + 0] = u;
+			mesh.positions[3 * v + 1] = h;
+			mesh.positions[3 * v + 2] = w;
+			mesh.normals[3 * v + 0] = -dx / len;
+			mesh.normals[3 * v + 1] = 1.0f / len;
+			mesh.normals[3 * v + 2] = -dy / len;
+			mesh.texcoords[2 * v + 0] = u;
+			mesh.texcoords[2 * v + 1] = w;
+		}
+	}
+
+	int32_t* tri = mesh.tri_indices;
+	for (int y = 0; y + 1 < side; ++y)
+	{
+		for (int x = 0; x + 1 < side; ++x)
+		{
+			const int32_t v = y * side + x;
+			*tri++ = v;
+			*tri++ = v + side;
+			*tri++ = v + 1;
+			*tri++ = v + 1;
+			*tri++ = v + side;
+			*tri++ = v + side + 1;
+		}
+	}
+	std::fill(mesh.mat_indices, mesh.mat_indices + mesh.num_triangles, 0);
+}
+
+
+void writeObj(const std::string& filename, const Mesh& mesh)
+{
+	std::ofstream out(filename.c_str(), std::ios::binary);
+	out << std::setprecision(6);
+	for (int32_t v = 0; v < mesh.num_vertices; ++v)
+		out << "v " << mesh.positions[3 * v] << " " << mesh.positions[3 * v + 1] << " " << mesh.positions[3 * v + 2] << "\n";
+	for (int32_t v = 0; v < mesh.num_vertices; ++v)
+		out << "vn " << mesh.normals[3 * v] << " " << mesh.normals[3 * v + 1] << " " << mesh.normals[3 * v + 2] << "\n";
+	for (int32_t v = 0; v < mesh.num_vertices; ++v)
+		out << "vt " << mesh.texcoords[2 * v] << " " << mesh.texcoords[2 * v + 1] << "\n";
+	for (int32_t t = 0; t < mesh.num_triangles; ++t)
+	{
+		out << "f";
+		for (int k = 0; k < 3; ++k)
+		{
+			const int32_t i = mesh.tri_indices[3 * t + k] + 1;
+			out << " " << i << "/" << i << "/" << i;
+		}
+		out << "\n";
+	}
+	if (!out)
+		throw std::runtime_error("Could not write " + filename);
+}
+
+
+void writeAsciiPly(const std::string& filename, const Mesh& mesh)
+{
+	std::ofstream out(filename.c_str(), std::ios::binary);
+	out << "ply\nformat ascii 1.0\n"
+		<< "element vertex " << mesh.num_vertices << "\n"
+		<< "property float x\nproperty float y\nproperty float z\n"
+		<< "property float nx\nproperty float ny\nproperty float nz\n"
+		<< "property float u\nproperty float v\n"
+		<< "element face " << mesh.num_triangles << "\n"
+		<< "property list uchar int vertex_indices\n"
+		<< "end_header\n" << std::setprecision(6);
+	for (int32_t v = 0; v < mesh.num_vertices; ++v)
+	{
+		out << mesh.positions[3 * v] << " " << mesh.positions[3 * v + 1] << " " << mesh.positions[3 * v + 2] << " "
+			<< mesh.normals[3 * v] << " " << mesh.normals[3 * v + 1] << " " << mesh.normals[3 * v + 2] << " "
+			<< mesh.texcoords[2 * v] << " " << mesh.texcoords[2 * v + 1] << "\n";
+	}
+	for (int32_t t = 0; t < mesh.num_triangles; ++t)
+		out << "3 " << mesh.tri_indices[3 * t] << " " << mesh.tri_indices[3 * t + 1] << " " << mesh.tri_indices[3 * t + 2] << "\n";
+	if (!out)
+		throw std::runtime_error("Could not write " + filename);
+}
+
+
+// Noisy sky gradient with a small bright sun, the shape the environment CDF is built for.
+void generateSky(unsigned int width, unsigned int height, std::vector<float>& rgb, std::mt19937& rng)
+{
+	std::uniform_real_distribution<float> noise(0.95f, 1.05f);
+	rgb.resize(size_t(width) * height * 3);
+	const float sunX = 0.3f * width, sunY = 0.25f * height, sunR = 0.01f * width + 1.0f;
+	for (unsigned int y = 0; y < height; ++y)
+	{
+		for (unsigned int x = 0; x < width; ++x)
+		{
+			float* p = &rgb[(size_t(y) * width + x) * 3];
+			const float t = float(y) / height;
+			p[0] = (0.3f + 0.5f * t) * noise(rng);
+			p[1] = (0.5f + 0.3f * t) * noise(rng);
+			p[2] = (1.0f - 0.2f * t) * noise(rng);
+			const float dx = x - sunX, dy = y - sunY;
+			if (dx * dx + dy * dy < sunR * sunR)
+				p[0] = p[1] = p[2] = 5000.0f;
+		}
+	}
+}
+
+
+// Radiance RGBE with run-length encoded scanlines, as written by most tools.
+void writeHdr(const std::string& filename, unsigned int width, unsigned int height, const std::vector<float>& rgb)
+{
+	std::ofstream out(filename.c_str(), std::ios::binary);
+	out << "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y " << height << " +X " << width << "\n";
+
+	std::vector<unsigned char> line(width * 4);
+	for (unsigned int y = 0; y < height; ++y)
+	{
+		for (unsigned int x = 0; x < width; ++x)
+		{
+			const float* p = &rgb[(size_t(y) * width + x) * 3];
+			const float m = std::max(p[0], std::max(p[1], p[2]));
+			unsigned char* e = &line[x * 4];
+			if (m < 1e-32f)
+			{
+				e[0] = e[1] = e[2] = e[3] = 0;
+				continue;
+			}
+			int exponent;
+			const float s = std::frexp(m, &exponent) * 256.0f / m;
+			e[0] = static_cast<unsigned char>(p[0] * s);
+			e[1] = static_cast<unsigned char>(p[1] * s);
+			e[2] = static_cast<unsigned char>(p[2] * s);
+			e[3] = static_cast<unsigned char>(exponent + 128);
+		}
+
+		const unsigned char header[4] = { 2, 2, static_cast<unsigned char>(width >> 8), static_cast<unsigned char>(width & 0xFF) };
+		out.write(reinterpret_cast<const char*>(header), 4);
+		for (unsigned int c = 0; c < 4; ++c)
+		{
+			unsigned int x = 0;
+			while (x < width)
+			{
+				// Runs of 3 and more equal bytes are encoded, the rest goes into literal spans of up to 128 bytes.
+				unsigned int run = 1;
+				while (x + run < width && run < 127 && line[(x + run) * 4 + c] == line[x * 4 + c])
+					++run;
+				if (run >= 3)
+				{
+					out.put(static_cast<char>(0x80 | run));
+					out.put(static_cast<char>(line[x * 4 + c]));
+					x += run;
+					continue;
+				}
+				unsigned int span = 0;
+				while (x + span < width && span < 128)
+				{
+					const unsigned int i = x + span;
+					if (i + 2 < width && line[i * 4 + c] == line[(i + 1) * 4 + c] && line[i * 4 + c] == line[(i + 2) * 4 + c])
+						break;
+					++span;
+				}
+				out.put(static_cast<char>(span));
+				for (unsigned int i = 0; i < span; ++i)
+					out.put(static_cast<char>(line[(x + i) * 4 + c]));
+				x += span;
+			}
+		}
+	}
+	if (!out)
+		throw std::runtime_error("Could not write " + filename);
+}
+
+
+// Uncompressed 24 bit TGA, bottom row first.
+void writeTga(const std::string& filename, unsigned int width, unsigned int height, std::mt19937& rng)
+{
+	std::ofstream out(filename.c_str(), std::ios::binary);
+	unsigned char header[18] = { 0 };
+	header[2] = 2;
+	header[12] = static_cast<unsigned char>(width & 0xFF);
+	header[13] = static_cast<unsigned char>(width >> 8);
+	header[14] = static_cast<unsigned char>(height & 0xFF);
+	header[15] = static_cast<unsigned char>(height >> 8);
+	header[16] = 24;
+	out.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+	std::vector<unsigned char> line(width * 3);
+	for (unsigned int y = 0; y < height; ++y)
+	{
+		for (unsigned int x = 0; x < width; ++x)
+		{
+			const unsigned int checker = ((x / 32) ^ (y / 32)) & 1;
+			line[x * 3 + 0] = static_cast<unsigned char>(checker ? 200 : 40 + (rng() & 15));
+			line[x * 3 + 1] = static_cast<unsigned char>((x * 255) / width);
+			line[x * 3 + 2] = static_cast<unsigned char>((y * 255) / height);
+		}
+		out.write(reinterpret_cast<const char*>(line.data()), line.size());
+	}
+	if (!out)
+		throw std::runtime_error("Could not write " + filename);
+}
+
+
+// Materials, single meshes, instances and lights in the proportions of the generated training scenes.
+void writeScene(const std::string& filename, int blocks, std::mt19937& rng)
+{
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::ofstream out(filename.c_str(), std::ios::binary);
+	out << std::fixed << std::setprecision(6);
+
+	out << "properties\n{\n\twidth 512\n\theight 512\n\tfov 45\n\tmax_depth 4\n"
+		<< "\tposition 0 1 5\n\tlook_at 0 0 0\n\tup 0 1 0\n}\n\n";
+
+	const char* brdfs[] = { "DISNEY", "GLASS", "LAMBERT", "ROUGHDIELECTRIC" };
+	const int materials = std::max(1, blocks / 4);
+	for (int m = 0; m < materials; ++m)
+	{
+		out << "material mat" << m << "\n{\n"
+			<< "\tcolor " << unit(rng) << " " << unit(rng) << " " << unit(rng) << "\n"
+			<< "\troughness " << 0.1f + 0.8f * unit(rng) << "\n"
+			<< "\tmetallic " << unit(rng) << "\n"
+			<< "\tbrdf " << brdfs[m % 4] << "\n";
+		if (m % 8 == 0)
+			out << "\talbedoTex textures/tex" << m % 64 << ".png\n";
+		out << "}\n\n";
+	}
+
+	for (int b = 0; b < blocks; ++b)
+	{
+		const bool instance = b % 16 == 0;
+		out << (instance ? "instance" : "mesh") << "\n{\n"
+			<< "\tfile meshes/mesh" << b % 256 << ".obj\n"
+			<< "\tmaterial mat" << rng() % materials << "\n";
+		for (int t = 0; t < (instance ? 16 : 1); ++t)
+		{
+			const float s = 0.5f + unit(rng);
+			out << "\ttransform " << s << " 0 0 " << 10.0f * unit(rng) << " 0 " << s << " 0 " << 10.0f * unit(rng)
+				<< " 0 0 " << s << " " << 10.0f * unit(rng) << " 0 0 0 1\n";
+		}
+		out << "}\n\n";
+	}
+
+	for (int l = 0; l < std::max(1, blocks / 64); ++l)
+	{
+		out << "light\n{\n\ttype Quad\n"
+			<< "\tposition " << unit(rng) << " 4 " << unit(rng) << "\n"
+			<< "\tv1 " << 1.0f + unit(rng) << " 4 0\n"
+			<< "\tv2 0 4 " << 1.0f + unit(rng) << "\n"
+			<< "\temission 10 10 10\n}\n\n";
+	}
+	if (!out)
+		throw std::runtime_error("Could not write " + filename);
+}
+
+
+void benchScene(Bench& bench, const BenchOptions& options)
+{
+	std::mt19937 rng(1234);
+	if (!bench.enabled("scene.parse"))
+		return;
+
+	const std::string filename = options.dir + "/bench.scene";
+	writeScene(filename, std::max(16, static_cast<int>(20000 * options.scale)), rng);
+
+	bench.run("scene.parse", "MB/s", double(fileSize(filename)), [&]()
+	{
+		delete LoadScene(filename.c_str(), false);
+	});
+}
+
+
+void benchMeshes(Bench& bench, const BenchOptions& options)
+{
+	const bool needObj = bench.enabled("obj.scan") || bench.enabled("obj.load");
+	const bool needPly = bench.enabled("ply.scan") || bench.enabled("ply.load");
+	const bool needAsciiPly = bench.enabled("ply.ascii.load");
+	if (!needObj && !needPly && !needAsciiPly)
+		return;
+
+	const int side = std::max(8, static_cast<int>(512 * std::sqrt(options.scale)));
+	Mesh grid;
+	generateGrid(side, grid);
+
+	const std::string obj = options.dir + "/bench.obj";
+	const std::string ply = options.dir + "/bench.ply";
+	const std::string asciiPly = options.dir + "/bench_ascii.ply";
+	if (needObj)
+		writeObj(obj, grid);
+	if (needPly)
+		saveMeshPLY(ply, grid);
+	if (needAsciiPly)
+		writeAsciiPly(asciiPly, grid);
+	freeMesh(grid);
+
+	// Scanning with the default flags includes the cleanup, loading includes the scan like loadMesh() does.
+	const struct
+	{
+		const char*        name;
+		const std::string& filename;
+		bool               load;
+	} cases[] = {
+		{ "obj.scan", obj, false },
+		{ "obj.load", obj, true },
+		{ "ply.scan", ply, false },
+		{ "ply.load", ply, true },
+		{ "ply.ascii.load", asciiPly, true },
+	};
+	for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i)
+	{
+		if (!bench.enabled(cases[i].name))
+			continue;
+
+		const std::string& filename = cases[i].filename;
+		const bool load = cases[i].load;
+		bench.run(cases[i].name, "MB/s", double(fileSize(filename)), [&]()
+		{
+			Mesh mesh;
+			MeshLoader loader(filename);
+			loader.scanMesh(mesh);
+			if (mesh.num_triangles != 2 * (side - 1) * (side - 1))
+				throw std::runtime_error("Unexpected triangle count in " + filename);
+			if (load)
+			{
+				allocMesh(mesh);
+				loader.loadMesh(mesh);
+				freeMesh(mesh);
+			}
+		});
+	}
+}
+
+
+void benchImages(Bench& bench, const BenchOptions& options)
+{
+	std::mt19937 rng(1234);
+	const double side = std::sqrt(options.scale);
+	// The RLE scanlines of .hdr files are limited to 32767 pixels, TGA to 65535.
+	const unsigned int envWidth = std::min(32767u, std::max(16u, static_cast<unsigned int>(2048 * side)));
+	const unsigned int envHeight = envWidth / 2;
+	const unsigned int texSide = std::min(65535u, std::max(16u, static_cast<unsigned int>(2048 * side)));
+
+	const std::string hdr = options.dir + "/bench.hdr";
+	const std::string tga = options.dir + "/bench.tga";
+	const bool needHdr = bench.enabled("hdr.load") || bench.enabled("picture.load.hdr") || bench.enabled("texture.cdf");
+	if (needHdr)
+	{
+		std::vector<float> sky;
+		generateSky(envWidth, envHeight, sky, rng);
+		writeHdr(hdr, envWidth, envHeight, sky);
+	}
+	if (bench.enabled("picture.load.tga"))
+		writeTga(tga, texSide, texSide, rng);
+
+	if (bench.enabled("hdr.load"))
+	{
+		bench.run("hdr.load", "items/s", double(envWidth) * envHeight, [&]()
+		{
+			HDRLoader loader(hdr);
+			if (loader.failed())
+				throw std::runtime_error("HDRLoader failed on " + hdr);
+		});
+	}
+
+	if (bench.enabled("picture.load.hdr"))
+	{
+		bench.run("picture.load.hdr", "items/s", double(envWidth) * envHeight, [&]()
+		{
+			Picture picture;
+			if (!picture.load(hdr))
+				throw std::runtime_error("Picture::load failed on " + hdr);
+		});
+	}
+
+	if (bench.enabled("picture.load.tga"))
+	{
+		bench.run("picture.load.tga", "items/s", double(texSide) * texSide, [&]()
+		{
+			Picture picture;
+			if (!picture.load(tga))
+				throw std::runtime_error("Picture::load failed on " + tga);
+		});
+	}
+
+	// Environment maps are converted to RGBA32F once, the CDF is rebuilt from those texels in every run.
+	if (bench.enabled("texture.cdf"))
+	{
+		Picture picture;
+		Texture environment;
+		if (!picture.load(hdr) || !environment.createEnvironment(&picture))
+			throw std::runtime_error("Could not create the environment from " + hdr);
+
+		std::vector<float> cdfU, cdfV;
+		bench.run("texture.cdf", "items/s", double(envWidth) * envHeight, [&]()
+		{
+			if (!environment.calculateCDF(cdfU, cdfV))
+				throw std::runtime_error("Texture::calculateCDF failed");
+		});
+	}
+}
+
+
+// Host to device conversions of the pixel formats DevIL hands to Texture::createSampler().
+void benchConvert(Bench& bench, const BenchOptions& options)
+{
+	std::mt19937 rng(1234);
+	const size_t texels = std::max<size_t>(256, static_cast<size_t>(1024 * 1024 * options.scale));
+
+	const struct
+	{
+		const char* name;
+		int         channels;
+		int         format;
+	} formats[] = {
+		{ "l", 1, IL_LUMINANCE },
+		{ "la", 2, IL_LUMINANCE_ALPHA },
+		{ "rgb", 3, IL_RGB },
+		{ "bgr", 3, IL_BGR },
+		{ "rgba", 4, IL_RGBA },
+		{ "bgra", 4, IL_BGRA },
+	};
+	const struct
+	{
+		const char* name;
+		size_t      size;
+		int         type;
+	} types[] = {
+		{ "u8", 1, IL_UNSIGNED_BYTE },
+		{ "u16", 2, IL_UNSIGNED_SHORT },
+		{ "f32", 4, IL_FLOAT },
+	};
+
+	std::vector<unsigned char> src(texels * 4 * sizeof(float));
+	for (size_t i = 0; i < src.size(); ++i)
+		src[i] = static_cast<unsigned char>(rng());
+	// Random float bits may be NaN or denormal, which runs slower on some hosts.
+	std::vector<float> srcFloat(texels * 4);
+	for (size_t i = 0; i < srcFloat.size(); ++i)
+		srcFloat[i] = float(rng() & 0xFFFF) / 65535.0f;
+
+	std::vector<unsigned char> dst;
+	for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); ++f)
+	{
+		for (size_t t = 0; t < sizeof(types) / sizeof(types[0]); ++t)
+		{
+			const std::string name = std::string("texture.convert.") + formats[f].name + "." + types[t].name;
+			if (!bench.enabled(name))
+				continue;
+
+			Texture texture;
+			const unsigned int hostEncoding = texture.determineHostEncoding(formats[f].format, types[t].type);
+			if (!texture.determineDeviceEncoding(formats[f].format, types[t].type))
+				throw std::runtime_error("No device encoding for " + name);
+			dst.resize(texels * texture.getElementSize());
+
+			const void* source = types[t].type == IL_FLOAT ? static_cast<const void*>(srcFloat.data()) : src.data();
+			bench.run(name, "items/s", double(texels), [&]()
+			{
+				texture.convert(dst.data(), source, texels, hostEncoding);
+			});
+		}
+	}
+}
+
+
+// writeBufferToNpy() maps the buffer and hands the pointer to writeDataToNpy(), the host array stands in for the mapping.
+void benchNpy(Bench& bench, const BenchOptions& options)
+{
+	std::mt19937 rng(1234);
+	if (!bench.enabled("npy.write.features") && !bench.enabled("npy.write.reference"))
+		return;
+
+	const double side = std::sqrt(options.scale);
+	const size_t width = std::max<size_t>(16, static_cast<size_t>(256 * side));
+	const size_t height = width;
+	const int frames = 8;
+	const int featDim = sizeof(PathFeature) / sizeof(float);
+
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::vector<float> features(width * height * frames * featDim);
+	for (size_t i = 0; i < features.size(); ++i)
+		features[i] = unit(rng);
+	std::vector<float> reference(width * height * 4);
+	for (size_t i = 0; i < reference.size(); ++i)
+		reference[i] = unit(rng);
+
+	const std::string featFile = options.dir + "/bench_feat.npy";
+	const std::string refFile = options.dir + "/bench_ref.npy";
+
+	bench.run("npy.write.features", "MB/s", double(features.size() * sizeof(float)), [&]()
+	{
+		writeDataToNpy(featFile, features.data(), width, height, false, frames, featDim);
+	});
+	bench.run("npy.write.reference", "MB/s", double(reference.size() * sizeof(float)), [&]()
+	{
+		writeDataToNpy(refFile, reference.data(), width, height, true, 1, 4);
+	});
+}
+
+
+// Sample, Pdf and Eval as in the closest hit program, and Pdf and Eval alone as for the light samples.
+void benchBsdfs(Bench& bench, const BenchOptions& options)
+{
+	const size_t count = std::max<size_t>(1024, static_cast<size_t>((1 << 18) * options.scale));
+	const optix::float3 normal = optix::make_float3(0.0f, 0.0f, 1.0f);
+
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::vector<optix::float3> incident(count), outgoing(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		const float cosTheta = 0.05f + 0.95f * unit(rng);
+		const float phi = 2.0f * M_PIf * unit(rng);
+		const float sinTheta = sqrtf(1.0f - cosTheta * cosTheta);
+		incident[i] = optix::make_float3(sinTheta * cosf(phi), sinTheta * sinf(phi), cosTheta);
+		outgoing[i] = optix::normalize(optix::make_float3(unit(rng) - 0.5f, unit(rng) - 0.5f, unit(rng)));
+	}
+
+	State state;
+	state.fhp = state.bhp = optix::make_float3(0.0f);
+	state.normal = state.ffnormal = normal;
+
+	const std::vector<BsdfCase> cases = getBsdfCases();
+	for (size_t c = 0; c < cases.size(); ++c)
+	{
+		const MaterialParameter& mat = cases[c].mat;
+		float sink = 0.0f;
+
+		bench.run("bsdf.sample." + cases[c].name, "items/s", double(count), [&]()
+		{
+			PerRayData_radiance prd;
+			memset(&prd, 0, sizeof(prd));
+			prd.sampler.type = SAMPLER_RANDOM;
+			prd.sampler.seed = 1234;
+			for (size_t i = 0; i < count; ++i)
+			{
+				prd.wo = incident[i];
+				prd.done = false;
+				bsdfSample(mat, state, prd);
+				bsdfPdf(mat, state, prd);
+				const optix::float3 f = bsdfEval(mat, state, prd);
+				sink += f.x / fmaxf(prd.pdf, 1e-6f);
+			}
+		});
+		bench.run("bsdf.eval." + cases[c].name, "items/s", double(count), [&]()
+		{
+			PerRayData_radiance prd;
+			memset(&prd, 0, sizeof(prd));
+			for (size_t i = 0; i < count; ++i)
+			{
+				prd.wo = incident[i];
+				prd.bsdfDir = outgoing[i];
+				bsdfPdf(mat, state, prd);
+				const optix::float3 f = bsdfEval(mat, state, prd);
+				sink += f.x + prd.pdf;
+			}
+		});
+
+		// Keeps the loops from being optimized away.
+		if (!std::isfinite(sink))
+			std::cerr << "bsdf." << cases[c].name << ": non-finite results" << std::endl;
+	}
+}
+
+
+// One dimension per item, as a path draws them: new sampler per frame, then consecutive dimensions.
+void benchSamplers(Bench& bench, const BenchOptions& options)
+{
+	const unsigned int DIMENSIONS = 16;
+	const unsigned int pixels = std::max(64u, static_cast<unsigned int>((1 << 14) * options.scale));
+	const char* const names[NUM_SAMPLER_TYPES] = { "random", "sobol", "bluenoise" };
+
+	for (unsigned int type = 0; type < NUM_SAMPLER_TYPES; ++type)
+	{
+		float sink = 0.0f;
+		bench.run(std::string("sampler.") + names[type], "items/s", double(pixels) * DIMENSIONS, [&]()
+		{
+			for (unsigned int p = 0; p < pixels; ++p)
+			{
+				Sampler sampler = makeSampler(type, p & 255u, p >> 8, 256, 17, 1234);
+				for (unsigned int d = 0; d < DIMENSIONS; ++d)
+					sink += rnd(sampler);
+			}
+		});
+
+		// Keeps the loop from being optimized away.
+		if (!std::isfinite(sink))
+			std::cerr << "sampler." << names[type] << ": non-finite results" << std::endl;
+	}
+}
+
+
+int checkBsdfs(const BenchOptions& options)
+{
+	int failures = 0;
+	const std::vector<BsdfCase> cases = getBsdfCases();
+	for (size_t c = 0; c < cases.size(); ++c)
+	{
+		if (options.filter.empty() || ("bsdf." + cases[c].name).find(options.filter) != std::string::npos)
+			failures += checkBsdf(cases[c], std::cout);
+	}
+	if (options.filter.empty() || std::string("sampler").find(options.filter) != std::string::npos)
+		failures += checkSamplers(std::cout);
+	if (options.filter.empty() || std::string("lights").find(options.filter) != std::string::npos)
+		failures += checkLightSelection(std::cout);
+	std::cout << "[Check] " << (failures ? std::to_string(failures) + " checks failed" : std::string("all checks passed")) << "\n" << std::endl;
+	return failures;
+}
+
+
+std::string jsonEscape(const std::string& s)
+{
+	std::string out;
+	for (size_t i = 0; i < s.size(); ++i)
+	{
+		if (s[i] == '"' || s[i] == '\\')
+			out += '\\';
+		out += s[i];
+	}
+	return out;
+}
+
+
+void saveResults(const std::string& filename, const BenchOptions& options, const std::vector<BenchResult>& results)
+{
+	std::ofstream out(filename.c_str());
+	out << "{\n\t\"runs\": " << options.runs << ",\n\t\"scale\": " << options.scale << ",\n\t\"results\": [\n";
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		out << "\t\t{ \"name\": \"" << jsonEscape(results[i].name) << "\", \"unit\": \"" << jsonEscape(results[i].unit)
+			<< "\", \"value\": " << std::setprecision(9) << results[i].value << " }" << (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	out << "\t]\n}\n";
+	if (!out)
+		throw std::runtime_error("Could not write " + filename);
+	std::cout << "Saved " << results.size() << " results to " << filename << std::endl;
+}
+
+
+// Reads the result entries of a file written by saveResults(), keyed by name.
+std::map<std::string, BenchResult> loadResults(const std::string& filename, double& scale)
+{
+	std::ifstream in(filename.c_str());
+	if (!in)
+		throw std::runtime_error("Could not open the baseline " + filename);
+	std::stringstream text;
+	text << in.rdbuf();
+	const std::string json = text.str();
+
+	scale = 1.0;
+	std::smatch match;
+	if (std::regex_search(json, match, std::regex("\"scale\"\\s*:\\s*([-+0-9.eE]+)")))
+		scale = std::atof(match[1].str().c_str());
+
+	std::map<std::string, BenchResult> results;
+	const std::regex entry("\\{\\s*\"name\"\\s*:\\s*\"([^\"]*)\"\\s*,\\s*\"unit\"\\s*:\\s*\"([^\"]*)\"\\s*,\\s*\"value\"\\s*:\\s*([-+0-9.eE]+)\\s*\\}");
+	for (std::sregex_iterator it(json.begin(), json.end(), entry), end; it != end; ++it)
+	{
+		BenchResult result;
+		result.name = (*it)[1];
+		result.unit = (*it)[2];
+		result.value = std::atof((*it)[3].str().c_str());
+		result.seconds = 0.0;
+		results[result.name] = result;
+	}
+	if (results.empty())
+		throw std::runtime_error("No results in the baseline " + filename);
+	return results;
+}
+
+
+// Returns the number of cases slower than the threshold.
+int compareResults(const std::string& filename, const BenchOptions& options, const std::vector<BenchResult>& results)
+{
+	double scale;
+	const std::map<std::string, BenchResult> baseline = loadResults(filename, scale);
+	std::cout << std::defaultfloat;
+	if (scale != options.scale)
+		std::cout << "warning: the baseline was measured with --scale " << scale << std::endl;
+
+	std::cout << "\nCompared to " << filename << " (threshold " << options.threshold << "%):" << std::endl;
+	int regressions = 0;
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const BenchResult& result = results[i];
+		std::map<std::string, BenchResult>::const_iterator it = baseline.find(result.name);
+		std::cout << std::left << std::setw(36) << result.name << std::right;
+		if (it == baseline.end() || it->second.unit != result.unit || it->second.value <= 0.0)
+		{
+			std::cout << "    (no baseline)" << std::endl;
+			continue;
+		}
+
+		const double change = 100.0 * (result.value / it->second.value - 1.0);
+		std::cout << std::setw(13) << std::showpos << std::fixed << std::setprecision(1) << change << "%" << std::noshowpos;
+		if (change < -options.threshold)
+		{
+			std::cout << "  REGRESSION";
+			++regressions;
+		}
+		std::cout << std::endl;
+	}
+
+	if (regressions)
+		std::cout << regressions << " case(s) slower than the baseline by more than " << options.threshold << "%" << std::endl;
+	return regressions;
+}
+
+
+void printUsageAndExit(const char* argv0)
+{
+	std::cerr << "\nUsage: " << argv0 << " [options]\n";
+	std::cerr <<
+		"Host benchmarks of the scene parser, mesh, image and texture loaders, the .npy writer, the BSDFs and the samplers,\n"
+		"no GPU needed.\n"
+		"App Options:\n"
+		"  -h | --help            Print this usage message and exit.\n"
+		"  -r | --runs N          Runs per case, the fastest is reported (default: 5).\n"
+		"  -s | --scale S         Multiplies the size of every generated input (default: 1).\n"
+		"  -f | --filter NAME     Only run the cases whose name contains NAME, e.g. obj or texture.convert.\n"
+		"  -d | --dir DIR         Directory for the generated inputs (default: a temporary directory, removed at exit).\n"
+		"       --save FILE       Write the results as JSON, to be used as --baseline later.\n"
+		"  -b | --baseline FILE   Compare with the results saved in FILE, exits with 1 on regressions.\n"
+		"  -t | --threshold PCT   Slowdown in percent that counts as a regression (default: 10).\n"
+		"  -c | --check           Validate the BSDFs (chi-square, white furnace, reciprocity), the convergence of the\n"
+		"                         samplers and the variance of the light selection first, exits with 1 on failures.\n"
+		"                         --filter also selects the checks, e.g. disney, roughdielectric.ggx, sampler or lights.\n"
+		<< std::endl;
+
+	exit(EXIT_FAILURE);
+}
+
+} // namespace
+
+
+int main(int argc, char** argv)
+{
+	BenchOptions options;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string arg(argv[i]);
+		const bool hasValue = i + 1 < argc;
+
+		if (arg == "-h" || arg == "--help")
+			printUsageAndExit(argv[0]);
+		else if ((arg == "-r" || arg == "--runs") && hasValue)
+			options.runs = std::max(1, atoi(argv[++i]));
+		else if ((arg == "-s" || arg == "--scale") && hasValue)
+			options.scale = atof(argv[++i]);
+		else if ((arg == "-f" || arg == "--filter") && hasValue)
+			options.filter = argv[++i];
+		else if ((arg == "-d" || arg == "--dir") && hasValue)
+			options.dir = argv[++i];
+		else if (arg == "--save" && hasValue)
+			options.save = argv[++i];
+		else if ((arg == "-b" || arg == "--baseline") && hasValue)
+			options.baseline = argv[++i];
+		else if ((arg == "-t" || arg == "--threshold") && hasValue)
+			options.threshold = atof(argv[++i]);
+		else if (arg == "-c" || arg == "--check")
+			options.check = true;
+		else
+		{
+			std::cerr << "Unknown option or missing value: '" << arg << "'" << std::endl;
+			printUsageAndExit(argv[0]);
+		}
+	}
+	if (options.scale <= 0.0)
+	{
+		std::cerr << "--scale must be positive" << std::endl;
+		printUsageAndExit(argv[0]);
+	}
+
+	const bool temporary = options.dir.empty();
+	int regressions = 0;
+	try
+	{
+		if (options.check)
+			regressions += checkBsdfs(options);
+
+		if (temporary)
+			options.dir = tempDirectory() + "/optabench-" + std::to_string(std::random_device()());
+		makeDirectories(options.dir);
+
+		ilInit();
+
+		Bench bench(options);
+		benchScene(bench, options);
+		benchMeshes(bench, options);
+		benchImages(bench, options);
+		benchConvert(bench, options);
+		benchNpy(bench, options);
+		benchBsdfs(bench, options);
+		benchSamplers(bench, options);
+
+		if (!options.save.empty())
+			saveResults(options.save, options, bench.getResults());
+		if (!options.baseline.empty())
+			regressions += compareResults(options.baseline, options, bench.getResults());
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "OptaBench: " << e.what() << std::endl;
+		regressions = -1;
+	}
+
+	if (temporary && !options.dir.empty())
+		removeDirectory(options.dir);
+
+	return regressions == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
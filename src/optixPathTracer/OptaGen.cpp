@@ -53,22 +53,36 @@
 #include "material_parameters.h"
 #include "properties.h"
 #include "path.h"
+#include "sampler.h"
+#include "CpuRenderer.h"
+#include "LightSelection.h"
+#include "SceneProbe.h"
+#include "SceneBundle.h"
+#include "OccupancyGrid.h"
+#include "JobPlan.h"
+#include "MeshLod.h"
+#include "MeshOrderBench.h"
+#include "NpyWriter.h"
+#include "Telemetry.h"
 #include <IL/il.h>
 #include <Camera.h>
 #include <OptiXMesh.h>
+#include <Trace.h>
 
 #include <imgui/imgui.h>
 #include <imgui/imgui_impl_glfw.h>
 
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
 #include <fstream>
+#include <limits>
+#include <random>
+#include <sstream>
 #include <dirent.h>
 #include <stdint.h>
 
-#include "cnpy.h"
-
 #define M_REF 0
 #define M_FET 1
 #define M_ALL 2
@@ -100,6 +114,28 @@ double lastTime = 0;
 Properties	properties;
 Context		context = 0;
 Scene*		scene;
+CpuRenderer*	cpuRenderer = nullptr; // Set when rendering with '--backend cpu'. The OptiX context is not created then.
+SceneProbe*	sceneProbe = nullptr; // Host copy of the scene triangles for validating random cameras.
+CameraCheckStats	cameraStats; // Accumulated over all random cameras of this run.
+const int	MAX_CAMERA_CANDIDATES = 256;
+bool	cameraCheck = true; // '--camera-check', the scene probe is also used for the camera bounds when this is off.
+bool	surfaceLookat = true; // '--lookat', draw lookats on the scene surfaces instead of inside the bounds.
+OccupancyGrid*	occupancyGrid = nullptr; // Free space of indoor scenes for drawing camera eyes, cached next to the scene file.
+const unsigned int	OCCUPANCY_RESOLUTION = 128; // voxels along the longest axis
+unsigned int	meshLoadFlags = MESH_LOADER_DEFAULT; // MeshLoaderFlags of every mesh file, '--reorder-meshes' adds MESH_LOADER_REORDER.
+bool	quantizeMeshes = false; // '--quantize-meshes', device meshes as QuantizedMesh with the programs of quantized_mesh.cu.
+bool	mergeMeshes = false; // '--merge-meshes', mesh files placed once are concatenated per material into one geometry.
+Telemetry	telemetry; // '--telemetry', per-patch phase timings of the batch modes.
+SamplerType	samplerType = SAMPLER_SOBOL; // '--sampler', sample stream of pinhole_camera and the CPU backend.
+
+struct CameraBounds
+{
+	optix::float3 aabb_min;
+	optix::float3 aabb_max;
+	bool indoor;
+};
+CameraBounds	cameraBounds; // Loaded once by loadCameraBounds() before the first random camera.
+bool	cameraBoundsLoaded = false;
 
 
 //------------------------------------------------------------------------------
@@ -198,6 +234,21 @@ void destroyContext()
 		context->destroy();
 		context = 0;
 	}
+	if (cpuRenderer)
+	{
+		delete cpuRenderer;
+		cpuRenderer = nullptr;
+	}
+	if (sceneProbe)
+	{
+		delete sceneProbe;
+		sceneProbe = nullptr;
+	}
+	if (occupancyGrid)
+	{
+		delete occupancyGrid;
+		occupancyGrid = nullptr;
+	}
 }
 
 
@@ -237,6 +288,7 @@ void createContext(bool use_pbo, unsigned int max_depth, unsigned int num_frames
 	context["cutoff_color"]->setFloat(0.0f, 0.0f, 0.0f);
 	context["frame"]->setUint(0u);
 	context["curr_time"]->setUint(static_cast <unsigned int> (time(0)));
+	context["sampler_type"]->setUint(static_cast<unsigned int>(samplerType));
 	context["scene_epsilon"]->setFloat(1.e-3f);
 	context["mbpf_frames"]->setInt(num_frames);
 
@@ -370,6 +422,12 @@ Material createLightMaterial(const LightParameter &mat, int index)
 
 void updateMaterialParameters(const std::vector<MaterialParameter> &materials)
 {
+	if (cpuRenderer)
+	{
+		cpuRenderer->setMaterials(materials);
+		return;
+	}
+
 	MaterialParameter* dst = static_cast<MaterialParameter*>(m_bufferMaterialParameters->map(0, RT_BUFFER_MAP_WRITE_DISCARD));
 	for (size_t i = 0; i < materials.size(); ++i, ++dst) {
 		MaterialParameter mat = materials[i];
@@ -403,20 +461,41 @@ void updateLightParameters(std::vector<LightParameter> &lightParameters)
 	// The environment light is expected in sysLightDefinitions[sysNumberOfLights - 1]!
 	if (scene->properties.envmap_fn != "") // HDR Environment mapping with loaded texture.
 	{
-		Picture* picture = new Picture;
-		picture->load(scene->properties.envmap_fn);
-
-		m_environmentTexture.createEnvironment(picture);
+		{
+			Telemetry::Scope timing(telemetry, PHASE_ENV_DECODE);
+			Picture* picture = new Picture;
+			picture->load(scene->properties.envmap_fn);
 
-		delete picture;
+			m_environmentTexture.createEnvironment(picture);
 
-		// Generate the CDFs for direct environment lighting and the environment texture sampler itself.
-		m_environmentTexture.calculateCDF(context);
+			delete picture;
+		}
 
 		LightParameter light;
 		light.lightType = LightType::ENVMAP;
 		light.area = 4.0f * M_PIf; // Unused.
 
+		if (cpuRenderer)
+		{
+			// The CPU backend keeps the texels and the CDFs on the host.
+			{
+				Telemetry::Scope timing(telemetry, PHASE_CDF);
+				cpuRenderer->setEnvironment(&m_environmentTexture);
+			}
+			light.environmentIntegral = m_environmentTexture.getIntegral();
+
+			lightParameters.push_back(light);
+			buildLightSelection(lightParameters);
+			cpuRenderer->setLights(lightParameters);
+			return;
+		}
+
+		// Generate the CDFs for direct environment lighting and the environment texture sampler itself.
+		{
+			Telemetry::Scope timing(telemetry, PHASE_CDF);
+			m_environmentTexture.calculateCDF(context);
+		}
+
 		// Set the bindless texture and buffer IDs inside the LightDefinition.
 		light.idEnvironmentTexture = m_environmentTexture.getId();
 		light.idEnvironmentCDF_U = m_environmentTexture.getBufferCDF_U()->getId();
@@ -436,6 +515,15 @@ void updateLightParameters(std::vector<LightParameter> &lightParameters)
 		m_bufferLightParameters->setSize(lightParameters.size()); // Update the buffer size
 	}
 
+	// Lights are picked proportional to their power, the environment by its integral.
+	buildLightSelection(lightParameters);
+
+	if (cpuRenderer)
+	{
+		cpuRenderer->setLights(lightParameters);
+		return;
+	}
+
 	LightParameter* dst = static_cast<LightParameter*>(m_bufferLightParameters->map(0, RT_BUFFER_MAP_WRITE_DISCARD));
 	for (size_t i = 0; i < lightParameters.size(); ++i, ++dst) {
 		LightParameter mat = lightParameters[i];
@@ -452,6 +540,10 @@ void updateLightParameters(std::vector<LightParameter> &lightParameters)
 		dst->idEnvironmentCDF_U = mat.idEnvironmentCDF_U;
 		dst->idEnvironmentCDF_V = mat.idEnvironmentCDF_V;
 		dst->environmentIntegral = mat.environmentIntegral;
+
+		dst->selectionPdf = mat.selectionPdf;
+		dst->aliasProbability = mat.aliasProbability;
+		dst->aliasIndex = mat.aliasIndex;
 	}
 
 	m_bufferLightParameters->unmap();
@@ -464,6 +556,16 @@ const float randFloat(const float min, const float max)
 }
 
 
+// Uniforms in [0, 1) for the area-weighted lookats. rand() has 15 bits on MSVC, too few to reach every triangle of a
+// large scene, and randFloat() can return 1.
+std::mt19937 surfaceRng(static_cast <unsigned> (time(0)));
+
+float surfaceUniform()
+{
+	return (surfaceRng() >> 8) * (1.0f / 16777216.0f);
+}
+
+
 inline int argmin(optix::float3 v)
 {
 	if (v.x <= v.y && v.x <= v.z) // x is the minimum
@@ -518,144 +620,540 @@ float swapScore(optix::float3 v, optix::float3 aabb_min, optix::float3 aabb_max,
 }
 
 
-sutil::Camera setRandomCameraParams(const optix::Aabb aabb, std::string aabb_txt_fn)
+// Reads aabb.txt style bounds (type, xmin .. zmax). The generated cache also has a key line.
+bool readCameraBounds(std::string fn, CameraBounds& bounds, unsigned long long* key = nullptr)
 {
-	optix::float3 camera_eye, camera_lookat, camera_up;
-	FILE* aabb_txt = NULL;
-	
-	if (scene->cameras.size() > 0)
+	FILE* aabb_txt = fopen(fn.c_str(), "r");
+	const int MAXLINELEN = 256;
+
+	if (!aabb_txt)
+		return false;
+
+	char line[MAXLINELEN];
+	char type[MAXLINELEN] = "None";
+
+	while (fgets(line, MAXLINELEN, aabb_txt))
 	{
-		CameraParams cam = scene->cameras[rand() % scene->cameras.size()];
-		camera_eye = cam.camera_eye;
-		camera_lookat = cam.camera_lookat;
-		camera_up = cam.camera_up;
+		sscanf(line, "type %s", type);
+		sscanf(line, "xmin %f", &bounds.aabb_min.x);
+		sscanf(line, "xmax %f", &bounds.aabb_max.x);
+		sscanf(line, "ymin %f", &bounds.aabb_min.y);
+		sscanf(line, "ymax %f", &bounds.aabb_max.y);
+		sscanf(line, "zmin %f", &bounds.aabb_min.z);
+		sscanf(line, "zmax %f", &bounds.aabb_max.z);
+		if (key)
+			sscanf(line, "key %llx", key);
 	}
+
+	if (strcmp(type, "indoor") == 0)
+		bounds.indoor = true;
 	else
+		bounds.indoor = false;
+
+	fclose(aabb_txt);
+	return true;
+}
+
+
+bool writeCameraBounds(std::string fn, const CameraBounds& bounds, unsigned long long key)
+{
+	FILE* file = fopen(fn.c_str(), "w");
+	if (!file)
+		return false;
+
+	fprintf(file, "key %llx\n", key);
+	fprintf(file, "type %s\n", bounds.indoor ? "indoor" : "outdoor");
+	fprintf(file, "xmin %f\nxmax %f\n", bounds.aabb_min.x, bounds.aabb_max.x);
+	fprintf(file, "ymin %f\nymax %f\n", bounds.aabb_min.y, bounds.aabb_max.y);
+	fprintf(file, "zmin %f\nzmax %f\n", bounds.aabb_min.z, bounds.aabb_max.z);
+
+	fclose(file);
+	return true;
+}
+
+
+// Bounds for random camera placement, loaded once per run:
+// a hand-written aabb.txt next to the scene if present, otherwise robust bounds and an indoor/outdoor
+// classification computed from the scene probe and cached as <scene>.bounds, otherwise the mesh AABB.
+void loadCameraBounds(const optix::Aabb aabb, std::string aabb_txt_fn, std::string scene_file)
+{
+	cameraBoundsLoaded = true;
+
+	if (readCameraBounds(aabb_txt_fn, cameraBounds))
+	{
+		// aabb.txt 파일이 있다
+		std::cerr << "Using predefined aabb.txt file" << std::endl;
+	}
+	else if (sceneProbe && !scene_file.empty())
 	{
-		aabb_txt = fopen(aabb_txt_fn.c_str(), "r");
-		optix::float3 aabb_min, aabb_max; // minimum xyz, maximum xyz
-		bool indoor = true;
-		const int MAXLINELEN = 256;
+		const std::string bounds_fn = scene_file + ".bounds";
+		const unsigned long long key = sceneProbe->getGeometryHash();
+		unsigned long long cached_key = 0;
 
-		if (!aabb_txt)
+		if (readCameraBounds(bounds_fn, cameraBounds, &cached_key) && cached_key == key)
 		{
-			// aabb.txt 파일이 없다
-			std::cerr << "No predefined aabb.txt file" << std::endl;
-			aabb_min = aabb.m_min;
-			aabb_max = aabb.m_max;
-			indoor = true;
+			std::cerr << "Using cached " << bounds_fn << std::endl;
 		}
 		else
 		{
-			// aabb.txt 파일이 있다
-			std::cerr << "Using predefined aabb.txt file" << std::endl;
-			char line[MAXLINELEN];
-			char type[MAXLINELEN] = "None";
+			const double startTime = sutil::currentTime();
+			const optix::Aabb robust = sceneProbe->computeRobustBounds();
+			cameraBounds.aabb_min = robust.m_min;
+			cameraBounds.aabb_max = robust.m_max;
+			cameraBounds.indoor = sceneProbe->isIndoor(robust);
+			std::cerr << "Computed robust bounds in " << sutil::currentTime() - startTime << "s" << std::endl;
+
+			if (!writeCameraBounds(bounds_fn, cameraBounds, key))
+				std::cerr << "Failed to write " << bounds_fn << std::endl;
+		}
+	}
+	else
+	{
+		// aabb.txt 파일이 없다
+		std::cerr << "No predefined aabb.txt file" << std::endl;
+		cameraBounds.aabb_min = aabb.m_min;
+		cameraBounds.aabb_max = aabb.m_max;
+		cameraBounds.indoor = true;
+	}
 
-			while (fgets(line, MAXLINELEN, aabb_txt))
-			{
-				sscanf(line, "type %s", type);
-				sscanf(line, "xmin %f", &aabb_min.x);
-				sscanf(line, "xmax %f", &aabb_max.x);
-				sscanf(line, "ymin %f", &aabb_min.y);
-				sscanf(line, "ymax %f", &aabb_max.y);
-				sscanf(line, "zmin %f", &aabb_min.z);
-				sscanf(line, "zmax %f", &aabb_max.z);
-			}
+	if (cameraBounds.indoor)
+		std::cerr << "Indoor scene" << std::endl;
+	else
+		std::cerr << "Object scene" << std::endl;
+}
 
-			if (strcmp(type, "indoor") == 0)
-				indoor = true;
-			else
-				indoor = false;
+
+// Draws an eye from the free voxels of the occupancy grid that also lies inside the camera bounds.
+bool sampleFreeEye(const optix::float3 aabb_min, const optix::float3 aabb_max, optix::float3& camera_eye)
+{
+	if (!occupancyGrid)
+		return false;
+
+	for (int i = 0; i < 8; ++i)
+	{
+		optix::float3 p;
+		if (!occupancyGrid->sampleFreePoint(randFloat(0.0f, 1.0f), randFloat(0.0f, 1.0f), randFloat(0.0f, 1.0f), randFloat(0.0f, 1.0f), p))
+			return false;
+
+		if (p.x >= aabb_min.x && p.y >= aabb_min.y && p.z >= aabb_min.z &&
+			p.x <= aabb_max.x && p.y <= aabb_max.y && p.z <= aabb_max.z)
+		{
+			camera_eye = p;
+			return true;
 		}
+	}
+
+	return false;
+}
 
-		optix::float3 center = 0.5f * (aabb_min + aabb_max);
-		optix::float3 half_widths = 0.5f * (aabb_max - aabb_min);
-		float margin = 0.7; // safe margin to prevent camera-object occlusion, etc.
 
-		if (indoor)
+// Draws a lookat on the scene surfaces (area-weighted) that lies inside the camera bounds.
+bool sampleSurfaceLookat(const optix::float3 aabb_min, const optix::float3 aabb_max, optix::float3& camera_lookat)
+{
+	if (!sceneProbe || !surfaceLookat)
+		return false;
+
+	for (int i = 0; i < 8; ++i)
+	{
+		optix::float3 p;
+		if (!sceneProbe->sampleSurface(surfaceUniform(), surfaceUniform(), surfaceUniform(), surfaceUniform(), p))
+			return false;
+
+		if (p.x >= aabb_min.x && p.y >= aabb_min.y && p.z >= aabb_min.z &&
+			p.x <= aabb_max.x && p.y <= aabb_max.y && p.z <= aabb_max.z)
 		{
-			std::cerr << "Indoor scene" << std::endl;
+			camera_lookat = p;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+void sampleCameraCandidate(const optix::float3 aabb_min, const optix::float3 aabb_max, bool indoor,
+	optix::float3& camera_eye, optix::float3& camera_lookat)
+{
+	optix::float3 center = 0.5f * (aabb_min + aabb_max);
+	optix::float3 half_widths = 0.5f * (aabb_max - aabb_min);
+	float margin = 0.7; // safe margin to prevent camera-object occlusion, etc.
+
+	const bool on_surface = sampleSurfaceLookat(aabb_min, aabb_max, camera_lookat);
+	if (!on_surface)
+	{
+		camera_lookat = make_float3(
+			randFloat(center.x - margin * half_widths.x, center.x + margin * half_widths.x),
+			randFloat(center.y - margin * half_widths.y, center.y + margin * half_widths.y),
+			randFloat(center.z - margin * half_widths.z, center.z + margin * half_widths.z)
+			);
+	}
+
+	if (indoor)
+	{
+		// Eyes drawn from the free space already keep their clearance, the swap heuristic is not needed.
+		if (sampleFreeEye(aabb_min, aabb_max, camera_eye))
+			return;
 
-			camera_lookat = make_float3(
-				randFloat(center.x - margin * half_widths.x, center.x + margin * half_widths.x),
-				randFloat(center.y - margin * half_widths.y, center.y + margin * half_widths.y),
-				randFloat(center.z - margin * half_widths.z, center.z + margin * half_widths.z)
-				);
-			camera_eye = make_float3(
-				randFloat(center.x - margin * half_widths.x, center.x + margin * half_widths.x),
-				randFloat(center.y - margin * half_widths.y, center.y + margin * half_widths.y),
-				randFloat(center.z - margin * half_widths.z, center.z + margin * half_widths.z)
-				);
+		camera_eye = make_float3(
+			randFloat(center.x - margin * half_widths.x, center.x + margin * half_widths.x),
+			randFloat(center.y - margin * half_widths.y, center.y + margin * half_widths.y),
+			randFloat(center.z - margin * half_widths.z, center.z + margin * half_widths.z)
+			);
 
-			float prob_lookat, prob_eye, d_lookat, d_eye;
-			d_lookat = swapScore(camera_lookat, aabb_min, aabb_max, prob_lookat);
-			d_eye = swapScore(camera_eye, aabb_min, aabb_max, prob_eye);
+		// A lookat on a surface must not become the eye.
+		if (on_surface)
+			return;
 
-			if (d_lookat > d_eye)
+		float prob_lookat, prob_eye, d_lookat, d_eye;
+		d_lookat = swapScore(camera_lookat, aabb_min, aabb_max, prob_lookat);
+		d_eye = swapScore(camera_eye, aabb_min, aabb_max, prob_eye);
+
+		if (d_lookat > d_eye)
+		{
+			if (randFloat(0.0f, 1.0f) <= prob_lookat) // change lookat to eye in a low chance
 			{
-				if (randFloat(0.0f, 1.0f) <= prob_lookat) // change lookat to eye in a low chance
-				{
-					optix::float3 tmp = optix::make_float3(camera_eye.x, camera_eye.y, camera_eye.z);
-					camera_eye = optix::make_float3(camera_lookat.x, camera_lookat.y, camera_lookat.z);
-					camera_lookat = optix::make_float3(tmp.x, tmp.y, tmp.z);
-				}
+				optix::float3 tmp = optix::make_float3(camera_eye.x, camera_eye.y, camera_eye.z);
+				camera_eye = optix::make_float3(camera_lookat.x, camera_lookat.y, camera_lookat.z);
+				camera_lookat = optix::make_float3(tmp.x, tmp.y, tmp.z);
 			}
-			else if (d_lookat == d_eye)
+		}
+		else if (d_lookat == d_eye)
+		{
+			if (randFloat(0.0f, 1.0f) <= 0.5f) // half chance
 			{
-				if (randFloat(0.0f, 1.0f) <= 0.5f) // half chance
-				{
-					// swap
-					optix::float3 tmp = optix::make_float3(camera_eye.x, camera_eye.y, camera_eye.z);
-					camera_eye = optix::make_float3(camera_lookat.x, camera_lookat.y, camera_lookat.z);
-					camera_lookat = optix::make_float3(tmp.x, tmp.y, tmp.z);
-				}
+				// swap
+				optix::float3 tmp = optix::make_float3(camera_eye.x, camera_eye.y, camera_eye.z);
+				camera_eye = optix::make_float3(camera_lookat.x, camera_lookat.y, camera_lookat.z);
+				camera_lookat = optix::make_float3(tmp.x, tmp.y, tmp.z);
 			}
-			else
+		}
+		else
+		{
+			if (randFloat(0.0f, 1.0f) >= prob_eye) // change lookat to eye in a high chance
 			{
-				if (randFloat(0.0f, 1.0f) >= prob_eye) // change lookat to eye in a high chance
-				{
-					optix::float3 tmp = optix::make_float3(camera_eye.x, camera_eye.y, camera_eye.z);
-					camera_eye = optix::make_float3(camera_lookat.x, camera_lookat.y, camera_lookat.z);
-					camera_lookat = optix::make_float3(tmp.x, tmp.y, tmp.z);
-				}
+				optix::float3 tmp = optix::make_float3(camera_eye.x, camera_eye.y, camera_eye.z);
+				camera_eye = optix::make_float3(camera_lookat.x, camera_lookat.y, camera_lookat.z);
+				camera_lookat = optix::make_float3(tmp.x, tmp.y, tmp.z);
 			}
 		}
-		else
+	}
+	else
+	{
+		camera_eye = make_float3(
+			randFloat(center.x - 5 * half_widths.x, center.x + 5 * half_widths.x),
+			randFloat(center.y - half_widths.y, center.y + 5 * half_widths.y), // min.y에는 floor가 있는 경우가 많으므로 경계 확장 X
+			randFloat(center.z - 5 * half_widths.z, center.z + 5 * half_widths.z)
+			);
+	}
+}
+
+
+void printCameraStats(const char* tag, const CameraCheckStats& stats)
+{
+	std::cerr << "[Camera] " << tag << stats.candidates << " candidate(s), rejected:";
+	for (int i = CAMERA_ACCEPTED + 1; i < NUM_CAMERA_REJECTIONS; ++i)
+		std::cerr << " " << cameraRejectionName(CameraRejection(i)) << " " << stats.rejected[i];
+	std::cerr << std::endl;
+}
+
+
+// Draws candidates until the scene probe accepts one (or MAX_CAMERA_CANDIDATES is reached).
+// Without a scene probe the first candidate is used, as before.
+void sampleValidatedCamera(const optix::Aabb aabb, std::string aabb_txt_fn,
+	optix::float3& camera_eye, optix::float3& camera_lookat, optix::float3& camera_up, float& vfov)
+{
+	if (!cameraBoundsLoaded)
+		loadCameraBounds(aabb, aabb_txt_fn, "");
+
+	const float aspect_ratio = static_cast<float>(scene->properties.width) / static_cast<float>(scene->properties.height);
+	CameraCheckStats stats;
+
+	for (int candidate = 1; ; ++candidate)
+	{
+		sampleCameraCandidate(cameraBounds.aabb_min, cameraBounds.aabb_max, cameraBounds.indoor, camera_eye, camera_lookat);
+
+		camera_up = optix::make_float3(
+			randFloat(-0.5f, 0.5f),
+			randFloat(-0.5f, 0.5f),
+			randFloat(-0.5f, 0.5f));
+
+		vfov = scene->properties.vfov * randFloat(0.8f, 1.2f);
+
+		if (!sceneProbe || !cameraCheck)
+			return;
+
+		++stats.candidates;
+		const CameraRejection rejection = sceneProbe->checkCamera(camera_eye, camera_lookat, camera_up, vfov, aspect_ratio);
+		if (rejection == CAMERA_ACCEPTED)
+			break;
+
+		++stats.rejected[rejection];
+		if (candidate >= MAX_CAMERA_CANDIDATES)
+		{
+			std::cerr << "No valid camera after " << candidate << " candidates, using the last one." << std::endl;
+			break;
+		}
+	}
+
+	printCameraStats("", stats);
+
+	cameraStats.candidates += stats.candidates;
+	for (int i = 0; i < NUM_CAMERA_REJECTIONS; ++i)
+		cameraStats.rejected[i] += stats.rejected[i];
+}
+
+
+// Backend independent part of setRandomCameraParams(). Also used by the CPU backend.
+void randomCameraParams(const optix::Aabb aabb, std::string aabb_txt_fn,
+	optix::float3& camera_eye, optix::float3& camera_lookat, optix::float3& camera_up, float& vfov)
+{
+	if (scene->cameras.size() > 0)
+	{
+		CameraParams cam = scene->cameras[rand() % scene->cameras.size()];
+		camera_eye = cam.camera_eye;
+		camera_lookat = cam.camera_lookat;
+
+		camera_up = optix::make_float3(
+			randFloat(-0.5f, 0.5f),
+			randFloat(-0.5f, 0.5f),
+			randFloat(-0.5f, 0.5f));
+
+		vfov = scene->properties.vfov * randFloat(0.8f, 1.2f);
+	}
+	else
+	{
+		sampleValidatedCamera(aabb, aabb_txt_fn, camera_eye, camera_lookat, camera_up, vfov);
+	}
+}
+
+
+// Replaces the camera block of the scene file with the given cameras. Everything else is copied verbatim. The file is
+// written next to the scene first, so a failed write leaves the scene untouched.
+bool writeCameraBlock(const std::string& scene_file, const std::vector<CameraParams>& cameras)
+{
+	std::ifstream in(scene_file);
+	if (!in)
+		return false;
+
+	std::vector<std::string> lines;
+	std::string line;
+	int depth = 0;
+	bool skip = false;
+
+	while (std::getline(in, line))
+	{
+		// The camera block starts with the top level keyword "camera".
+		if (depth == 0 && !skip)
 		{
-			std::cerr << "Object scene" << std::endl;
-			camera_lookat = make_float3(
-				randFloat(center.x - margin * half_widths.x, center.x + margin * half_widths.x),
-				randFloat(center.y - margin * half_widths.y, center.y + margin * half_widths.y),
-				randFloat(center.z - margin * half_widths.z, center.z + margin * half_widths.z)
-				);
+			std::istringstream tokens(line);
+			std::string keyword;
+			if (tokens >> keyword && (keyword == "camera" || keyword.compare(0, 7, "camera{") == 0))
+				skip = true;
+		}
+
+		depth += static_cast<int>(std::count(line.begin(), line.end(), '{'));
+		depth -= static_cast<int>(std::count(line.begin(), line.end(), '}'));
 
-			camera_eye = make_float3(
-				randFloat(center.x - 5 * half_widths.x, center.x + 5 * half_widths.x),
-				randFloat(center.y - half_widths.y, center.y + 5 * half_widths.y), // min.y에는 floor가 있는 경우가 많으므로 경계 확장 X
-				randFloat(center.z - 5 * half_widths.z, center.z + 5 * half_widths.z)
-				);
+		if (skip)
+		{
+			if (depth <= 0 && line.find('}') != std::string::npos)
+			{
+				skip = false;
+				depth = 0;
+			}
+			continue;
 		}
 
+		lines.push_back(line);
+	}
+	in.close();
+
+	const std::string temp_file = scene_file + ".tmp";
+	std::ofstream out(temp_file);
+	if (!out)
+		return false;
+
+	// Enough digits to reload exactly the validated float coordinates.
+	out.precision(std::numeric_limits<float>::max_digits10);
+
+	for (const std::string& l : lines)
+		out << l << "\n";
+
+	out << "\ncamera\n{\n";
+	for (const CameraParams& cam : cameras)
+	{
+		out << "\tCamera\n";
+		out << "\tposition " << cam.camera_eye.x << " " << cam.camera_eye.y << " " << cam.camera_eye.z << "\n";
+		out << "\tlook_at " << cam.camera_lookat.x << " " << cam.camera_lookat.y << " " << cam.camera_lookat.z << "\n";
+		out << "\tup " << cam.camera_up.x << " " << cam.camera_up.y << " " << cam.camera_up.z << "\n";
+	}
+	out << "}\n";
+
+	out.close();
+	if (!out)
+	{
+		std::remove(temp_file.c_str());
+		return false;
+	}
+
+	// Replaces the scene in one step. If that fails, the scene stays as it was and the new one is left in the .tmp file.
+#if defined( _WIN32 )
+	return MoveFileExA(temp_file.c_str(), scene_file.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	return std::rename(temp_file.c_str(), scene_file.c_str()) == 0;
+#endif
+}
+
+
+// Surface lookats are area-weighted, textured meshes (more detail per area) are scaled by lookat_detail.
+// Every mesh has the material with its own index.
+void setLookatWeights(float lookat_detail)
+{
+	if (lookat_detail == 1.0f)
+		return;
+
+	std::vector<float> mesh_weights(scene->mesh_names.size(), 1.0f);
+	for (size_t i = 0; i < mesh_weights.size() && i < scene->materials.size(); ++i)
+	{
+		if (scene->materials[i].albedoID != RT_TEXTURE_ID_NULL)
+			mesh_weights[i] = lookat_detail;
+	}
+
+	sceneProbe->setSurfaceWeights(mesh_weights);
+}
+
+
+// Loads the occupancy grid sidecar of the scene, or voxelizes the scene probe geometry and writes it.
+// Only indoor scenes draw their eyes from the grid. It covers the camera bounds plus a margin for the walls.
+void createOccupancyGrid(std::string scene_file, unsigned int num_threads)
+{
+	if (!cameraBounds.indoor)
+		return;
+
+	optix::Aabb grid_bounds(cameraBounds.aabb_min, cameraBounds.aabb_max);
+	const optix::float3 margin = 0.05f * grid_bounds.extent();
+	grid_bounds = optix::Aabb(grid_bounds.m_min - margin, grid_bounds.m_max + margin);
+	grid_bounds.intersection(sceneProbe->getBounds());
+
+	const std::string grid_fn = scene_file + ".occ";
+	uint64_t key = sceneProbe->getGeometryHash();
+	key = hashBytes(&OCCUPANCY_RESOLUTION, sizeof(OCCUPANCY_RESOLUTION), key);
+	key = hashBytes(&grid_bounds, sizeof(grid_bounds), key);
+	const double startTime = sutil::currentTime();
+
+	occupancyGrid = new OccupancyGrid;
+	if (occupancyGrid->load(grid_fn, key))
+	{
+		std::cerr << "[Occupancy] cached " << grid_fn << std::endl;
+	}
+	else
+	{
+		occupancyGrid->build(sceneProbe->getVertices(), sceneProbe->getIndices(), grid_bounds, OCCUPANCY_RESOLUTION, num_threads);
+		occupancyGrid->setKey(key);
+		if (!occupancyGrid->save(grid_fn))
+			std::cerr << "Failed to write " << grid_fn << std::endl;
+	}
+
+	occupancyGrid->setMinClearance(CameraCheckParams().minClearance * sceneProbe->getSceneDiagonal());
+
+	std::cerr << "[Occupancy] " << occupancyGrid->getNumBricks() << " bricks, " << occupancyGrid->getNumCandidates() << " free voxels, "
+		<< sutil::currentTime() - startTime << "s" << std::endl;
+}
+
+
+// Every mesh file of the scene in object space, from the compiled bundle or loaded once each into host_meshes.
+std::vector<MeshView> loadMeshViews(std::vector<std::unique_ptr<HostMesh> >& host_meshes)
+{
+	if (scene->bundle)
+		return scene->bundle->getMeshes();
+
+	std::vector<MeshView> views;
+	for (size_t i = 0; i < scene->geometry_names.size(); ++i)
+	{
+		host_meshes.push_back(std::unique_ptr<HostMesh>(new HostMesh(scene->geometry_names[i], 0, meshLoadFlags)));
+		views.push_back(makeMeshView(*host_meshes.back()));
+	}
+	return views;
+}
+
+
+// Host copy of the scene geometry for placing cameras. Reuses the CPU renderer's meshes.
+void createSceneProbe(unsigned int num_threads)
+{
+	sceneProbe = new SceneProbe;
+
+	if (cpuRenderer)
+	{
+		sceneProbe->createGeometry(cpuRenderer->getVertices(), cpuRenderer->getIndices(), cpuRenderer->getTriangleMaterials(), num_threads);
+	}
+	else
+	{
+		std::vector<std::unique_ptr<HostMesh> > host_meshes;
+		sceneProbe->createGeometry(loadMeshViews(host_meshes), scene->mesh_geometry, scene->transforms, num_threads);
+	}
+}
+
+
+// Offline camera generation ('--gen-cameras'). Only needs the host geometry, no OptiX context.
+void generateCameras(std::string scene_file, int num_of_cameras, unsigned int num_threads, float lookat_detail)
+{
+	if (scene_file.size() > 4 && scene_file.compare(scene_file.size() - 4, 4, ".xml") == 0)
+		throw std::runtime_error("--gen-cameras writes into a .scene file, convert " + scene_file + " with scripts/xml2scene.py first");
+
+	createSceneProbe(num_threads);
+	setLookatWeights(lookat_detail);
+
+	std::string aabb_txt_fn = scene_file.substr(0, scene_file.find_last_of("\\")) + "\\aabb.txt";
+	loadCameraBounds(sceneProbe->getBounds(), aabb_txt_fn, scene_file);
+	createOccupancyGrid(scene_file, num_threads);
+
+	srand(static_cast <unsigned> (time(0)));
+
+	std::vector<CameraParams> cameras = scene->cameras;
+	for (int i = 0; i < num_of_cameras; ++i)
+	{
+		CameraParams cam;
+		float vfov;
+		sampleValidatedCamera(sceneProbe->getBounds(), aabb_txt_fn, cam.camera_eye, cam.camera_lookat, cam.camera_up, vfov);
+		cameras.push_back(cam);
 	}
 
-	camera_up = optix::make_float3(
-		randFloat(-0.5f, 0.5f),
-		randFloat(-0.5f, 0.5f),
-		randFloat(-0.5f, 0.5f));
+	printCameraStats("(total) ", cameraStats);
+
+	if (!writeCameraBlock(scene_file, cameras))
+		throw std::runtime_error("Failed to write the camera block of " + scene_file);
+
+	std::cerr << "[Output] " << cameras.size() << " camera(s) in " << scene_file << std::endl;
+}
+
+
+sutil::Camera setRandomCameraParams(const optix::Aabb aabb, std::string aabb_txt_fn)
+{
+	optix::float3 camera_eye, camera_lookat, camera_up;
+	float vfov;
+
+	randomCameraParams(aabb, aabb_txt_fn, camera_eye, camera_lookat, camera_up, vfov);
 
 	sutil::Camera camera(
-		scene->properties.width, scene->properties.height, scene->properties.vfov * randFloat(0.8f, 1.2f),
+		scene->properties.width, scene->properties.height, vfov,
 		&camera_eye.x, &camera_lookat.x, &camera_up.x,
 		context["eye"], context["U"], context["V"], context["W"]);
 
-	if (aabb_txt)
-		fclose(aabb_txt);
-
 	return camera;
 }
 
 
+void setRandomCpuCameraParams(const optix::Aabb aabb, std::string aabb_txt_fn)
+{
+	optix::float3 camera_eye, camera_lookat, camera_up;
+	float vfov;
+
+	randomCameraParams(aabb, aabb_txt_fn, camera_eye, camera_lookat, camera_up, vfov);
+
+	cpuRenderer->setCamera(camera_eye, camera_lookat, camera_up, vfov);
+}
+
+
 void setRandomMaterials()
 {
 	// Randomize the material parameters
@@ -708,12 +1206,25 @@ void setRandomMaterials()
 		}
 	}
 	updateMaterialParameters(scene->materials);
-	context["sysMaterialParameters"]->setBuffer(m_bufferMaterialParameters);
+	if (!cpuRenderer)
+		context["sysMaterialParameters"]->setBuffer(m_bufferMaterialParameters);
 }
 
 
 void setRandomBackground(const std::string base_hdrs, const std::vector<std::string> entries)
 {
+	if (cpuRenderer)
+	{
+		scene->properties.envmap_fn = base_hdrs + entries[rand() % entries.size()];
+		std::cerr << scene->properties.envmap_fn << std::endl;
+
+		if (m_environmentTexture.getWidth() != 1) // if there is a pre-assigned env light
+			scene->lights.pop_back();
+
+		updateLightParameters(scene->lights);
+		return;
+	}
+
 	std::string ptx_path = ptxPath("background.cu");
 	context->setMissProgram(0, context->createProgramFromPTXFile(ptx_path, "miss"));
 	scene->properties.envmap_fn = base_hdrs + entries[rand() % entries.size()];
@@ -768,13 +1279,198 @@ void updateAabbLights(optix::Aabb aabb)
 }
 
 
-optix::Aabb createGeometry(
-	// output: this is a Group with two GeometryGroup children, for toggling visibility later
-	optix::Group& top_group
-	)
+// Same buffers and variables as loadMesh() in OptiXMesh.cpp, copied straight from the mapped bundle.
+// With a transform the mesh is baked into world space on the way.
+void loadBundleMesh(const MeshView& bundle_mesh, OptiXMesh& mesh, const optix::Matrix4x4* transform)
 {
+	const int num_vertices = bundle_mesh.num_vertices;
+	const int num_triangles = bundle_mesh.num_triangles;
+
+	Buffer tri_indices = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_INT3, num_triangles);
+	Buffer mat_indices = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_INT, num_triangles);
+	Buffer positions = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_FLOAT3, num_vertices);
+	Buffer normals = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_FLOAT3, bundle_mesh.normals ? num_vertices : 0);
+	Buffer texcoords = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_FLOAT2, bundle_mesh.texcoords ? num_vertices : 0);
+
+	memcpy(tri_indices->map(), bundle_mesh.indices, num_triangles * sizeof(optix::int3));
+	tri_indices->unmap();
+	memset(mat_indices->map(), 0, num_triangles * sizeof(int)); // single material override
+	mat_indices->unmap();
+	optix::float3* mapped_positions = static_cast<optix::float3*>(positions->map());
+	if (transform)
+		transformPositions(bundle_mesh.positions, num_vertices, *transform, mapped_positions);
+	else
+		memcpy(mapped_positions, bundle_mesh.positions, num_vertices * sizeof(optix::float3));
+	positions->unmap();
+	if (bundle_mesh.normals)
+	{
+		optix::float3* mapped_normals = static_cast<optix::float3*>(normals->map());
+		if (transform)
+			transformNormals(bundle_mesh.normals, num_vertices, *transform, mapped_normals);
+		else
+			memcpy(mapped_normals, bundle_mesh.normals, num_vertices * sizeof(optix::float3));
+		normals->unmap();
+	}
+	if (bundle_mesh.texcoords)
+	{
+		memcpy(texcoords->map(), bundle_mesh.texcoords, num_vertices * sizeof(optix::float2));
+		texcoords->unmap();
+	}
 
-	const std::string ptx_path = ptxPath("triangle_mesh.cu");
+	Geometry geometry = context->createGeometry();
+	geometry["vertex_buffer"]->setBuffer(positions);
+	geometry["normal_buffer"]->setBuffer(normals);
+	geometry["texcoord_buffer"]->setBuffer(texcoords);
+	geometry["material_buffer"]->setBuffer(mat_indices);
+	geometry["index_buffer"]->setBuffer(tri_indices);
+	geometry->setPrimitiveCount(num_triangles);
+	geometry->setBoundingBoxProgram(mesh.bounds);
+	geometry->setIntersectionProgram(mesh.intersection);
+
+	mesh.geom_instance = context->createGeometryInstance(geometry, &mesh.material, &mesh.material + 1);
+	const optix::Aabb bounds = transform ? transformBounds(bundle_mesh.bbox_min, bundle_mesh.bbox_max, *transform)
+		: optix::Aabb(bundle_mesh.bbox_min, bundle_mesh.bbox_max);
+	mesh.bbox_min = bounds.m_min;
+	mesh.bbox_max = bounds.m_max;
+	mesh.num_triangles = num_triangles;
+}
+
+
+// World space concatenation of meshes placed once that share a material.
+struct MergedMesh
+{
+	MergedMesh() : num_meshes(0) {}
+
+	std::vector<optix::float3> positions;
+	std::vector<optix::float3> normals;
+	std::vector<optix::float2> texcoords;
+	std::vector<optix::int3>   indices;
+	optix::Aabb                bounds;
+	int                        num_meshes;
+};
+
+
+void appendMergedMesh(const MeshView& view, const optix::Matrix4x4& transform, MergedMesh& merged)
+{
+	const int base = static_cast<int>(merged.positions.size());
+	merged.positions.resize(base + view.num_vertices);
+	transformPositions(view.positions, view.num_vertices, transform, merged.positions.data() + base);
+	if (view.normals)
+	{
+		merged.normals.resize(base + view.num_vertices);
+		transformNormals(view.normals, view.num_vertices, transform, merged.normals.data() + base);
+	}
+	if (view.texcoords)
+		merged.texcoords.insert(merged.texcoords.end(), view.texcoords, view.texcoords + view.num_vertices);
+
+	merged.indices.reserve(merged.indices.size() + view.num_triangles);
+	for (int t = 0; t < view.num_triangles; ++t)
+	{
+		const optix::int3& tri = view.indices[t];
+		merged.indices.push_back(optix::make_int3(tri.x + base, tri.y + base, tri.z + base));
+	}
+	merged.bounds.include(transformBounds(view.bbox_min, view.bbox_max, transform));
+	++merged.num_meshes;
+}
+
+
+// Placements of mesh files placed once, grouped by identical material parameters. MaterialParameter has no padding,
+// so its bytes are the key. Groups of one placement are left out, they gain nothing from merging.
+std::vector<std::vector<int> > findMergeGroups(const std::vector<int>& placements)
+{
+	std::map<std::string, std::vector<int> > groups;
+	for (size_t i = 0; i < scene->mesh_names.size(); ++i)
+	{
+		if (placements[scene->mesh_geometry[i]] != 1)
+			continue;
+		const std::string key(reinterpret_cast<const char*>(&scene->materials[i]), sizeof(MaterialParameter));
+		groups[key].push_back(static_cast<int>(i));
+	}
+
+	std::vector<std::vector<int> > result;
+	for (std::map<std::string, std::vector<int> >::iterator it = groups.begin(); it != groups.end(); ++it)
+	{
+		if (it->second.size() > 1)
+			result.push_back(it->second);
+	}
+	return result;
+}
+
+
+// Loads the placements of one merge group into world space and uploads them as one GeometryInstance per combination
+// of vertex attributes, with the material of the first placement. Returns the number of instances created.
+int loadMergedMeshes(const std::vector<int>& group, const std::string& ptx_path, GeometryGroup& geometry_group,
+	optix::Aabb& aabb, int& num_triangles)
+{
+	// Meshes with and without normals or texcoords are not mixed, missing attributes would have to be invented.
+	MergedMesh merged[4];
+	for (size_t k = 0; k < group.size(); ++k)
+	{
+		const int i = group[k];
+		std::unique_ptr<HostMesh> host_mesh;
+		MeshView view;
+		if (scene->bundle)
+			view = scene->bundle->getMeshes()[scene->mesh_geometry[i]];
+		else
+		{
+			host_mesh.reset(new HostMesh(scene->mesh_names[i], 0, meshLoadFlags));
+			view = makeMeshView(*host_mesh);
+		}
+		appendMergedMesh(view, scene->transforms[i], merged[(view.normals ? 1 : 0) + (view.texcoords ? 2 : 0)]);
+	}
+
+	const Material material = createMaterial(scene->materials[group[0]], group[0]);
+	int num_instances = 0;
+	for (int a = 0; a < 4; ++a)
+	{
+		const MergedMesh& m = merged[a];
+		if (m.num_meshes == 0)
+			continue;
+
+		MeshView view;
+		view.num_vertices = static_cast<int32_t>(m.positions.size());
+		view.num_triangles = static_cast<int32_t>(m.indices.size());
+		view.positions = m.positions.data();
+		view.normals = m.normals.empty() ? NULL : m.normals.data();
+		view.texcoords = m.texcoords.empty() ? NULL : m.texcoords.data();
+		view.indices = m.indices.data();
+		view.bbox_min = m.bounds.m_min;
+		view.bbox_max = m.bounds.m_max;
+
+		OptiXMesh mesh;
+		mesh.context = context;
+		mesh.intersection = context->createProgramFromPTXFile(ptx_path, "mesh_intersect_refine");
+		mesh.bounds = context->createProgramFromPTXFile(ptx_path, "mesh_bounds");
+		mesh.material = material;
+		loadBundleMesh(view, mesh, NULL);
+		geometry_group->addChild(mesh.geom_instance);
+
+		aabb.include(mesh.bbox_min, mesh.bbox_max);
+		num_triangles += mesh.num_triangles;
+		++num_instances;
+	}
+	return num_instances;
+}
+
+
+optix::Aabb createGeometry(
+	// output: this is a Group with two GeometryGroup children, for toggling visibility later,
+	// and a Transform per placement of the mesh files that are placed more than once
+	optix::Group& top_group
+	)
+{
+	if (cpuRenderer)
+	{
+		// Light geometry is created from the light parameters in CpuRenderer::setLights().
+		std::vector<std::unique_ptr<HostMesh> > host_meshes;
+		return cpuRenderer->createGeometry(loadMeshViews(host_meshes), scene->mesh_geometry, scene->transforms);
+	}
+
+	// Bundle meshes are uploaded as stored.
+	const bool quantized = quantizeMeshes && !scene->bundle;
+	if (quantizeMeshes && scene->bundle)
+		std::cerr << "Option '--quantize-meshes' is ignored for compiled scenes." << std::endl;
+	const std::string ptx_path = ptxPath(quantized ? "quantized_mesh.cu" : "triangle_mesh.cu");
 
 	top_group = context->createGroup();
 	top_group->setAcceleration(context->createAcceleration("Trbvh"));
@@ -787,7 +1483,40 @@ optix::Aabb createGeometry(
 		geometry_group->setAcceleration(context->createAcceleration("Trbvh"));
 		top_group->addChild(geometry_group);
 
+		// Mesh files placed once are baked into world space as before. Files placed more often are loaded once,
+		// their Geometry and acceleration structure are shared by one Transform per placement.
+		const size_t num_geometries = scene->geometry_names.size();
+		std::vector<int> placements(num_geometries, 0);
+		for (i = 0; i < scene->mesh_geometry.size(); ++i)
+			++placements[scene->mesh_geometry[i]];
+
+		std::vector<Geometry> shared_geometry(num_geometries);
+		std::vector<Acceleration> shared_acceleration(num_geometries);
+		std::vector<optix::Aabb> shared_bounds(num_geometries);
+		std::vector<int> shared_triangles(num_geometries, 0);
+		int num_unique_triangles = 0;
+
+		// Merged placements are loaded per material after the others.
+		std::vector<std::vector<int> > merge_groups;
+		std::vector<bool> merged(scene->mesh_names.size(), false);
+		if (mergeMeshes && quantized)
+			std::cerr << "Option '--merge-meshes' is ignored with '--quantize-meshes'." << std::endl;
+		else if (mergeMeshes)
+		{
+			merge_groups = findMergeGroups(placements);
+			for (size_t g = 0; g < merge_groups.size(); ++g)
+			{
+				for (size_t k = 0; k < merge_groups[g].size(); ++k)
+					merged[merge_groups[g][k]] = true;
+			}
+		}
+
 		for (i = 0, j = 0; i < scene->mesh_names.size(); ++i, ++j) {
+			if (merged[i])
+				continue;
+			const int geometry = scene->mesh_geometry[i];
+			const optix::Matrix4x4& transform = scene->transforms[i];
+
 			OptiXMesh mesh;
 			mesh.context = context;
 
@@ -796,15 +1525,71 @@ optix::Aabb createGeometry(
 			mesh.bounds = context->createProgramFromPTXFile(ptx_path, "mesh_bounds");
 			mesh.material = createMaterial(scene->materials[i], i);
 
-			loadMesh(scene->mesh_names[i], mesh, scene->transforms[i]);
-			geometry_group->addChild(mesh.geom_instance);
+			if (placements[geometry] == 1)
+			{
+				if (scene->bundle)
+					loadBundleMesh(scene->bundle->getMeshes()[geometry], mesh, &transform);
+				else if (quantized)
+					loadQuantizedMesh(scene->mesh_names[i], mesh, transform, meshLoadFlags);
+				else
+					loadMesh(scene->mesh_names[i], mesh, transform, meshLoadFlags);
+				geometry_group->addChild(mesh.geom_instance);
 
-			aabb.include(mesh.bbox_min, mesh.bbox_max);
+				aabb.include(mesh.bbox_min, mesh.bbox_max);
+				num_unique_triangles += mesh.num_triangles;
+			}
+			else
+			{
+				if (!shared_geometry[geometry])
+				{
+					if (scene->bundle)
+						loadBundleMesh(scene->bundle->getMeshes()[geometry], mesh, NULL);
+					else if (quantized)
+						loadQuantizedMesh(scene->mesh_names[i], mesh, optix::Matrix4x4::identity(), meshLoadFlags);
+					else
+						loadMesh(scene->mesh_names[i], mesh, optix::Matrix4x4::identity(), meshLoadFlags);
+					shared_geometry[geometry] = mesh.geom_instance->getGeometry();
+					shared_acceleration[geometry] = context->createAcceleration("Trbvh");
+					shared_bounds[geometry] = optix::Aabb(mesh.bbox_min, mesh.bbox_max);
+					shared_triangles[geometry] = mesh.num_triangles;
+					num_unique_triangles += mesh.num_triangles;
+				}
+				mesh.num_triangles = shared_triangles[geometry];
+
+				GeometryGroup instance_group = context->createGeometryGroup();
+				instance_group->setAcceleration(shared_acceleration[geometry]);
+				instance_group->addChild(context->createGeometryInstance(shared_geometry[geometry], &mesh.material, &mesh.material + 1));
+
+				const optix::Matrix4x4 inverse = transform.inverse();
+				Transform instance = context->createTransform();
+				instance->setMatrix(false, transform.getData(), inverse.getData());
+				instance->setChild(instance_group);
+				top_group->addChild(instance);
+
+				aabb.include(transformBounds(shared_bounds[geometry].m_min, shared_bounds[geometry].m_max, transform));
+			}
 
 			std::cerr << scene->mesh_names[i] << ": " << mesh.num_triangles << std::endl;
 			num_triangles += mesh.num_triangles;
 		}
-		std::cerr << "Total triangle count: " << num_triangles << std::endl;
+
+		if (!merge_groups.empty())
+		{
+			size_t num_merged = 0;
+			int num_instances = 0, num_merged_triangles = 0;
+			for (size_t g = 0; g < merge_groups.size(); ++g)
+			{
+				num_merged += merge_groups[g].size();
+				num_instances += loadMergedMeshes(merge_groups[g], ptx_path, geometry_group, aabb, num_merged_triangles);
+			}
+			std::cerr << "[Merge] " << num_merged << " meshes with " << merge_groups.size() << " material(s) merged into "
+				<< num_instances << " geometries, " << num_merged - num_instances << " objects saved, "
+				<< num_merged_triangles << " triangles" << std::endl;
+			num_triangles += num_merged_triangles;
+			num_unique_triangles += num_merged_triangles;
+		}
+		std::cerr << "Total triangle count: " << num_triangles << " (" << num_unique_triangles << " in "
+			<< num_geometries << " mesh files)" << std::endl;
 	}
 	//Lights
 	{
@@ -1048,6 +1833,10 @@ void printUsageAndExit()
 		"\n"
 		"usage: OptaGen.exe [-h] [--mode MODE] --scene SCENE [--in IN] [--out OUT] [--num NUM] \n"
 		"                   [--spp SPP] [--mspp MSPP] [--roc ROC] [--width WIDTH] [--visual VISUAL] \n"
+		"                   [--backend BACKEND] [--threads THREADS] [--camera-check CHECK] [--gen-cameras NUM] \n"
+		"                   [--lookat LOOKAT] [--lookat-detail DETAIL] [--compile-scene] [--plan] [--mem-budget MB] \n"
+		"                   [--reorder-meshes] [--bench-mesh-order] [--quantize-meshes] [--lod] [--lod-triangles NUM] \n"
+		"                   [--merge-meshes] [--telemetry FILE] [--trace FILE] [--sampler SAMPLER] \n"
 		"\n"
 		"OptaGen renderer... \n"
 		"Copyright © 2020 by Inyoung Cho (ciy405x@kaist.ac.kr) \n"
@@ -1068,6 +1857,30 @@ void printUsageAndExit()
 		"  -w | --width WIDTH    image width and height for training data processing (optional) \n"
 		"       --device DEVICE  device ID \n"
 		"  -v | --visual VISUAL  visual mode (default: 0, 0: off, 1: on) \n"
+		"       --backend BACKEND  rendering backend (default: optix, optix: GPU, cpu: multi-threaded CPU) \n"
+		"       --threads THREADS  number of CPU render threads (default: 0, all hardware threads) \n"
+		"       --camera-check CHECK  validate random cameras with host ray casts (default: 1, 0: off, 1: on) \n"
+		"       --gen-cameras NUM  write NUM validated cameras into the camera block of the scene file and exit \n"
+		"       --lookat LOOKAT  random lookat placement (default: 1, 0: inside the scene bounds, 1: on the scene surfaces) \n"
+		"       --lookat-detail DETAIL  weight of textured meshes relative to their area for surface lookats (default: 1) \n"
+		"       --compile-scene  write the parsed scene and its transformed meshes to SCENE.bundle and exit \n"
+		"                        (later runs load the bundle while it is newer than the scene and mesh files) \n"
+		"       --plan           print the expected host and device memory, output size and cost of the job and exit \n"
+		"       --mem-budget MB  refuse jobs that need more device memory (host memory with the cpu backend) than MB (default: 0, no limit) \n"
+		"       --reorder-meshes  sort the triangles and vertices of every mesh file along a Morton curve for memory locality \n"
+		"       --bench-mesh-order  time the CPU BVH and count simulated cache misses of every mesh file with and without reordering and exit \n"
+		"       --quantize-meshes  store mesh positions, normals and UVs in 16 instead of 32 bytes per vertex on the device \n"
+		"       --lod            simplify the largest meshes of jobs over --mem-budget until they fit instead of refusing them \n"
+		"                        (levels are cached as MESH.lod<k>.ply while they are newer than the mesh file) \n"
+		"       --lod-triangles NUM  simplify the largest meshes until the scene has at most NUM placed triangles (default: 0, no limit) \n"
+		"       --merge-meshes   concatenate the meshes placed once that share identical material parameters into one geometry \n"
+		"                        (optix backend, merged meshes also share their random materials) \n"
+		"       --telemetry FILE  append one JSON line per patch with the time of each phase, bytes written and peak RSS to FILE, \n"
+		"                        and a summary line at exit (batch modes only) \n"
+		"       --trace FILE     record a timeline of the loaders, launches and writes and save it to FILE as Chrome trace JSON \n"
+		"                        (chrome://tracing or ui.perfetto.dev, batch modes only) \n"
+		"       --sampler SAMPLER  sample stream of the renderer (default: sobol, random: tea + LCG of earlier versions, \n"
+		"                        sobol: Owen-scrambled Sobol per pixel, bluenoise: Sobol with the error spread as blue noise) \n"
 		"\n"
 		"app keystrokes:\n"
 		"  q  Quit\n"
@@ -1083,76 +1896,70 @@ void printUsageAndExit()
 
 void writeBufferToNpy(std::string filename, optix::Buffer buffer, bool ref, int num_of_frames)
 {
-	GLsizei width, height;
 	RTsize buffer_width, buffer_height;
 
+	sutil::TraceScope trace("writeBufferToNpy", filename);
+
 	float* data;
 	rtBufferMap(buffer->get(), (void**)&data);
 
 	buffer->getSize(buffer_width, buffer_height);
-	width = static_cast<GLsizei>(buffer_width);
-	height = static_cast<GLsizei>(buffer_height);
 
-	if (ref)
-	{
-		std::vector<float> pix(width * height * 3);
-		// this buffer is upside down
-		for (int j = height - 1; j >= 0; --j)
-		{
-			float* dst = &pix[0] + (3 * width*(height - 1 - j));
-			float* src = data + 4 * width*j;
-			for (int i = 0; i < width; i++)
-			{
-				for (int elem = 0; elem < 3; ++elem)
-				{
-					*dst++ = *src++;
-				}
+	int feat_dim = ref ? 4 : static_cast<int>(buffer->getElementSize() / sizeof(float) / num_of_frames);
+	writeDataToNpy(filename, data, buffer_width, buffer_height, ref, num_of_frames, feat_dim);
 
-				// skip alpha (padding)
-				src++;
-			}
+	RT_CHECK_ERROR(rtBufferUnmap(buffer->get()));
+}
 
-		}
 
-		cnpy::npy_save(
-			filename,
-			&pix[0],
-			{ buffer_width, buffer_height, 3 },
-			"w");
+// Backend dispatch for the batch rendering loops in main().
+void launchFrame(unsigned int frame)
+{
+	sutil::TraceScope trace("launchFrame");
+
+	if (cpuRenderer)
+	{
+		cpuRenderer->launch(frame);
+		return;
 	}
+
+	context["frame"]->setUint(frame);
+	context->launch(0, scene->properties.width, scene->properties.height);
+}
+
+
+void writeFeaturesToNpy(std::string filename, int num_of_frames)
+{
+	Telemetry::Scope timing(telemetry, PHASE_WRITE);
+	if (cpuRenderer)
+		writeDataToNpy(filename, reinterpret_cast<const float*>(cpuRenderer->getPathFeatureBuffer().data()),
+			cpuRenderer->getWidth(), cpuRenderer->getHeight(), false, num_of_frames, sizeof(PathFeature) / sizeof(float));
 	else
-	{
-		int feat_dim = buffer->getElementSize() / sizeof(float) / num_of_frames;
+		writeBufferToNpy(filename, getMBFBuffer(), false, num_of_frames);
 
-		std::vector<float> pix(width * height * num_of_frames * feat_dim);
-		// this buffer is upside down
-		for (int j = height - 1; j >= 0; --j)
-		{
-			float* dst = &pix[0] + (num_of_frames * feat_dim * width*(height - 1 - j));
-			float* src = data + num_of_frames * feat_dim * width*j;
-			for (int i = 0; i < width; i++)
-			{
-				for (int elem = 0; elem < num_of_frames * feat_dim; ++elem)
-				{
-					*dst++ = *src++;
-				}
+	telemetry.addBytesWritten(filename);
+	std::cerr << "[Output] (feat) " << filename << std::endl;
+}
 
-				// if spp % 4 == 0 ==> no need to pad
-			}
-		}
 
-		cnpy::npy_save(
-			filename,
-			&pix[0],
-			{ buffer_width, buffer_height,
-			(size_t)num_of_frames,
-			(size_t)feat_dim },
-			"w");
-	}
+void writeReferenceToNpy(std::string filename, int num_of_frames)
+{
+	Telemetry::Scope timing(telemetry, PHASE_WRITE);
+	if (cpuRenderer)
+		writeDataToNpy(filename, reinterpret_cast<const float*>(cpuRenderer->getOutputBuffer().data()),
+			cpuRenderer->getWidth(), cpuRenderer->getHeight(), true, num_of_frames, 4);
+	else
+		writeBufferToNpy(filename, getOutputBuffer(), true, num_of_frames);
+
+	telemetry.addBytesWritten(filename);
+	std::cerr << "[Output] (ref) " << filename << std::endl;
+}
 
-	RT_CHECK_ERROR(rtBufferUnmap(buffer->get()));
 
-	std::cerr << "[Output] " << (ref ? "(ref) " : "(feat) ") << filename << std::endl;
+void printThroughput(const char* tag, double elapsed, unsigned int frames)
+{
+	const double samples = double(scene->properties.width) * scene->properties.height * frames;
+	std::cerr << "[Throughput] " << tag << samples / elapsed << " samples/s\n";
 }
 
 
@@ -1163,12 +1970,28 @@ int main(int argc, char** argv)
 	std::string scene_file = "", hdrs_home = "", in_file = "", out_file = "";
 	bool visual = false;
 	bool use_pbo = false;
+	bool use_cpu = false;
+	unsigned int num_threads = 0;
+	int num_of_cameras = 0;
+	float lookat_detail = 1.0f;
+	bool compile_scene = false;
+	bool plan_only = false;
+	bool bench_mesh_order = false;
+	double mem_budget = 0.0;
+	bool use_lod = false;
+	uint64_t lod_triangles = 0;
+	std::string telemetry_file = "";
+	std::string trace_file = "";
 
 	std::vector<std::string> opts = {
 		"-h", "--help", "-M", "--mode", "-s", "--scene",
 		"-d", "--hdr", "-i", "--in", "-o", "--out",
 		"-n", "--num", "-c", "--ckp", "-p", "--spp", "-m", "--mspp",
-		"-r", "--roc", "-w", "--width", "-v", "--visual"
+		"-r", "--roc", "-w", "--width", "-v", "--visual",
+		"--device", "--backend", "--threads", "--camera-check", "--gen-cameras",
+		"--lookat", "--lookat-detail", "--compile-scene", "--plan", "--mem-budget",
+		"--reorder-meshes", "--bench-mesh-order", "--quantize-meshes", "--lod", "--lod-triangles",
+		"--merge-meshes", "--telemetry", "--trace", "--sampler"
 	};
 
 	for (int i = 1; i < argc; ++i)
@@ -1397,6 +2220,222 @@ int main(int argc, char** argv)
 				printUsageAndExit();
 			}
 		}
+		else if (arg == "--backend")
+		{
+			if (i == argc - 1 || (std::find(opts.begin(), opts.end(), argv[i + 1]) != opts.end()))
+			{
+				std::cerr << "Option '" << arg << "' requires additional argument.\n";
+				printUsageAndExit();
+			}
+
+			const std::string backend(argv[++i]);
+			if (backend == "cpu")
+				use_cpu = true;
+			else if (backend == "optix")
+				use_cpu = false;
+			else
+			{
+				std::cerr << "Option '" << arg << "' should be 'optix' or 'cpu'.\n";
+				printUsageAndExit();
+			}
+		}
+		else if (arg == "--threads")
+		{
+			if (i == argc - 1 || (std::find(opts.begin(), opts.end(), argv[i + 1]) != opts.end()))
+			{
+				std::cerr << "Option '" << arg << "' requires additional argument.\n";
+				printUsageAndExit();
+			}
+
+			try
+			{
+				int threads = std::stoi(argv[++i]);
+				if (threads < 0)
+				{
+					throw std::exception();
+				}
+				num_threads = static_cast<unsigned int>(threads);
+			}
+			catch (std::exception const &e)
+			{
+				std::cerr << "Option '" << arg << "' should be a non-negative interger value.\n";
+				printUsageAndExit();
+			}
+		}
+		else if (arg == "--camera-check")
+		{
+			if (i == argc - 1 || (std::find(opts.begin(), opts.end(), argv[i + 1]) != opts.end()))
+			{
+				std::cerr << "Option '" << arg << "' requires additional argument.\n";
+				printUsageAndExit();
+			}
+			cameraCheck = strcmp(argv[++i], "0") == 0 ? false : true;
+		}
+		else if (arg == "--gen-cameras")
+		{
+			if (i == argc - 1 || (std::find(opts.begin(), opts.end(), argv[i + 1]) != opts.end()))
+			{
+				std::cerr << "Option '" << arg << "' requires additional argument.\n";
+				printUsageAndExit();
+			}
+
+			try
+			{
+				num_of_cameras = std::stoi(argv[++i]);
+				if (num_of_cameras <= 0)
+				{
+					throw std::exception();
+				}
+			}
+			catch (std::exception const &e)
+			{
+				std::cerr << "Option '" << arg << "' should be a positive interger value.\n";
+				printUsageAndExit();
+			}
+		}
+		else if (arg == "--compile-scene")
+		{
+			compile_scene = true;
+		}
+		else if (arg == "--plan")
+		{
+			plan_only = true;
+		}
+		else if (arg == "--reorder-meshes")
+		{
+			meshLoadFlags |= MESH_LOADER_REORDER;
+		}
+		else if (arg == "--bench-mesh-order")
+		{
+			bench_mesh_order = true;
+		}
+		else if (arg == "--quantize-meshes")
+		{
+			quantizeMeshes = true;
+		}
+		else if (arg == "--merge-meshes")
+		{
+			mergeMeshes = true;
+		}
+		else if (arg == "--telemetry")
+		{
+			if (i == argc - 1 || (std::find(opts.begin(), opts.end(), argv[i + 1]) != opts.end()))
+			{
+				std::cerr << "Option '" << arg << "' requires additional argument.\n";
+				printUsageAndExit();
+			}
+			telemetry_file = argv[++i];
+		}
+		else if (arg == "--trace")
+		{
+			if (i == argc - 1 || (std::find(opts.begin(), opts.end(), argv[i + 1]) != opts.end()))
+			{
+				std::cerr << "Option '" << arg << "' requires additional argument.\n";
+				printUsageAndExit();
+			}
+			trace_file = argv[++i];
+		}
+		else if (arg == "--sampler")
+		{
+			if (i == argc - 1 || (std::find(opts.begin(), opts.end(), argv[i + 1]) != opts.end()))
+			{
+				std::cerr << "Option '" << arg << "' requires additional argument.\n";
+				printUsageAndExit();
+			}
+
+			const std::string sampler(argv[++i]);
+			if (sampler == "random")
+				samplerType = SAMPLER_RANDOM;
+			else if (sampler == "sobol")
+				samplerType = SAMPLER_SOBOL;
+			else if (sampler == "bluenoise")
+				samplerType = SAMPLER_BLUE_NOISE;
+			else
+			{
+				std::cerr << "Option '" << arg << "' should be 'random', 'sobol' or 'bluenoise'.\n";
+				printUsageAndExit();
+			}
+		}
+		else if (arg == "--lod")
+		{
+			use_lod = true;
+		}
+		else if (arg == "--lod-triangles")
+		{
+			if (i == argc - 1 || (std::find(opts.begin(), opts.end(), argv[i + 1]) != opts.end()))
+			{
+				std::cerr << "Option '" << arg << "' requires additional argument.\n";
+				printUsageAndExit();
+			}
+
+			try
+			{
+				const long long value = std::stoll(argv[++i]);
+				if (value < 0)
+				{
+					throw std::exception();
+				}
+				lod_triangles = static_cast<uint64_t>(value);
+			}
+			catch (std::exception const &e)
+			{
+				std::cerr << "Option '" << arg << "' should be a non-negative interger value.\n";
+				printUsageAndExit();
+			}
+		}
+		else if (arg == "--mem-budget")
+		{
+			if (i == argc - 1 || (std::find(opts.begin(), opts.end(), argv[i + 1]) != opts.end()))
+			{
+				std::cerr << "Option '" << arg << "' requires additional argument.\n";
+				printUsageAndExit();
+			}
+
+			try
+			{
+				mem_budget = std::stod(argv[++i]);
+				if (mem_budget < 0.0)
+				{
+					throw std::exception();
+				}
+			}
+			catch (std::exception const &e)
+			{
+				std::cerr << "Option '" << arg << "' should be a non-negative real value.\n";
+				printUsageAndExit();
+			}
+		}
+		else if (arg == "--lookat")
+		{
+			if (i == argc - 1 || (std::find(opts.begin(), opts.end(), argv[i + 1]) != opts.end()))
+			{
+				std::cerr << "Option '" << arg << "' requires additional argument.\n";
+				printUsageAndExit();
+			}
+			surfaceLookat = strcmp(argv[++i], "0") == 0 ? false : true;
+		}
+		else if (arg == "--lookat-detail")
+		{
+			if (i == argc - 1 || (std::find(opts.begin(), opts.end(), argv[i + 1]) != opts.end()))
+			{
+				std::cerr << "Option '" << arg << "' requires additional argument.\n";
+				printUsageAndExit();
+			}
+
+			try
+			{
+				lookat_detail = std::stof(argv[++i]);
+				if (lookat_detail <= 0.0f)
+				{
+					throw std::exception();
+				}
+			}
+			catch (std::exception const &e)
+			{
+				std::cerr << "Option '" << arg << "' should be a positive real value.\n";
+				printUsageAndExit();
+			}
+		}
 		else if (arg == "-v" || arg == "--visual")
 		{
 			if (i == argc - 1 || (std::find(opts.begin(), opts.end(), argv[i + 1]) != opts.end()))
@@ -1443,9 +2482,35 @@ int main(int argc, char** argv)
 		printUsageAndExit();
 	}
 
+	if (use_cpu && num_of_cameras == 0 && (visual || (in_file.empty() && out_file.empty())))
+	{
+		std::cerr << "The CPU backend does not support the visual mode. Option '--in' or '--out' is required. \n";
+		printUsageAndExit();
+	}
+
 	try
 	{
-		scene = LoadScene(scene_file.c_str());
+		if (!telemetry_file.empty() && !telemetry.open(telemetry_file, scene_file))
+			throw std::runtime_error("Couldn't open " + telemetry_file + " for appending.");
+		if (!trace_file.empty())
+			sutil::traceBegin();
+
+		{
+			Telemetry::Scope timing(telemetry, PHASE_SCENE_LOAD);
+			scene = LoadScene(scene_file.c_str(), !compile_scene);
+		}
+
+		// Compiled before any command line overrides are applied to the scene.
+		if (compile_scene)
+		{
+			const std::string bundle_fn = scene_file + ".bundle";
+			if (!SceneBundle::write(bundle_fn, *scene, meshLoadFlags))
+				throw std::runtime_error("Failed to write " + bundle_fn);
+			std::cerr << "[Output] " << bundle_fn << std::endl;
+			destroyContext();
+			return 0;
+		}
+
 		if (width != 0)
 		{
 			scene->properties.width = width;
@@ -1453,6 +2518,81 @@ int main(int argc, char** argv)
 		}
 		SAVE_DIR = scene->dir;
 
+		if (num_of_cameras > 0)
+		{
+			generateCameras(scene_file, num_of_cameras, num_threads, lookat_detail);
+			destroyContext();
+			return 0;
+		}
+
+		if (bench_mesh_order)
+		{
+			benchmarkMeshOrder(*scene, num_threads, std::cerr);
+			destroyContext();
+			return 0;
+		}
+
+		JobSettings settings;
+		settings.width = scene->properties.width;
+		settings.height = scene->properties.height;
+		settings.spp = num_of_frames;
+		settings.ref_spp = max_ref_frames;
+		settings.patches = num_of_patches;
+		settings.features = mode == M_FET || mode == M_ALL;
+		settings.reference = mode == M_REF || mode == M_ALL;
+		settings.cpu = use_cpu;
+		settings.random_cameras = num_of_patches > 1 && scene->cameras.empty();
+		settings.quantized_meshes = quantizeMeshes;
+		settings.occupancy_resolution = cameraCheck ? OCCUPANCY_RESOLUTION : 0;
+		settings.hdrs_dir = hdrs_home;
+
+		// Simplified meshes replace the mesh files of the scene before the job is planned and loaded.
+		if (lod_triangles > 0 || (use_lod && mem_budget > 0.0))
+		{
+			LodBudget budget;
+			budget.triangles = lod_triangles;
+			if (use_lod && mem_budget > 0.0)
+			{
+				JobPlan plan;
+				plan.estimate(*scene, settings);
+				const uint64_t planned = use_cpu ? plan.getHostBytes() : plan.getDeviceBytes();
+				const uint64_t limit = static_cast<uint64_t>(mem_budget * 1024.0 * 1024.0);
+				if (planned > limit)
+				{
+					// Everything but the meshes stays as planned.
+					const uint64_t others = planned - plan.getMeshBytes();
+					budget.bytes = limit > others ? limit - others : 1;
+				}
+			}
+			if ((budget.triangles > 0 || budget.bytes > 0) && !applyMeshLods(*scene, settings, budget, std::cerr))
+				std::cerr << "[LOD] The scene is over its budget even at the coarsest levels." << std::endl;
+		}
+		else if (use_lod)
+			std::cerr << "Option '--lod' has no effect without '--mem-budget'." << std::endl;
+
+		// Planned before anything is allocated, so jobs over the budget stop here instead of failing mid-run.
+		if (plan_only || mem_budget > 0.0)
+		{
+			JobPlan plan;
+			plan.estimate(*scene, settings);
+
+			const uint64_t planned = use_cpu ? plan.getHostBytes() : plan.getDeviceBytes();
+			const bool over_budget = mem_budget > 0.0 && planned > mem_budget * 1024.0 * 1024.0;
+			if (plan_only || over_budget)
+				plan.print(std::cerr);
+			if (over_budget)
+			{
+				std::ostringstream msg;
+				msg << "The job needs " << planned / (1024 * 1024) << " MB of " << (use_cpu ? "host" : "device")
+					<< " memory, the budget is " << mem_budget << " MB (--mem-budget).";
+				throw std::runtime_error(msg.str());
+			}
+			if (plan_only)
+			{
+				destroyContext();
+				return 0;
+			}
+		}
 
 		GLFWwindow* window;
 		GLenum err;
@@ -1470,11 +2610,18 @@ int main(int argc, char** argv)
 
 		ilInit();
 
-		createContext(use_pbo, scene->properties.max_depth, num_of_frames, deviceID);
+		if (use_cpu)
+		{
+			cpuRenderer = new CpuRenderer(scene->properties.width, scene->properties.height, scene->properties.max_depth, num_of_frames, num_threads);
+			cpuRenderer->setSampler(samplerType);
+		}
+		else
+			createContext(use_pbo, scene->properties.max_depth, num_of_frames, deviceID);
 
 		// Load textures
 		for (int i = 0; i < scene->texture_map.size(); i++)
 		{
+			Telemetry::Scope timing(telemetry, PHASE_TEXTURE_LOAD);
 			Texture tex;
 			Picture* picture = new Picture;
 			std::string textureFilename = scene->dir + std::string(scene->texture_map[i]);
@@ -1483,35 +2630,53 @@ int main(int argc, char** argv)
 			{
 				std::cout << "Load failed: " << textureFilename << std::endl;
 			}
-			tex.createSampler(context, picture);
+			if (cpuRenderer)
+				tex.createHostTexels(picture);
+			else
+				tex.createSampler(context, picture);
 			scene->textures.push_back(tex);
 			delete picture;
 		}
 
-		// Set textures to albedo ID of materials
-		for (int i = 0; i < scene->materials.size(); i++)
+		if (cpuRenderer)
+		{
+			// The CPU backend looks the textures up by the 1-based albedo ID directly.
+			cpuRenderer->setTextures(&scene->textures);
+			updateLightParameters(scene->lights);
+			updateMaterialParameters(scene->materials);
+		}
+		else
 		{
-			if (scene->materials[i].albedoID != RT_TEXTURE_ID_NULL)
+			// Set textures to albedo ID of materials
+			for (int i = 0; i < scene->materials.size(); i++)
 			{
-				scene->materials[i].albedoID = scene->textures[scene->materials[i].albedoID - 1].getId();
+				if (scene->materials[i].albedoID != RT_TEXTURE_ID_NULL)
+				{
+					scene->materials[i].albedoID = scene->textures[scene->materials[i].albedoID - 1].getId();
+				}
 			}
-		}
 
-		m_bufferLightParameters = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_USER);
-		m_bufferLightParameters->setElementSize(sizeof(LightParameter));
-		m_bufferLightParameters->setSize(scene->lights.size());
-		updateLightParameters(scene->lights);
-		context["sysLightParameters"]->setBuffer(m_bufferLightParameters);
+			m_bufferLightParameters = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_USER);
+			m_bufferLightParameters->setElementSize(sizeof(LightParameter));
+			m_bufferLightParameters->setSize(scene->lights.size());
+			updateLightParameters(scene->lights);
+			context["sysLightParameters"]->setBuffer(m_bufferLightParameters);
 
-		m_bufferMaterialParameters = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_USER);
-		m_bufferMaterialParameters->setElementSize(sizeof(MaterialParameter));
-		m_bufferMaterialParameters->setSize(scene->materials.size());
-		updateMaterialParameters(scene->materials);
-		context["sysMaterialParameters"]->setBuffer(m_bufferMaterialParameters);
+			m_bufferMaterialParameters = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_USER);
+			m_bufferMaterialParameters->setElementSize(sizeof(MaterialParameter));
+			m_bufferMaterialParameters->setSize(scene->materials.size());
+			updateMaterialParameters(scene->materials);
+			context["sysMaterialParameters"]->setBuffer(m_bufferMaterialParameters);
+
+			context["sysNumberOfLights"]->setInt(scene->lights.size());
+		}
 
-		context["sysNumberOfLights"]->setInt(scene->lights.size());
 		optix::Group top_group;
-		const optix::Aabb aabb = createGeometry(top_group);
+		optix::Aabb aabb;
+		{
+			Telemetry::Scope timing(telemetry, PHASE_MESH_LOAD);
+			aabb = createGeometry(top_group);
+		}
 
 		/* Visualize axis-aligned bounding box (aabb)
 		updateAabbLights(aabb1);
@@ -1520,7 +2685,19 @@ int main(int argc, char** argv)
 		const optix::Aabb aabb = createGeometry(top_group); // 이게 없어도 light은 적용됨. 눈에 안보일 뿐.
 		*/
 
-		context->validate();
+		if (!cpuRenderer)
+			context->validate();
+
+		// Random cameras are placed and validated with a host copy of the scene.
+		if (num_of_patches > 1 && scene->cameras.empty())
+		{
+			createSceneProbe(num_threads);
+			setLookatWeights(lookat_detail);
+
+			loadCameraBounds(aabb, scene_file.substr(0, scene_file.find_last_of("\\")) + "\\aabb.txt", scene_file);
+			if (cameraCheck)
+				createOccupancyGrid(scene_file, num_threads);
+		}
 
 		if (!scene->properties.init_eye)
 			scene->properties.camera_eye = optix::make_float3(0.0f, 1.5f*aabb.extent(1), 1.5f*aabb.extent(2));
@@ -1577,6 +2754,8 @@ int main(int argc, char** argv)
 		}
 		else
 		{
+			telemetry.endSetup();
+
 			if (num_of_patches == 1)
 			{
 				if (mode == M_REF)
@@ -1586,11 +2765,18 @@ int main(int argc, char** argv)
 				else
 					std::cerr << "[Mode] reference-and-feature" << "\n";
 
-				sutil::Camera camera(
-					scene->properties.width, scene->properties.height, scene->properties.vfov,
-					&scene->properties.camera_eye.x, &scene->properties.camera_lookat.x, &scene->properties.camera_up.x,
-					context["eye"], context["U"], context["V"], context["W"]
-					);
+				if (cpuRenderer)
+				{
+					cpuRenderer->setCamera(scene->properties.camera_eye, scene->properties.camera_lookat, scene->properties.camera_up, scene->properties.vfov);
+				}
+				else
+				{
+					sutil::Camera camera(
+						scene->properties.width, scene->properties.height, scene->properties.vfov,
+						&scene->properties.camera_eye.x, &scene->properties.camera_lookat.x, &scene->properties.camera_up.x,
+						context["eye"], context["U"], context["V"], context["W"]
+						);
+				}
 
 				if (mode == M_REF)
 					std::cerr << "[Samples] " << max_ref_frames << " (per-pixel)\n";
@@ -1605,30 +2791,39 @@ int main(int argc, char** argv)
 
 				if (mode == M_FET || mode == M_ALL)
 				{
-					for (unsigned int frame = 0; frame < num_of_frames; ++frame)
 					{
-						context["frame"]->setUint(frame);
-						context->launch(0, scene->properties.width, scene->properties.height);
+						sutil::TraceScope trace("feature_launch");
+						for (unsigned int frame = 0; frame < num_of_frames; ++frame)
+							launchFrame(frame);
 					}
-					std::cerr << "[Elapsed time] (feat) " << sutil::currentTime() - startTime << "s\n";
+					const double elapsed = sutil::currentTime() - startTime;
+					telemetry.add(PHASE_FEATURE_LAUNCH, elapsed);
+					std::cerr << "[Elapsed time] (feat) " << elapsed << "s\n";
+					printThroughput("(feat) ", elapsed, num_of_frames);
 
-					writeBufferToNpy(in_file, getMBFBuffer(), false, num_of_frames);
+					writeFeaturesToNpy(in_file, num_of_frames);
 
 					startTime = sutil::currentTime();
 				}
 
 				if (mode == M_REF || mode == M_ALL)
 				{
-					for (unsigned int frame = 0; frame < max_ref_frames; ++frame)
 					{
-						context["frame"]->setUint(frame);
-						context->launch(0, scene->properties.width, scene->properties.height);
+						sutil::TraceScope trace("reference_launch");
+						for (unsigned int frame = 0; frame < max_ref_frames; ++frame)
+							launchFrame(frame);
 					}
-					std::cerr << "[Elapsed time] (ref) " << sutil::currentTime() - startTime << "s\n";
+					const double elapsed = sutil::currentTime() - startTime;
+					telemetry.add(PHASE_REFERENCE_LAUNCH, elapsed);
+					std::cerr << "[Elapsed time] (ref) " << elapsed << "s\n";
+					printThroughput("(ref) ", elapsed, max_ref_frames);
 
-					writeBufferToNpy(out_file, getOutputBuffer(), true, num_of_frames);
+					writeReferenceToNpy(out_file, num_of_frames);
 				}
 
+				telemetry.endPatch(ckp, mode == M_REF ? 0 : num_of_frames, mode == M_FET ? 0 : max_ref_frames);
+				telemetry.close();
+
 				destroyContext();
 			}
 			else
@@ -1666,8 +2861,14 @@ int main(int argc, char** argv)
 
 				for (int r = ckp; r < ckp + num_of_patches; r++)
 				{
-					sutil::Camera camera = setRandomCameraParams(aabb, aabb_txt_fn);
-					setRandomMaterials();
+					{
+						Telemetry::Scope timing(telemetry, PHASE_RANDOMIZE);
+						if (cpuRenderer)
+							setRandomCpuCameraParams(aabb, aabb_txt_fn);
+						else
+							setRandomCameraParams(aabb, aabb_txt_fn);
+						setRandomMaterials();
+					}
 					if (hdrs_home != "")
 						setRandomBackground(hdrs_home, entries);
 
@@ -1683,39 +2884,58 @@ int main(int argc, char** argv)
 					double startTime = sutil::currentTime();
 					if (mode == M_FET || mode == M_ALL)
 					{
-						for (unsigned int frame = 0; frame < num_of_frames; ++frame)
 						{
-							context["frame"]->setUint(frame);
-							context->launch(0, scene->properties.width, scene->properties.height);
+							sutil::TraceScope trace("feature_launch");
+							for (unsigned int frame = 0; frame < num_of_frames; ++frame)
+								launchFrame(frame);
 						}
-						std::cerr << "[Elapsed time] (feat) " << sutil::currentTime() - startTime << "\n";
+						const double elapsed = sutil::currentTime() - startTime;
+						telemetry.add(PHASE_FEATURE_LAUNCH, elapsed);
+						std::cerr << "[Elapsed time] (feat) " << elapsed << "\n";
+						printThroughput("(feat) ", elapsed, num_of_frames);
 
 						in_fn = in_file.substr(0, in_file.find('.')) + "_" + std::to_string(r) + ".npy";
-						writeBufferToNpy(in_fn, getMBFBuffer(), false, num_of_frames);
+						writeFeaturesToNpy(in_fn, num_of_frames);
 
 						startTime = sutil::currentTime();
 					}
 
 					if (mode == M_REF || mode == M_ALL)
 					{
-						for (unsigned int frame = 0; frame < max_ref_frames; ++frame)
 						{
-							context["frame"]->setUint(frame);
-							context->launch(0, scene->properties.width, scene->properties.height);
+							sutil::TraceScope trace("reference_launch");
+							for (unsigned int frame = 0; frame < max_ref_frames; ++frame)
+								launchFrame(frame);
 						}
-						std::cerr << "[Elapsed time] (ref) " << sutil::currentTime() - startTime << "\n";
+						const double elapsed = sutil::currentTime() - startTime;
+						telemetry.add(PHASE_REFERENCE_LAUNCH, elapsed);
+						std::cerr << "[Elapsed time] (ref) " << elapsed << "\n";
+						printThroughput("(ref) ", elapsed, max_ref_frames);
 
 						out_fn = out_file.substr(0, out_file.find('.')) + "_" + std::to_string(r) + ".npy";
-						writeBufferToNpy(out_fn, getOutputBuffer(), true, num_of_frames);
+						writeReferenceToNpy(out_fn, num_of_frames);
 					}
+
+					telemetry.endPatch(r, mode == M_REF ? 0 : num_of_frames, mode == M_FET ? 0 : max_ref_frames);
 				}
 
+				if (sceneProbe)
+					printCameraStats("(total) ", cameraStats);
+				telemetry.close();
+
 				destroyContext();
 			}
 		}
 
+		if (!trace_file.empty())
+		{
+			if (!sutil::traceWrite(trace_file))
+				throw std::runtime_error("Couldn't write " + trace_file);
+			std::cerr << "[Trace] " << trace_file << "\n";
+		}
+
 		return 0;
 	}
-	SUTIL_CATCH(context->get())
+	SUTIL_CATCH(context ? context->get() : 0)
 }
 
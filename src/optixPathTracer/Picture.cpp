@@ -33,6 +33,8 @@
 #include "Picture.h"
 
 #include "IL/il.h"
+#include <HostMemory.h>
+#include <Trace.h>
 
 #include <algorithm>
 #include <cctype>
@@ -42,6 +44,23 @@
 #include "MyAssert.h"
 
 
+// All pixel arrays go through these two, so the decoded images show up in the host memory report.
+static unsigned char* allocPixels(size_t bytes)
+{
+  unsigned char* pixels = new unsigned char[bytes];
+  sutil::hostMemoryAllocated(sutil::HOST_MEMORY_IMAGE, bytes);
+  return pixels;
+}
+
+static void freePixels(unsigned char* pixels, size_t bytes)
+{
+  if (pixels != nullptr)
+  {
+    sutil::hostMemoryReleased(sutil::HOST_MEMORY_IMAGE, bytes);
+    delete[] pixels;
+  }
+}
+
 static unsigned int numberOfComponents(int format)
 {
   switch (format)
@@ -125,11 +144,8 @@ Image::Image(unsigned int width,
 
 Image::~Image()
 {
-  if (m_pixels != nullptr)
-  {
-    delete[] m_pixels;
-    m_pixels = nullptr;
-  }
+  freePixels(m_pixels, m_nob);
+  m_pixels = nullptr;
 }
 
 Image::Image(const Image& image)
@@ -146,7 +162,7 @@ Image::Image(const Image& image)
 {
   if (image.m_pixels != nullptr) 
   {
-    m_pixels = new unsigned char[image.m_nob];
+    m_pixels = allocPixels(image.m_nob);
     memcpy(m_pixels, image.m_pixels, image.m_nob); // Deep copy.
   }
 }
@@ -217,6 +233,8 @@ bool Picture::isCubemap() const
 
 bool Picture::load(const std::string& filename)
 {
+  sutil::TraceScope trace("Picture::load", filename);
+
   bool success = false;
 
   m_images.clear(); // Each load() wipes previously loaded image data.
@@ -470,11 +488,7 @@ bool Picture::copyMipmaps(unsigned int index, std::vector<const void*> const& mi
   // Release existing mipmaps.
   if (1 < images.size())
   {
-    for (size_t i = 1; i < images.size(); ++i)
-    {
-      delete[] images[i].m_pixels;
-    }
-    images.resize(1);
+    images.resize(1); // ~Image() frees the pixels.
   }
 
   unsigned int numMipmaps = numberOfMipmaps(images[0].m_width, images[0].m_height, images[0].m_depth); // Includes LOD 0.
@@ -511,7 +525,7 @@ bool Picture::copyMipmaps(unsigned int index, std::vector<const void*> const& mi
 
     Image* dst = &images.back(); // points to newly created Image
 
-    dst->m_pixels = new unsigned char[dst->m_nob];
+    dst->m_pixels = allocPixels(dst->m_nob);
     memcpy(dst->m_pixels, mipmaps[i], dst->m_nob);
   }
   return true; // succeeded if we get here
@@ -523,13 +537,10 @@ void Picture::setImageData(unsigned int index, const void* pixels, std::vector<c
 
   Image* image = &m_images[index][0]; // LOD 0 image
 
-  if (image->m_pixels)
-  {
-    delete[] image->m_pixels;
-    image->m_pixels = nullptr;
-  }
+  freePixels(image->m_pixels, image->m_nob);
+  image->m_pixels = nullptr;
 
-  image->m_pixels = new unsigned char[image->m_nob];
+  image->m_pixels = allocPixels(image->m_nob);
 
   memcpy(image->m_pixels, pixels, image->m_nob);
 
@@ -550,7 +561,7 @@ void Picture::mirrorX(unsigned int index)
     Image* image = &m_images[index][i];
 
     const unsigned char* srcPixels = image->m_pixels;
-    unsigned char*       dstPixels = new unsigned char[image->m_nob];
+    unsigned char*       dstPixels = allocPixels(image->m_nob);
 
     for (unsigned int z = 0; z < image->m_depth; ++z) 
     {
@@ -562,7 +573,7 @@ void Picture::mirrorX(unsigned int index)
         memcpy(dstLine, srcLine, image->m_bpl);
       }
     }
-    delete[] image->m_pixels;
+    freePixels(image->m_pixels, image->m_nob);
     image->m_pixels = dstPixels;
   }
 }
@@ -577,7 +588,7 @@ void Picture::mirrorY(unsigned int index)
     Image* image = &m_images[index][i];
 
     const unsigned char* srcPixels = image->m_pixels;
-    unsigned char*       dstPixels = new unsigned char[image->m_nob];
+    unsigned char*       dstPixels = allocPixels(image->m_nob);
 
     for (unsigned int z = 0; z < image->m_depth; ++z) 
     {
@@ -596,7 +607,7 @@ void Picture::mirrorY(unsigned int index)
       }
     }
 
-    delete[] image->m_pixels;
+    freePixels(image->m_pixels, image->m_nob);
     image->m_pixels = dstPixels;
   }
 }
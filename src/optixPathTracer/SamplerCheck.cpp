@@ -0,0 +1,245 @@
+#include "SamplerCheck.h"
+#include "sampler.h"
+
+#include <cmath>
+#include <iomanip>
+#include <vector>
+
+namespace
+{
+
+const unsigned int IMAGE_SIZE = 64;		/* pixels per axis, one estimate per pixel */
+const unsigned int MAX_SPP = 256;
+const unsigned int NET_LOG2_POINTS = 8;
+const double BIAS_SIGMAS = 5.0;			/* of the mean error over the pixels */
+const unsigned int FILTER_SPP = 4;		/* for the blue noise check */
+const unsigned int SEED = 1234;
+
+const char* const SAMPLER_NAMES[NUM_SAMPLER_TYPES] = { "random", "sobol", "bluenoise" };
+
+
+// Indicator of a disk, the discontinuity is what geometric and shadow edges give.
+double disk(Sampler& sampler)
+{
+	const double u = rnd(sampler) - 0.5;
+	const double v = rnd(sampler) - 0.5;
+	return u * u + v * v < 0.16 ? 1.0 : 0.0;
+}
+
+
+double gaussian(Sampler& sampler)
+{
+	const double u = rnd(sampler);
+	const double v = rnd(sampler);
+	return exp(-(u * u + v * v));
+}
+
+
+// Smooth product over the dimensions a path with two vertices draws: jitter, light selection and sample, BSDF sample.
+double path(Sampler& sampler)
+{
+	double f = (0.5 + rnd(sampler)) * (0.5 + rnd(sampler));
+	for (int depth = 0; depth < 2; ++depth)
+	{
+		samplerStartDimension(sampler, depth, SAMPLER_LIGHT_DIMENSION);
+		for (int i = 0; i < 3; ++i)
+			f *= 0.5 + rnd(sampler);
+		samplerStartDimension(sampler, depth, SAMPLER_BSDF_DIMENSION);
+		for (int i = 0; i < 3; ++i)
+			f *= 0.5 + rnd(sampler);
+	}
+	return f;
+}
+
+
+struct Integrand
+{
+	const char* name;
+	double      value;
+	double      (*f)(Sampler& sampler);
+};
+
+
+std::vector<Integrand> getIntegrands()
+{
+	const double erf1 = 0.5 * sqrt(M_PI) * erf(1.0);
+	std::vector<Integrand> integrands;
+	integrands.push_back({ "disk", M_PI * 0.16, disk });
+	integrands.push_back({ "gaussian", erf1 * erf1, gaussian });
+	integrands.push_back({ "path", 1.0, path });
+	return integrands;
+}
+
+
+struct Convergence
+{
+	std::vector<unsigned int> spp;	/* powers of two */
+	std::vector<double>       rmse;
+	bool                      biased;			/* mean error off by more than BIAS_SIGMAS */
+	double                    slope;			/* of log rmse against log spp */
+	double                    filteredRatio;	/* RMSE after a 3x3 box filter over RMSE at FILTER_SPP */
+};
+
+
+// RMSE after a 3x3 box filter of the errors, wrapping around the borders.
+double filteredRmse(const std::vector<double>& errors)
+{
+	double sum = 0.0;
+	for (unsigned int y = 0; y < IMAGE_SIZE; ++y)
+	{
+		for (unsigned int x = 0; x < IMAGE_SIZE; ++x)
+		{
+			double filtered = 0.0;
+			for (unsigned int j = 0; j < 3; ++j)
+				for (unsigned int i = 0; i < 3; ++i)
+					filtered += errors[((y + j + IMAGE_SIZE - 1) % IMAGE_SIZE) * IMAGE_SIZE + (x + i + IMAGE_SIZE - 1) % IMAGE_SIZE];
+			filtered /= 9.0;
+			sum += filtered * filtered;
+		}
+	}
+	return sqrt(sum / errors.size());
+}
+
+
+Convergence measure(unsigned int type, const Integrand& integrand)
+{
+	const size_t pixels = IMAGE_SIZE * IMAGE_SIZE;
+	std::vector<double> sums(pixels, 0.0), errors(pixels);
+
+	Convergence result;
+	result.biased = false;
+	result.filteredRatio = 0.0;
+	for (unsigned int spp = 1; spp <= MAX_SPP; ++spp)
+	{
+		for (unsigned int y = 0; y < IMAGE_SIZE; ++y)
+		{
+			for (unsigned int x = 0; x < IMAGE_SIZE; ++x)
+			{
+				Sampler sampler = makeSampler(type, x, y, IMAGE_SIZE, spp - 1, SEED);
+				sums[y * IMAGE_SIZE + x] += integrand.f(sampler);
+			}
+		}
+		if (spp & (spp - 1))
+			continue;
+
+		double mean = 0.0, squares = 0.0;
+		for (size_t p = 0; p < pixels; ++p)
+		{
+			errors[p] = sums[p] / spp - integrand.value;
+			mean += errors[p];
+			squares += errors[p] * errors[p];
+		}
+		mean /= pixels;
+		const double rmse = sqrt(squares / pixels);
+		result.spp.push_back(spp);
+		result.rmse.push_back(rmse);
+		// The blue noise pixels share one sequence, their errors are not independent.
+		if (type != SAMPLER_BLUE_NOISE && fabs(mean) > BIAS_SIGMAS * rmse / sqrt(double(pixels)))
+			result.biased = true;
+		if (spp == FILTER_SPP)
+			result.filteredRatio = filteredRmse(errors) / rmse;
+	}
+
+	// Least squares fit over the second half of the spp, the start is dominated by the first samples.
+	double sx = 0.0, sy = 0.0, sxx = 0.0, sxy = 0.0;
+	const size_t first = result.spp.size() / 2;
+	for (size_t i = first; i < result.spp.size(); ++i)
+	{
+		const double x = log(double(result.spp[i]));
+		const double y = log(result.rmse[i]);
+		sx += x;
+		sy += y;
+		sxx += x * x;
+		sxy += x * y;
+	}
+	const double n = double(result.spp.size() - first);
+	result.slope = (n * sxy - sx * sy) / (n * sxx - sx * sx);
+	return result;
+}
+
+
+// Every elementary interval of 2^k x 2^(NET_LOG2_POINTS - k) cells has to hold exactly one of the first points.
+bool checkStratification(std::ostream& log)
+{
+	const unsigned int points = 1u << NET_LOG2_POINTS;
+	int bad = 0;
+	for (unsigned int pixel = 0; pixel < 16; ++pixel)
+	{
+		std::vector<float> u(points), v(points);
+		for (unsigned int frame = 0; frame < points; ++frame)
+		{
+			Sampler sampler = makeSampler(SAMPLER_SOBOL, pixel, 0, IMAGE_SIZE, frame, SEED);
+			u[frame] = rnd(sampler);
+			v[frame] = rnd(sampler);
+		}
+		for (unsigned int k = 0; k <= NET_LOG2_POINTS; ++k)
+		{
+			std::vector<int> cells(points, 0);
+			for (unsigned int i = 0; i < points; ++i)
+			{
+				const unsigned int cu = static_cast<unsigned int>(u[i] * (1u << k));
+				const unsigned int cv = static_cast<unsigned int>(v[i] * (1u << (NET_LOG2_POINTS - k)));
+				++cells[(cv << k) + cu];
+			}
+			for (unsigned int c = 0; c < points; ++c)
+				bad += cells[c] != 1;
+		}
+	}
+
+	log << "    stratification " << points << " frames of 16 pixels: " << bad << " elementary intervals without exactly one point"
+		<< std::endl;
+	return bad == 0;
+}
+
+} // namespace
+
+
+int checkSamplers(std::ostream& log)
+{
+	const std::ios::fmtflags flags = log.flags();
+	const std::streamsize precision = log.precision();
+	log << std::setprecision(4);
+
+	int failures = 0;
+	const std::vector<Integrand> integrands = getIntegrands();
+	for (size_t i = 0; i < integrands.size(); ++i)
+	{
+		log << "[Sampler] " << integrands[i].name << ", RMSE over " << IMAGE_SIZE << "x" << IMAGE_SIZE << " pixels" << std::endl;
+
+		Convergence results[NUM_SAMPLER_TYPES];
+		for (unsigned int type = 0; type < NUM_SAMPLER_TYPES; ++type)
+		{
+			const Convergence& result = results[type] = measure(type, integrands[i]);
+			log << "    " << std::left << std::setw(10) << SAMPLER_NAMES[type] << std::right;
+			for (size_t s = 0; s < result.spp.size(); s += 2)
+				log << " " << result.spp[s] << " spp " << result.rmse[s] << ",";
+			log << " slope " << result.slope << ", 3x3 filtered " << result.filteredRatio << " of the RMSE at " << FILTER_SPP
+				<< " spp" << (result.biased ? ", BIASED" : "") << std::endl;
+			if (result.biased)
+				++failures;
+			// At every spp the log reports, OptaGen renders the inputs at 4 spp by default. One sample has the variance of
+			// random for any sampler.
+			for (size_t s = 0; type != SAMPLER_RANDOM && s < result.spp.size(); s += 2)
+			{
+				if (result.spp[s] > 1 && result.rmse[s] >= results[SAMPLER_RANDOM].rmse[s])
+				{
+					log << "    " << SAMPLER_NAMES[type] << " is not below the random RMSE at " << result.spp[s] << " spp" << std::endl;
+					++failures;
+				}
+			}
+		}
+		if (results[SAMPLER_BLUE_NOISE].filteredRatio >= results[SAMPLER_SOBOL].filteredRatio)
+		{
+			log << "    the blue noise error is not of higher frequency than the Sobol error" << std::endl;
+			++failures;
+		}
+	}
+
+	log << "[Sampler] sobol" << std::endl;
+	if (!checkStratification(log))
+		++failures;
+
+	log.flags(flags);
+	log.precision(precision);
+	return failures;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#ifndef SAMPLER_CHECK_H
+#define SAMPLER_CHECK_H
+
+#include <ostream>
+
+/*
+	Host checks of the samplers of sampler.h on integrands with known integrals, one estimate per pixel of a small
+	image with the Sampler of that pixel, as the renderer uses them:
+	- convergence: RMSE over the pixels for 1 to 256 frames and the slope of log RMSE against log spp (-0.5 for
+	  independent samples); Sobol and blue noise have to beat the LCG at 256 spp and the mean error of the pixels has
+	  to be zero (except for blue noise, its pixels share one sequence),
+	- stratification: 256 frames of the first two Sobol dimensions are a (0, 8, 2)-net in every pixel,
+	- blue noise: a 3x3 box filter removes more of the blue noise error than of the Sobol error.
+	Returns the number of failed checks and logs every result.
+*/
+int checkSamplers(std::ostream& log);
+
+#endif
@@ -0,0 +1,611 @@
+#include "SceneBundle.h"
+#include "sceneLoader.h"
+#include "SceneProbe.h"
+
+#include <Mesh.h>
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+
+#if defined( _WIN32 )
+#  define WIN32_LEAN_AND_MEAN
+#  define NOMINMAX
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+using namespace optix;
+
+static const char     kBundleMagic[8] = { 'O', 'P', 'T', 'A', 'S', 'C', 'N', '\0' };
+static const uint32_t kBundleVersion = 4;
+static const uint64_t kPageSize = 4096;
+
+/*
+	Layout: header, scene description, one record per mesh file, then the page aligned mesh arrays.
+*/
+struct BundleHeader
+{
+	char     magic[8];				/* zero until the bundle is complete */
+	uint32_t version;
+	uint32_t numMeshes;				/* mesh files, not placements */
+	uint64_t sceneHash;				/* of the .scene text */
+	uint64_t descriptionOffset;
+	uint64_t descriptionSize;
+	uint64_t recordsOffset;
+	uint64_t fileSize;
+};
+
+struct BundleMeshRecord
+{
+	uint64_t sourceHash;			/* of the mesh file */
+	uint64_t sourceSize;			/* size and modification time of the mesh file, it is only hashed again if they differ */
+	int64_t  sourceTime;
+	int32_t  numVertices;
+	int32_t  numTriangles;
+	float    bboxMin[3];
+	float    bboxMax[3];
+	uint64_t positionsOffset;
+	uint64_t normalsOffset;			/* 0 if the mesh has no normals */
+	uint64_t texcoordsOffset;		/* 0 if the mesh has no texcoords */
+	uint64_t indicesOffset;
+};
+
+
+static inline uint64_t alignUp(uint64_t offset, uint64_t alignment)
+{
+	return (offset + alignment - 1) / alignment * alignment;
+}
+
+
+template <typename T>
+static void putValue(std::string& buffer, const T& value)
+{
+	buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+
+static void putString(std::string& buffer, const std::string& value)
+{
+	putValue(buffer, static_cast<uint32_t>(value.size()));
+	buffer.append(value);
+}
+
+
+// Only for the parameter structs that are copied to the device as they are.
+template <typename T>
+static void putArray(std::string& buffer, const std::vector<T>& values)
+{
+	putValue(buffer, static_cast<uint32_t>(values.size()));
+	if (!values.empty())
+		buffer.append(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+}
+
+
+/*
+	Reads the scene description back. Every read is bounds checked, a short description leaves ok() false.
+*/
+class DescriptionReader
+{
+public:
+	DescriptionReader(const char* data, size_t size)
+		: m_cur(data), m_end(data + size), m_ok(true)
+	{
+	}
+
+	bool ok() const
+	{
+		return m_ok;
+	}
+
+	bool read(void* value, size_t size)
+	{
+		if (!m_ok || static_cast<size_t>(m_end - m_cur) < size)
+		{
+			m_ok = false;
+			return false;
+		}
+		memcpy(value, m_cur, size);
+		m_cur += size;
+		return true;
+	}
+
+	template <typename T>
+	void getValue(T& value)
+	{
+		read(&value, sizeof(T));
+	}
+
+	void getString(std::string& value)
+	{
+		uint32_t size = 0;
+		getValue(size);
+		if (m_ok && static_cast<size_t>(m_end - m_cur) >= size)
+		{
+			value.assign(m_cur, size);
+			m_cur += size;
+		}
+		else
+			m_ok = false;
+	}
+
+	template <typename T>
+	void getArray(std::vector<T>& values)
+	{
+		uint32_t size = 0;
+		getValue(size);
+		if (!m_ok || static_cast<size_t>(m_end - m_cur) / sizeof(T) < size)
+		{
+			m_ok = false;
+			return;
+		}
+		values.resize(size);
+		read(values.data(), size * sizeof(T));
+	}
+
+private:
+	const char* m_cur;
+	const char* m_end;
+	bool        m_ok;
+};
+
+
+static bool hashFile(const std::string& filename, uint64_t& hash)
+{
+	std::ifstream in(filename, std::ios::binary);
+	if (!in)
+		return false;
+
+	std::vector<char> chunk(1 << 20);
+	hash = hashBytes(NULL, 0);
+	while (in)
+	{
+		in.read(chunk.data(), chunk.size());
+		hash = hashBytes(chunk.data(), static_cast<size_t>(in.gcount()), hash);
+	}
+	return true;
+}
+
+
+// Size and last write time of the file, the time in platform units.
+static bool statFile(const std::string& filename, uint64_t& size, int64_t& time)
+{
+#if defined( _WIN32 )
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if (!GetFileAttributesExA(filename.c_str(), GetFileExInfoStandard, &data))
+		return false;
+	size = (static_cast<uint64_t>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+	time = static_cast<int64_t>((static_cast<uint64_t>(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime);
+#else
+	struct stat st;
+	if (stat(filename.c_str(), &st) != 0)
+		return false;
+	size = static_cast<uint64_t>(st.st_size);
+	time = static_cast<int64_t>(st.st_mtime);
+#endif
+	return true;
+}
+
+
+// Pads the file to the next page and appends the array, returns its offset.
+static uint64_t writeArray(std::ofstream& out, uint64_t& offset, const void* data, size_t size)
+{
+	static const char zeros[kPageSize] = { 0 };
+
+	const uint64_t start = alignUp(offset, kPageSize);
+	out.write(zeros, static_cast<std::streamsize>(start - offset));
+	out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+	offset = start + size;
+	return start;
+}
+
+
+SceneBundle::SceneBundle()
+	: m_data(NULL)
+	, m_size(0)
+	, m_file(NULL)
+	, m_mapping(NULL)
+{
+}
+
+
+SceneBundle::~SceneBundle()
+{
+	unmap();
+}
+
+
+bool SceneBundle::write(const std::string& filename, const Scene& scene, unsigned int meshFlags)
+{
+	std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+	if (!out)
+		return false;
+
+	// Scene description. Mesh files are stored relative to the scene directory.
+	std::string description;
+
+	const Properties& prop = scene.properties;
+	putValue(description, prop.width);
+	putValue(description, prop.height);
+	putValue(description, prop.vfov);
+	putValue(description, prop.max_depth);
+	putValue(description, static_cast<uint8_t>(prop.init_eye));
+	putValue(description, static_cast<uint8_t>(prop.init_lookat));
+	putValue(description, static_cast<uint8_t>(prop.init_up));
+	putValue(description, prop.camera_eye);
+	putValue(description, prop.camera_lookat);
+	putValue(description, prop.camera_up);
+	putString(description, prop.envmap_fn);
+
+	putArray(description, scene.materials);
+	putArray(description, scene.lights);
+	putArray(description, scene.cameras);
+
+	putValue(description, static_cast<uint32_t>(scene.texture_map.size()));
+	for (std::map<int, std::string>::const_iterator it = scene.texture_map.begin(); it != scene.texture_map.end(); ++it)
+	{
+		putValue(description, static_cast<int32_t>(it->first));
+		putString(description, it->second);
+	}
+
+	putValue(description, static_cast<uint32_t>(scene.geometry_names.size()));
+	for (size_t i = 0; i < scene.geometry_names.size(); ++i)
+	{
+		const std::string& name = scene.geometry_names[i];
+		putString(description, name.compare(0, scene.dir.size(), scene.dir) == 0 ? name.substr(scene.dir.size()) : name);
+	}
+
+	putValue(description, static_cast<uint32_t>(scene.mesh_geometry.size()));
+	for (size_t i = 0; i < scene.mesh_geometry.size(); ++i)
+	{
+		putValue(description, static_cast<int32_t>(scene.mesh_geometry[i]));
+		putValue(description, scene.transforms[i]);
+	}
+
+	BundleHeader header;
+	memset(&header, 0, sizeof(header));
+	header.version = kBundleVersion;
+	header.numMeshes = static_cast<uint32_t>(scene.geometry_names.size());
+	header.sceneHash = scene.source_hash;
+	header.descriptionOffset = sizeof(BundleHeader);
+	header.descriptionSize = description.size();
+	header.recordsOffset = alignUp(header.descriptionOffset + header.descriptionSize, 8);
+
+	std::vector<BundleMeshRecord> records(header.numMeshes);
+	memset(records.data(), 0, records.size() * sizeof(BundleMeshRecord));
+
+	// The header is written without magic first, so an interrupted write leaves an invalid bundle.
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	out.write(description.data(), description.size());
+	out.write("\0\0\0\0\0\0\0", static_cast<std::streamsize>(header.recordsOffset - header.descriptionOffset - header.descriptionSize));
+	out.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(BundleMeshRecord));
+
+	uint64_t offset = header.recordsOffset + records.size() * sizeof(BundleMeshRecord);
+
+	for (size_t i = 0; i < scene.geometry_names.size(); ++i)
+	{
+		const std::string& name = scene.geometry_names[i];
+		BundleMeshRecord& record = records[i];
+
+		if (!statFile(name, record.sourceSize, record.sourceTime) || !hashFile(name, record.sourceHash))
+			throw std::runtime_error("Couldn't open " + name + " for reading.");
+
+		HostMesh mesh(name, 0, meshFlags);
+		record.numVertices = mesh.num_vertices;
+		record.numTriangles = mesh.num_triangles;
+		memcpy(record.bboxMin, mesh.bbox_min, sizeof(record.bboxMin));
+		memcpy(record.bboxMax, mesh.bbox_max, sizeof(record.bboxMax));
+
+		record.positionsOffset = writeArray(out, offset, mesh.positions, mesh.num_vertices * sizeof(float3));
+		if (mesh.has_normals)
+			record.normalsOffset = writeArray(out, offset, mesh.normals, mesh.num_vertices * sizeof(float3));
+		if (mesh.has_texcoords)
+			record.texcoordsOffset = writeArray(out, offset, mesh.texcoords, mesh.num_vertices * sizeof(float2));
+		record.indicesOffset = writeArray(out, offset, mesh.tri_indices, mesh.num_triangles * sizeof(int3));
+
+		std::cerr << name << ": " << mesh.num_triangles << std::endl;
+	}
+
+	header.fileSize = offset;
+	memcpy(header.magic, kBundleMagic, sizeof(header.magic));
+
+	out.seekp(static_cast<std::streamoff>(header.recordsOffset));
+	out.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(BundleMeshRecord));
+	out.seekp(0);
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	return out.good();
+}
+
+
+bool SceneBundle::load(const std::string& filename, uint64_t sceneHash, Scene& scene)
+{
+	unmap();
+	m_meshes.clear();
+
+	if (!map(filename))
+		return false;
+
+	BundleHeader header;
+	if (m_size < sizeof(header))
+	{
+		unmap();
+		return false;
+	}
+	memcpy(&header, m_data, sizeof(header));
+
+	if (memcmp(header.magic, kBundleMagic, sizeof(header.magic)) != 0 || header.version != kBundleVersion ||
+		header.fileSize != m_size ||
+		header.descriptionOffset + header.descriptionSize > m_size ||
+		header.recordsOffset + static_cast<uint64_t>(header.numMeshes) * sizeof(BundleMeshRecord) > m_size)
+	{
+		std::cerr << filename << " is not a scene bundle of version " << kBundleVersion << ", ignored" << std::endl;
+		unmap();
+		return false;
+	}
+
+	if (header.sceneHash != sceneHash)
+	{
+		std::cerr << filename << " is out of date (the scene file changed), ignored" << std::endl;
+		unmap();
+		return false;
+	}
+
+	Properties prop;
+	std::vector<MaterialParameter> materials;
+	std::vector<LightParameter> lights;
+	std::vector<CameraParams> cameras;
+	std::map<int, std::string> texture_map;
+	std::vector<std::string> geometry_names;
+	std::vector<int> mesh_geometry;
+	std::vector<std::string> mesh_names;
+	std::vector<Matrix4x4> transforms;
+
+	DescriptionReader reader(m_data + header.descriptionOffset, static_cast<size_t>(header.descriptionSize));
+
+	uint8_t init_eye = 0, init_lookat = 0, init_up = 0;
+	reader.getValue(prop.width);
+	reader.getValue(prop.height);
+	reader.getValue(prop.vfov);
+	reader.getValue(prop.max_depth);
+	reader.getValue(init_eye);
+	reader.getValue(init_lookat);
+	reader.getValue(init_up);
+	reader.getValue(prop.camera_eye);
+	reader.getValue(prop.camera_lookat);
+	reader.getValue(prop.camera_up);
+	reader.getString(prop.envmap_fn);
+	prop.init_eye = init_eye != 0;
+	prop.init_lookat = init_lookat != 0;
+	prop.init_up = init_up != 0;
+
+	reader.getArray(materials);
+	reader.getArray(lights);
+	reader.getArray(cameras);
+
+	uint32_t numTextures = 0;
+	reader.getValue(numTextures);
+	for (uint32_t i = 0; i < numTextures && reader.ok(); ++i)
+	{
+		int32_t id = 0;
+		reader.getValue(id);
+		reader.getString(texture_map[id]);
+	}
+
+	uint32_t numGeometries = 0;
+	reader.getValue(numGeometries);
+	for (uint32_t i = 0; i < numGeometries && reader.ok(); ++i)
+	{
+		std::string name;
+		reader.getString(name);
+		geometry_names.push_back(scene.dir + name);
+	}
+
+	uint32_t numMeshes = 0;
+	reader.getValue(numMeshes);
+	for (uint32_t i = 0; i < numMeshes && reader.ok(); ++i)
+	{
+		int32_t geometry = -1;
+		Matrix4x4 transform;
+		reader.getValue(geometry);
+		reader.getValue(transform);
+		if (geometry < 0 || geometry >= static_cast<int32_t>(numGeometries))
+			break;
+		mesh_geometry.push_back(geometry);
+		mesh_names.push_back(geometry_names[geometry]);
+		transforms.push_back(transform);
+	}
+
+	if (!reader.ok() || numGeometries != header.numMeshes || mesh_geometry.size() != numMeshes)
+	{
+		std::cerr << filename << " has a broken scene description, ignored" << std::endl;
+		unmap();
+		return false;
+	}
+
+	const BundleMeshRecord* records = reinterpret_cast<const BundleMeshRecord*>(m_data + header.recordsOffset);
+
+	for (uint32_t i = 0; i < numGeometries; ++i)
+	{
+		const BundleMeshRecord& record = records[i];
+		const std::string& name = geometry_names[i];
+
+		// Hashing every mesh would read the whole scene on each start, unchanged size and time are trusted.
+		uint64_t sourceSize = 0, sourceHash = 0;
+		int64_t sourceTime = 0;
+		const bool stamped = statFile(name, sourceSize, sourceTime);
+		const bool unchanged = stamped && sourceSize == record.sourceSize && sourceTime == record.sourceTime;
+		if (!stamped || (!unchanged && (!hashFile(name, sourceHash) || sourceHash != record.sourceHash)))
+		{
+			std::cerr << filename << " is out of date (" << name << " changed), ignored" << std::endl;
+			unmap();
+			m_meshes.clear();
+			return false;
+		}
+
+		const uint64_t vertices = static_cast<uint64_t>(record.numVertices);
+		const uint64_t triangles = static_cast<uint64_t>(record.numTriangles);
+		if (record.numVertices < 0 || record.numTriangles < 0 ||
+			record.positionsOffset + vertices * sizeof(float3) > m_size ||
+			record.normalsOffset + vertices * sizeof(float3) > m_size ||
+			record.texcoordsOffset + vertices * sizeof(float2) > m_size ||
+			record.indicesOffset + triangles * sizeof(int3) > m_size)
+		{
+			std::cerr << filename << " has a broken mesh record, ignored" << std::endl;
+			unmap();
+			m_meshes.clear();
+			return false;
+		}
+
+		MeshView mesh;
+		mesh.num_vertices = record.numVertices;
+		mesh.num_triangles = record.numTriangles;
+		mesh.positions = reinterpret_cast<const float3*>(m_data + record.positionsOffset);
+		mesh.normals = record.normalsOffset ? reinterpret_cast<const float3*>(m_data + record.normalsOffset) : NULL;
+		mesh.texcoords = record.texcoordsOffset ? reinterpret_cast<const float2*>(m_data + record.texcoordsOffset) : NULL;
+		mesh.indices = reinterpret_cast<const int3*>(m_data + record.indicesOffset);
+		mesh.bbox_min = make_float3(record.bboxMin[0], record.bboxMin[1], record.bboxMin[2]);
+		mesh.bbox_max = make_float3(record.bboxMax[0], record.bboxMax[1], record.bboxMax[2]);
+		m_meshes.push_back(mesh);
+	}
+
+	scene.properties = prop;
+	scene.materials.swap(materials);
+	scene.lights.swap(lights);
+	scene.cameras.swap(cameras);
+	scene.texture_map.swap(texture_map);
+	scene.geometry_names.swap(geometry_names);
+	scene.mesh_geometry.swap(mesh_geometry);
+	scene.mesh_names.swap(mesh_names);
+	scene.transforms.swap(transforms);
+
+	return true;
+}
+
+
+const std::vector<MeshView>& SceneBundle::getMeshes() const
+{
+	return m_meshes;
+}
+
+
+bool SceneBundle::map(const std::string& filename)
+{
+#if defined( _WIN32 )
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	const void* data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+	if (!data)
+	{
+		if (mapping)
+			CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	m_file = file;
+	m_mapping = mapping;
+	m_data = static_cast<const char*>(data);
+	m_size = static_cast<size_t>(size.QuadPart);
+#else
+	const int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	void* data = mmap(NULL, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return false;
+
+	m_data = static_cast<const char*>(data);
+	m_size = static_cast<size_t>(st.st_size);
+#endif
+	return true;
+}
+
+
+void SceneBundle::unmap()
+{
+	if (!m_data)
+		return;
+
+#if defined( _WIN32 )
+	UnmapViewOfFile(m_data);
+	CloseHandle(static_cast<HANDLE>(m_mapping));
+	CloseHandle(static_cast<HANDLE>(m_file));
+#else
+	munmap(const_cast<char*>(m_data), m_size);
+#endif
+
+	m_data = NULL;
+	m_size = 0;
+	m_file = NULL;
+	m_mapping = NULL;
+}
+
+
+MeshView makeMeshView(const Mesh& mesh)
+{
+	MeshView view;
+	view.num_vertices = mesh.num_vertices;
+	view.num_triangles = mesh.num_triangles;
+	view.positions = reinterpret_cast<const float3*>(mesh.positions);
+	view.normals = mesh.has_normals ? reinterpret_cast<const float3*>(mesh.normals) : NULL;
+	view.texcoords = mesh.has_texcoords ? reinterpret_cast<const float2*>(mesh.texcoords) : NULL;
+	view.indices = reinterpret_cast<const int3*>(mesh.tri_indices);
+	view.bbox_min = make_float3(mesh.bbox_min[0], mesh.bbox_min[1], mesh.bbox_min[2]);
+	view.bbox_max = make_float3(mesh.bbox_max[0], mesh.bbox_max[1], mesh.bbox_max[2]);
+	return view;
+}
+
+
+void transformPositions(const float3* positions, int count, const Matrix4x4& transform, float3* result)
+{
+	for (int i = 0; i < count; ++i)
+		result[i] = make_float3(transform * make_float4(positions[i], 1.0f));
+}
+
+
+void transformNormals(const float3* normals, int count, const Matrix4x4& transform, float3* result)
+{
+	const Matrix4x4 normalTransform = transform.inverse().transpose();
+	for (int i = 0; i < count; ++i)
+		result[i] = make_float3(normalTransform * make_float4(normals[i], 1.0f));
+}
+
+
+Aabb transformBounds(const float3& bboxMin, const float3& bboxMax, const Matrix4x4& transform)
+{
+	Aabb aabb;
+	for (int corner = 0; corner < 8; ++corner)
+	{
+		const float3 p = make_float3(
+			(corner & 1) ? bboxMax.x : bboxMin.x,
+			(corner & 2) ? bboxMax.y : bboxMin.y,
+			(corner & 4) ? bboxMax.z : bboxMin.z);
+		aabb.include(make_float3(transform * make_float4(p, 1.0f)));
+	}
+	return aabb;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#ifndef SCENE_BUNDLE_H
+#define SCENE_BUNDLE_H
+
+#include <optixu/optixu_math_namespace.h>
+#include <optixu/optixu_aabb_namespace.h>
+#include <optixu/optixu_matrix_namespace.h>
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct Mesh;
+struct Scene;
+
+/*
+	Read-only view of the arrays of one mesh file in object space, either inside a mapped bundle or of a loaded HostMesh.
+	Scenes place the same mesh several times, see Scene::mesh_geometry.
+*/
+struct MeshView
+{
+	int32_t              num_vertices;
+	int32_t              num_triangles;
+	const optix::float3* positions;
+	const optix::float3* normals;		/* NULL if the mesh has no normals */
+	const optix::float2* texcoords;		/* NULL if the mesh has no texcoords */
+	const optix::int3*   indices;
+	optix::float3        bbox_min;
+	optix::float3        bbox_max;
+};
+
+/*
+	Compiled .scene file: the scene description and every mesh file loaded once, in one versioned binary file.
+	Mesh arrays start on page boundaries, so they are uploaded straight from the memory mapped file.
+	The bundle is keyed by hashes of the .scene text and of every mesh file, load() refuses stale bundles. A mesh file is
+	only hashed again when its size or modification time differs from the bundled one.
+*/
+class SceneBundle
+{
+public:
+	SceneBundle();
+	~SceneBundle();
+
+	static bool write(const std::string& filename, const Scene& scene, unsigned int meshFlags);	/* loads every mesh file of the parsed scene with these MeshLoaderFlags */
+	bool load(const std::string& filename, uint64_t sceneHash, Scene& scene);	/* false if missing, broken or stale */
+
+	const std::vector<MeshView>& getMeshes() const;		/* one per Scene::geometry_names */
+
+private:
+	SceneBundle(const SceneBundle&);
+	SceneBundle& operator=(const SceneBundle&);
+
+	bool map(const std::string& filename);
+	void unmap();
+
+private:
+	const char*             m_data;
+	size_t                  m_size;
+	void*                   m_file;		/* platform handles of the mapping */
+	void*                   m_mapping;
+	std::vector<MeshView>   m_meshes;
+};
+
+MeshView makeMeshView(const Mesh& mesh);
+
+// Same as the load transform of the sutil mesh loader, normals use the inverse transpose and are not normalized.
+void transformPositions(const optix::float3* positions, int count, const optix::Matrix4x4& transform, optix::float3* result);
+void transformNormals(const optix::float3* normals, int count, const optix::Matrix4x4& transform, optix::float3* result);
+optix::Aabb transformBounds(const optix::float3& bboxMin, const optix::float3& bboxMax, const optix::Matrix4x4& transform);
+
+#endif
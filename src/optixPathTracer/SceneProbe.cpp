@@ -0,0 +1,359 @@
+#include "SceneProbe.h"
+#include "AliasTable.h"
+
+#include <sutil.h>
+
+#include "random.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+using namespace optix;
+
+#ifndef M_PI
+#define M_PI  3.14159265358979323846264338327950288419716939937510
+#endif
+
+
+// Fibonacci lattice over the sphere, i in [0, n).
+static inline float3 sphereDirection(int i, int n)
+{
+	const float goldenAngle = static_cast<float>(M_PI) * (3.0f - sqrtf(5.0f));
+	const float z = 1.0f - (2.0f * i + 1.0f) / n;
+	const float r = sqrtf(fmaxf(0.0f, 1.0f - z * z));
+	const float phi = goldenAngle * i;
+	return make_float3(r * cosf(phi), r * sinf(phi), z);
+}
+
+
+SceneProbe::SceneProbe()
+	: m_sceneDiagonal(0.0f)
+	, m_geometryHash(0)
+{
+}
+
+
+void SceneProbe::createGeometry(const std::vector<MeshView>& meshes, const std::vector<int>& meshGeometry,
+	const std::vector<Matrix4x4>& transforms, unsigned int numThreads)
+{
+	std::vector<float3> vertices;
+	std::vector<int3> indices;
+	std::vector<int> triangleMeshes;
+
+	for (size_t i = 0; i < meshGeometry.size(); ++i)
+	{
+		const MeshView& mesh = meshes[meshGeometry[i]];
+
+		const int base = static_cast<int>(vertices.size());
+		vertices.resize(base + mesh.num_vertices);
+		transformPositions(mesh.positions, mesh.num_vertices, transforms[i], &vertices[base]);
+
+		for (int tri = 0; tri < mesh.num_triangles; ++tri)
+		{
+			const int3& index = mesh.indices[tri];
+			indices.push_back(make_int3(base + index.x, base + index.y, base + index.z));
+			triangleMeshes.push_back(static_cast<int>(i));
+		}
+	}
+
+	createGeometry(vertices, indices, triangleMeshes, numThreads);
+}
+
+
+void SceneProbe::createGeometry(const std::vector<float3>& vertices, const std::vector<int3>& indices,
+	const std::vector<int>& triangleMeshes, unsigned int numThreads)
+{
+	m_vertices = vertices;
+	m_indices = indices;
+	m_triangleMeshes = triangleMeshes;
+
+	const double startTime = sutil::currentTime();
+	m_bvh.build(m_vertices.data(), m_indices.data(), static_cast<unsigned int>(m_indices.size()), numThreads);
+	m_sceneDiagonal = m_bvh.getBounds().valid() ? length(m_bvh.getBounds().extent()) : 0.0f;
+	m_geometryHash = hashBytes(m_vertices.data(), m_vertices.size() * sizeof(float3));
+	m_geometryHash = hashBytes(m_indices.data(), m_indices.size() * sizeof(int3), m_geometryHash);
+
+	setSurfaceWeights(std::vector<float>());
+
+	std::cerr << "Scene probe: " << m_bvh.getNumTriangles() << " triangles, " << sutil::currentTime() - startTime << "s" << std::endl;
+}
+
+
+bool SceneProbe::empty() const
+{
+	return m_bvh.getNumTriangles() == 0;
+}
+
+
+const Aabb& SceneProbe::getBounds() const
+{
+	return m_bvh.getBounds();
+}
+
+
+float SceneProbe::getSceneDiagonal() const
+{
+	return m_sceneDiagonal;
+}
+
+
+uint64_t SceneProbe::getGeometryHash() const
+{
+	return m_geometryHash;
+}
+
+
+const std::vector<float3>& SceneProbe::getVertices() const
+{
+	return m_vertices;
+}
+
+
+const std::vector<int3>& SceneProbe::getIndices() const
+{
+	return m_indices;
+}
+
+
+bool SceneProbe::isBackface(const BvhHit& hit, const float3& direction) const
+{
+	const int3 tri = m_indices[hit.prim];
+	const float3 p0 = m_vertices[tri.x];
+	const float3 n = cross(m_vertices[tri.y] - p0, m_vertices[tri.z] - p0);
+	return dot(n, direction) > 0.0f;
+}
+
+
+CameraRejection SceneProbe::checkCamera(const float3& eye, const float3& lookat, const float3& up,
+	float vfov, float aspectRatio, const CameraCheckParams& params) const
+{
+	if (empty())
+		return CAMERA_ACCEPTED;
+
+	const float epsilon = 1e-4f * m_sceneDiagonal;
+	const float minClearance = params.minClearance * m_sceneDiagonal;
+
+	// Probe rays over the whole sphere for enclosure and clearance.
+	int hits = 0, backfaces = 0;
+	float farthest = 0.0f;
+	for (int i = 0; i < params.numProbeRays; ++i)
+	{
+		const float3 direction = sphereDirection(i, params.numProbeRays);
+
+		BvhHit hit;
+		if (!m_bvh.intersect(eye, direction, epsilon, RT_DEFAULT_MAX, hit))
+			continue;
+
+		if (hit.t < minClearance)
+			return CAMERA_CLEARANCE;
+
+		++hits;
+		farthest = fmaxf(farthest, hit.t);
+		if (isBackface(hit, direction))
+			++backfaces;
+	}
+
+	// The back face test needs consistently wound meshes, the pocket test does not.
+	if (hits > 0 && backfaces > params.maxBackfaceRatio * hits)
+		return CAMERA_ENCLOSED;
+	if (hits == params.numProbeRays && farthest < params.minPocketSize * m_sceneDiagonal)
+		return CAMERA_ENCLOSED;
+
+	// The lookat itself may lie on a surface, so the segment stops just short of it.
+	const float3 toLookat = lookat - eye;
+	const float distance = length(toLookat);
+	if (distance <= epsilon)
+		return CAMERA_LOOKAT_HIDDEN;
+	if (m_bvh.occluded(eye, toLookat / distance, epsilon, distance * 0.999f - epsilon))
+		return CAMERA_LOOKAT_HIDDEN;
+
+	// Same ray generation as pinhole_camera at the pixel centres of a coarse grid.
+	float3 U, V, W;
+	sutil::calculateCameraVariables(eye, lookat, up, vfov, aspectRatio, U, V, W, true);
+
+	int covered = 0;
+	for (int j = 0; j < params.frustumRes; ++j)
+	{
+		for (int i = 0; i < params.frustumRes; ++i)
+		{
+			const float2 d = make_float2((i + 0.5f) / params.frustumRes, (j + 0.5f) / params.frustumRes) * 2.f - 1.f;
+			const float3 direction = normalize(d.x * U + d.y * V + W);
+			if (m_bvh.occluded(eye, direction, epsilon, RT_DEFAULT_MAX))
+				++covered;
+		}
+	}
+
+	if (covered < params.minCoverage * params.frustumRes * params.frustumRes)
+		return CAMERA_COVERAGE;
+
+	return CAMERA_ACCEPTED;
+}
+
+
+Aabb SceneProbe::computeRobustBounds(float percentile, unsigned int numSamples) const
+{
+	if (empty() || numSamples == 0)
+		return m_bvh.getBounds();
+
+	std::vector<float> areas(m_indices.size());
+	for (size_t i = 0; i < m_indices.size(); ++i)
+	{
+		const float3 p0 = m_vertices[m_indices[i].x];
+		const float area = 0.5f * length(cross(m_vertices[m_indices[i].y] - p0, m_vertices[m_indices[i].z] - p0));
+		areas[i] = std::isfinite(area) ? area : 0.0f;
+	}
+
+	std::vector<float> sorted(areas);
+	std::nth_element(sorted.begin(), sorted.begin() + sorted.size() * 95 / 100, sorted.end());
+	const float maxArea = sorted[sorted.size() * 95 / 100];
+
+	// The alias table sums in double, a float CDF stops growing on millions of small triangles.
+	for (size_t i = 0; i < areas.size(); ++i)
+		areas[i] = fminf(areas[i], maxArea);
+	AliasTable table;
+	if (!table.build(areas))
+		return m_bvh.getBounds();
+
+	// Fixed seed, so the bounds of a scene are reproducible and can be cached.
+	std::vector<float> samples[3];
+	for (int axis = 0; axis < 3; ++axis)
+		samples[axis].resize(numSamples);
+
+	unsigned int seed = tea<16>(numSamples, 0);
+	for (unsigned int s = 0; s < numSamples; ++s)
+	{
+		const float uBin = rnd(seed);
+		const float uCoin = rnd(seed);
+		const unsigned int tri = table.sample(uBin, uCoin);
+		float u = rnd(seed), v = rnd(seed);
+		if (u + v > 1.0f)
+		{
+			u = 1.0f - u;
+			v = 1.0f - v;
+		}
+
+		const float3 p0 = m_vertices[m_indices[tri].x];
+		const float3 p = p0 + u * (m_vertices[m_indices[tri].y] - p0) + v * (m_vertices[m_indices[tri].z] - p0);
+		samples[0][s] = p.x;
+		samples[1][s] = p.y;
+		samples[2][s] = p.z;
+	}
+
+	float lo[3], hi[3];
+	const size_t loIndex = static_cast<size_t>(percentile * (numSamples - 1));
+	const size_t hiIndex = static_cast<size_t>((1.0f - percentile) * (numSamples - 1));
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		std::vector<float>& values = samples[axis];
+		std::nth_element(values.begin(), values.begin() + loIndex, values.end());
+		lo[axis] = values[loIndex];
+		std::nth_element(values.begin(), values.begin() + hiIndex, values.end());
+		hi[axis] = values[hiIndex];
+	}
+
+	return Aabb(make_float3(lo[0], lo[1], lo[2]), make_float3(hi[0], hi[1], hi[2]));
+}
+
+
+float SceneProbe::getEnclosure(const float3& p, int numRays) const
+{
+	if (empty() || numRays <= 0)
+		return 0.0f;
+
+	const float epsilon = 1e-4f * m_sceneDiagonal;
+	int hits = 0;
+	for (int i = 0; i < numRays; ++i)
+	{
+		if (m_bvh.occluded(p, sphereDirection(i, numRays), epsilon, RT_DEFAULT_MAX))
+			++hits;
+	}
+
+	return static_cast<float>(hits) / numRays;
+}
+
+
+bool SceneProbe::isIndoor(const Aabb& bounds, float minEnclosure) const
+{
+	// Rooms enclose most points inside their bounds, objects on a ground plane leave the upper hemisphere open.
+	const float3 center = bounds.center();
+	const float3 offset = 0.25f * bounds.extent();
+	const float3 points[7] = {
+		center,
+		center - make_float3(offset.x, 0.0f, 0.0f), center + make_float3(offset.x, 0.0f, 0.0f),
+		center - make_float3(0.0f, offset.y, 0.0f), center + make_float3(0.0f, offset.y, 0.0f),
+		center - make_float3(0.0f, 0.0f, offset.z), center + make_float3(0.0f, 0.0f, offset.z)
+	};
+
+	float enclosure = 0.0f;
+	for (int i = 0; i < 7; ++i)
+		enclosure += getEnclosure(points[i]);
+
+	return enclosure / 7.0f >= minEnclosure;
+}
+
+
+void SceneProbe::setSurfaceWeights(const std::vector<float>& meshWeights)
+{
+	std::vector<float> weights(m_indices.size());
+	for (size_t i = 0; i < m_indices.size(); ++i)
+	{
+		const float3 p0 = m_vertices[m_indices[i].x];
+		const float area = 0.5f * length(cross(m_vertices[m_indices[i].y] - p0, m_vertices[m_indices[i].z] - p0));
+		const int mesh = m_triangleMeshes[i];
+		const float factor = mesh < static_cast<int>(meshWeights.size()) ? meshWeights[mesh] : 1.0f;
+		weights[i] = std::isfinite(area) ? area * factor : 0.0f;
+	}
+
+	m_surfaceTable.build(weights);
+}
+
+
+bool SceneProbe::sampleSurface(float r0, float r1, float r2, float r3, float3& p) const
+{
+	if (m_surfaceTable.empty())
+		return false;
+
+	const int3 tri = m_indices[m_surfaceTable.sample(r0, r1)];
+	if (r2 + r3 > 1.0f)
+	{
+		r2 = 1.0f - r2;
+		r3 = 1.0f - r3;
+	}
+
+	const float3 p0 = m_vertices[tri.x];
+	p = p0 + r2 * (m_vertices[tri.y] - p0) + r3 * (m_vertices[tri.z] - p0);
+	return true;
+}
+
+
+const char* cameraRejectionName(CameraRejection rejection)
+{
+	switch (rejection)
+	{
+	case CAMERA_ACCEPTED:
+		return "accepted";
+	case CAMERA_ENCLOSED:
+		return "enclosed";
+	case CAMERA_CLEARANCE:
+		return "clearance";
+	case CAMERA_LOOKAT_HIDDEN:
+		return "lookat";
+	case CAMERA_COVERAGE:
+		return "coverage";
+	default:
+		return "unknown";
+	}
+}
+
+
+uint64_t hashBytes(const void* data, size_t size, uint64_t hash)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#ifndef SCENE_PROBE_H
+#define SCENE_PROBE_H
+
+#include <optixu/optixu_math_namespace.h>
+#include <optixu/optixu_aabb_namespace.h>
+#include <optixu/optixu_matrix_namespace.h>
+
+#include "AliasTable.h"
+#include "CpuBvh.h"
+#include "SceneBundle.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+enum CameraRejection
+{
+	CAMERA_ACCEPTED = 0,
+	CAMERA_ENCLOSED,		/* the eye is inside furniture or behind a wall: mostly back faces or a small closed pocket */
+	CAMERA_CLEARANCE,		/* a surface is closer than minClearance */
+	CAMERA_LOOKAT_HIDDEN,	/* the segment from the eye to the lookat is blocked */
+	CAMERA_COVERAGE,		/* too few frustum rays hit geometry */
+	NUM_CAMERA_REJECTIONS
+};
+
+struct CameraCheckParams
+{
+	float minClearance;		/* relative to the scene diagonal */
+	float maxBackfaceRatio;	/* of the probe rays that hit something */
+	float minPocketSize;	/* relative to the scene diagonal; closed pockets smaller than this count as enclosed */
+	float minCoverage;		/* fraction of the frustum rays that hit geometry */
+	int   numProbeRays;		/* rays over the sphere around the eye */
+	int   frustumRes;		/* frustumRes x frustumRes rays through the image plane */
+
+	CameraCheckParams()
+		: minClearance(0.01f)
+		, maxBackfaceRatio(0.5f)
+		, minPocketSize(0.15f)
+		, minCoverage(0.2f)
+		, numProbeRays(64)
+		, frustumRes(8)
+	{
+	}
+};
+
+struct CameraCheckStats
+{
+	unsigned int candidates;
+	unsigned int rejected[NUM_CAMERA_REJECTIONS];
+
+	CameraCheckStats() : candidates(0)
+	{
+		for (int i = 0; i < NUM_CAMERA_REJECTIONS; ++i)
+			rejected[i] = 0;
+	}
+};
+
+/*
+	Host-side ray casting against the scene triangles, independent of the render backend.
+	Used to validate randomly placed cameras before they are handed to the renderer.
+*/
+class SceneProbe
+{
+public:
+	SceneProbe();
+
+	void createGeometry(const std::vector<MeshView>& meshes, const std::vector<int>& meshGeometry,
+		const std::vector<optix::Matrix4x4>& transforms, unsigned int numThreads = 0);	/* see CpuRenderer::createGeometry() */
+	void createGeometry(const std::vector<optix::float3>& vertices, const std::vector<optix::int3>& indices,
+		const std::vector<int>& triangleMeshes, unsigned int numThreads = 0);	/* triangleMeshes: mesh index per triangle */
+
+	bool empty() const;
+	const optix::Aabb& getBounds() const;
+	float getSceneDiagonal() const;
+	uint64_t getGeometryHash() const;	/* for keying the per-scene caches */
+	const std::vector<optix::float3>& getVertices() const;
+	const std::vector<optix::int3>& getIndices() const;
+
+	// Per-axis percentiles of area-weighted surface samples. The area of every triangle is capped at the
+	// 95th percentile of all triangle areas, so a handful of huge ground planes or skydome triangles are trimmed.
+	optix::Aabb computeRobustBounds(float percentile = 0.02f, unsigned int numSamples = 1 << 16) const;
+	float getEnclosure(const optix::float3& p, int numRays = 64) const;	/* fraction of rays that hit geometry */
+	bool isIndoor(const optix::Aabb& bounds, float minEnclosure = 0.85f) const;
+
+	// Area-weighted surface sampling with an alias table. Built with pure area weights by createGeometry().
+	void setSurfaceWeights(const std::vector<float>& meshWeights);	/* per mesh factor on the triangle areas */
+	bool sampleSurface(float r0, float r1, float r2, float r3, optix::float3& p) const;	/* r* uniform in [0, 1) */
+
+	CameraRejection checkCamera(const optix::float3& eye, const optix::float3& lookat, const optix::float3& up,
+		float vfov, float aspectRatio, const CameraCheckParams& params = CameraCheckParams()) const;
+
+private:
+	bool isBackface(const BvhHit& hit, const optix::float3& direction) const;
+
+private:
+	std::vector<optix::float3> m_vertices;
+	std::vector<optix::int3>   m_indices;
+	std::vector<int>           m_triangleMeshes;
+	AliasTable                 m_surfaceTable;
+	CpuBvh                     m_bvh;
+	float                      m_sceneDiagonal;
+	uint64_t                   m_geometryHash;
+};
+
+const char* cameraRejectionName(CameraRejection rejection);
+
+// FNV-1a, chained through hash.
+uint64_t hashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ull);
+
+#endif
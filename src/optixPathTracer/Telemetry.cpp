@@ -0,0 +1,307 @@
+#include "Telemetry.h"
+
+#include <sutil.h>
+
+#include <algorithm>
+#include <ctime>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifdef _WIN32
+#  ifndef WIN32_LEAN_AND_MEAN
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+#  include <windows.h>
+#  include <psapi.h>
+#  pragma comment(lib, "psapi.lib")
+#else
+#  include <sys/resource.h>
+#endif
+
+namespace
+{
+
+const char* const PHASE_NAMES[NUM_TELEMETRY_PHASES] = {
+	"scene_load", "mesh_load", "texture_load", "env_decode", "cdf", "randomize", "feature_launch", "reference_launch", "write"
+};
+
+
+std::string jsonString(const std::string& s)
+{
+	std::string out = "\"";
+	for (size_t i = 0; i < s.size(); ++i)
+	{
+		const unsigned char c = static_cast<unsigned char>(s[i]);
+		if (c == '"' || c == '\\')
+		{
+			out += '\\';
+			out += static_cast<char>(c);
+		}
+		else if (c < 0x20)
+		{
+			static const char HEX[] = "0123456789abcdef";
+			out += "\\u00";
+			out += HEX[c >> 4];
+			out += HEX[c & 0xf];
+		}
+		else
+			out += static_cast<char>(c);
+	}
+	return out + "\"";
+}
+
+
+// { "mesh": { "current": 0, "peak": 0 }, ..., "total": { ... } }, peaks has a total at the end.
+std::string memoryJson(const uint64_t* current, const uint64_t* peaks)
+{
+	std::ostringstream json;
+	json << "{";
+	for (int i = 0; i <= sutil::NUM_HOST_MEMORY_CATEGORIES; ++i)
+	{
+		const char* name = i < sutil::NUM_HOST_MEMORY_CATEGORIES ? sutil::hostMemoryCategoryName(static_cast<sutil::HostMemoryCategory>(i)) : "total";
+		json << (i ? ", \"" : " \"") << name << "\": { ";
+		if (current)
+			json << "\"current\": " << current[i] << ", ";
+		json << "\"peak\": " << peaks[i] << " }";
+	}
+	json << " }";
+	return json.str();
+}
+
+
+// Current sizes with the total at the end.
+void currentMemory(const sutil::HostMemoryStats& stats, uint64_t* current)
+{
+	std::copy(stats.current, stats.current + sutil::NUM_HOST_MEMORY_CATEGORIES, current);
+	current[sutil::NUM_HOST_MEMORY_CATEGORIES] = stats.current_total;
+}
+
+
+void peakMemory(const sutil::HostMemoryStats& stats, uint64_t* peaks)
+{
+	for (int i = 0; i < sutil::NUM_HOST_MEMORY_CATEGORIES; ++i)
+		peaks[i] = std::max(peaks[i], stats.peak[i]);
+	peaks[sutil::NUM_HOST_MEMORY_CATEGORIES] = std::max(peaks[sutil::NUM_HOST_MEMORY_CATEGORIES], stats.peak_total);
+}
+
+
+std::string megabytes(uint64_t bytes)
+{
+	std::ostringstream out;
+	out << bytes / (1024 * 1024) << " MB";
+	return out.str();
+}
+
+} // namespace
+
+
+Telemetry::Telemetry()
+	: m_file(nullptr), m_start(0.0), m_recordStart(0.0), m_bytes(0), m_totalBytes(0), m_patches(0), m_totalSamples(0)
+{
+	for (int i = 0; i < NUM_TELEMETRY_PHASES; ++i)
+		m_phases[i] = m_totals[i] = 0.0;
+	std::fill(m_runPeaks, m_runPeaks + sutil::NUM_HOST_MEMORY_CATEGORIES + 1, 0);
+	for (int i = 0; i < NUM_TELEMETRY_PHASES; ++i)
+		std::fill(m_phasePeaks[i], m_phasePeaks[i] + sutil::NUM_HOST_MEMORY_CATEGORIES + 1, 0);
+}
+
+
+Telemetry::~Telemetry()
+{
+	if (m_file)
+		fclose(m_file);
+}
+
+
+bool Telemetry::open(const std::string& filename, const std::string& scene)
+{
+	m_file = fopen(filename.c_str(), "a");
+	if (!m_file)
+		return false;
+
+	std::ostringstream run;
+	run << std::time(nullptr) << "-" << std::hex << std::random_device()();
+	m_run = run.str();
+	m_scene = scene;
+	m_start = m_recordStart = sutil::currentTime();
+	sutil::hostMemoryResetPeaks();
+	return true;
+}
+
+
+void Telemetry::add(TelemetryPhase phase, double seconds)
+{
+	m_phases[phase] += seconds;
+}
+
+
+void Telemetry::addBytesWritten(const std::string& filename)
+{
+	struct stat fileStat;
+	if (m_file && stat(filename.c_str(), &fileStat) == 0)
+		m_bytes += static_cast<uint64_t>(fileStat.st_size);
+}
+
+
+void Telemetry::addMemory(TelemetryPhase phase, const sutil::HostMemoryStats& stats)
+{
+	if (m_file)
+		peakMemory(stats, m_phasePeaks[phase]);
+}
+
+
+void Telemetry::endSetup()
+{
+	if (!m_file)
+		return;
+
+	const double now = sutil::currentTime();
+	writeRecord("setup", m_phases, m_bytes, now - m_recordStart, recordMemory());
+	for (int i = 0; i < NUM_TELEMETRY_PHASES; ++i)
+	{
+		m_totals[i] += m_phases[i];
+		m_phases[i] = 0.0;
+	}
+	m_totalBytes += m_bytes;
+	m_bytes = 0;
+	m_recordStart = now;
+}
+
+
+void Telemetry::endPatch(int patch, int feature_spp, int reference_spp)
+{
+	if (!m_file)
+		return;
+
+	std::ostringstream extra;
+	extra << ", \"patch\": " << patch << ", \"spp\": { \"feature\": " << feature_spp << ", \"reference\": " << reference_spp << " }"
+		<< recordMemory();
+
+	const double now = sutil::currentTime();
+	writeRecord("patch", m_phases, m_bytes, now - m_recordStart, extra.str());
+	for (int i = 0; i < NUM_TELEMETRY_PHASES; ++i)
+	{
+		m_totals[i] += m_phases[i];
+		m_phases[i] = 0.0;
+	}
+	m_totalBytes += m_bytes;
+	m_bytes = 0;
+	m_totalSamples += feature_spp + reference_spp;
+	++m_patches;
+	m_recordStart = now;
+}
+
+
+void Telemetry::close()
+{
+	if (!m_file)
+		return;
+
+	// Phases timed after the last patch still count.
+	for (int i = 0; i < NUM_TELEMETRY_PHASES; ++i)
+		m_totals[i] += m_phases[i];
+	m_totalBytes += m_bytes;
+
+	const double seconds = sutil::currentTime() - m_start;
+	std::ostringstream extra;
+	extra << ", \"patches\": " << m_patches << ", \"spp\": " << m_totalSamples
+		<< ", \"seconds_per_patch\": " << (m_patches > 0 ? seconds / m_patches : 0.0);
+
+	const sutil::HostMemoryStats stats = sutil::hostMemoryStats();
+	uint64_t current[sutil::NUM_HOST_MEMORY_CATEGORIES + 1];
+	currentMemory(stats, current);
+	peakMemory(stats, m_runPeaks);
+	extra << ", \"host_memory\": " << memoryJson(current, m_runPeaks) << ", \"phase_host_memory\": {";
+	for (int i = 0; i < NUM_TELEMETRY_PHASES; ++i)
+		extra << (i ? ", \"" : " \"") << PHASE_NAMES[i] << "\": " << memoryJson(nullptr, m_phasePeaks[i]);
+	extra << " }";
+	writeRecord("summary", m_totals, m_totalBytes, seconds, extra.str());
+
+	fclose(m_file);
+	m_file = nullptr;
+
+	std::cerr << "[Telemetry] " << m_patches << " patches in " << seconds << "s:";
+	for (int i = 0; i < NUM_TELEMETRY_PHASES; ++i)
+		std::cerr << " " << PHASE_NAMES[i] << " " << m_totals[i] << "s" << (i + 1 < NUM_TELEMETRY_PHASES ? "," : "");
+	std::cerr << "\n[Telemetry] " << m_totalBytes / (1024 * 1024) << " MB written, peak RSS " << getPeakRss() / (1024 * 1024) << " MB" << std::endl;
+
+	// Peak host memory by category, of the run and of each phase that allocated any.
+	for (int p = -1; p < NUM_TELEMETRY_PHASES; ++p)
+	{
+		const uint64_t* peaks = p < 0 ? m_runPeaks : m_phasePeaks[p];
+		if (p >= 0 && peaks[sutil::NUM_HOST_MEMORY_CATEGORIES] == 0)
+			continue;
+		std::cerr << "[Host memory] " << (p < 0 ? "run" : PHASE_NAMES[p]) << ":";
+		for (int i = 0; i < sutil::NUM_HOST_MEMORY_CATEGORIES; ++i)
+			std::cerr << " " << sutil::hostMemoryCategoryName(static_cast<sutil::HostMemoryCategory>(i)) << " " << megabytes(peaks[i]) << ",";
+		std::cerr << " total " << megabytes(peaks[sutil::NUM_HOST_MEMORY_CATEGORIES]) << " peak";
+		if (p < 0)
+			std::cerr << ", " << megabytes(current[sutil::NUM_HOST_MEMORY_CATEGORIES]) << " still allocated";
+		std::cerr << std::endl;
+	}
+}
+
+
+void Telemetry::writeRecord(const char* type, const double* phases, uint64_t bytes, double seconds, const std::string& extra)
+{
+	std::ostringstream record;
+	record << "{ \"type\": \"" << type << "\", \"run\": " << jsonString(m_run) << ", \"scene\": " << jsonString(m_scene)
+		<< extra << ", \"seconds\": " << seconds << ", \"phases\": {";
+	for (int i = 0; i < NUM_TELEMETRY_PHASES; ++i)
+		record << (i ? ", \"" : " \"") << PHASE_NAMES[i] << "\": " << phases[i];
+	record << " }, \"bytes_written\": " << bytes << ", \"peak_rss\": " << getPeakRss() << " }\n";
+
+	// One write per record, so a crash does not leave half a line behind.
+	const std::string line = record.str();
+	fwrite(line.data(), 1, line.size(), m_file);
+	fflush(m_file);
+}
+
+
+std::string Telemetry::recordMemory()
+{
+	const sutil::HostMemoryStats stats = sutil::hostMemoryResetPeaks();
+	uint64_t current[sutil::NUM_HOST_MEMORY_CATEGORIES + 1];
+	uint64_t peaks[sutil::NUM_HOST_MEMORY_CATEGORIES + 1] = {};
+	currentMemory(stats, current);
+	peakMemory(stats, peaks);
+	peakMemory(stats, m_runPeaks);
+	return ", \"host_memory\": " + memoryJson(current, peaks);
+}
+
+
+uint64_t Telemetry::getPeakRss()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return static_cast<uint64_t>(counters.PeakWorkingSetSize);
+	return 0;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+#  ifdef __APPLE__
+	return static_cast<uint64_t>(usage.ru_maxrss);			/* bytes */
+#  else
+	return static_cast<uint64_t>(usage.ru_maxrss) * 1024;	/* kilobytes */
+#  endif
+#endif
+}
+
+
+Telemetry::Scope::Scope(Telemetry& telemetry, TelemetryPhase phase)
+	: m_telemetry(telemetry), m_phase(phase), m_start(sutil::currentTime()), m_memory(sutil::hostMemoryResetPeaks()), m_trace(PHASE_NAMES[phase])
+{
+}
+
+
+Telemetry::Scope::~Scope()
+{
+	m_telemetry.add(m_phase, sutil::currentTime() - m_start);
+	m_telemetry.addMemory(m_phase, sutil::hostMemoryStats());
+	sutil::hostMemoryMergePeaks(m_memory);
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include <cstdio>
+#include <string>
+
+#include <HostMemory.h>
+#include <Trace.h>
+
+enum TelemetryPhase
+{
+	PHASE_SCENE_LOAD,
+	PHASE_MESH_LOAD,
+	PHASE_TEXTURE_LOAD,
+	PHASE_ENV_DECODE,		/* Picture::load and the RGBA32F conversion of the environment */
+	PHASE_CDF,				/* environment CDFs, including their upload with the optix backend */
+	PHASE_RANDOMIZE,		/* random camera and materials, a random background counts as env decode and CDF */
+	PHASE_FEATURE_LAUNCH,
+	PHASE_REFERENCE_LAUNCH,
+	PHASE_WRITE,
+
+	NUM_TELEMETRY_PHASES
+};
+
+/*
+	Per-patch timing log (--telemetry FILE), one JSON object per line and appended, so the runs of a fleet can share or
+	concatenate their files. Phases timed before the first patch go into a "setup" record, each patch gets a "patch"
+	record and close() adds a "summary" record with the totals. Every record carries the scene and a run id.
+	Records also hold the current and peak host memory of each sutil::HostMemoryCategory, peaks since the previous
+	record; the summary has the peaks of the run and of every phase timed by a Scope.
+	All calls are no-ops while no file is open.
+*/
+class Telemetry
+{
+public:
+	Telemetry();
+	~Telemetry();
+
+	bool open(const std::string& filename, const std::string& scene);
+	bool isOpen() const { return m_file != nullptr; }
+
+	void add(TelemetryPhase phase, double seconds);
+	void addBytesWritten(const std::string& filename);	/* size of a file that was just written */
+	void addMemory(TelemetryPhase phase, const sutil::HostMemoryStats& stats);	/* peaks during one run of the phase */
+
+	void endSetup();
+	void endPatch(int patch, int feature_spp, int reference_spp);
+
+	// Writes the summary record and prints it to stderr.
+	void close();
+
+	static uint64_t getPeakRss();	/* bytes */
+
+	// Adds the time until the end of the scope to a phase, and a span named after it to the --trace timeline.
+	// The host memory peaks are measured from the start of the scope, nested scopes keep the outer peaks.
+	class Scope
+	{
+	public:
+		Scope(Telemetry& telemetry, TelemetryPhase phase);
+		~Scope();
+
+	private:
+		Telemetry&     m_telemetry;
+		TelemetryPhase m_phase;
+		double         m_start;
+		sutil::HostMemoryStats m_memory;	/* before the scope */
+		sutil::TraceScope m_trace;
+	};
+
+private:
+	void writeRecord(const char* type, const double* phases, uint64_t bytes, double seconds, const std::string& extra);
+	std::string recordMemory();	/* JSON of the record, restarts the peaks */
+
+	FILE*       m_file;
+	std::string m_scene;
+	std::string m_run;
+	double      m_start;
+	double      m_recordStart;
+
+	double      m_phases[NUM_TELEMETRY_PHASES];		/* of the current record */
+	uint64_t    m_bytes;
+	double      m_totals[NUM_TELEMETRY_PHASES];
+	uint64_t    m_totalBytes;
+	int         m_patches;
+	uint64_t    m_totalSamples;		/* samples per pixel over all patches */
+
+	uint64_t    m_runPeaks[sutil::NUM_HOST_MEMORY_CATEGORIES + 1];	/* bytes, the last one is the total */
+	uint64_t    m_phasePeaks[NUM_TELEMETRY_PHASES][sutil::NUM_HOST_MEMORY_CATEGORIES + 1];
+};
+
+#endif
@@ -29,6 +29,7 @@
 #include "Texture.h"
 
 #include "IL/il.h"
+#include <Trace.h>
 
 #include <optix.h>
 #include <optixu/optixpp_namespace.h>
@@ -1003,6 +1004,125 @@ void Texture::createEnvironment()
   }
 }
 
+// Host texture support for the CPU backend.
+// The image is expanded to RGBA32F like for the device, but fixed-point data is normalized by the maximum of its type
+// to match the RT_TEXTURE_READ_NORMALIZED_FLOAT read mode the device sampler would use.
+bool Texture::createHostTexels(const Picture* picture)
+{
+  if (picture == nullptr)
+  {
+    std::cerr << "ERROR: createHostTexels() called with nullptr picture." << std::endl;
+    return false;
+  }
+
+  const Image* image = picture->getImageFace(0, 0);
+
+  if (image == nullptr || image->m_depth != 1 || picture->isCubemap())
+  {
+    std::cerr << "ERROR: createHostTexels() only supports 2D images." << std::endl;
+    return false;
+  }
+
+  const unsigned int hostEncoding = determineHostEncoding(image->m_format, image->m_type);
+
+  if (!determineDeviceEncoding(image->m_format, image->m_type)) // Sets the channel layout, the type is replaced below.
+  {
+    return false;
+  }
+
+  float scale = 1.0f;
+  switch (image->m_type)
+  {
+    case IL_UNSIGNED_BYTE:  scale = 1.0f / 255.0f;        break;
+    case IL_UNSIGNED_SHORT: scale = 1.0f / 65535.0f;      break;
+    case IL_UNSIGNED_INT:   scale = 1.0f / 4294967295.0f; break;
+    case IL_BYTE:           scale = 1.0f / 127.0f;        break;
+    case IL_SHORT:          scale = 1.0f / 32767.0f;      break;
+    case IL_INT:            scale = 1.0f / 2147483647.0f; break;
+  }
+
+  m_width  = image->m_width;
+  m_height = image->m_height;
+  m_depth  = 1;
+
+  m_encoding  = (m_encoding & ~((ENC_MASK << ENC_TYPE_SHIFT) | ENC_FIXED_POINT)) | ENC_TYPE_FLOAT;
+  m_format    = RT_FORMAT_FLOAT4;
+  m_readMode  = RT_TEXTURE_READ_ELEMENT_TYPE;
+  m_indexMode = RT_TEXTURE_INDEX_NORMALIZED_COORDINATES;
+
+  m_texels.resize(m_width * m_height * 4);
+  convert(m_texels.data(), image->m_pixels, m_width * m_height, hostEncoding);
+
+  if (scale != 1.0f)
+  {
+    for (size_t i = 0; i < m_texels.size(); i += 4)
+    {
+      // Alpha has already been set to 1.0f when the source had none.
+      m_texels[i    ] *= scale;
+      m_texels[i + 1] *= scale;
+      m_texels[i + 2] *= scale;
+      if (!(m_encoding & ENC_ALPHA_ONE) && ((hostEncoding >> ENC_ALPHA_SHIFT) & ENC_MASK) < 4)
+      {
+        m_texels[i + 3] *= scale;
+      }
+    }
+  }
+  return true;
+}
+
+// Matches the device sampler setup: bilinear filtering on texel centers, repeat in u, repeat or clamp-to-edge in v.
+optix::float4 Texture::sampleHost(float u, float v, bool clampV) const
+{
+  if (m_texels.empty())
+  {
+    return optix::make_float4(0.0f);
+  }
+
+  const float x = u * float(m_width)  - 0.5f;
+  const float y = v * float(m_height) - 0.5f;
+
+  const float fx = floorf(x);
+  const float fy = floorf(y);
+  const float tx = x - fx;
+  const float ty = y - fy;
+
+  const int w = int(m_width);
+  const int h = int(m_height);
+
+  int x0 = int(fx) % w;
+  if (x0 < 0)
+  {
+    x0 += w;
+  }
+  const int x1 = (x0 + 1) % w;
+
+  int y0 = int(fy);
+  int y1 = y0 + 1;
+  if (clampV)
+  {
+    y0 = std::min(std::max(y0, 0), h - 1);
+    y1 = std::min(std::max(y1, 0), h - 1);
+  }
+  else
+  {
+    y0 %= h;
+    if (y0 < 0)
+    {
+      y0 += h;
+    }
+    y1 = (y0 + 1) % h;
+  }
+
+  const optix::float4* texels = reinterpret_cast<const optix::float4*>(m_texels.data());
+
+  const optix::float4 c00 = texels[y0 * w + x0];
+  const optix::float4 c10 = texels[y0 * w + x1];
+  const optix::float4 c01 = texels[y1 * w + x0];
+  const optix::float4 c11 = texels[y1 * w + x1];
+
+  return optix::lerp(optix::lerp(c00, c10, tx), optix::lerp(c01, c11, tx), ty);
+}
+
 // Implement a simple Gaussian 3x3 filter with sigma = 0.5
 // Needed for the CDF generation of the importance sampled HDR environment texture light.
 static float gaussianFilter(const float* rgba, unsigned int width, unsigned int height, unsigned int x, unsigned int y)
@@ -1047,16 +1167,80 @@ static float gaussianFilter(const float* rgba, unsigned int width, unsigned int
 // See "Physically Based Rendering" v2, chapter 14.6.5 on Infinite Area Lights.
 bool Texture::calculateCDF(optix::Context context)
 {
+  sutil::TraceScope trace("calculateCDF");
+
   if (m_texels.empty() || (m_texels.size() != m_width * m_height * 4))
   {
     return false;
   }
 
+  std::vector<float> cdfU;
+  std::vector<float> cdfV;
+
+  buildCDF(cdfU, cdfV);
+
+  // Upload that RGBA32F environment texture data.
+  // Doing this here no not duplicate the code in the createEnvironment routines.
+  m_buffer = context->createBuffer(RT_BUFFER_INPUT, m_format, m_width, m_height);
+  m_buffer->setMipLevelCount(1);
+
+  void *dst = m_buffer->map(0, RT_BUFFER_MAP_WRITE_DISCARD);
+  memcpy(dst, m_texels.data(), m_width * m_height * sizeof(float) * 4);
+  m_buffer->unmap();
+
+  m_sampler = context->createTextureSampler();
+
+  m_sampler->setWrapMode(0, RT_WRAP_REPEAT);
+  m_sampler->setWrapMode(1, RT_WRAP_CLAMP_TO_EDGE); // Do not filter across the poles.
+  m_sampler->setWrapMode(2, RT_WRAP_REPEAT);
+  m_sampler->setFilteringModes(RT_FILTER_LINEAR, RT_FILTER_LINEAR, RT_FILTER_NONE);
+  m_sampler->setIndexingMode(m_indexMode);
+  m_sampler->setReadMode(m_readMode);
+  m_sampler->setMaxAnisotropy(1.0f);
+  m_sampler->setBuffer(0, 0, m_buffer);
+
+  // Upload the CDFs into OptiX buffers.
+  m_bufferCDF_U = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_FLOAT, m_width + 1, m_height); 
+
+  void* buf = m_bufferCDF_U->map(0, RT_BUFFER_MAP_WRITE_DISCARD);
+  memcpy(buf, cdfU.data(), (m_width + 1) * m_height * sizeof(float));
+  m_bufferCDF_U->unmap();
+
+  m_bufferCDF_V = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_FLOAT, m_height + 1);
+
+  buf = m_bufferCDF_V->map(0, RT_BUFFER_MAP_WRITE_DISCARD);
+  memcpy(buf, cdfV.data(), (m_height + 1) * sizeof(float));
+  m_bufferCDF_V->unmap();
+
+  // The original float data is not needed anymore. clear() alone would keep the allocation.
+  m_texels.clear();
+  m_texels.shrink_to_fit();
+
+  return true;
+}
+
+// Host variant for the CPU backend. The texels stay resident because the CPU renderer samples them directly.
+bool Texture::calculateCDF(std::vector<float>& cdfU, std::vector<float>& cdfV)
+{
+  sutil::TraceScope trace("calculateCDF");
+
+  if (m_texels.empty() || (m_texels.size() != m_width * m_height * 4))
+  {
+    return false;
+  }
+
+  buildCDF(cdfU, cdfV);
+
+  return true;
+}
+
+void Texture::buildCDF(std::vector<float>& cdfU, std::vector<float>& cdfV)
+{
   const float *rgba = m_texels.data();
 
   // The original data needs to be retained to calculate the PDF.
-  float *funcU = new float[m_width * m_height];
-  float *funcV = new float[m_height + 1];
+  std::vector<float> funcU(m_width * m_height);
+  std::vector<float> funcV(m_height + 1);
 
   float sum = 0.0f;
   // First generate the function data.
@@ -1085,8 +1269,8 @@ bool Texture::calculateCDF(optix::Context context)
   // Now generate the CDF data.
   // Normalized 1D distributions in the rows of the 2D buffer, and the marginal CDF in the 1D buffer.
   // Include the starting 0.0f and the ending 1.0f to avoid special cases during the continuous sampling.
-  float *cdfU = new float[(m_width + 1) * m_height];
-  float *cdfV = new float[m_height + 1];
+  cdfU.resize((m_width + 1) * m_height);
+  cdfV.resize(m_height + 1);
 
   for (unsigned int y = 0; y < m_height; ++y)
   {
@@ -1142,49 +1326,6 @@ bool Texture::calculateCDF(optix::Context context)
       cdfV[y] = float(y) / float(m_height);
     }
   }
-
-  // Upload that RGBA32F environment texture data.
-  // Doing this here no not duplicate the code in the createEnvironment routines.
-  m_buffer = context->createBuffer(RT_BUFFER_INPUT, m_format, m_width, m_height);
-  m_buffer->setMipLevelCount(1);
-
-  void *dst = m_buffer->map(0, RT_BUFFER_MAP_WRITE_DISCARD);
-  memcpy(dst, m_texels.data(), m_width * m_height * sizeof(float) * 4);
-  m_buffer->unmap();
-
-  m_sampler = context->createTextureSampler();
-
-  m_sampler->setWrapMode(0, RT_WRAP_REPEAT);
-  m_sampler->setWrapMode(1, RT_WRAP_CLAMP_TO_EDGE); // Do not filter across the poles.
-  m_sampler->setWrapMode(2, RT_WRAP_REPEAT);
-  m_sampler->setFilteringModes(RT_FILTER_LINEAR, RT_FILTER_LINEAR, RT_FILTER_NONE);
-  m_sampler->setIndexingMode(m_indexMode);
-  m_sampler->setReadMode(m_readMode);
-  m_sampler->setMaxAnisotropy(1.0f);
-  m_sampler->setBuffer(0, 0, m_buffer);
-
-  // Upload the CDFs into OptiX buffers.
-  m_bufferCDF_U = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_FLOAT, m_width + 1, m_height); 
-
-  void* buf = m_bufferCDF_U->map(0, RT_BUFFER_MAP_WRITE_DISCARD);
-  memcpy(buf, cdfU, (m_width + 1) * m_height * sizeof(float));
-  m_bufferCDF_U->unmap();
-
-  m_bufferCDF_V = context->createBuffer(RT_BUFFER_INPUT, RT_FORMAT_FLOAT, m_height + 1);
-
-  buf = m_bufferCDF_V->map(0, RT_BUFFER_MAP_WRITE_DISCARD);
-  memcpy(buf, cdfV, (m_height + 1) * sizeof(float));
-  m_bufferCDF_V->unmap();
-
-  delete [] cdfV;
-  delete [] cdfU;
-        
-  delete [] funcV;
-  delete [] funcU;
-
-  m_texels.clear(); // The original float data is not needed anymore.
-
-  return true;
 }
 
 float Texture::getIntegral() const
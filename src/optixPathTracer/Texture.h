@@ -37,6 +37,8 @@
 
 #include "Picture.h"
 
+#include <HostMemory.h>
+
 #include <string>
 #include <vector>
 
@@ -144,7 +146,15 @@ public:
   float getIntegral() const;
   optix::Buffer getBufferCDF_U() const;
   optix::Buffer getBufferCDF_V() const;
+
+  // Host-side texel access for the CPU backend. No OptiX objects are created by these.
+  bool createHostTexels(const Picture* picture); // Converts LOD 0 of face 0 to RGBA32F, normalizing fixed-point data like RT_TEXTURE_READ_NORMALIZED_FLOAT.
+  bool calculateCDF(std::vector<float>& cdfU, std::vector<float>& cdfV); // Same CDFs as above, but returned on the host and m_texels is kept.
+  optix::float4 sampleHost(float u, float v, bool clampV = false) const; // Bilinear lookup with normalized coordinates, repeat wrap mode (clamped in v for environments).
   
+private:
+  void buildCDF(std::vector<float>& cdfU, std::vector<float>& cdfV); // Shared by both calculateCDF() variants, sets m_integral.
+
 private:
   unsigned int m_width;
   unsigned int m_height;
@@ -160,7 +170,7 @@ private:
   optix::TextureSampler m_sampler;
 
   // These fields are only used for spherical environment maps.
-  std::vector<float> m_texels;      // Contains HDR RGBA32F texture data, input to CDF generation.
+  std::vector<float, sutil::TrackedAllocator<float, sutil::HOST_MEMORY_TEXTURE> > m_texels; // Contains HDR RGBA32F texture data, input to CDF generation.
   float              m_integral;
   optix::Buffer      m_bufferCDF_U;
   optix::Buffer      m_bufferCDF_V;
@@ -0,0 +1,48 @@
+#pragma once
+
+#ifndef BSDF_H
+#define BSDF_H
+
+#include "disney.h"
+#include "glass.h"
+#include "lambert.h"
+#include "roughdielectric.h"
+
+// The callable program buffers sysBRDFPdf, sysBRDFSample and sysBRDFEval as a switch on the BRDF type,
+// for the CPU backend and the BSDF checks in OptaBench.
+RT_FUNCTION_HD void bsdfPdf(const MaterialParameter& mat, const State& state, PerRayData_radiance& prd)
+{
+	switch (mat.brdf)
+	{
+	case DISNEY:          disney::Pdf(mat, state, prd); break;
+	case GLASS:           glass::Pdf(mat, state, prd); break;
+	case LAMBERT:         lambert::Pdf(mat, state, prd); break;
+	case ROUGHDIELECTRIC: roughdielectric::Pdf(mat, state, prd); break;
+	}
+}
+
+RT_FUNCTION_HD void bsdfSample(const MaterialParameter& mat, const State& state, PerRayData_radiance& prd)
+{
+	switch (mat.brdf)
+	{
+	case DISNEY:          disney::Sample(mat, state, prd); break;
+	case GLASS:           glass::Sample(mat, state, prd); break;
+	case LAMBERT:         lambert::Sample(mat, state, prd); break;
+	case ROUGHDIELECTRIC: roughdielectric::Sample(mat, state, prd); break;
+	}
+}
+
+// BSDF times the cosine of the sampled direction.
+RT_FUNCTION_HD optix::float3 bsdfEval(const MaterialParameter& mat, const State& state, PerRayData_radiance& prd)
+{
+	switch (mat.brdf)
+	{
+	case DISNEY:          return disney::Eval(mat, state, prd);
+	case GLASS:           return glass::Eval(mat, state, prd);
+	case LAMBERT:         return lambert::Eval(mat, state, prd);
+	case ROUGHDIELECTRIC: return roughdielectric::Eval(mat, state, prd);
+	}
+	return optix::make_float3(0.0f);
+}
+
+#endif // BSDF_H
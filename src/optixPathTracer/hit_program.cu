@@ -36,6 +36,7 @@
 #include "material_parameters.h"
 #include "light_parameters.h"
 #include "state.h"
+#include "light_sample.h"
 #include <assert.h>
 
 using namespace optix;
@@ -57,7 +58,7 @@ rtDeclareVariable(int, max_depth, , );
 rtBuffer< rtCallableProgramId<void(MaterialParameter &mat, State &state, PerRayData_radiance &prd)> > sysBRDFPdf;
 rtBuffer< rtCallableProgramId<void(MaterialParameter &mat, State &state, PerRayData_radiance &prd)> > sysBRDFSample;
 rtBuffer< rtCallableProgramId<float3(MaterialParameter &mat, State &state, PerRayData_radiance &prd)> > sysBRDFEval;
-rtBuffer< rtCallableProgramId<void(const LightParameter &light, const float3 &surfacePos, unsigned int &seed, LightSample &lightSample)> > sysLightSample;
+rtBuffer< rtCallableProgramId<void(const LightParameter &light, const float3 &surfacePos, Sampler &sampler, LightSample &lightSample)> > sysLightSample;
 
 rtBuffer<MaterialParameter> sysMaterialParameters;
 rtDeclareVariable(int, materialId, , );
@@ -71,13 +72,14 @@ RT_FUNCTION float3 DirectLight(MaterialParameter &mat, State &state)
 	float3 L = make_float3(0.0f);
 
 	//Pick a light to sample
-	int index = optix::clamp(static_cast<int>(floorf(rnd(prd.seed) * sysNumberOfLights)), 0, sysNumberOfLights - 1);
+	samplerStartDimension(prd.sampler, prd.depth, SAMPLER_LIGHT_DIMENSION);
+	int index = selectLight(sysLightParameters, sysNumberOfLights, rnd(prd.sampler));
 	LightParameter light = sysLightParameters[index];
 	LightSample lightSample;
 
 	float3 surfacePos = state.fhp;
 
-	sysLightSample[light.lightType](light, surfacePos, prd.seed, lightSample);
+	sysLightSample[light.lightType](light, surfacePos, prd.sampler, lightSample);
 
 	if (0.0f < lightSample.pdf)
 	{
@@ -118,9 +120,10 @@ RT_PROGRAM void closest_hit()
 		mat.color = make_float3(powf(texColor.x, 2.2f), powf(texColor.y, 2.2f), powf(texColor.z, 2.2f));
 	}
 
+	// The hit points are in object space, placements of shared mesh files sit under a Transform.
 	State state;
-	state.fhp = front_hit_point;
-	state.bhp = back_hit_point;
+	state.fhp = rtTransformPoint(RT_OBJECT_TO_WORLD, front_hit_point);
+	state.bhp = rtTransformPoint(RT_OBJECT_TO_WORLD, back_hit_point);
 	state.normal = world_shading_normal;
 	state.ffnormal = ffnormal;
 	prd.wo = -ray.direction;
@@ -136,6 +139,7 @@ RT_PROGRAM void closest_hit()
 		prd.radiance += DirectLight(mat, state);
 
 	// BRDF Sampling
+	samplerStartDimension(prd.sampler, prd.depth, SAMPLER_BSDF_DIMENSION);
 	sysBRDFSample[mat.brdf](mat, state, prd);
 	sysBRDFPdf[mat.brdf](mat, state, prd);
 	float3 f = sysBRDFEval[mat.brdf](mat, state, prd);
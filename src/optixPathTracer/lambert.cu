@@ -24,58 +24,24 @@
 #include "rt_function.h"
 #include "material_parameters.h"
 #include "state.h"
+#include "lambert.h"
 
 using namespace optix;
 
 
 RT_CALLABLE_PROGRAM void Pdf(MaterialParameter &mat, State &state, PerRayData_radiance &prd)
 {
-	float3 n = state.ffnormal;
-	float3 L = prd.bsdfDir;
-
-	float pdfDiff = abs(dot(L, n))* (1.0f / M_PIf);
-
-	prd.pdf = pdfDiff;
-
+	lambert::Pdf(mat, state, prd);
 }
 
+
 RT_CALLABLE_PROGRAM void Sample(MaterialParameter &mat, State &state, PerRayData_radiance &prd)
 {
-	float3 N = state.ffnormal;
-	prd.origin = state.fhp;
-
-	float3 dir;
-
-	float r1 = rnd(prd.seed);
-	float r2 = rnd(prd.seed);
-
-	optix::Onb onb(N);
-
-	cosine_sample_hemisphere(r1, r2, dir);
-	onb.inverse_transform(dir);
-
-	prd.bsdfDir = dir;
-
-	// update path feature
-	prd.roughness = 1.0f;
-	prd.tag = DIFF;
+	lambert::Sample(mat, state, prd);
 }
 
 
 RT_CALLABLE_PROGRAM float3 Eval(MaterialParameter &mat, State &state, PerRayData_radiance &prd)
 {
-	float3 N = state.ffnormal;
-	float3 V = prd.wo;
-	float3 L = prd.bsdfDir;
-
-	float NDotL = dot(N, L);
-	float NDotV = dot(N, V);
-	if (NDotL <= 0.0f || NDotV <= 0.0f) return make_float3(0.0f);
-
-	float3 out = (1.0f / M_PIf) * mat.color;
-
-	// update path feature
-	prd.thpt_at_vtx = out * clamp(dot(N, L), 0.0f, 1.0f);
-
-	return prd.thpt_at_vtx;
+	return lambert::Eval(mat, state, prd);
 }
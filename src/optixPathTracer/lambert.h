@@ -0,0 +1,92 @@
+/*
+ Copyright Disney Enterprises, Inc.  All rights reserved.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License
+ and the following modification to it: Section 6 Trademarks.
+ deleted and replaced with:
+
+ 6. Trademarks. This License does not grant permission to use the
+ trade names, trademarks, service marks, or product names of the
+ Licensor and its affiliates, except as required for reproducing
+ the content of the NOTICE file.
+
+ You may obtain a copy of the License at
+ http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#pragma once
+
+#ifndef LAMBERT_H
+#define LAMBERT_H
+
+#include <optixu/optixu_math_namespace.h>
+#include "prd.h"
+#include "random.h"
+#include "rt_function.h"
+#include "material_parameters.h"
+#include "state.h"
+
+// Lambertian BRDF shared by the callable programs in lambert.cu and the CPU backend.
+namespace lambert
+{
+
+using namespace optix;
+
+
+
+RT_FUNCTION_HD void Pdf(const MaterialParameter &/*mat*/, const State &state, PerRayData_radiance &prd)
+{
+	float3 n = state.ffnormal;
+	float3 L = prd.bsdfDir;
+
+	float pdfDiff = fabsf(dot(L, n))* (1.0f / M_PIf);
+
+	prd.pdf = pdfDiff;
+
+}
+
+RT_FUNCTION_HD void Sample(const MaterialParameter &/*mat*/, const State &state, PerRayData_radiance &prd)
+{
+	float3 N = state.ffnormal;
+	prd.origin = state.fhp;
+
+	float3 dir;
+
+	float r1 = rnd(prd.sampler);
+	float r2 = rnd(prd.sampler);
+
+	optix::Onb onb(N);
+
+	cosine_sample_hemisphere(r1, r2, dir);
+	onb.inverse_transform(dir);
+
+	prd.bsdfDir = dir;
+
+	// update path feature
+	prd.roughness = 1.0f;
+	prd.tag = DIFF;
+}
+
+
+RT_FUNCTION_HD float3 Eval(const MaterialParameter &mat, const State &state, PerRayData_radiance &prd)
+{
+	float3 N = state.ffnormal;
+	float3 V = prd.wo;
+	float3 L = prd.bsdfDir;
+
+	float NDotL = dot(N, L);
+	float NDotV = dot(N, V);
+	if (NDotL <= 0.0f || NDotV <= 0.0f) return make_float3(0.0f);
+
+	float3 out = (1.0f / M_PIf) * mat.color;
+
+	// update path feature
+	prd.thpt_at_vtx = out * clamp(dot(N, L), 0.0f, 1.0f);
+
+	return prd.thpt_at_vtx;
+}
+
+} // namespace lambert
+
+#endif // LAMBERT_H
@@ -83,7 +83,7 @@ RT_PROGRAM void closest_hit()
 	}
 	else if (light.lightType == SPHERE)
 	{
-		const float3 lightNormal = normalize(front_hit_point - light.position);
+		const float3 lightNormal = normalize(rtTransformPoint(RT_OBJECT_TO_WORLD, front_hit_point) - light.position);
 		cosTheta = dot(-ray.direction, lightNormal);
 	}
 
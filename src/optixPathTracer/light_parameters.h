@@ -40,10 +40,16 @@ struct LightParameter
 	rtBufferId<float, 2> idEnvironmentCDF_U;   // rtBufferId fields are integers.
 	rtBufferId<float, 1> idEnvironmentCDF_V;
 	float                environmentIntegral;
-	
+
+	// Selection proportional to the emitted power, an alias table spread over the lights (buildLightSelection()).
+	float selectionPdf;			// probability of picking this light
+	float aliasProbability;		// of keeping this light when its slot is drawn, aliasIndex otherwise
+	int   aliasIndex;
+
 	// Manual padding to float4 alignment.
-	float unsused0;
-	float unsused1;
+	float unused0;
+	float unused1;
+	float unused2;
 };
 
 struct LightSample
@@ -36,31 +36,18 @@
 #include "material_parameters.h"
 #include "light_parameters.h"
 #include "state.h"
+#include "light_sample.h"
 #include <assert.h>
 #include <stdio.h>
 
 using namespace optix;
 
-rtDeclareVariable(int, sysNumberOfLights, , );
-
 rtBuffer<LightParameter> sysLightParameters;
 
-RT_FUNCTION float3 UniformSampleSphere(float u1, float u2)
-{
-	float z = 1.f - 2.f * u1;
-	float r = sqrtf(max(0.f, 1.f - z * z));
-	float phi = 2.f * M_PIf * u2;
-	float x = r * cosf(phi);
-	float y = r * sinf(phi);
-
-	return make_float3(x, y, z);
-}
-
-
-RT_CALLABLE_PROGRAM void envmap_sample(const LightParameter &light, const float3 &surfacePos, unsigned int &seed, LightSample &lightSample)
+RT_CALLABLE_PROGRAM void envmap_sample(const LightParameter &light, const float3 &surfacePos, Sampler &sampler, LightSample &lightSample)
 {
-	const float r1 = rnd(seed);
-	const float r2 = rnd(seed);
+	const float r1 = rnd(sampler);
+	const float r2 = rnd(sampler);
 
 	const unsigned int sizeU = static_cast<unsigned int>(light.idEnvironmentCDF_U.size().x);
 	const unsigned int sizeV = static_cast<unsigned int>(light.idEnvironmentCDF_V.size());
@@ -140,66 +127,20 @@ RT_CALLABLE_PROGRAM void envmap_sample(const LightParameter &light, const float3
 
 	const float3 emission = make_float3(optix::rtTex2D<float4>(light.idEnvironmentTexture, u, v));
 	// Explicit light sample. The returned emission must be scaled by the inverse probability to select this light.
-	lightSample.emission = emission * float(sysNumberOfLights);
+	lightSample.emission = emission / light.selectionPdf;
 	// For simplicity we pretend that we perfectly importance-sampled the actual texture-filtered environment map
 	// and not the Gaussian-smoothed one used to actually generate the CDFs and uniform sampling in the texel.
 	lightSample.pdf = 0.3333333333f * (emission.x + emission.y + emission.z) / light.environmentIntegral;
 }
 
 
-RT_CALLABLE_PROGRAM void sphere_sample(const LightParameter &light, const float3 &surfacePos, unsigned int &seed, LightSample &lightSample)
+RT_CALLABLE_PROGRAM void sphere_sample(const LightParameter &light, const float3 &surfacePos, Sampler &sampler, LightSample &lightSample)
 {
-	const float r1 = rnd(seed);
-	const float r2 = rnd(seed);
-
-	lightSample.pdf = 0.0f;
-
-	optix::float3 lightSamplePos = light.position + UniformSampleSphere(r1, r2) * light.radius;
-	lightSample.direction = lightSamplePos - surfacePos;
-	lightSample.distance = length(lightSample.direction);
-
-	if (1.0e-6f < lightSample.distance)
-	{
-		lightSample.direction /= lightSample.distance;
-		optix::float3 lightNormal = normalize(lightSamplePos - light.position);
-
-		const float cosTheta = dot(-lightSample.direction, lightNormal); // light surface ٶ󺸴 ̾ Ѵ.
-		if (1.0e-6f < cosTheta)
-		{
-			lightSample.emission = light.emission * float(sysNumberOfLights);
-			lightSample.pdf = (lightSample.distance * lightSample.distance) / (light.area * cosTheta);
-		}
-	}
+	sampleSphereLight(light, surfacePos, sampler, lightSample);
 }
 
 
-/*
- lightSample pdf, distance, direction, emission Ѵ.
- pdf: Monte Carlo estimator power heuristic  ϱ 
- distance:    ִ valid  Ȯϱ  shadowRay  
- direction: shadowRay  Ÿ
- emission: emissive radiance
- */
-RT_CALLABLE_PROGRAM void quad_sample(const LightParameter &light, const float3 &surfacePos, unsigned int &seed, LightSample &lightSample)
+RT_CALLABLE_PROGRAM void quad_sample(const LightParameter &light, const float3 &surfacePos, Sampler &sampler, LightSample &lightSample)
 {
-	const float r1 = rnd(seed);
-	const float r2 = rnd(seed);
-
-	lightSample.pdf = 0.0f;
-
-	optix::float3 lightSamplePos = light.position + light.u * r1 + light.v * r2;
-	lightSample.direction = lightSamplePos - surfacePos;
-	lightSample.distance = length(lightSample.direction);
-
-	if (1.0e-6f < lightSample.distance)
-	{
-		lightSample.direction /= lightSample.distance;
-
-		const float cosTheta = dot(-lightSample.direction, light.normal); // light surface ٶ󺸴 ̾ Ѵ.
-		if (1.0e-6f < cosTheta)
-		{
-			lightSample.emission = light.emission * float(sysNumberOfLights);
-			lightSample.pdf = (lightSample.distance * lightSample.distance) / (light.area * cosTheta);
-		}
-	}
+	sampleQuadLight(light, surfacePos, sampler, lightSample);
 }
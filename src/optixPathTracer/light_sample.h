@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#ifndef LIGHT_SAMPLE_H
+#define LIGHT_SAMPLE_H
+
+#include <optixu/optixu_math_namespace.h>
+#include "sampler.h"
+#include "rt_function.h"
+#include "light_parameters.h"
+
+// Area light sampling shared by the callable programs in light_sample.cu and the CPU backend.
+// The returned emission is scaled by 1 / selectionPdf, the inverse probability of picking this light.
+
+
+// Picks a light with the alias table of buildLightSelection() (LightSelection.h), u uniform in [0, 1).
+// The probability of the returned light is its selectionPdf. lights is sysLightParameters or a host vector.
+template <typename LightBuffer>
+RT_FUNCTION_HD int selectLight(LightBuffer& lights, int numberOfLights, float u)
+{
+	const float scaled = u * float(numberOfLights);
+	const int index = optix::clamp(static_cast<int>(scaled), 0, numberOfLights - 1);
+	return scaled - float(index) < lights[index].aliasProbability ? index : lights[index].aliasIndex;
+}
+
+RT_FUNCTION_HD optix::float3 UniformSampleSphere(float u1, float u2)
+{
+	float z = 1.f - 2.f * u1;
+	float r = sqrtf(fmaxf(0.f, 1.f - z * z));
+	float phi = 2.f * M_PIf * u2;
+	float x = r * cosf(phi);
+	float y = r * sinf(phi);
+
+	return optix::make_float3(x, y, z);
+}
+
+
+RT_FUNCTION_HD void sampleSphereLight(const LightParameter &light, const optix::float3 &surfacePos, Sampler &sampler, LightSample &lightSample)
+{
+	using namespace optix; // The vector operators live in the optix namespace.
+
+	const float r1 = rnd(sampler);
+	const float r2 = rnd(sampler);
+
+	lightSample.pdf = 0.0f;
+
+	optix::float3 lightSamplePos = light.position + UniformSampleSphere(r1, r2) * light.radius;
+	lightSample.direction = lightSamplePos - surfacePos;
+	lightSample.distance = optix::length(lightSample.direction);
+
+	if (1.0e-6f < lightSample.distance)
+	{
+		lightSample.direction /= lightSample.distance;
+		optix::float3 lightNormal = optix::normalize(lightSamplePos - light.position);
+
+		const float cosTheta = optix::dot(-lightSample.direction, lightNormal); // The light must face the surface.
+		if (1.0e-6f < cosTheta)
+		{
+			lightSample.emission = light.emission / light.selectionPdf;
+			lightSample.pdf = (lightSample.distance * lightSample.distance) / (light.area * cosTheta);
+		}
+	}
+}
+
+
+/*
+ Fills in the pdf, distance, direction and emission of the lightSample.
+ pdf: used by the power heuristic of the Monte Carlo estimator
+ distance: length of the shadow ray which checks that the sample is unoccluded
+ direction: direction of the shadow ray
+ emission: emissive radiance
+ */
+RT_FUNCTION_HD void sampleQuadLight(const LightParameter &light, const optix::float3 &surfacePos, Sampler &sampler, LightSample &lightSample)
+{
+	using namespace optix; // The vector operators live in the optix namespace.
+
+	const float r1 = rnd(sampler);
+	const float r2 = rnd(sampler);
+
+	lightSample.pdf = 0.0f;
+
+	optix::float3 lightSamplePos = light.position + light.u * r1 + light.v * r2;
+	lightSample.direction = lightSamplePos - surfacePos;
+	lightSample.distance = optix::length(lightSample.direction);
+
+	if (1.0e-6f < lightSample.distance)
+	{
+		lightSample.direction /= lightSample.distance;
+
+		const float cosTheta = optix::dot(-lightSample.direction, light.normal); // The light must face the surface.
+		if (1.0e-6f < cosTheta)
+		{
+			lightSample.emission = light.emission / light.selectionPdf;
+			lightSample.pdf = (lightSample.distance * lightSample.distance) / (light.area * cosTheta);
+		}
+	}
+}
+
+#endif // LIGHT_SAMPLE_H
@@ -32,7 +32,7 @@
 #include "prd.h"
 #include "path.h"
 #include "rt_function.h"
-#include "random.h"
+#include "sampler.h"
 #include <assert.h>
 #include <stdio.h>
 
@@ -53,6 +53,7 @@ rtBuffer<float4, 2>              accum_buffer;
 rtDeclareVariable(rtObject, top_object, , );
 rtDeclareVariable(unsigned int, frame, , );
 rtDeclareVariable(unsigned int, curr_time, , );
+rtDeclareVariable(unsigned int, sampler_type, , );	/* SamplerType */
 rtDeclareVariable(int, mbpf_frames, , );
 rtDeclareVariable(uint2, launch_index, rtLaunchIndex, );
 
@@ -97,11 +98,11 @@ __device__ inline float3 clip(const float3& c)
 RT_PROGRAM void pinhole_camera()
 {
 	size_t2 screen = output_buffer.size();
-	unsigned int seed = tea<16>(screen.x*launch_index.y + launch_index.x, frame + curr_time);
+	Sampler sampler = makeSampler(sampler_type, launch_index.x, launch_index.y, static_cast<unsigned int>(screen.x), frame, curr_time);
 
 	// Subpixel jitter: send the ray through a different position inside the pixel each time,
 	// to provide antialiasing.
-	float2 subpixel_jitter = frame == 0 ? make_float2(0.0f) : make_float2(rnd(seed) - 0.5f, rnd(seed) - 0.5f);
+	float2 subpixel_jitter = frame == 0 ? make_float2(0.0f) : make_float2(rnd(sampler) - 0.5f, rnd(sampler) - 0.5f);
 
 	float2 d = (make_float2(launch_index) + subpixel_jitter) / make_float2(screen) * 2.f - 1.f;
 	float3 ray_origin = eye;
@@ -109,7 +110,7 @@ RT_PROGRAM void pinhole_camera()
 
 	PerRayData_radiance prd;
 	prd.depth = 0;
-	prd.seed = seed;
+	prd.sampler = sampler;
 	prd.done = false;
 	prd.pdf = 0.0f;
 	prd.specularBounce = false;
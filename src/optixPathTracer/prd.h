@@ -30,11 +30,12 @@
 
 #include <optixu/optixu_vector_types.h>
 #include "path.h"
+#include "sampler.h"
 
 struct PerRayData_radiance
 {
   int depth;
-  unsigned int seed;
+  Sampler sampler;
 
   // shading state
   bool done;
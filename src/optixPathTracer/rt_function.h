@@ -35,4 +35,9 @@
 #define RT_FUNCTION __forceinline__ __device__
 #endif
 
+// Functions which are shared between the device programs and the CPU backend.
+#ifndef RT_FUNCTION_HD
+#define RT_FUNCTION_HD __forceinline__ __host__ __device__
+#endif
+
 #endif // RT_FUNCTION_H
@@ -0,0 +1,187 @@
+#pragma once
+
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <optixu/optixu_math_namespace.h>
+#include "random.h"
+#include "rt_function.h"
+
+/*
+	Sample streams of the path tracer, indexed by (pixel, frame, dimension) and shared by the device programs and the
+	CPU backend. rnd(Sampler&) returns the next dimension.
+	- SAMPLER_RANDOM: the tea + LCG stream the renderer always used, the dimension is ignored.
+	- SAMPLER_SOBOL: Owen-scrambled Sobol points, scrambled per pixel. Dimensions are padded in groups of four, every
+	  group is a 4D Sobol point of the frame index shuffled per group (Burley 2020), so any number of dimensions only
+	  needs the first four Sobol dimensions.
+	- SAMPLER_BLUE_NOISE: one scrambled sequence for all pixels, rotated per pixel by interleaved gradient noise, which
+	  spreads the error of neighbouring pixels as blue noise. The dimensions add golden ratio steps to the rotation.
+	  The first two frames of every pixel lie a fixed distance apart, so at 2 spp the error can exceed random; use it
+	  from 4 spp on.
+*/
+enum SamplerType
+{
+	SAMPLER_RANDOM,
+	SAMPLER_SOBOL,
+	SAMPLER_BLUE_NOISE,
+
+	NUM_SAMPLER_TYPES
+};
+
+// Dimensions of the camera ray (subpixel jitter) and of each path vertex: the light selection and the light sample,
+// then the BSDF lobe and direction. Every part starts at a multiple of four, so pairs stay within one Sobol group.
+#define SAMPLER_CAMERA_DIMENSIONS 4
+#define SAMPLER_BOUNCE_DIMENSIONS 8
+#define SAMPLER_LIGHT_DIMENSION   0
+#define SAMPLER_BSDF_DIMENSION    4
+
+struct Sampler
+{
+	unsigned int type;		/* SamplerType */
+	unsigned int seed;		/* LCG state of SAMPLER_RANDOM, scramble seed of the others */
+	unsigned int index;		/* frame */
+	unsigned int dimension;	/* of the next rnd() */
+	unsigned int pixel;		/* x | y << 16, for SAMPLER_BLUE_NOISE */
+};
+
+
+RT_FUNCTION_HD unsigned int reverseBits(unsigned int x)
+{
+#ifdef __CUDA_ARCH__
+	return __brev(x);
+#else
+	x = (x << 16) | (x >> 16);
+	x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+	x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+	x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+	x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+	return x;
+#endif
+}
+
+
+RT_FUNCTION_HD unsigned int samplerHash(unsigned int x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352du;
+	x ^= x >> 15;
+	x *= 0x846ca68bu;
+	x ^= x >> 16;
+	return x;
+}
+
+
+RT_FUNCTION_HD unsigned int samplerHashCombine(unsigned int seed, unsigned int value)
+{
+	return seed ^ (value + 0x9e3779b9u + (seed << 6) + (seed >> 2));
+}
+
+
+// Owen scrambling: every bit is flipped depending on the bits above it, hashed with the seed (Laine-Karras permutation
+// applied to the reversed bits).
+RT_FUNCTION_HD unsigned int nestedUniformScramble(unsigned int x, unsigned int seed)
+{
+	x = reverseBits(x);
+	x ^= x * 0x3d20adeau;
+	x += seed;
+	x *= (seed >> 16) | 1u;
+	x ^= x * 0x05526c56u;
+	x ^= x * 0x53a22864u;
+	return reverseBits(x);
+}
+
+
+// Dimension 0 to 3 of the Sobol sequence. The direction numbers follow from the primitive polynomials x + 1, x^2 + x + 1
+// and x^3 + x + 1 with the initial values of Joe and Kuo, so there is no table to keep on the device.
+RT_FUNCTION_HD unsigned int sobol(unsigned int index, unsigned int dimension)
+{
+	if (dimension == 0)
+		return reverseBits(index);
+
+	unsigned int result = 0;
+	unsigned int v1 = 0, v2 = 0, v3 = 0;	/* previous direction numbers */
+	for (unsigned int bit = 0; index; ++bit, index >>= 1)
+	{
+		unsigned int v;
+		if (bit < dimension)
+			v = bit == 0 ? 0x80000000u : bit == 1 ? 0xc0000000u : 0x20000000u;
+		else if (dimension == 1)
+			v = v1 ^ (v1 >> 1);
+		else if (dimension == 2)
+			v = v1 ^ v2 ^ (v2 >> 2);
+		else
+			v = v2 ^ v3 ^ (v3 >> 3);
+
+		if (index & 1u)
+			result ^= v;
+		v3 = v2;
+		v2 = v1;
+		v1 = v;
+	}
+	return result;
+}
+
+
+// 32 bit scrambled Sobol sample of any dimension.
+RT_FUNCTION_HD unsigned int sobolSample(unsigned int index, unsigned int dimension, unsigned int seed)
+{
+	const unsigned int groupSeed = samplerHash(samplerHashCombine(seed, dimension >> 2));
+	const unsigned int shuffled = nestedUniformScramble(index, groupSeed);
+	return nestedUniformScramble(sobol(shuffled, dimension & 3u), samplerHashCombine(groupSeed, dimension & 3u));
+}
+
+
+// Interleaved gradient noise (Jimenez 2014) of the pixel as a 24 bit rotation. Offsetting the pixel linearly per dimension
+// tied the rotations of the dimensions together and lost to random on integrands over many dimensions, golden ratio
+// steps keep the dimensions apart.
+RT_FUNCTION_HD unsigned int blueNoiseShift(unsigned int pixel, unsigned int dimension)
+{
+	const float x = static_cast<float>(pixel & 0xffffu);
+	const float y = static_cast<float>(pixel >> 16);
+	const float f = 0.06711056f * x + 0.00583715f * y;
+	const float g = 52.9829189f * (f - floorf(f));
+	const float r = (g - floorf(g)) + 0.6180339887f * static_cast<float>(dimension);
+	return static_cast<unsigned int>((r - floorf(r)) * 16777216.0f) & 0x00ffffffu;
+}
+
+
+// seed is the per-run seed (curr_time). SAMPLER_RANDOM seeds exactly like pinhole_camera always did.
+RT_FUNCTION_HD Sampler makeSampler(unsigned int type, unsigned int x, unsigned int y, unsigned int width, unsigned int frame,
+	unsigned int seed)
+{
+	Sampler sampler;
+	sampler.type = type;
+	sampler.index = frame;
+	sampler.dimension = 0;
+	sampler.pixel = (x & 0xffffu) | (y << 16);
+	if (type == SAMPLER_RANDOM)
+		sampler.seed = tea<16>(width * y + x, frame + seed);
+	else if (type == SAMPLER_SOBOL)
+		sampler.seed = samplerHash(samplerHashCombine(seed, width * y + x));
+	else
+		sampler.seed = samplerHash(seed);
+	return sampler;
+}
+
+
+// Moves to the first dimension of a part (SAMPLER_LIGHT_DIMENSION, SAMPLER_BSDF_DIMENSION) of the vertex at depth.
+RT_FUNCTION_HD void samplerStartDimension(Sampler& sampler, int depth, unsigned int part)
+{
+	sampler.dimension = SAMPLER_CAMERA_DIMENSIONS + static_cast<unsigned int>(depth) * SAMPLER_BOUNCE_DIMENSIONS + part;
+}
+
+
+// Uniform in [0, 1) with 24 bits, like rnd(unsigned int&).
+RT_FUNCTION_HD float rnd(Sampler& sampler)
+{
+	if (sampler.type == SAMPLER_RANDOM)
+		return rnd(sampler.seed);
+
+	unsigned int x = sobolSample(sampler.index, sampler.dimension, sampler.seed) >> 8;
+	if (sampler.type == SAMPLER_BLUE_NOISE)
+		x = (x + blueNoiseShift(sampler.pixel, sampler.dimension)) & 0x00ffffffu;
+	++sampler.dimension;
+	return static_cast<float>(x) / static_cast<float>(0x01000000);
+}
+
+#endif
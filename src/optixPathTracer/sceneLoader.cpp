@@ -17,9 +17,12 @@ misrepresented as being the original software.
 3. This notice may not be removed or altered from any source distribution.*/
 
 #include "sceneLoader.h"
+#include "SceneBundle.h"
+#include "SceneProbe.h"
+#include <Trace.h>
 #include <filesystem>
-
-static const int kMaxLineLength = 2048;
+#include <stdexcept>
+#include <vector>
 
 std::string getDir(const char* filename)
 {
@@ -34,327 +37,1539 @@ float clip(float &x, float min, float max)
 	return x;
 }
 
-Scene* LoadScene(const char* filename)
+/*
+	A .scene file is a list of top level blocks ("material <name> { ... }", "mesh { ... }", ...).
+	Inside a block every line is a key followed by its values, values never continue on the next line.
+*/
+struct SceneToken
 {
-	Scene *scene = new Scene;
-	int tex_id = 0;
-	FILE* file = fopen(filename, "r");
-	scene->dir = getDir(filename);
+	const char* str;	/* points into the file buffer, not terminated */
+	size_t      len;
+	int         line;
 
-	if (!file)
+	bool is(const char* keyword) const
 	{
-		printf("Couldn't open %s for reading.", filename);
-		return NULL;
+		return strncmp(str, keyword, len) == 0 && keyword[len] == '\0';
 	}
 
-	std::map<std::string, MaterialParameter> materials_map;
-	std::map<std::string, int> texture_ids;
+	bool isBrace() const
+	{
+		return len == 1 && (str[0] == '{' || str[0] == '}');
+	}
 
-	char line[kMaxLineLength];
+	std::string text() const
+	{
+		return std::string(str, len);
+	}
+};
 
-	while (fgets(line, kMaxLineLength, file))
+/*
+	Splits the file into whitespace separated tokens in a single pass. '{' and '}' are tokens of their own,
+	'#' at the start of a token comments out the rest of the line.
+*/
+class SceneTokenizer
+{
+public:
+	SceneTokenizer(const char* text)
+		: m_cur(text), m_line(1), m_hasPeek(false)
 	{
-		// skip comments
-		if (line[0] == '#')
-			continue;
+		// UTF-8 BOM
+		if (strncmp(m_cur, "\xEF\xBB\xBF", 3) == 0)
+			m_cur += 3;
+	}
+
+	bool next(SceneToken& tok)
+	{
+		if (m_hasPeek)
+		{
+			tok = m_peek;
+			m_hasPeek = false;
+			return true;
+		}
+		return scan(tok);
+	}
 
-		// name used for materials and meshes
-		char name[kMaxLineLength] = { 0 };
+	bool peek(SceneToken& tok)
+	{
+		if (!m_hasPeek)
+			m_hasPeek = scan(m_peek);
+		tok = m_peek;
+		return m_hasPeek;
+	}
 
+	// Tokens that are left on the given line.
+	bool peekOnLine(int line, SceneToken& tok)
+	{
+		return peek(tok) && tok.line == line;
+	}
 
-		//--------------------------------------------
-		// Material
+	void skipLine(int line)
+	{
+		SceneToken tok;
+		while (peekOnLine(line, tok) && !tok.isBrace())
+			next(tok);
+	}
 
-		if (sscanf(line, "material %s", name) == 1)
+private:
+	bool scan(SceneToken& tok)
+	{
+		for (;;)
 		{
-			printf("%s", line);
+			const char c = *m_cur;
+			if (c == '\0')
+				return false;
 
-			MaterialParameter material;
-			char tex_name[kMaxLineLength] = "None";
-			char brdf_type[20] = "None";
-			char dist_type[20] = "None";
-
-			while (fgets(line, kMaxLineLength, file))
+			if (c == '\n')
 			{
-				// end group
-				if (strchr(line, '}'))
-					break;
-
-				sscanf(line, " name %s", name);
-				sscanf(line, " color %f %f %f", &material.color.x, &material.color.y, &material.color.z);
-				sscanf(line, " albedoTex %s", &tex_name);
-				sscanf(line, " emission %f %f %f", &material.emission.x, &material.emission.y, &material.emission.z);
+				++m_line;
+				++m_cur;
+			}
+			else if (c == '#')
+			{
+				while (*m_cur != '\0' && *m_cur != '\n')
+					++m_cur;
+			}
+			else if (isspace(static_cast<unsigned char>(c)))
+				++m_cur;
+			else
+				break;
+		}
 
-				sscanf(line, " metallic %f", &material.metallic);
-				sscanf(line, " subsurface %f", &material.subsurface);
-				sscanf(line, " specular %f", &material.specular);
-				sscanf(line, " specularTint %f", &material.specularTint);
-				sscanf(line, " roughness %f", &material.roughness);
-				sscanf(line, " sheen %f", &material.sheen);
-				sscanf(line, " sheenTint %f", &material.sheenTint);
-				sscanf(line, " clearcoat %f", &material.clearcoat);
-				sscanf(line, " clearcoatGloss %f", &material.clearcoatGloss);
-				sscanf(line, " brdf %s", brdf_type);
+		tok.str = m_cur;
+		tok.line = m_line;
 
-				// params for rough dielectrics
-				sscanf(line, " intIOR %f", &material.intIOR);
-				sscanf(line, " extIOR %f", &material.extIOR);
-				sscanf(line, " dist %s", dist_type);
+		if (*m_cur == '{' || *m_cur == '}')
+			++m_cur;
+		else
+		{
+			while (*m_cur != '\0' && *m_cur != '{' && *m_cur != '}' && !isspace(static_cast<unsigned char>(*m_cur)))
+				++m_cur;
+		}
 
-				if (strcmp(brdf_type, "DISNEY") == 0 || strcmp(brdf_type, "0") == 0)
-					material.brdf = DISNEY;
-				else if (strcmp(brdf_type, "GLASS") == 0 || strcmp(brdf_type, "1") == 0)
-					material.brdf = GLASS;
-				else if (strcmp(brdf_type, "LAMBERT") == 0 || strcmp(brdf_type, "2") == 0)
-					material.brdf = LAMBERT;
-				else if (strcmp(brdf_type, "ROUGHDIELECTRIC") == 0 || strcmp(brdf_type, "3") == 0)
-					material.brdf = ROUGHDIELECTRIC;
-				else
-					material.brdf = DISNEY;
+		tok.len = static_cast<size_t>(m_cur - tok.str);
+		return true;
+	}
 
-				if (strcmp(dist_type, "Beckmann") == 0 ||
-					strcmp(dist_type, "beckmann") == 0 ||
-					strcmp(dist_type, "0") == 0)
-					material.dist = Beckmann;
-				else if (strcmp(dist_type, "GGX") == 0 ||
-					strcmp(dist_type, "ggx") == 0 ||
-					strcmp(dist_type, "1") == 0)
-					material.dist = GGX;
-				else if (strcmp(dist_type, "Phong") == 0 ||
-					strcmp(dist_type, "phong") == 0 ||
-					strcmp(dist_type, "2") == 0)
-					material.dist = Phong;
-				else
-					material.dist = GGX;
+private:
+	const char* m_cur;
+	int         m_line;
+	bool        m_hasPeek;
+	SceneToken  m_peek;
+};
 
-				// clipping
-				clip(material.color.x, 0.0f, 1.0f);
-				clip(material.metallic, 0.0f, 1.0f);
-				clip(material.subsurface, 0.0f, 1.0f);
-				clip(material.specular, 0.0f, 1.0f);
-				clip(material.specularTint, 0.0f, 1.0f);
-				clip(material.sheen, 0.0f, 1.0f);
-				clip(material.sheenTint, 0.0f, 1.0f);
-				clip(material.clearcoat, 0.0f, 1.0f);
-				clip(material.clearcoatGloss, 0.0f, 1.0f);
-				clip(material.roughness, 0.0f, 1.0f);
-
-				if (material.brdf == DISNEY)
-				{
-					if (material.roughness < 0.004f)
-					{
-						printf("Cannot create a GGX distribution with roughness<0.004 (clamped to 0.004)."
-							"Please use the corresponding smooth reflectance model to get zero roughness. \n");
-						material.roughness = 0.004f;
-					}
-				}
-				else if (material.brdf == ROUGHDIELECTRIC)
-				{
-					if (material.roughness < 0.023f)
-					{
-						printf("Cannot create a GGX distribution with roughness<0.023 (clamped to 0.023)."
-							"Please use the corresponding smooth reflectance model to get zero roughness. \n");
-						material.roughness = 0.023f;
-					}
-				}
+/*
+	State shared by the .scene and the Mitsuba parsers: named materials, texture ids, mesh files and the value ranges
+	the renderer supports.
+*/
+class SceneBuilder
+{
+protected:
+	SceneBuilder(const char* filename, Scene* scene)
+		: m_filename(filename), m_scene(scene), m_texId(0)
+	{
+	}
 
-			}
+	// Clipping, the roughness limits of the microfacet models and the texture id.
+	void finishMaterial(MaterialParameter& material, const std::string& tex_name)
+	{
+		clip(material.color.x, 0.0f, 1.0f);
+		clip(material.metallic, 0.0f, 1.0f);
+		clip(material.subsurface, 0.0f, 1.0f);
+		clip(material.specular, 0.0f, 1.0f);
+		clip(material.specularTint, 0.0f, 1.0f);
+		clip(material.sheen, 0.0f, 1.0f);
+		clip(material.sheenTint, 0.0f, 1.0f);
+		clip(material.clearcoat, 0.0f, 1.0f);
+		clip(material.clearcoatGloss, 0.0f, 1.0f);
+		clip(material.roughness, 0.0f, 1.0f);
 
-			// Check if texture is already loaded
-			if (texture_ids.find(tex_name) != texture_ids.end()) // Found Texture
+		if (material.brdf == DISNEY)
+		{
+			if (material.roughness < 0.004f)
 			{
-				material.albedoID = texture_ids[tex_name];
+				printf("Cannot create a GGX distribution with roughness<0.004 (clamped to 0.004)."
+					"Please use the corresponding smooth reflectance model to get zero roughness. \n");
+				material.roughness = 0.004f;
 			}
-			else if (strcmp(tex_name, "None") != 0)
+		}
+		else if (material.brdf == ROUGHDIELECTRIC)
+		{
+			if (material.roughness < 0.023f)
 			{
-				tex_id++;
-				texture_ids[tex_name] = tex_id;
-				scene->texture_map[tex_id - 1] = tex_name;
-				material.albedoID = tex_id;
+				printf("Cannot create a GGX distribution with roughness<0.023 (clamped to 0.023)."
+					"Please use the corresponding smooth reflectance model to get zero roughness. \n");
+				material.roughness = 0.023f;
 			}
+		}
 
-			// add material to map
-			materials_map[name] = material;
+		// Check if texture is already loaded
+		std::map<std::string, int>::const_iterator it = m_textureIds.find(tex_name);
+		if (it != m_textureIds.end()) // Found Texture
+		{
+			material.albedoID = it->second;
 		}
+		else if (tex_name != "None")
+		{
+			m_texId++;
+			m_textureIds[tex_name] = m_texId;
+			m_scene->texture_map[m_texId - 1] = tex_name;
+			material.albedoID = m_texId;
+		}
+	}
 
-		//--------------------------------------------
-		// Light
+	static void clipProperties(Properties& prop, int depth)
+	{
+		prop.width = (prop.width < MINW) ? MINW : ((prop.width > MAXW ? MAXW : prop.width));
+		prop.height = (prop.height < MINH) ? MINH : ((prop.height > MAXH ? MAXH : prop.height));
+		prop.vfov = (prop.vfov < MINFOV) ? MINFOV : prop.vfov;
+		prop.max_depth = (depth < MINDEPTH) ? MINDEPTH : ((depth > MAXDEPTH ? MAXDEPTH : depth));
+	}
 
-		if (strstr(line, "light"))
+	// The position, and the radius of spheres, are set by the caller.
+	static void setQuadLight(LightParameter& light, const optix::float3& v1, const optix::float3& v2)
+	{
+		light.lightType = QUAD;
+		light.u = v1 - light.position;
+		light.v = v2 - light.position;
+		light.area = optix::length(optix::cross(light.u, light.v));
+		light.normal = optix::normalize(optix::cross(light.u, light.v));
+	}
+
+	static void setSphereLight(LightParameter& light)
+	{
+		light.lightType = SPHERE;
+		light.area = 4.0f * M_PIf * light.radius * light.radius;
+	}
+
+	// Placements of the same file share one geometry.
+	void addMesh(const std::string& path, const optix::Matrix4x4& xform)
+	{
+		const std::string name = m_scene->dir + path;
+
+		std::map<std::string, int>::const_iterator it = m_geometryIds.find(name);
+		if (it == m_geometryIds.end())
+		{
+			it = m_geometryIds.insert(std::make_pair(name, static_cast<int>(m_scene->geometry_names.size()))).first;
+			m_scene->geometry_names.push_back(name);
+		}
+
+		m_scene->mesh_names.push_back(name);
+		m_scene->transforms.push_back(xform);
+		m_scene->mesh_geometry.push_back(it->second);
+	}
+
+	void warning(int line, const std::string& msg) const
+	{
+		printf("%s:%d: %s\n", m_filename.c_str(), line, msg.c_str());
+	}
+
+	void error(int line, const std::string& msg) const
+	{
+		throw std::runtime_error(m_filename + ":" + std::to_string(line) + ": " + msg);
+	}
+
+protected:
+	std::string m_filename;
+	Scene*      m_scene;
+
+	std::map<std::string, MaterialParameter> m_materials;
+	std::map<std::string, int>               m_textureIds;
+	std::map<std::string, int>               m_geometryIds;
+	int                                      m_texId;
+};
+
+/*
+	Dispatches the top level keywords and the keys of each block. Syntax errors throw with the file name and line,
+	unknown keys are reported and skipped.
+*/
+class SceneParser : private SceneBuilder
+{
+public:
+	SceneParser(const char* filename, const char* text, Scene* scene)
+		: SceneBuilder(filename, scene), m_tokens(text)
+	{
+	}
+
+	void parse()
+	{
+		SceneToken tok;
+		while (m_tokens.next(tok))
+		{
+			if (tok.is("material"))
+				parseMaterial(tok);
+			else if (tok.is("mesh"))
+				parseMesh(tok);
+			else if (tok.is("instance"))
+				parseInstance(tok);
+			else if (tok.is("light"))
+				parseLight(tok);
+			else if (tok.is("properties"))
+				parseProperties(tok);
+			else if (tok.is("camera"))
+				parseCamera(tok);
+			else if (tok.isBrace())
+				error(tok.line, "unexpected '" + tok.text() + "'");
+			else
+				skipBlock(tok);
+		}
+	}
+
+private:
+	void parseMaterial(const SceneToken& keyword)
+	{
+		MaterialParameter material;
+		std::string name, tex_name = "None", brdf_type = "None", dist_type = "None";
+
+		SceneToken tok;
+		if (m_tokens.peekOnLine(keyword.line, tok) && !tok.isBrace())
+			readWord(keyword, name);
+
+		openBlock(keyword);
+
+		SceneToken key;
+		while (nextKey(keyword, key))
 		{
-			LightParameter light;
-			optix::float3 v1, v2;
-			char light_type[20] = "None";
+			if (key.is("name"))
+				readWord(key, name);
+			else if (key.is("color"))
+				readFloats(key, &material.color.x, 3);
+			else if (key.is("albedoTex"))
+				readWord(key, tex_name);
+			else if (key.is("emission"))
+				readFloats(key, &material.emission.x, 3);
+			else if (key.is("metallic"))
+				readFloats(key, &material.metallic, 1);
+			else if (key.is("subsurface"))
+				readFloats(key, &material.subsurface, 1);
+			else if (key.is("specular"))
+				readFloats(key, &material.specular, 1);
+			else if (key.is("specularTint"))
+				readFloats(key, &material.specularTint, 1);
+			else if (key.is("roughness"))
+				readFloats(key, &material.roughness, 1);
+			else if (key.is("sheen"))
+				readFloats(key, &material.sheen, 1);
+			else if (key.is("sheenTint"))
+				readFloats(key, &material.sheenTint, 1);
+			else if (key.is("clearcoat"))
+				readFloats(key, &material.clearcoat, 1);
+			else if (key.is("clearcoatGloss"))
+				readFloats(key, &material.clearcoatGloss, 1);
+			else if (key.is("brdf"))
+				readWord(key, brdf_type);
+			// params for rough dielectrics
+			else if (key.is("intIOR"))
+				readFloats(key, &material.intIOR, 1);
+			else if (key.is("extIOR"))
+				readFloats(key, &material.extIOR, 1);
+			else if (key.is("dist"))
+				readWord(key, dist_type);
+			else
+				ignoreKey(key, keyword);
+		}
+
+		if (name.empty())
+			error(keyword.line, "material without a name");
+
+		if (brdf_type == "DISNEY" || brdf_type == "0")
+			material.brdf = DISNEY;
+		else if (brdf_type == "GLASS" || brdf_type == "1")
+			material.brdf = GLASS;
+		else if (brdf_type == "LAMBERT" || brdf_type == "2")
+			material.brdf = LAMBERT;
+		else if (brdf_type == "ROUGHDIELECTRIC" || brdf_type == "3")
+			material.brdf = ROUGHDIELECTRIC;
+		else
+			material.brdf = DISNEY;
+
+		if (dist_type == "Beckmann" || dist_type == "beckmann" || dist_type == "0")
+			material.dist = Beckmann;
+		else if (dist_type == "GGX" || dist_type == "ggx" || dist_type == "1")
+			material.dist = GGX;
+		else if (dist_type == "Phong" || dist_type == "phong" || dist_type == "2")
+			material.dist = Phong;
+		else
+			material.dist = GGX;
+
+		finishMaterial(material, tex_name);
 
-			while (fgets(line, kMaxLineLength, file))
+		// add material to map
+		m_materials[name] = material;
+	}
+
+	void parseLight(const SceneToken& keyword)
+	{
+		LightParameter light;
+		optix::float3 v1, v2;
+		std::string light_type = "None";
+
+		openBlock(keyword);
+
+		SceneToken key;
+		while (nextKey(keyword, key))
+		{
+			if (key.is("position"))
+				readFloats(key, &light.position.x, 3);
+			else if (key.is("emission"))
+				readFloats(key, &light.emission.x, 3);
+			else if (key.is("normal"))
+				readFloats(key, &light.normal.x, 3);
+			else if (key.is("radius"))
+				readFloats(key, &light.radius, 1);
+			else if (key.is("v1"))
+				readFloats(key, &v1.x, 3);
+			else if (key.is("v2"))
+				readFloats(key, &v2.x, 3);
+			else if (key.is("type"))
+				readWord(key, light_type);
+			else
+				ignoreKey(key, keyword);
+		}
+
+		if (light_type == "Quad" || light_type == "1")
+			setQuadLight(light, v1, v2);
+		else if (light_type == "Sphere" || light_type == "0")
+			setSphereLight(light);
+		else
+			error(keyword.line, "light without a valid type (Quad or Sphere)");
+
+		m_scene->lights.push_back(light);
+	}
+
+	void parseProperties(const SceneToken& keyword)
+	{
+		//Defaults
+		Properties prop;
+		int depth = prop.max_depth;
+
+		openBlock(keyword);
+
+		SceneToken key;
+		while (nextKey(keyword, key))
+		{
+			if (key.is("width"))
+				readInt(key, prop.width);
+			else if (key.is("height"))
+				readInt(key, prop.height);
+			else if (key.is("fov"))
+				readFloats(key, &prop.vfov, 1);
+			else if (key.is("max_depth"))
+				readInt(key, depth);
+			else if (key.is("position"))
+			{
+				readFloats(key, &prop.camera_eye.x, 3);
+				prop.init_eye = true;
+			}
+			else if (key.is("look_at"))
+			{
+				readFloats(key, &prop.camera_lookat.x, 3);
+				prop.init_lookat = true;
+			}
+			else if (key.is("up"))
 			{
-				// end group
-				if (strchr(line, '}'))
-					break;
+				readFloats(key, &prop.camera_up.x, 3);
+				prop.init_up = true;
+			}
+			else if (key.is("envmap"))
+				readWord(key, prop.envmap_fn);
+			else
+				ignoreKey(key, keyword);
+		}
+
+		clipProperties(prop, depth);
+		m_scene->properties = prop;
+	}
 
-				sscanf(line, " position %f %f %f", &light.position.x, &light.position.y, &light.position.z);
-				sscanf(line, " emission %f %f %f", &light.emission.x, &light.emission.y, &light.emission.z);
-				sscanf(line, " normal %f %f %f", &light.normal.x, &light.normal.y, &light.normal.z);
+	// Camera permutation parameters, a "Camera" line starts each entry.
+	void parseCamera(const SceneToken& keyword)
+	{
+		CameraParams cam;
+		int cam_line = 0;
+		int read = 0;
+
+		openBlock(keyword);
+
+		SceneToken key;
+		for (;;)
+		{
+			const bool more = nextKey(keyword, key);
 
-				sscanf(line, " radius %f", &light.radius);
-				sscanf(line, " v1 %f %f %f", &v1.x, &v1.y, &v1.z);
-				sscanf(line, " v2 %f %f %f", &v2.x, &v2.y, &v2.z);
-				sscanf(line, " type %s", light_type);
+			if (cam_line != 0 && (!more || key.is("Camera")))
+			{
+				if (read != 7)
+					error(cam_line, "camera entry needs position, look_at and up");
+				m_scene->cameras.push_back(cam);
+				cam_line = 0;
 			}
+			if (!more)
+				break;
 
-			if (strcmp(light_type, "Quad") == 0 || strcmp(light_type, "1") == 0)
+			if (key.is("Camera"))
+			{
+				cam_line = key.line;
+				read = 0;
+			}
+			else if (cam_line == 0 && (key.is("position") || key.is("look_at") || key.is("up")))
+				error(key.line, "'" + key.text() + "' before the first 'Camera'");
+			else if (key.is("position"))
 			{
-				light.lightType = QUAD;
-				light.u = v1 - light.position;
-				light.v = v2 - light.position;
-				light.area = optix::length(optix::cross(light.u, light.v));
-				light.normal = optix::normalize(optix::cross(light.u, light.v));
+				readFloats(key, &cam.camera_eye.x, 3);
+				read |= 1;
 			}
-			else if (strcmp(light_type, "Sphere") == 0 || strcmp(light_type, "0") == 0)
+			else if (key.is("look_at"))
 			{
-				light.lightType = SPHERE;
-				// light.normal = optix::normalize(light.normal);
-				light.area = 4.0f * M_PIf * light.radius * light.radius;
+				readFloats(key, &cam.camera_lookat.x, 3);
+				read |= 2;
 			}
+			else if (key.is("up"))
+			{
+				readFloats(key, &cam.camera_up.x, 3);
+				read |= 4;
+			}
+			else
+				ignoreKey(key, keyword);
+		}
+
+		printf("Number of cameras for random scene permutation: %d \n", static_cast<int>(m_scene->cameras.size()));
+	}
+
+	void parseMesh(const SceneToken& keyword)
+	{
+		optix::Matrix4x4 xform = optix::Matrix4x4::identity();
+		std::string path;
+		bool has_material = false;
+
+		openBlock(keyword);
 
-			scene->lights.push_back(light);
+		SceneToken key;
+		while (nextKey(keyword, key))
+		{
+			if (key.is("file"))
+				readWord(key, path);
+			else if (key.is("transform"))
+			{
+				float data[4 * 4];
+				readFloats(key, data, 16);
+				xform = optix::Matrix4x4(data);
+			}
+			else if (key.is("material"))
+				readMaterial(key, has_material);
+			else
+				ignoreKey(key, keyword);
 		}
 
-		//--------------------------------------------
-		// Properties
+		if (path.empty())
+			error(keyword.line, "mesh without a file");
+		if (!has_material)
+			error(keyword.line, "mesh without a material");
 
-		//Defaults
-		Properties prop;
+		addMesh(path, xform);
+	}
 
-		if (strstr(line, "properties"))
-		{
-			while (fgets(line, kMaxLineLength, file))
-			{
-				// end group
-				if (strchr(line, '}'))
-					break;
-
-				char envmap_fn[2048];
-
-				if (sscanf(line, " width %i", &prop.width) != 0)
-					prop.width = (prop.width < MINW) ? MINW : ((prop.width > MAXW ? MAXW : prop.width));
-				if (sscanf(line, " height %i", &prop.height) != 0)
-					prop.height = (prop.height < MINH) ? MINH : ((prop.height > MAXH ? MAXH : prop.height));
-				if (sscanf(line, " fov %f", &prop.vfov) != 0)
-					prop.vfov = (prop.vfov < MINFOV) ? MINFOV : prop.vfov;
-				if (sscanf(line, " max_depth %u", &prop.max_depth) != 0)
-					prop.max_depth = (prop.max_depth < MINDEPTH) ? MINDEPTH : ((prop.max_depth > MAXDEPTH ? MAXDEPTH : prop.max_depth));
-
-				if (sscanf(line, " position %f %f %f", &prop.camera_eye.x, &prop.camera_eye.y, &prop.camera_eye.z) != 0)
-					prop.init_eye = true;
-				if (sscanf(line, " look_at %f %f %f", &prop.camera_lookat.x, &prop.camera_lookat.y, &prop.camera_lookat.z) != 0)
-					prop.init_lookat = true;
-				if (sscanf(line, " up %f %f %f", &prop.camera_up.x, &prop.camera_up.y, &prop.camera_up.z) != 0)
-					prop.init_up = true;
-				if (sscanf(line, " envmap %s", envmap_fn) == 1) {
-					prop.envmap_fn = std::string(envmap_fn);
-				}
+	// One mesh file placed with many transforms and the same material.
+	void parseInstance(const SceneToken& keyword)
+	{
+		std::vector<optix::Matrix4x4> xforms;
+		std::string path;
+		bool has_material = false;
+
+		openBlock(keyword);
 
+		SceneToken key;
+		while (nextKey(keyword, key))
+		{
+			if (key.is("file"))
+				readWord(key, path);
+			else if (key.is("transform"))
+			{
+				float data[4 * 4];
+				readFloats(key, data, 16);
+				xforms.push_back(optix::Matrix4x4(data));
 			}
+			else if (key.is("material"))
+				readMaterial(key, has_material);
+			else
+				ignoreKey(key, keyword);
+		}
+
+		if (path.empty())
+			error(keyword.line, "instance without a file");
+		if (!has_material)
+			error(keyword.line, "instance without a material");
+		if (xforms.empty())
+			xforms.push_back(optix::Matrix4x4::identity());
 
-			scene->properties = prop;
+		// The material was added once by readMaterial(), every further placement gets a copy.
+		for (size_t i = 0; i < xforms.size(); ++i)
+		{
+			if (i > 0)
+				m_scene->materials.push_back(m_scene->materials.back());
+			addMesh(path, xforms[i]);
 		}
+	}
+
+	// Every placement needs exactly one material, scene->materials runs parallel to the meshes.
+	void readMaterial(const SceneToken& key, bool& has_material)
+	{
+		if (has_material)
+			error(key.line, "second material in one block");
+
+		std::string material;
+		readWord(key, material);
+
+		// look up material in dictionary
+		std::map<std::string, MaterialParameter>::const_iterator it = m_materials.find(material);
+		if (it == m_materials.end())
+			error(key.line, "could not find material " + material);
+
+		m_scene->materials.push_back(it->second);
+		has_material = true;
+	}
+
+	// Unknown top level keyword, skips its line and the block that follows it.
+	void skipBlock(const SceneToken& keyword)
+	{
+		warning(keyword.line, "unknown keyword '" + keyword.text() + "' (ignored)");
+		m_tokens.skipLine(keyword.line);
+
+		SceneToken tok;
+		if (!m_tokens.peek(tok) || !tok.is("{"))
+			return;
 
-		//--------------------------------------------
-		// Camera Permutation Parameters
-		
-		if (strstr(line, "camera"))
+		m_tokens.next(tok);
+		while (m_tokens.next(tok) && !tok.is("}"))
 		{
-			while (fgets(line, kMaxLineLength, file))
-			{
-				if (strchr(line, '}'))
-					break;
+			if (tok.is("{"))
+				error(tok.line, "nested blocks are not supported");
+		}
+	}
 
-				if (strstr(line, "Camera"))
-				{
-					CameraParams cam;
-					bool read_pos = false, read_look = false, read_up = false;
-
-					while (fgets(line, kMaxLineLength, file))
-					{
-						if (sscanf(line, " position %f %f %f", &cam.camera_eye.x, &cam.camera_eye.y, &cam.camera_eye.z) != 0)
-							read_pos = true;
-						if (sscanf(line, " look_at %f %f %f", &cam.camera_lookat.x, &cam.camera_lookat.y, &cam.camera_lookat.z) != 0)
-							read_look = true;
-						if (sscanf(line, " up %f %f %f", &cam.camera_up.x, &cam.camera_up.y, &cam.camera_up.z) != 0)
-							read_up = true;
-
-						if (read_pos && read_look && read_up)
-							break;
-					}
-
-					scene->cameras.push_back(cam);
-				}
+	void openBlock(const SceneToken& keyword)
+	{
+		SceneToken tok;
+		if (!m_tokens.next(tok) || !tok.is("{"))
+			error(keyword.line, "expected '{' after '" + keyword.text() + "'");
+	}
+
+	// False at the '}' that closes the block.
+	bool nextKey(const SceneToken& keyword, SceneToken& key)
+	{
+		if (!m_tokens.next(key))
+			error(keyword.line, "'" + keyword.text() + "' block is not closed");
+		if (key.is("{"))
+			error(key.line, "nested blocks are not supported");
+		return !key.is("}");
+	}
+
+	// The values of a key are the remaining tokens of its line.
+	bool nextValue(const SceneToken& key, SceneToken& value)
+	{
+		return m_tokens.peekOnLine(key.line, value) && !value.isBrace() && m_tokens.next(value);
+	}
+
+	void endOfValues(const SceneToken& key)
+	{
+		SceneToken tok;
+		if (m_tokens.peekOnLine(key.line, tok) && !tok.isBrace())
+			error(tok.line, "unexpected '" + tok.text() + "' after the values of '" + key.text() + "'");
+	}
+
+	void readFloats(const SceneToken& key, float* values, int n)
+	{
+		for (int i = 0; i < n; ++i)
+		{
+			SceneToken value;
+			if (!nextValue(key, value) || !parseFloat(value, values[i]))
+				error(key.line, "'" + key.text() + "' expects " + std::to_string(n) + " number(s)");
+		}
+		endOfValues(key);
+	}
+
+	void readInt(const SceneToken& key, int& value)
+	{
+		SceneToken tok;
+		if (!nextValue(key, tok) || !parseInt(tok, value))
+			error(key.line, "'" + key.text() + "' expects an integer");
+		endOfValues(key);
+	}
+
+	void readWord(const SceneToken& key, std::string& value)
+	{
+		SceneToken tok;
+		if (!nextValue(key, tok))
+			error(key.line, "'" + key.text() + "' expects a value");
+		value = tok.text();
+		endOfValues(key);
+	}
+
+	// The whole token has to be the number, the buffer is terminated so strto* stops in time.
+	static bool parseFloat(const SceneToken& tok, float& value)
+	{
+		char* end;
+		value = strtof(tok.str, &end);
+		return end == tok.str + tok.len;
+	}
+
+	static bool parseInt(const SceneToken& tok, int& value)
+	{
+		char* end;
+		value = static_cast<int>(strtol(tok.str, &end, 10));
+		return end == tok.str + tok.len;
+	}
+
+	void ignoreKey(const SceneToken& key, const SceneToken& keyword)
+	{
+		warning(key.line, "unknown key '" + key.text() + "' in '" + keyword.text() + "' block (ignored)");
+		m_tokens.skipLine(key.line);
+	}
+
+private:
+	SceneTokenizer m_tokens;
+};
+
+/*
+	One tag of a Mitsuba scene file, text between tags is ignored. Attribute values are decoded.
+*/
+struct XmlTag
+{
+	std::string name;
+	std::vector<std::pair<std::string, std::string>> attributes;
+	bool        closing;	/* </name> */
+	bool        empty;		/* <name ... /> */
+	int         line;
+
+	const std::string* attribute(const char* key) const
+	{
+		for (size_t i = 0; i < attributes.size(); ++i)
+		{
+			if (attributes[i].first == key)
+				return &attributes[i].second;
+		}
+		return NULL;
+	}
+};
+
+/*
+	Streams the tags of the file in a single pass, no document tree is built. Comments, the XML declaration
+	and DOCTYPE are skipped.
+*/
+class XmlTokenizer
+{
+public:
+	XmlTokenizer(const std::string& filename, const char* text)
+		: m_filename(filename), m_cur(text), m_line(1)
+	{
+		// UTF-8 BOM
+		if (strncmp(m_cur, "\xEF\xBB\xBF", 3) == 0)
+			m_cur += 3;
+	}
+
+	bool next(XmlTag& tag)
+	{
+		for (;;)
+		{
+			while (*m_cur != '\0' && *m_cur != '<')
+				advance();
+			if (*m_cur == '\0')
+				return false;
+
+			if (strncmp(m_cur, "<!--", 4) == 0)
+				skipPast("-->");
+			else if (strncmp(m_cur, "<?", 2) == 0)
+				skipPast("?>");
+			else if (strncmp(m_cur, "<!", 2) == 0)
+				skipPast(">");
+			else
+				break;
+		}
+
+		tag.line = m_line;
+		tag.attributes.clear();
+		tag.empty = false;
+
+		++m_cur;
+		tag.closing = *m_cur == '/';
+		if (tag.closing)
+			++m_cur;
+
+		tag.name = readName();
+		if (tag.name.empty())
+			error("expected a tag name");
+
+		for (;;)
+		{
+			skipSpace();
+			if (*m_cur == '>')
+			{
+				++m_cur;
+				return true;
+			}
+			if (*m_cur == '/' && m_cur[1] == '>' && !tag.closing)
+			{
+				m_cur += 2;
+				tag.empty = true;
+				return true;
 			}
+			if (*m_cur == '\0')
+				error("'<" + tag.name + "' is not closed");
 
-			printf("Number of cameras for random scene permutation: %d \n", scene->cameras.size());
+			const std::string key = readName();
+			skipSpace();
+			if (key.empty() || *m_cur != '=')
+				error("malformed attribute in '<" + tag.name + "'");
+			++m_cur;
+			skipSpace();
+			tag.attributes.push_back(std::make_pair(key, readQuoted()));
 		}
+	}
+
+private:
+	void advance()
+	{
+		if (*m_cur == '\n')
+			++m_line;
+		++m_cur;
+	}
+
+	void skipSpace()
+	{
+		while (isspace(static_cast<unsigned char>(*m_cur)))
+			advance();
+	}
+
+	void skipPast(const char* end)
+	{
+		const size_t len = strlen(end);
+		while (*m_cur != '\0' && strncmp(m_cur, end, len) != 0)
+			advance();
+		if (*m_cur == '\0')
+			error(std::string("expected '") + end + "'");
+		m_cur += len;
+	}
 
+	std::string readName()
+	{
+		const char* start = m_cur;
+		while (*m_cur != '\0' && *m_cur != '=' && *m_cur != '>' && *m_cur != '/' && !isspace(static_cast<unsigned char>(*m_cur)))
+			++m_cur;
+		return std::string(start, m_cur);
+	}
 
-		//--------------------------------------------
-		// Mesh
+	std::string readQuoted()
+	{
+		const char quote = *m_cur;
+		if (quote != '"' && quote != '\'')
+			error("expected a quoted attribute value");
+		++m_cur;
 
-		if (strstr(line, "mesh"))
+		std::string value;
+		while (*m_cur != quote)
 		{
-			optix::Matrix4x4 xform = optix::Matrix4x4::identity();
+			if (*m_cur == '\0')
+				error("attribute value is not closed");
+			if (*m_cur == '&')
+				value += readEntity();
+			else
+			{
+				value += *m_cur;
+				advance();
+			}
+		}
+		++m_cur;
+		return value;
+	}
 
-			while (fgets(line, kMaxLineLength, file))
+	char readEntity()
+	{
+		static const struct { const char* name; char c; } entities[] = {
+			{ "&amp;", '&' }, { "&lt;", '<' }, { "&gt;", '>' }, { "&quot;", '"' }, { "&apos;", '\'' } };
+
+		for (size_t i = 0; i < sizeof(entities) / sizeof(entities[0]); ++i)
+		{
+			const size_t len = strlen(entities[i].name);
+			if (strncmp(m_cur, entities[i].name, len) == 0)
 			{
-				// end group
-				if (strchr(line, '}'))
-					break;
+				m_cur += len;
+				return entities[i].c;
+			}
+		}
+		error("unknown entity");
+		return '&';
+	}
 
-				int count = 0;
+	void error(const std::string& msg) const
+	{
+		throw std::runtime_error(m_filename + ":" + std::to_string(m_line) + ": " + msg);
+	}
 
-				char path[2048];
-				float data[4 * 4];
+private:
+	std::string m_filename;
+	const char* m_cur;
+	int         m_line;
+};
 
-				/*
-				if (sscanf(line, " file %s", path) == 1)
-				{
-				const optix::Matrix4x4 xform = optix::Matrix4x4::identity();// optix::Matrix4x4::rotate(-M_PIf / 2.0f, optix::make_float3(0.0f, 1.0f, 0.0f)
-				scene->mesh_names.push_back(std::string(sutil::samplesDir()) + "/data/" + path);
-				scene->transforms.push_back(xform);
-				}
-				*/
+/*
+	Plugins of a Mitsuba 0.6 scene (the format of the Bitterli scenes) mapped to a Scene, with the same conversions as
+	scripts/xml2scene.py: bsdfs become named materials, obj/ply shapes meshes, area emitters on rectangles and spheres
+	Quad and Sphere lights, the integrator and the sensor the properties. Bsdfs and textures are shared through <ref>,
+	shapegroups are placed by instance shapes without loading their files again. Unsupported plugins are reported and skipped.
+*/
+class MitsubaParser : private SceneBuilder
+{
+public:
+	MitsubaParser(const char* filename, const char* text, Scene* scene)
+		: SceneBuilder(filename, scene), m_tags(filename, text), m_depth(scene->properties.max_depth)
+	{
+	}
 
+	void parse()
+	{
+		XmlTag root;
+		if (!m_tags.next(root) || root.closing || root.name != "scene")
+			error(root.line, "expected <scene>");
 
-				if (sscanf(line, " file %s", path) == 1)
-				{
-					scene->mesh_names.push_back(scene->dir + path);
-				}
+		XmlTag tag;
+		while (nextChild(root, tag))
+		{
+			if (tag.name == "integrator")
+				parseIntegrator(tag);
+			else if (tag.name == "sensor")
+				parseSensor(tag);
+			else if (tag.name == "bsdf")
+			{
+				const MaterialParameter material = readBsdf(tag);
+				if (const std::string* id = tag.attribute("id"))
+					m_materials[*id] = material;
+			}
+			else if (tag.name == "texture")
+			{
+				std::string id = attribute(tag, "id");
+				Plugin props;
+				readProperties(tag, props);
+				m_textureFiles[id] = props.values["filename"];
+			}
+			else if (tag.name == "shape")
+				parseShape(tag, NULL);
+			else if (tag.name == "emitter")
+				parseEmitter(tag);
+			else if (tag.name == "default")
+			{
+				m_defaults[attribute(tag, "name")] = attribute(tag, "value");
+				skipElement(tag);
+			}
+			else
+			{
+				warning(tag.line, "unsupported element <" + tag.name + "> (ignored)");
+				skipElement(tag);
+			}
+		}
+
+		clipProperties(m_scene->properties, m_depth);
+	}
+
+private:
+	// Values of the children of a plugin, nested plugins are reduced to what the scene can use.
+	struct Plugin
+	{
+		Plugin() : transform(optix::Matrix4x4::identity()), has_bsdf(false) {}
+
+		std::map<std::string, std::string> values;		/* name -> value of <float>, <rgb>, <point>, ... */
+		std::map<std::string, std::string> textures;	/* name -> bitmap file */
+		std::vector<std::string>           refs;
+		optix::Matrix4x4                   transform;
+		bool                               has_bsdf;
+		MaterialParameter                  bsdf;
+		std::string                        emitter;		/* type of a nested emitter */
+		std::map<std::string, std::string> emitter_values;
+	};
+
+	// A shape of a shapegroup, placed again by every instance of the group.
+	struct Placement
+	{
+		std::string       path;
+		optix::Matrix4x4  transform;
+		MaterialParameter material;
+	};
+
+	void parseIntegrator(const XmlTag& tag)
+	{
+		Plugin props;
+		readProperties(tag, props);
+
+		if (props.values.count("maxDepth"))
+		{
+			// -1 is unbounded in Mitsuba.
+			m_depth = static_cast<int>(number(tag, props.values, "maxDepth", 0.0f));
+			if (m_depth < 0)
+				m_depth = MAXDEPTH;
+		}
+	}
+
+	void parseSensor(const XmlTag& tag)
+	{
+		Plugin props;
+		readProperties(tag, props);
+
+		Properties& prop = m_scene->properties;
+		prop.vfov = number(tag, props.values, "fov", prop.vfov);
+		prop.width = static_cast<int>(number(tag, props.values, "width", static_cast<float>(prop.width)));
+		prop.height = static_cast<int>(number(tag, props.values, "height", static_cast<float>(prop.height)));
+
+		// The camera looks down its local z axis, y is up.
+		const float* m = props.transform.getData();
+		prop.camera_eye = optix::make_float3(m[3], m[7], m[11]);
+		prop.camera_lookat = prop.camera_eye + optix::make_float3(m[2], m[6], m[10]);
+		prop.camera_up = optix::make_float3(m[1], m[5], m[9]);
+		prop.init_eye = prop.init_lookat = prop.init_up = true;
+	}
+
+	// Only environment maps can stand alone, area emitters are part of their shape.
+	void parseEmitter(const XmlTag& tag)
+	{
+		Plugin props;
+		readProperties(tag, props);
+
+		const std::string type = attribute(tag, "type");
+		if (type == "envmap" && props.values.count("filename"))
+			m_scene->properties.envmap_fn = m_scene->dir + props.values["filename"];
+		else
+			warning(tag.line, "unsupported emitter '" + type + "' (ignored)");
+	}
+
+	MaterialParameter readBsdf(const XmlTag& tag)
+	{
+		Plugin props;
+		readProperties(tag, props);
+
+		// twosided, mask and bumpmap wrap the bsdf that defines the material.
+		if (props.has_bsdf)
+			return props.bsdf;
 
-				if (sscanf(line, " transform %f %f %f %f %f %f %f %f %f %f %f %f %f %f %f %f",
-					&data[0], &data[1], &data[2], &data[3],
-					&data[4], &data[5], &data[6], &data[7],
-					&data[8], &data[9], &data[10], &data[11],
-					&data[12], &data[13], &data[14], &data[15]) != 0)
+		const std::string type = attribute(tag, "type");
+		const std::map<std::string, std::string>& values = props.values;
+		MaterialParameter material;
+		std::string tex_name = "None";
+
+		if (type == "diffuse")
+		{
+			readColor(tag, values, "reflectance", material.color);
+			texture(props, "reflectance", tex_name);
+		}
+		else if (type == "plastic")
+		{
+			readColor(tag, values, "diffuseReflectance", material.color);
+			material.roughness = 0.0f;
+		}
+		else if (type == "roughplastic")
+		{
+			material.roughness = number(tag, values, "alpha", material.roughness);
+			readColor(tag, values, "diffuseReflectance", material.color);
+			texture(props, "diffuseReflectance", tex_name);
+		}
+		else if (type == "conductor")
+		{
+			material.color = optix::make_float3(1.0f);
+			material.roughness = 0.0f;
+			material.metallic = 1.0f;
+		}
+		else if (type == "roughconductor")
+		{
+			material.roughness = number(tag, values, "alpha", material.roughness);
+			readColor(tag, values, "specularReflectance", material.color);
+			material.metallic = 1.0f;
+		}
+		else if (type == "dielectric" || type == "thindielectric" || type == "roughdielectric")
+		{
+			material.brdf = GLASS;
+			material.intIOR = ior(tag, values, "intIOR", 1.5046f);
+			material.extIOR = ior(tag, values, "extIOR", 1.000277f);
+			if (!readColor(tag, values, "specularReflectance", material.color))
+				readColor(tag, values, "specularTransmittance", material.color);
+
+			if (type == "roughdielectric")
+			{
+				material.brdf = ROUGHDIELECTRIC;
+				material.roughness = number(tag, values, "alpha", 1.0f);
+
+				const std::map<std::string, std::string>::const_iterator dist = values.find("distribution");
+				if (dist == values.end() || dist->second == "beckmann")
+					material.dist = Beckmann;
+				else if (dist->second == "ggx")
+					material.dist = GGX;
+				else if (dist->second == "phong")
+					material.dist = Phong;
+				else
 				{
-					xform = optix::Matrix4x4(data);
+					warning(tag.line, "unsupported distribution '" + dist->second + "' (using beckmann)");
+					material.dist = Beckmann;
 				}
+			}
+		}
+		else
+			warning(tag.line, "unsupported bsdf '" + type + "' (using the default material)");
 
-				if (sscanf(line, " material %s", path) == 1)
+		finishMaterial(material, tex_name);
+		return material;
+	}
+
+	void parseShape(const XmlTag& tag, std::vector<Placement>* group)
+	{
+		const std::string type = attribute(tag, "type");
+
+		if (type == "shapegroup")
+		{
+			if (group)
+				error(tag.line, "nested shapegroups are not supported");
+
+			std::vector<Placement>& shapes = m_groups[attribute(tag, "id")];
+			XmlTag child;
+			while (nextChild(tag, child))
+			{
+				if (child.name == "shape")
+					parseShape(child, &shapes);
+				else
 				{
-					// look up material in dictionary
-					if (materials_map.find(path) != materials_map.end())
-					{
-						MaterialParameter copy_mat(materials_map[path]);
-						scene->materials.push_back(copy_mat);
-					}
-					else
-					{
-						printf("Could not find material %s\n", path);
-					}
+					warning(child.line, "unsupported element <" + child.name + "> in a shapegroup (ignored)");
+					skipElement(child);
 				}
 			}
+			return;
+		}
+
+		Plugin props;
+		readProperties(tag, props);
+
+		if (type == "instance")
+		{
+			if (props.refs.empty() || !m_groups.count(props.refs[0]))
+				error(tag.line, "instance without a shapegroup");
+
+			// Copy, a shapegroup may be instanced into another one.
+			const std::vector<Placement> shapes = m_groups[props.refs[0]];
+			for (size_t i = 0; i < shapes.size(); ++i)
+				place(shapes[i].path, props.transform * shapes[i].transform, shapes[i].material, group);
+			return;
+		}
+
+		MaterialParameter material;
+		if (props.has_bsdf)
+			material = props.bsdf;
+		else if (!props.refs.empty() && m_materials.count(props.refs[0]))
+			material = m_materials[props.refs[0]];
+		else
+		{
+			if (!props.refs.empty())
+				warning(tag.line, "could not find bsdf " + props.refs[0]);
+			finishMaterial(material, "None");
+		}
+
+		if (props.emitter == "area")
+		{
+			optix::float3 radiance = optix::make_float3(0.0f);
+			readColor(tag, props.emitter_values, "radiance", radiance);
+			const float* m = props.transform.getData();
+
+			// The rectangle spans [-1, 1]^2 in its local xy plane.
+			if (type == "rectangle")
+			{
+				LightParameter light;
+				light.position = optix::make_float3(-m[0] - m[1] + m[3], -m[4] - m[5] + m[7], -m[8] - m[9] + m[11]);
+				light.emission = radiance;
+				setQuadLight(light,
+					light.position + 2.0f * optix::make_float3(m[0], m[4], m[8]),
+					light.position + 2.0f * optix::make_float3(m[1], m[5], m[9]));
+				m_scene->lights.push_back(light);
+				return;
+			}
+			if (type == "sphere")
+			{
+				LightParameter light;
+				light.position = optix::make_float3(0.0f);
+				readPoint(tag, props.values, "center", light.position);
+				light.position = light.position + optix::make_float3(m[3], m[7], m[11]);
+				light.radius = number(tag, props.values, "radius", 1.0f);
+				light.emission = radiance;
+				setSphereLight(light);
+				m_scene->lights.push_back(light);
+				return;
+			}
+
+			// Any other emitting shape is rendered as an emissive mesh.
+			material.emission = radiance;
+		}
+		else if (!props.emitter.empty())
+			warning(tag.line, "unsupported emitter '" + props.emitter + "' on a shape (ignored)");
+
+		std::string path;
+		if (type == "obj" || type == "ply")
+			path = attribute(tag, props.values, "filename");
+		else if (type == "rectangle")
+			path = "models/Rectangle.obj";
+		else
+		{
+			warning(tag.line, "unsupported shape '" + type + "' (ignored)");
+			return;
+		}
+
+		place(path, props.transform, material, group);
+	}
+
+	void place(const std::string& path, const optix::Matrix4x4& xform, const MaterialParameter& material, std::vector<Placement>* group)
+	{
+		if (group)
+		{
+			Placement placement = { path, xform, material };
+			group->push_back(placement);
+			return;
+		}
+
+		m_scene->materials.push_back(material);
+		addMesh(path, xform);
+	}
+
+	void readProperties(const XmlTag& parent, Plugin& props)
+	{
+		XmlTag tag;
+		while (nextChild(parent, tag))
+		{
+			const std::string* name = tag.attribute("name");
+
+			if (tag.name == "integer" || tag.name == "float" || tag.name == "string" || tag.name == "boolean" ||
+				tag.name == "rgb" || tag.name == "srgb" || tag.name == "spectrum")
+			{
+				props.values[attribute(tag, "name")] = attribute(tag, "value");
+				skipElement(tag);
+			}
+			else if (tag.name == "point" || tag.name == "vector")
+			{
+				const std::string* value = tag.attribute("value");
+				props.values[attribute(tag, "name")] = value ? substitute(tag, *value) :
+					attribute(tag, "x") + " " + attribute(tag, "y") + " " + attribute(tag, "z");
+				skipElement(tag);
+			}
+			else if (tag.name == "transform")
+				props.transform = readTransform(tag);
+			else if (tag.name == "texture")
+			{
+				Plugin texture;
+				readProperties(tag, texture);
+				if (attribute(tag, "type") != "bitmap" || !texture.values.count("filename"))
+					warning(tag.line, "unsupported texture '" + attribute(tag, "type") + "' (ignored)");
+				else if (name)
+					props.textures[*name] = texture.values["filename"];
+			}
+			else if (tag.name == "bsdf")
+			{
+				props.bsdf = readBsdf(tag);
+				props.has_bsdf = true;
+			}
+			else if (tag.name == "ref")
+			{
+				// A texture declared at the top level, or a bsdf or shapegroup.
+				const std::string id = attribute(tag, "id");
+				std::map<std::string, std::string>::const_iterator it = m_textureFiles.find(id);
+				if (it != m_textureFiles.end() && name)
+					props.textures[*name] = it->second;
+				else
+					props.refs.push_back(id);
+				skipElement(tag);
+			}
+			else if (tag.name == "emitter")
+			{
+				Plugin emitter;
+				readProperties(tag, emitter);
+				props.emitter = attribute(tag, "type");
+				props.emitter_values = emitter.values;
+			}
+			else if (tag.name == "film" || tag.name == "sampler" || tag.name == "rfilter")
+				readProperties(tag, props);
+			else
+			{
+				warning(tag.line, "unsupported element <" + tag.name + "> in <" + parent.name + "> (ignored)");
+				skipElement(tag);
+			}
+		}
+	}
 
-			scene->transforms.push_back(xform);
+	// Every operation is applied after the ones before it.
+	optix::Matrix4x4 readTransform(const XmlTag& parent)
+	{
+		optix::Matrix4x4 xform = optix::Matrix4x4::identity();
+
+		XmlTag tag;
+		while (nextChild(parent, tag))
+		{
+			optix::Matrix4x4 op = optix::Matrix4x4::identity();
+
+			if (tag.name == "matrix")
+			{
+				float data[4 * 4];
+				if (readFloats(attribute(tag, "value"), data, 16) != 16)
+					error(tag.line, "<matrix> expects 16 numbers");
+				op = optix::Matrix4x4(data);
+			}
+			else if (tag.name == "translate")
+				op = optix::Matrix4x4::translate(vectorAttribute(tag, 0.0f));
+			else if (tag.name == "scale")
+				op = optix::Matrix4x4::scale(vectorAttribute(tag, 1.0f));
+			else if (tag.name == "rotate")
+			{
+				const float angle = number(tag, attribute(tag, "angle"));
+				op = optix::Matrix4x4::rotate(angle * M_PIf / 180.0f, vectorAttribute(tag, 0.0f));
+			}
+			else if (tag.name == "lookat")
+			{
+				optix::float3 origin, target, up = optix::make_float3(0.0f, 1.0f, 0.0f);
+				readPoint(tag, attribute(tag, "origin"), origin);
+				readPoint(tag, attribute(tag, "target"), target);
+				if (const std::string* value = tag.attribute("up"))
+					readPoint(tag, substitute(tag, *value), up);
+
+				const optix::float3 dir = optix::normalize(target - origin);
+				const optix::float3 left = optix::normalize(optix::cross(up, dir));
+				const optix::float3 new_up = optix::cross(dir, left);
+				const float data[4 * 4] = {
+					left.x, new_up.x, dir.x, origin.x,
+					left.y, new_up.y, dir.y, origin.y,
+					left.z, new_up.z, dir.z, origin.z,
+					0.0f,   0.0f,     0.0f,  1.0f };
+				op = optix::Matrix4x4(data);
+			}
+			else
+				warning(tag.line, "unsupported transform <" + tag.name + "> (ignored)");
+
+			xform = op * xform;
+			skipElement(tag);
 		}
+
+		return xform;
 	}
+
+	// False at the end tag of the parent.
+	bool nextChild(const XmlTag& parent, XmlTag& tag)
+	{
+		if (parent.empty)
+			return false;
+		if (!m_tags.next(tag))
+			error(parent.line, "<" + parent.name + "> is not closed");
+		if (tag.closing)
+		{
+			if (tag.name != parent.name)
+				error(tag.line, "</" + tag.name + "> closes <" + parent.name + ">");
+			return false;
+		}
+		return true;
+	}
+
+	void skipElement(const XmlTag& parent)
+	{
+		XmlTag tag;
+		while (nextChild(parent, tag))
+			skipElement(tag);
+	}
+
+	// Attribute values may use the parameters declared with <default>.
+	std::string substitute(const XmlTag& tag, const std::string& value) const
+	{
+		if (value.size() < 2 || value[0] != '$')
+			return value;
+		std::map<std::string, std::string>::const_iterator it = m_defaults.find(value.substr(1));
+		if (it == m_defaults.end())
+			error(tag.line, "undefined parameter " + value);
+		return it->second;
+	}
+
+	std::string attribute(const XmlTag& tag, const char* key) const
+	{
+		const std::string* value = tag.attribute(key);
+		if (!value)
+			error(tag.line, "<" + tag.name + "> without '" + key + "'");
+		return substitute(tag, *value);
+	}
+
+	std::string attribute(const XmlTag& tag, const std::map<std::string, std::string>& values, const char* name) const
+	{
+		std::map<std::string, std::string>::const_iterator it = values.find(name);
+		if (it == values.end())
+			error(tag.line, "<" + tag.name + "> without '" + name + "'");
+		return it->second;
+	}
+
+	// "r, g, b", "r g b" or one gray value.
+	static int readFloats(const std::string& text, float* values, int n)
+	{
+		const char* cur = text.c_str();
+		int count = 0;
+		while (count < n)
+		{
+			while (*cur == ',' || isspace(static_cast<unsigned char>(*cur)))
+				++cur;
+			if (*cur == '\0')
+				break;
+			char* end;
+			values[count] = strtof(cur, &end);
+			if (end == cur)
+				return -1;
+			cur = end;
+			++count;
+		}
+		while (*cur == ',' || isspace(static_cast<unsigned char>(*cur)))
+			++cur;
+		return *cur == '\0' ? count : -1;
+	}
+
+	float number(const XmlTag& tag, const std::string& text) const
+	{
+		float value = 0.0f;
+		if (readFloats(text, &value, 1) != 1)
+			error(tag.line, "'" + text + "' is not a number");
+		return value;
+	}
+
+	float number(const XmlTag& tag, const std::map<std::string, std::string>& values, const char* name, float fallback) const
+	{
+		std::map<std::string, std::string>::const_iterator it = values.find(name);
+		return it == values.end() ? fallback : number(tag, it->second);
+	}
+
+	bool readColor(const XmlTag& tag, const std::map<std::string, std::string>& values, const char* name, optix::float3& color) const
+	{
+		std::map<std::string, std::string>::const_iterator it = values.find(name);
+		if (it == values.end())
+			return false;
+
+		const int count = readFloats(it->second, &color.x, 3);
+		if (count == 1)
+			color.y = color.z = color.x;
+		else if (count != 3)
+			error(tag.line, "'" + it->second + "' is not a color");
+		return true;
+	}
+
+	void readPoint(const XmlTag& tag, const std::string& text, optix::float3& point) const
+	{
+		if (readFloats(text, &point.x, 3) != 3)
+			error(tag.line, "'" + text + "' is not a point");
+	}
+
+	void readPoint(const XmlTag& tag, const std::map<std::string, std::string>& values, const char* name, optix::float3& point) const
+	{
+		std::map<std::string, std::string>::const_iterator it = values.find(name);
+		if (it != values.end())
+			readPoint(tag, it->second, point);
+	}
+
+	// x, y and z attributes, or one value with all three.
+	optix::float3 vectorAttribute(const XmlTag& tag, float fallback) const
+	{
+		optix::float3 v = optix::make_float3(fallback);
+		if (const std::string* value = tag.attribute("value"))
+		{
+			const int count = readFloats(substitute(tag, *value), &v.x, 3);
+			if (count == 1)
+				v.y = v.z = v.x;
+			else if (count != 3)
+				error(tag.line, "'" + *value + "' is not a vector");
+			return v;
+		}
+
+		const char* keys[3] = { "x", "y", "z" };
+		for (int i = 0; i < 3; ++i)
+		{
+			if (const std::string* value = tag.attribute(keys[i]))
+				(&v.x)[i] = number(tag, substitute(tag, *value));
+		}
+		return v;
+	}
+
+	// Named index of refraction values of Mitsuba.
+	float ior(const XmlTag& tag, const std::map<std::string, std::string>& values, const char* name, float fallback) const
+	{
+		static const struct { const char* name; float ior; } named[] = {
+			{ "vacuum", 1.0f }, { "air", 1.000277f }, { "water", 1.333f }, { "water ice", 1.31f },
+			{ "fused quartz", 1.458f }, { "pyrex", 1.47f }, { "acrylic glass", 1.49f }, { "polypropylene", 1.49f },
+			{ "bk7", 1.5046f }, { "diamond", 2.419f } };
+
+		std::map<std::string, std::string>::const_iterator it = values.find(name);
+		if (it == values.end())
+			return fallback;
+		for (size_t i = 0; i < sizeof(named) / sizeof(named[0]); ++i)
+		{
+			if (it->second == named[i].name)
+				return named[i].ior;
+		}
+		return number(tag, it->second);
+	}
+
+	static void texture(const Plugin& props, const char* name, std::string& tex_name)
+	{
+		std::map<std::string, std::string>::const_iterator it = props.textures.find(name);
+		if (it != props.textures.end())
+			tex_name = it->second;
+	}
+
+private:
+	XmlTokenizer m_tags;
+	int          m_depth;
+
+	std::map<std::string, std::string>            m_defaults;
+	std::map<std::string, std::string>            m_textureFiles;
+	std::map<std::string, std::vector<Placement>> m_groups;
+};
+
+Scene* LoadScene(const char* filename, bool use_bundle)
+{
+	sutil::TraceScope trace("LoadScene", filename);
+
+	FILE* file = fopen(filename, "rb");
+	if (!file)
+		throw std::runtime_error(std::string("Couldn't open ") + filename + " for reading.");
+
+	// The tokenizer works on the whole file at once.
+	std::vector<char> text;
+	fseek(file, 0, SEEK_END);
+	const long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	text.resize(size > 0 ? size + 1 : 1);
+	const size_t read = size > 0 ? fread(text.data(), 1, size, file) : 0;
+	text[read] = '\0';
+	fclose(file);
+
+	Scene *scene = new Scene;
+	scene->dir = getDir(filename);
+	scene->source_hash = hashBytes(text.data(), read);
+
+	if (use_bundle)
+	{
+		std::shared_ptr<SceneBundle> bundle(new SceneBundle);
+		const std::string bundle_fn = std::string(filename) + ".bundle";
+		if (bundle->load(bundle_fn, scene->source_hash, *scene))
+		{
+			printf("Loaded the compiled scene %s\n", bundle_fn.c_str());
+			scene->bundle = bundle;
+			return scene;
+		}
+	}
+
+	try
+	{
+		const std::string fn(filename);
+		if (fn.size() > 4 && fn.compare(fn.size() - 4, 4, ".xml") == 0)
+		{
+			MitsubaParser parser(filename, text.data(), scene);
+			parser.parse();
+		}
+		else
+		{
+			SceneParser parser(filename, text.data(), scene);
+			parser.parse();
+		}
+	}
+	catch (...)
+	{
+		delete scene;
+		throw;
+	}
+
 	return scene;
-}
\ No newline at end of file
+}
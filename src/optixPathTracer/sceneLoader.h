@@ -21,6 +21,7 @@ freely, subject to the following restrictions:
 #include <stdio.h>
 
 #include <map>
+#include <memory>
 #include <set>
 #include <string>
 #include <optixu/optixpp_namespace.h>
@@ -40,19 +41,27 @@ freely, subject to the following restrictions:
 #include <iostream>
 #include <stdint.h>
 
+class SceneBundle;
 
 struct Scene
 {
-	Scene() {};
+	Scene() : source_hash(0) {};
+	// One entry per placed mesh (a mesh block or one transform of an instance block).
 	std::vector<std::string> mesh_names;
 	std::vector<optix::Matrix4x4> transforms;
 	std::vector<MaterialParameter> materials;
+	std::vector<int> mesh_geometry; // index into geometry_names
+	std::vector<std::string> geometry_names; // unique mesh files, loaded once and shared by their placements
 	std::vector<LightParameter> lights;
 	std::vector<Texture> textures;
 	std::vector<CameraParams> cameras; // series of camera parameters for random scene permutation
 	std::map<int, std::string> texture_map;
 	std::string dir;
 	Properties properties; // primary camera parameters
+	uint64_t source_hash; // of the scene file text
+	std::shared_ptr<SceneBundle> bundle; // transformed meshes, only if the scene was loaded from its compiled bundle
 };
 
-Scene* LoadScene(const char* filename);
\ No newline at end of file
+// Parses a .scene file, or a Mitsuba .xml scene. Loads <filename>.bundle instead of parsing if it was compiled
+// from the current scene and mesh files.
+Scene* LoadScene(const char* filename, bool use_bundle = true);
\ No newline at end of file
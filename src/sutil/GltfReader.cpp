@@ -0,0 +1,1070 @@
+/*
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "GltfReader.h"
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+
+//------------------------------------------------------------------------------
+//
+// Helpers
+//
+//------------------------------------------------------------------------------
+
+namespace
+{
+
+const uint32_t GLB_MAGIC      = 0x46546C67u;   // "glTF"
+const uint32_t GLB_CHUNK_JSON = 0x4E4F534Au;
+const uint32_t GLB_CHUNK_BIN  = 0x004E4942u;
+
+const int GL_BYTE           = 5120;
+const int GL_UNSIGNED_BYTE  = 5121;
+const int GL_SHORT          = 5122;
+const int GL_UNSIGNED_SHORT = 5123;
+const int GL_UNSIGNED_INT   = 5125;
+const int GL_FLOAT          = 5126;
+
+const int MODE_TRIANGLES = 4;
+
+// Nesting limit of the JSON and of the node hierarchy
+const int MAX_DEPTH = 256;
+
+// Vertices or triangles handed to a thread at a time
+const size_t COPY_GRAIN = 1u << 16;
+
+
+//
+// Minimal JSON DOM, enough for the glTF header chunk
+//
+
+struct JsonValue
+{
+  enum Type { NUL, BOOLEAN, NUMBER, STRING, ARRAY, OBJECT };
+
+  JsonValue() : type( NUL ), number( 0.0 ) {}
+
+  // Member of an object, null if absent or not an object
+  const JsonValue* get( const char* key ) const
+  {
+    if( type != OBJECT )
+      return 0;
+    for( size_t i = 0; i < keys.size(); ++i )
+      if( keys[i] == key )
+        return &items[i];
+    return 0;
+  }
+
+  size_t size() const { return type == ARRAY ? items.size() : 0; }
+
+  Type                     type;
+  double                   number;
+  std::string              string;
+  std::vector<JsonValue>   items;     // array elements or object values
+  std::vector<std::string> keys;      // object keys
+};
+
+
+class JsonParser
+{
+public:
+  JsonParser( const char* begin, const char* end ) : m_p( begin ), m_end( end ) {}
+
+  bool parse( JsonValue& value )
+  {
+    if( !parseValue( value, 0 ) )
+      return false;
+    skipSpace();
+    return m_p == m_end;
+  }
+
+private:
+  void skipSpace()
+  {
+    while( m_p < m_end && ( *m_p == ' ' || *m_p == '\t' || *m_p == '\n' || *m_p == '\r' ) )
+      ++m_p;
+  }
+
+  bool accept( char c )
+  {
+    skipSpace();
+    if( m_p == m_end || *m_p != c )
+      return false;
+    ++m_p;
+    return true;
+  }
+
+  bool parseValue( JsonValue& value, int depth )
+  {
+    skipSpace();
+    if( m_p == m_end || depth > MAX_DEPTH )
+      return false;
+
+    switch( *m_p )
+    {
+      case '{': return parseObject( value, depth );
+      case '[': return parseArray( value, depth );
+      case '"': value.type = JsonValue::STRING; return parseString( value.string );
+      case 't': return parseLiteral( "true",  JsonValue::BOOLEAN, 1.0, value );
+      case 'f': return parseLiteral( "false", JsonValue::BOOLEAN, 0.0, value );
+      case 'n': return parseLiteral( "null",  JsonValue::NUL,     0.0, value );
+      default:  return parseNumber( value );
+    }
+  }
+
+  bool parseLiteral( const char* word, JsonValue::Type type, double number, JsonValue& value )
+  {
+    const size_t length = strlen( word );
+    if( static_cast<size_t>( m_end - m_p ) < length || strncmp( m_p, word, length ) != 0 )
+      return false;
+    m_p += length;
+    value.type   = type;
+    value.number = number;
+    return true;
+  }
+
+  bool parseNumber( JsonValue& value )
+  {
+    // strtod needs a terminated string, numbers are short
+    char   text[64];
+    size_t length = 0;
+    while( m_p + length < m_end && length < sizeof( text ) - 1 &&
+           ( ( m_p[length] >= '0' && m_p[length] <= '9' ) || strchr( "+-.eE", m_p[length] ) ) && m_p[length] != '\0' )
+    {
+      text[length] = m_p[length];
+      ++length;
+    }
+    text[length] = '\0';
+
+    char* end = 0;
+    value.number = strtod( text, &end );
+    if( length == 0 || end != text + length )
+      return false;
+    value.type = JsonValue::NUMBER;
+    m_p += length;
+    return true;
+  }
+
+  static void appendUtf8( uint32_t code, std::string& out )
+  {
+    if( code < 0x80 )
+      out += static_cast<char>( code );
+    else if( code < 0x800 )
+    {
+      out += static_cast<char>( 0xC0 | ( code >> 6 ) );
+      out += static_cast<char>( 0x80 | ( code & 0x3F ) );
+    }
+    else if( code < 0x10000 )
+    {
+      out += static_cast<char>( 0xE0 | ( code >> 12 ) );
+      out += static_cast<char>( 0x80 | ( ( code >> 6 ) & 0x3F ) );
+      out += static_cast<char>( 0x80 | ( code & 0x3F ) );
+    }
+    else
+    {
+      out += static_cast<char>( 0xF0 | ( code >> 18 ) );
+      out += static_cast<char>( 0x80 | ( ( code >> 12 ) & 0x3F ) );
+      out += static_cast<char>( 0x80 | ( ( code >> 6 ) & 0x3F ) );
+      out += static_cast<char>( 0x80 | ( code & 0x3F ) );
+    }
+  }
+
+  bool parseHex4( uint32_t& code )
+  {
+    if( m_end - m_p < 4 )
+      return false;
+    code = 0;
+    for( int i = 0; i < 4; ++i, ++m_p )
+    {
+      const char c = *m_p;
+      code <<= 4;
+      if( c >= '0' && c <= '9' )      code |= c - '0';
+      else if( c >= 'a' && c <= 'f' ) code |= c - 'a' + 10;
+      else if( c >= 'A' && c <= 'F' ) code |= c - 'A' + 10;
+      else return false;
+    }
+    return true;
+  }
+
+  bool parseString( std::string& out )
+  {
+    if( !accept( '"' ) )
+      return false;
+
+    while( m_p < m_end )
+    {
+      const char c = *m_p++;
+      if( c == '"' )
+        return true;
+      if( c != '\\' )
+      {
+        out += c;
+        continue;
+      }
+      if( m_p == m_end )
+        return false;
+
+      const char e = *m_p++;
+      switch( e )
+      {
+        case '"': case '\\': case '/': out += e; break;
+        case 'b': out += '\b'; break;
+        case 'f': out += '\f'; break;
+        case 'n': out += '\n'; break;
+        case 'r': out += '\r'; break;
+        case 't': out += '\t'; break;
+        case 'u':
+        {
+          uint32_t code;
+          if( !parseHex4( code ) )
+            return false;
+          // Surrogate pair
+          if( code >= 0xD800 && code < 0xDC00 && m_end - m_p >= 6 && m_p[0] == '\\' && m_p[1] == 'u' )
+          {
+            m_p += 2;
+            uint32_t low;
+            if( !parseHex4( low ) || low < 0xDC00 || low >= 0xE000 )
+              return false;
+            code = 0x10000 + ( ( code - 0xD800 ) << 10 ) + ( low - 0xDC00 );
+          }
+          appendUtf8( code, out );
+          break;
+        }
+        default:
+          return false;
+      }
+    }
+    return false;
+  }
+
+  bool parseArray( JsonValue& value, int depth )
+  {
+    ++m_p;
+    value.type = JsonValue::ARRAY;
+    if( accept( ']' ) )
+      return true;
+    do
+    {
+      value.items.push_back( JsonValue() );
+      if( !parseValue( value.items.back(), depth + 1 ) )
+        return false;
+    } while( accept( ',' ) );
+    return accept( ']' );
+  }
+
+  bool parseObject( JsonValue& value, int depth )
+  {
+    ++m_p;
+    value.type = JsonValue::OBJECT;
+    if( accept( '}' ) )
+      return true;
+    do
+    {
+      value.keys.push_back( std::string() );
+      value.items.push_back( JsonValue() );
+      skipSpace();
+      if( !parseString( value.keys.back() ) || !accept( ':' ) || !parseValue( value.items.back(), depth + 1 ) )
+        return false;
+    } while( accept( ',' ) );
+    return accept( '}' );
+  }
+
+  const char* m_p;
+  const char* m_end;
+};
+
+
+double getNumber( const JsonValue* value, double fallback )
+{
+  return value && value->type == JsonValue::NUMBER ? value->number : fallback;
+}
+
+
+// Array index, -1 if it is not one
+int toIndex( const JsonValue* value )
+{
+  if( !value || value->type != JsonValue::NUMBER || !( value->number >= 0.0 && value->number < 2147483647.0 ) )
+    return -1;
+  return static_cast<int>( value->number );
+}
+
+
+// Index member of a glTF object, -1 if absent
+int getIndex( const JsonValue& object, const char* key )
+{
+  return toIndex( object.get( key ) );
+}
+
+
+// Byte offset, length or element count.  Values past MAX_SIZE are rejected so
+// the bounds arithmetic cannot overflow.
+const double MAX_SIZE = 1099511627776.0;   // 1 TB
+
+size_t getSize( const JsonValue& object, const char* key, const std::string& error )
+{
+  const double value = getNumber( object.get( key ), 0.0 );
+  if( !( value >= 0.0 && value < MAX_SIZE ) )
+    throw std::runtime_error( error + "has an invalid '" + key + "'" );
+  return static_cast<size_t>( value );
+}
+
+
+std::string getString( const JsonValue& object, const char* key )
+{
+  const JsonValue* value = object.get( key );
+  return value && value->type == JsonValue::STRING ? value->string : std::string();
+}
+
+
+uint32_t readU32( const char* p )
+{
+  const unsigned char* u = reinterpret_cast<const unsigned char*>( p );
+  return uint32_t( u[0] ) | ( uint32_t( u[1] ) << 8 ) | ( uint32_t( u[2] ) << 16 ) | ( uint32_t( u[3] ) << 24 );
+}
+
+
+bool hostIsLittleEndian()
+{
+  const uint32_t one = 1;
+  return *reinterpret_cast<const unsigned char*>( &one ) == 1;
+}
+
+
+size_t componentSize( int component_type )
+{
+  switch( component_type )
+  {
+    case GL_BYTE:
+    case GL_UNSIGNED_BYTE:  return 1;
+    case GL_SHORT:
+    case GL_UNSIGNED_SHORT: return 2;
+    case GL_UNSIGNED_INT:
+    case GL_FLOAT:          return 4;
+    default:                return 0;
+  }
+}
+
+
+int componentCount( const std::string& type )
+{
+  if( type == "SCALAR" ) return 1;
+  if( type == "VEC2" )   return 2;
+  if( type == "VEC3" )   return 3;
+  if( type == "VEC4" )   return 4;
+  return 0;
+}
+
+
+// One component as float, normalized integers map to [0, 1] or [-1, 1]
+inline float readComponent( const char* p, int component_type, bool normalized )
+{
+  switch( component_type )
+  {
+    case GL_FLOAT:          { float v;    memcpy( &v, p, 4 ); return v; }
+    case GL_UNSIGNED_BYTE:  { uint8_t v = *reinterpret_cast<const uint8_t*>( p );
+                              return normalized ? v / 255.0f : v; }
+    case GL_BYTE:           { int8_t v = *reinterpret_cast<const int8_t*>( p );
+                              return normalized ? std::max( v / 127.0f, -1.0f ) : v; }
+    case GL_UNSIGNED_SHORT: { uint16_t v; memcpy( &v, p, 2 ); return normalized ? v / 65535.0f : v; }
+    case GL_SHORT:          { int16_t v;  memcpy( &v, p, 2 ); return normalized ? std::max( v / 32767.0f, -1.0f ) : v; }
+    case GL_UNSIGNED_INT:   { uint32_t v; memcpy( &v, p, 4 ); return static_cast<float>( v ); }
+    default:                return 0.0f;
+  }
+}
+
+
+inline uint32_t readIndex( const char* p, int component_type )
+{
+  switch( component_type )
+  {
+    case GL_UNSIGNED_BYTE:  return *reinterpret_cast<const uint8_t*>( p );
+    case GL_UNSIGNED_SHORT: { uint16_t v; memcpy( &v, p, 2 ); return v; }
+    default:                { uint32_t v; memcpy( &v, p, 4 ); return v; }
+  }
+}
+
+
+// Relative URIs may be percent encoded
+std::string decodeUri( const std::string& uri )
+{
+  std::string out;
+  for( size_t i = 0; i < uri.size(); ++i )
+  {
+    if( uri[i] == '%' && i + 2 < uri.size() && isxdigit( static_cast<unsigned char>( uri[i+1] ) ) &&
+        isxdigit( static_cast<unsigned char>( uri[i+2] ) ) )
+    {
+      out += static_cast<char>( strtol( uri.substr( i + 1, 2 ).c_str(), 0, 16 ) );
+      i += 2;
+    }
+    else
+      out += uri[i];
+  }
+  return out;
+}
+
+
+std::string directoryOf( const std::string& filename )
+{
+  const size_t slash = filename.find_last_of( "/\\" );
+  return slash == std::string::npos ? std::string() : filename.substr( 0, slash + 1 );
+}
+
+
+// Row major 4x4 products, doubles so deep hierarchies keep their precision
+void multiply( const double* a, const double* b, double* result )
+{
+  double r[16];
+  for( int i = 0; i < 4; ++i )
+    for( int j = 0; j < 4; ++j )
+      r[4*i + j] = a[4*i + 0]*b[0 + j] + a[4*i + 1]*b[4 + j] + a[4*i + 2]*b[8 + j] + a[4*i + 3]*b[12 + j];
+  memcpy( result, r, sizeof( r ) );
+}
+
+
+// Local transform of a node, either its column major matrix or T * R * S
+void nodeTransform( const JsonValue& node, double* m )
+{
+  const JsonValue* matrix = node.get( "matrix" );
+  if( matrix && matrix->size() == 16 )
+  {
+    for( int row = 0; row < 4; ++row )
+      for( int col = 0; col < 4; ++col )
+        m[4*row + col] = getNumber( &matrix->items[4*col + row], row == col ? 1.0 : 0.0 );
+    return;
+  }
+
+  double t[3] = { 0.0, 0.0, 0.0 }, s[3] = { 1.0, 1.0, 1.0 }, q[4] = { 0.0, 0.0, 0.0, 1.0 };
+  const JsonValue* translation = node.get( "translation" );
+  const JsonValue* rotation    = node.get( "rotation" );
+  const JsonValue* scale       = node.get( "scale" );
+  for( int k = 0; k < 3; ++k )
+  {
+    if( translation && translation->size() == 3 ) t[k] = getNumber( &translation->items[k], 0.0 );
+    if( scale && scale->size() == 3 )             s[k] = getNumber( &scale->items[k], 1.0 );
+  }
+  if( rotation && rotation->size() == 4 )
+    for( int k = 0; k < 4; ++k )
+      q[k] = getNumber( &rotation->items[k], k == 3 ? 1.0 : 0.0 );
+
+  const double x = q[0], y = q[1], z = q[2], w = q[3];
+  const double r[9] = {
+    1.0 - 2.0*( y*y + z*z ), 2.0*( x*y - z*w ),       2.0*( x*z + y*w ),
+    2.0*( x*y + z*w ),       1.0 - 2.0*( x*x + z*z ), 2.0*( y*z - x*w ),
+    2.0*( x*z - y*w ),       2.0*( y*z + x*w ),       1.0 - 2.0*( x*x + y*y ) };
+
+  for( int row = 0; row < 3; ++row )
+  {
+    for( int col = 0; col < 3; ++col )
+      m[4*row + col] = r[3*row + col] * s[col];
+    m[4*row + 3] = t[row];
+  }
+  m[12] = m[13] = m[14] = 0.0;
+  m[15] = 1.0;
+}
+
+
+// Work item of GltfReader::copyTo()
+struct CopyRange
+{
+  size_t primitive;
+  size_t begin;
+  size_t end;
+};
+
+} // namespace
+
+
+//------------------------------------------------------------------------------
+//
+// GltfReader
+//
+//------------------------------------------------------------------------------
+
+GltfReader::GltfReader()
+  : m_num_vertices( 0 ),
+    m_num_triangles( 0 ),
+    m_has_normals( false ),
+    m_has_texcoords( false )
+{
+}
+
+
+GltfReader::~GltfReader()
+{
+}
+
+
+void GltfReader::clear()
+{
+  m_file.unmap();
+  m_buffers.clear();
+  m_primitives.clear();
+  m_materials.clear();
+  m_num_vertices  = 0;
+  m_num_triangles = 0;
+  m_has_normals   = false;
+  m_has_texcoords = false;
+}
+
+
+void GltfReader::read( const std::string& filename )
+{
+  clear();
+  m_filename = filename;
+  const std::string error = "MeshLoader: glTF file '" + filename + "' ";
+
+  if( !hostIsLittleEndian() )
+    throw std::runtime_error( error + "cannot be read on big endian hosts" );
+  if( !m_file.map( filename ) )
+    throw std::runtime_error( "MeshLoader: Unable to open '" + filename + "'" );
+
+  // A .glb starts with its header and a JSON chunk, an optional BIN chunk
+  // follows.  Anything else is read as .gltf JSON.
+  const char* data = m_file.data();
+  const size_t size = m_file.size();
+  const char* json_begin = data;
+  const char* json_end   = data + size;
+  const char* bin        = 0;
+  size_t      bin_size   = 0;
+  if( size >= 12 && readU32( data ) == GLB_MAGIC )
+  {
+    if( readU32( data + 4 ) != 2 )
+      throw std::runtime_error( error + "is not glTF 2.0" );
+    const size_t length = std::min<size_t>( readU32( data + 8 ), size );
+    if( length < 20 || readU32( data + 16 ) != GLB_CHUNK_JSON || readU32( data + 12 ) > length - 20 )
+      throw std::runtime_error( error + "has no valid JSON chunk" );
+    json_begin = data + 20;
+    json_end   = json_begin + readU32( data + 12 );
+
+    const size_t bin_header = 20 + readU32( data + 12 );
+    if( bin_header + 8 <= length && readU32( data + bin_header + 4 ) == GLB_CHUNK_BIN )
+    {
+      bin      = data + bin_header + 8;
+      bin_size = std::min<size_t>( readU32( data + bin_header ), length - bin_header - 8 );
+    }
+  }
+
+  JsonValue root;
+  if( !JsonParser( json_begin, json_end ).parse( root ) || root.type != JsonValue::OBJECT )
+    throw std::runtime_error( error + "has invalid JSON" );
+
+  const JsonValue* asset = root.get( "asset" );
+  if( !asset || getString( *asset, "version" ).compare( 0, 2, "2." ) != 0 )
+    throw std::runtime_error( error + "is not glTF 2.0" );
+
+  static const JsonValue none;
+  const JsonValue* buffers      = root.get( "buffers" );
+  const JsonValue* buffer_views = root.get( "bufferViews" );
+  const JsonValue* accessors    = root.get( "accessors" );
+  const JsonValue* meshes       = root.get( "meshes" );
+  const JsonValue* nodes        = root.get( "nodes" );
+  const JsonValue* materials    = root.get( "materials" );
+  const JsonValue* textures     = root.get( "textures" );
+  const JsonValue* images       = root.get( "images" );
+  if( !buffers )      buffers      = &none;
+  if( !buffer_views ) buffer_views = &none;
+  if( !accessors )    accessors    = &none;
+  if( !meshes )       meshes       = &none;
+  if( !nodes )        nodes        = &none;
+  if( !materials )    materials    = &none;
+  if( !textures )     textures     = &none;
+  if( !images )       images       = &none;
+
+  // Buffers: the BIN chunk or mapped external files
+  const std::string directory = directoryOf( filename );
+  std::vector<std::pair<const char*, size_t> > buffer_data( buffers->size() );
+  for( size_t i = 0; i < buffers->size(); ++i )
+  {
+    const JsonValue& buffer = buffers->items[i];
+    const std::string uri = getString( buffer, "uri" );
+    const size_t byte_length = getSize( buffer, "byteLength", error );
+    if( uri.empty() )
+    {
+      if( i != 0 || !bin || bin_size < byte_length )
+        throw std::runtime_error( error + "has a buffer without data" );
+      buffer_data[i] = std::make_pair( bin, byte_length );
+    }
+    else if( uri.compare( 0, 5, "data:" ) == 0 )
+      throw std::runtime_error( error + "has an embedded data URI buffer, which is not supported" );
+    else
+    {
+      m_buffers.push_back( std::unique_ptr<sutil::MappedFile>( new sutil::MappedFile ) );
+      if( !m_buffers.back()->map( directory + decodeUri( uri ) ) || m_buffers.back()->size() < byte_length )
+        throw std::runtime_error( error + "references missing or short buffer '" + uri + "'" );
+      buffer_data[i] = std::make_pair( m_buffers.back()->data(), byte_length );
+    }
+  }
+
+  // Accessor lookup with every bound checked once here, so copyTo() needs none
+  const auto resolve = [&]( int index, int components, const int* component_types, Accessor& out )
+  {
+    if( index < 0 || static_cast<size_t>( index ) >= accessors->size() )
+      throw std::runtime_error( error + "references a missing accessor" );
+    const JsonValue& accessor = accessors->items[index];
+    if( accessor.get( "sparse" ) )
+      throw std::runtime_error( error + "has sparse accessors, which are not supported" );
+
+    out.component_type = getIndex( accessor, "componentType" );
+    out.components     = componentCount( getString( accessor, "type" ) );
+    out.count          = getSize( accessor, "count", error );
+    const JsonValue* normalized = accessor.get( "normalized" );
+    out.normalized     = normalized && normalized->type == JsonValue::BOOLEAN && normalized->number != 0.0;
+
+    bool type_ok = out.components == components;
+    bool found = false;
+    for( const int* t = component_types; *t; ++t )
+      found = found || *t == out.component_type;
+    if( !type_ok || !found )
+      throw std::runtime_error( error + "has an accessor of an unsupported type" );
+
+    const int view_index = getIndex( accessor, "bufferView" );
+    if( view_index < 0 || static_cast<size_t>( view_index ) >= buffer_views->size() )
+      throw std::runtime_error( error + "has an accessor without buffer view" );
+    const JsonValue& view = buffer_views->items[view_index];
+    const int buffer = getIndex( view, "buffer" );
+    if( buffer < 0 || static_cast<size_t>( buffer ) >= buffer_data.size() )
+      throw std::runtime_error( error + "has a buffer view without buffer" );
+
+    const size_t view_offset   = getSize( view, "byteOffset", error );
+    const size_t view_length   = getSize( view, "byteLength", error );
+    const size_t offset        = getSize( accessor, "byteOffset", error );
+    const size_t element_size  = componentSize( out.component_type ) * components;
+    out.stride = getSize( view, "byteStride", error );
+    if( out.stride == 0 )
+      out.stride = element_size;
+    if( out.stride < element_size || out.stride > 252 )
+      throw std::runtime_error( error + "has an invalid 'byteStride'" );
+
+    const size_t needed = out.count == 0 ? 0 : offset + out.stride * ( out.count - 1 ) + element_size;
+    if( view_offset + view_length > buffer_data[buffer].second || needed > view_length )
+      throw std::runtime_error( error + "has an accessor outside its buffer" );
+    out.data = buffer_data[buffer].first + view_offset + offset;
+  };
+
+  // Materials, then the default one
+  int embedded_textures = 0;
+  for( size_t i = 0; i < materials->size(); ++i )
+  {
+    const JsonValue& material = materials->items[i];
+    MaterialParams params;
+    params.name = getString( material, "name" );
+    params.Kd[0] = params.Kd[1] = params.Kd[2] = 1.0f;
+    params.Ks[0] = params.Ks[1] = params.Ks[2] = 0.0f;
+    params.Kr[0] = params.Kr[1] = params.Kr[2] = 0.0f;
+    params.Ka[0] = params.Ka[1] = params.Ka[2] = 0.0f;
+    params.exp   = 0.0f;
+
+    if( const JsonValue* pbr = material.get( "pbrMetallicRoughness" ) )
+    {
+      const JsonValue* factor = pbr->get( "baseColorFactor" );
+      if( factor && factor->size() == 4 )
+        for( int k = 0; k < 3; ++k )
+          params.Kd[k] = static_cast<float>( getNumber( &factor->items[k], 1.0 ) );
+
+      const JsonValue* texture_info = pbr->get( "baseColorTexture" );
+      const int texture = texture_info ? getIndex( *texture_info, "index" ) : -1;
+      const int image = texture >= 0 && static_cast<size_t>( texture ) < textures->size() ?
+                        getIndex( textures->items[texture], "source" ) : -1;
+      if( image >= 0 && static_cast<size_t>( image ) < images->size() )
+      {
+        const std::string uri = getString( images->items[image], "uri" );
+        if( !uri.empty() && uri.compare( 0, 5, "data:" ) != 0 )
+          params.Kd_map = directory + decodeUri( uri );
+        else
+          ++embedded_textures;
+      }
+    }
+    m_materials.push_back( params );
+  }
+
+  MaterialParams default_material;
+  default_material.Kd[0] = default_material.Kd[1] = default_material.Kd[2] = 0.7f;
+  default_material.Ks[0] = default_material.Ks[1] = default_material.Ks[2] = 0.0f;
+  default_material.Kr[0] = default_material.Kr[1] = default_material.Kr[2] = 0.0f;
+  default_material.Ka[0] = default_material.Ka[1] = default_material.Ka[2] = 0.0f;
+  default_material.exp   = 0.0f;
+  m_materials.push_back( default_material );
+  const int32_t default_index = static_cast<int32_t>( m_materials.size() - 1 );
+
+  // Root nodes of the default scene, or of the whole file without scenes
+  std::vector<int> roots;
+  const JsonValue* scenes = root.get( "scenes" );
+  if( scenes && scenes->size() > 0 )
+  {
+    int scene = getIndex( root, "scene" );
+    if( scene < 0 || static_cast<size_t>( scene ) >= scenes->size() )
+      scene = 0;
+    const JsonValue* scene_nodes = scenes->items[scene].get( "nodes" );
+    for( size_t i = 0; scene_nodes && i < scene_nodes->size(); ++i )
+      roots.push_back( toIndex( &scene_nodes->items[i] ) );
+  }
+  else
+  {
+    std::vector<bool> is_child( nodes->size(), false );
+    for( size_t i = 0; i < nodes->size(); ++i )
+    {
+      const JsonValue* children = nodes->items[i].get( "children" );
+      for( size_t c = 0; children && c < children->size(); ++c )
+      {
+        const int child = toIndex( &children->items[c] );
+        if( child >= 0 && static_cast<size_t>( child ) < nodes->size() )
+          is_child[child] = true;
+      }
+    }
+    for( size_t i = 0; i < nodes->size(); ++i )
+      if( !is_child[i] )
+        roots.push_back( static_cast<int>( i ) );
+  }
+
+  // Depth first over the hierarchy, every mesh reference bakes its primitives
+  static const int float_types[]    = { GL_FLOAT, 0 };
+  static const int texcoord_types[] = { GL_FLOAT, GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT, 0 };
+  static const int index_types[]    = { GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT, GL_UNSIGNED_INT, 0 };
+  static const double identity[16]  = { 1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,  0, 0, 0, 1 };
+
+  struct Visit { int node; int depth; double xform[16]; };
+  std::vector<Visit> stack;
+  for( size_t i = roots.size(); i-- > 0; )
+  {
+    Visit visit;
+    visit.node  = roots[i];
+    visit.depth = 0;
+    memcpy( visit.xform, identity, sizeof( identity ) );
+    stack.push_back( visit );
+  }
+
+  int     skipped = 0;
+  int64_t num_vertices = 0, num_triangles = 0;
+  m_has_normals = m_has_texcoords = true;
+  while( !stack.empty() )
+  {
+    const Visit parent = stack.back();
+    stack.pop_back();
+    if( parent.node < 0 || static_cast<size_t>( parent.node ) >= nodes->size() || parent.depth > MAX_DEPTH )
+      throw std::runtime_error( error + "has an invalid node hierarchy" );
+
+    const JsonValue& node = nodes->items[parent.node];
+    Visit visit = parent;
+    double local[16];
+    nodeTransform( node, local );
+    multiply( parent.xform, local, visit.xform );
+
+    const JsonValue* children = node.get( "children" );
+    for( size_t c = children ? children->size() : 0; c-- > 0; )
+    {
+      Visit child = visit;
+      child.node  = toIndex( &children->items[c] );
+      child.depth = visit.depth + 1;
+      stack.push_back( child );
+    }
+
+    const int mesh = getIndex( node, "mesh" );
+    if( mesh < 0 )
+      continue;
+    if( static_cast<size_t>( mesh ) >= meshes->size() )
+      throw std::runtime_error( error + "references a missing mesh" );
+    const JsonValue* primitives = meshes->items[mesh].get( "primitives" );
+
+    for( size_t p = 0; primitives && p < primitives->size(); ++p )
+    {
+      const JsonValue& primitive  = primitives->items[p];
+      const JsonValue* attributes = primitive.get( "attributes" );
+      if( !attributes || getNumber( primitive.get( "mode" ), MODE_TRIANGLES ) != MODE_TRIANGLES )
+      {
+        ++skipped;
+        continue;
+      }
+
+      Primitive prim;
+      memset( &prim, 0, sizeof( prim ) );
+      resolve( getIndex( *attributes, "POSITION" ), 3, float_types, prim.positions );
+      if( getIndex( *attributes, "NORMAL" ) >= 0 )
+        resolve( getIndex( *attributes, "NORMAL" ), 3, float_types, prim.normals );
+      if( getIndex( *attributes, "TEXCOORD_0" ) >= 0 )
+        resolve( getIndex( *attributes, "TEXCOORD_0" ), 2, texcoord_types, prim.texcoords );
+      if( getIndex( primitive, "indices" ) >= 0 )
+        resolve( getIndex( primitive, "indices" ), 1, index_types, prim.indices );
+
+      const size_t corners = prim.indices.data ? prim.indices.count : prim.positions.count;
+      if( corners % 3 != 0 )
+        throw std::runtime_error( error + "has a triangle primitive with a partial triangle" );
+      if( prim.normals.data && prim.normals.count < prim.positions.count )
+        throw std::runtime_error( error + "has fewer normals than positions" );
+      if( prim.texcoords.data && prim.texcoords.count < prim.positions.count )
+        throw std::runtime_error( error + "has fewer texcoords than positions" );
+
+      const int material = getIndex( primitive, "material" );
+      prim.material       = material >= 0 && material < default_index ? material : default_index;
+      prim.num_vertices   = static_cast<int32_t>( prim.positions.count );
+      prim.num_triangles  = static_cast<int32_t>( corners / 3 );
+      prim.first_vertex   = static_cast<int32_t>( num_vertices );
+      prim.first_triangle = static_cast<int32_t>( num_triangles );
+      num_vertices  += prim.positions.count;
+      num_triangles += corners / 3;
+      if( num_vertices > std::numeric_limits<int32_t>::max() || num_triangles > std::numeric_limits<int32_t>::max() )
+        throw std::runtime_error( error + "has too many vertices or triangles for one mesh" );
+
+      // Normals go through the inverse transpose, the cofactors divided by the determinant
+      const double* m = visit.xform;
+      prim.identity = std::equal( m, m + 16, identity );
+      for( int k = 0; k < 16; ++k )
+        prim.xform[k] = static_cast<float>( m[k] );
+      const double cofactor[9] = {
+        m[5]*m[10] - m[6]*m[9], m[6]*m[8] - m[4]*m[10], m[4]*m[9] - m[5]*m[8],
+        m[2]*m[9] - m[1]*m[10], m[0]*m[10] - m[2]*m[8], m[1]*m[8] - m[0]*m[9],
+        m[1]*m[6] - m[2]*m[5],  m[2]*m[4] - m[0]*m[6],  m[0]*m[5] - m[1]*m[4] };
+      const double det = m[0]*cofactor[0] + m[1]*cofactor[1] + m[2]*cofactor[2];
+      for( int k = 0; k < 9; ++k )
+        prim.normal_xform[k] = static_cast<float>( det < 0.0 ? -cofactor[k] : cofactor[k] );
+      prim.flip_winding = det < 0.0;
+
+      m_has_normals   = m_has_normals   && prim.normals.data   != 0;
+      m_has_texcoords = m_has_texcoords && prim.texcoords.data != 0;
+      m_primitives.push_back( prim );
+    }
+  }
+
+  if( m_primitives.empty() )
+    m_has_normals = m_has_texcoords = false;
+  m_num_vertices  = static_cast<int32_t>( num_vertices );
+  m_num_triangles = static_cast<int32_t>( num_triangles );
+
+  if( skipped > 0 )
+    std::cerr << "MeshLoader - glTF '" << filename << "': skipped " << skipped
+              << " primitive(s) that are not triangle lists" << std::endl;
+  if( embedded_textures > 0 )
+    std::cerr << "MeshLoader - glTF '" << filename << "': " << embedded_textures
+              << " embedded base color texture(s) are not referenced" << std::endl;
+}
+
+
+int32_t GltfReader::getNumVertices() const
+{
+  return m_num_vertices;
+}
+
+
+int32_t GltfReader::getNumTriangles() const
+{
+  return m_num_triangles;
+}
+
+
+bool GltfReader::hasNormals() const
+{
+  return m_has_normals;
+}
+
+
+bool GltfReader::hasTexcoords() const
+{
+  return m_has_texcoords;
+}
+
+
+const std::vector<MaterialParams>& GltfReader::getMaterials() const
+{
+  return m_materials;
+}
+
+
+namespace
+{
+
+// Copies width components of the elements [begin, end) to dst, one memcpy when
+// the accessor is laid out like the Mesh array
+void gather( const char* data, size_t stride, int component_type, bool normalized, int width,
+             size_t begin, size_t end, float* dst )
+{
+  const size_t element_size = width * sizeof( float );
+  if( component_type == GL_FLOAT && stride == element_size )
+  {
+    memcpy( dst, data + stride*begin, ( end - begin ) * element_size );
+    return;
+  }
+
+  const size_t component_size = componentSize( component_type );
+  for( size_t i = begin; i < end; ++i )
+    for( int k = 0; k < width; ++k )
+      *dst++ = readComponent( data + stride*i + component_size*k, component_type, normalized );
+}
+
+} // namespace
+
+
+void GltfReader::copyTo( Mesh& mesh ) const
+{
+  std::vector<CopyRange> vertex_ranges, triangle_ranges;
+  for( size_t p = 0; p < m_primitives.size(); ++p )
+  {
+    for( size_t b = 0; b < size_t( m_primitives[p].num_vertices ); b += COPY_GRAIN )
+    {
+      CopyRange range = { p, b, std::min( b + COPY_GRAIN, size_t( m_primitives[p].num_vertices ) ) };
+      vertex_ranges.push_back( range );
+    }
+    for( size_t b = 0; b < size_t( m_primitives[p].num_triangles ); b += COPY_GRAIN )
+    {
+      CopyRange range = { p, b, std::min( b + COPY_GRAIN, size_t( m_primitives[p].num_triangles ) ) };
+      triangle_ranges.push_back( range );
+    }
+  }
+
+  // Vertices, with bounds per range
+  std::vector<float> bounds( 6 * vertex_ranges.size() );
+  sutil::parallelFor( vertex_ranges.size(), [&]( size_t r, unsigned int )
+  {
+    const CopyRange& range = vertex_ranges[r];
+    const Primitive& prim  = m_primitives[range.primitive];
+    const size_t     count = range.end - range.begin;
+    float* positions = mesh.positions + 3*( prim.first_vertex + range.begin );
+
+    const Accessor& pos = prim.positions;
+    gather( pos.data, pos.stride, pos.component_type, pos.normalized, 3, range.begin, range.end, positions );
+    if( !prim.identity )
+    {
+      const float* m = prim.xform;
+      for( size_t i = 0; i < count; ++i )
+      {
+        float* v = positions + 3*i;
+        const float x = v[0], y = v[1], z = v[2];
+        v[0] = m[0]*x + m[1]*y + m[2]*z  + m[3];
+        v[1] = m[4]*x + m[5]*y + m[6]*z  + m[7];
+        v[2] = m[8]*x + m[9]*y + m[10]*z + m[11];
+      }
+    }
+
+    if( mesh.has_normals )
+    {
+      float* normals = mesh.normals + 3*( prim.first_vertex + range.begin );
+      const Accessor& nrm = prim.normals;
+      gather( nrm.data, nrm.stride, nrm.component_type, nrm.normalized, 3, range.begin, range.end, normals );
+      if( !prim.identity )
+      {
+        const float* m = prim.normal_xform;
+        for( size_t i = 0; i < count; ++i )
+        {
+          float* n = normals + 3*i;
+          const float x = m[0]*n[0] + m[1]*n[1] + m[2]*n[2];
+          const float y = m[3]*n[0] + m[4]*n[1] + m[5]*n[2];
+          const float z = m[6]*n[0] + m[7]*n[1] + m[8]*n[2];
+          const float length = sqrtf( x*x + y*y + z*z );
+          const float scale = length > 0.0f ? 1.0f / length : 0.0f;
+          n[0] = x * scale;
+          n[1] = y * scale;
+          n[2] = z * scale;
+        }
+      }
+    }
+
+    if( mesh.has_texcoords )
+    {
+      // glTF puts the UV origin at the top left, OBJ and PLY at the bottom left
+      float* texcoords = mesh.texcoords + 2*( prim.first_vertex + range.begin );
+      const Accessor& uv = prim.texcoords;
+      gather( uv.data, uv.stride, uv.component_type, uv.normalized, 2, range.begin, range.end, texcoords );
+      for( size_t i = 0; i < count; ++i )
+        texcoords[2*i + 1] = 1.0f - texcoords[2*i + 1];
+    }
+
+    float* bbox = &bounds[6*r];
+    bbox[0] = bbox[1] = bbox[2] =  1e16f;
+    bbox[3] = bbox[4] = bbox[5] = -1e16f;
+    for( size_t i = 0; i < count; ++i )
+    {
+      for( int k = 0; k < 3; ++k )
+      {
+        bbox[k]   = std::min( bbox[k],   positions[3*i + k] );
+        bbox[k+3] = std::max( bbox[k+3], positions[3*i + k] );
+      }
+    }
+  } );
+
+  for( size_t b = 0; b < bounds.size(); b += 6 )
+  {
+    for( int k = 0; k < 3; ++k )
+    {
+      mesh.bbox_min[k] = std::min( mesh.bbox_min[k], bounds[b + k] );
+      mesh.bbox_max[k] = std::max( mesh.bbox_max[k], bounds[b + k + 3] );
+    }
+  }
+
+  // Triangles, offset to the primitive's first vertex
+  std::atomic<bool> valid( true );
+  sutil::parallelFor( triangle_ranges.size(), [&]( size_t r, unsigned int )
+  {
+    const CopyRange& range = triangle_ranges[r];
+    const Primitive& prim  = m_primitives[range.primitive];
+    const Accessor&  idx   = prim.indices;
+    int32_t* indices = mesh.tri_indices + 3*( prim.first_triangle + range.begin );
+    const size_t corners = 3*( range.end - range.begin );
+
+    if( !idx.data )
+    {
+      for( size_t c = 0; c < corners; ++c )
+        indices[c] = prim.first_vertex + static_cast<int32_t>( 3*range.begin + c );
+    }
+    else
+    {
+      const uint32_t num_vertices = static_cast<uint32_t>( prim.num_vertices );
+      if( idx.component_type == GL_UNSIGNED_INT && idx.stride == 4 )
+        memcpy( indices, idx.data + 4*3*range.begin, corners * sizeof( int32_t ) );
+      else
+        for( size_t c = 0; c < corners; ++c )
+          indices[c] = static_cast<int32_t>( readIndex( idx.data + idx.stride*( 3*range.begin + c ), idx.component_type ) );
+
+      bool in_range = true;
+      for( size_t c = 0; c < corners; ++c )
+      {
+        in_range = in_range && static_cast<uint32_t>( indices[c] ) < num_vertices;
+        indices[c] += prim.first_vertex;
+      }
+      if( !in_range )
+        valid = false;
+    }
+
+    if( prim.flip_winding )
+      for( size_t c = 0; c < corners; c += 3 )
+        std::swap( indices[c + 1], indices[c + 2] );
+
+    std::fill( mesh.mat_indices + prim.first_triangle + range.begin,
+               mesh.mat_indices + prim.first_triangle + range.end, prim.material );
+  } );
+
+  if( !valid )
+    throw std::runtime_error( "MeshLoader: glTF file '" + m_filename + "' has indices past the end of a primitive" );
+}
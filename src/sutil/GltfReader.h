@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "Mesh.h"
+#include "MappedFile.h"
+
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+
+//------------------------------------------------------------------------------
+//
+// glTF 2.0 reader used by MeshLoader, for .glb files and .gltf files with
+// external .bin buffers
+//
+// Buffers are memory mapped and accessors point into them.  The triangle
+// primitives of every node of the default scene are baked into one mesh with
+// their node transforms applied.  Accessors laid out like the Mesh arrays
+// (tightly packed floats, 32 bit indices) are copied with memcpy, all others
+// with a strided per-component copy.  Sparse accessors, data URIs and
+// primitive modes other than TRIANGLES are not supported.
+//
+//------------------------------------------------------------------------------
+class GltfReader
+{
+public:
+  GltfReader();
+  ~GltfReader();
+
+  // Parses the JSON and maps the buffers.  Throws std::runtime_error for
+  // invalid or unsupported files.
+  void read( const std::string& filename );
+
+  // Unmaps the buffers and forgets the primitives
+  void clear();
+
+  int32_t getNumVertices() const;
+  int32_t getNumTriangles() const;
+  bool    hasNormals() const;     // every primitive has normals
+  bool    hasTexcoords() const;   // every primitive has TEXCOORD_0
+
+  // One per glTF material with the base color as Kd and the base color
+  // texture as Kd_map if it is an external image, followed by a default
+  // material for primitives without one.
+  const std::vector<MaterialParams>& getMaterials() const;
+
+  // Fills the arrays of a mesh allocated from the counts above and grows its
+  // bounding box.
+  void copyTo( Mesh& mesh ) const;
+
+private:
+  struct Accessor
+  {
+    const char* data;             // first element, null if absent
+    size_t      count;
+    size_t      stride;
+    int         component_type;   // GL enum, 5120 .. 5126
+    int         components;
+    bool        normalized;
+  };
+
+  struct Primitive
+  {
+    Accessor    positions;
+    Accessor    normals;
+    Accessor    texcoords;
+    Accessor    indices;          // data is null for non-indexed primitives
+    int32_t     material;
+    float       xform[16];        // row major, object to file space
+    float       normal_xform[9];  // inverse transpose of its upper 3x3
+    bool        identity;
+    bool        flip_winding;     // the transform mirrors
+    int32_t     num_vertices;
+    int32_t     num_triangles;
+    int32_t     first_vertex;
+    int32_t     first_triangle;
+  };
+
+  GltfReader( const GltfReader& );
+  GltfReader& operator=( const GltfReader& );
+
+  std::string                                     m_filename;
+  sutil::MappedFile                               m_file;
+  std::vector<std::unique_ptr<sutil::MappedFile> > m_buffers;    // external .bin files
+  std::vector<Primitive>                          m_primitives;
+  std::vector<MaterialParams>                     m_materials;
+  int32_t                                         m_num_vertices;
+  int32_t                                         m_num_triangles;
+  bool                                            m_has_normals;
+  bool                                            m_has_texcoords;
+};
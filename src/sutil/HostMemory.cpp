@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "HostMemory.h"
+
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+//------------------------------------------------------------------------------
+//
+// Counters
+//
+//------------------------------------------------------------------------------
+
+namespace
+{
+
+const char* const CATEGORY_NAMES[sutil::NUM_HOST_MEMORY_CATEGORIES] = { "mesh", "image", "texture", "output" };
+
+std::atomic<uint64_t> g_current[sutil::NUM_HOST_MEMORY_CATEGORIES];
+std::atomic<uint64_t> g_peak[sutil::NUM_HOST_MEMORY_CATEGORIES];
+std::atomic<uint64_t> g_current_total( 0 );
+std::atomic<uint64_t> g_peak_total( 0 );
+
+std::mutex g_tracked_mutex;
+std::unordered_map<const void*, std::pair<size_t, sutil::HostMemoryCategory> > g_tracked;
+
+
+void raise( std::atomic<uint64_t>& peak, uint64_t value )
+{
+  uint64_t old = peak.load( std::memory_order_relaxed );
+  while( value > old && !peak.compare_exchange_weak( old, value, std::memory_order_relaxed ) )
+    ;
+}
+
+} // namespace
+
+
+namespace sutil
+{
+
+const char* hostMemoryCategoryName( HostMemoryCategory category )
+{
+  return CATEGORY_NAMES[category];
+}
+
+
+void hostMemoryAllocated( HostMemoryCategory category, size_t bytes )
+{
+  raise( g_peak[category], g_current[category].fetch_add( bytes, std::memory_order_relaxed ) + bytes );
+  raise( g_peak_total, g_current_total.fetch_add( bytes, std::memory_order_relaxed ) + bytes );
+}
+
+
+void hostMemoryReleased( HostMemoryCategory category, size_t bytes )
+{
+  g_current[category].fetch_sub( bytes, std::memory_order_relaxed );
+  g_current_total.fetch_sub( bytes, std::memory_order_relaxed );
+}
+
+
+void hostMemoryTrack( const void* ptr, size_t bytes, HostMemoryCategory category )
+{
+  if( !ptr )
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock( g_tracked_mutex );
+    g_tracked[ptr] = std::make_pair( bytes, category );
+  }
+  hostMemoryAllocated( category, bytes );
+}
+
+
+void hostMemoryUntrack( const void* ptr )
+{
+  if( !ptr )
+    return;
+
+  std::pair<size_t, HostMemoryCategory> tracked;
+  {
+    std::lock_guard<std::mutex> lock( g_tracked_mutex );
+    auto it = g_tracked.find( ptr );
+    if( it == g_tracked.end() )
+      return;
+    tracked = it->second;
+    g_tracked.erase( it );
+  }
+  hostMemoryReleased( tracked.second, tracked.first );
+}
+
+
+HostMemoryStats hostMemoryStats()
+{
+  HostMemoryStats stats;
+  for( int i = 0; i < NUM_HOST_MEMORY_CATEGORIES; ++i )
+  {
+    stats.current[i] = g_current[i].load( std::memory_order_relaxed );
+    stats.peak[i]    = g_peak[i].load( std::memory_order_relaxed );
+  }
+  stats.current_total = g_current_total.load( std::memory_order_relaxed );
+  stats.peak_total    = g_peak_total.load( std::memory_order_relaxed );
+  return stats;
+}
+
+
+HostMemoryStats hostMemoryResetPeaks()
+{
+  HostMemoryStats stats;
+  for( int i = 0; i < NUM_HOST_MEMORY_CATEGORIES; ++i )
+  {
+    stats.current[i] = g_current[i].load( std::memory_order_relaxed );
+    stats.peak[i]    = g_peak[i].exchange( stats.current[i], std::memory_order_relaxed );
+    // An allocation between the two loads may have raised the peak further.
+    raise( g_peak[i], g_current[i].load( std::memory_order_relaxed ) );
+  }
+  stats.current_total = g_current_total.load( std::memory_order_relaxed );
+  stats.peak_total    = g_peak_total.exchange( stats.current_total, std::memory_order_relaxed );
+  raise( g_peak_total, g_current_total.load( std::memory_order_relaxed ) );
+  return stats;
+}
+
+
+void hostMemoryMergePeaks( const HostMemoryStats& stats )
+{
+  for( int i = 0; i < NUM_HOST_MEMORY_CATEGORIES; ++i )
+    raise( g_peak[i], stats.peak[i] );
+  raise( g_peak_total, stats.peak_total );
+}
+
+} // end namespace sutil
@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <sutilapi.h>
+
+#include <cstddef>
+#include <new>
+#include <stdint.h>
+
+
+//------------------------------------------------------------------------------
+//
+// Host memory accounting.  The large host allocations of the loaders, textures
+// and output path report their bytes to a category, which keeps its current
+// and peak size.  Counters are atomic, allocations may come from any thread.
+//
+//------------------------------------------------------------------------------
+
+namespace sutil
+{
+
+enum HostMemoryCategory
+{
+  HOST_MEMORY_MESH,     // Mesh and QuantizedMesh arrays, including the loader's cleaned copy
+  HOST_MEMORY_IMAGE,    // decoded Image pixels and mipmaps
+  HOST_MEMORY_TEXTURE,  // RGBA32F texels kept for the environment CDF
+  HOST_MEMORY_OUTPUT,   // staging of the .npy writes
+
+  NUM_HOST_MEMORY_CATEGORIES
+};
+
+struct HostMemoryStats
+{
+  uint64_t current[NUM_HOST_MEMORY_CATEGORIES];
+  uint64_t peak[NUM_HOST_MEMORY_CATEGORIES];
+  uint64_t current_total;
+  uint64_t peak_total;  // of the sum, not the sum of the peaks
+};
+
+SUTILAPI const char* hostMemoryCategoryName( HostMemoryCategory category );
+
+SUTILAPI void hostMemoryAllocated( HostMemoryCategory category, size_t bytes );
+SUTILAPI void hostMemoryReleased( HostMemoryCategory category, size_t bytes );
+
+// For arrays whose size is not known where they are freed.  Untracking a null
+// or unknown pointer does nothing.
+SUTILAPI void hostMemoryTrack( const void* ptr, size_t bytes, HostMemoryCategory category );
+SUTILAPI void hostMemoryUntrack( const void* ptr );
+
+SUTILAPI HostMemoryStats hostMemoryStats();
+
+// Restarts the peaks at the current sizes and returns the stats from before.
+// Hand them back to hostMemoryMergePeaks() to nest measurements.
+SUTILAPI HostMemoryStats hostMemoryResetPeaks();
+SUTILAPI void hostMemoryMergePeaks( const HostMemoryStats& stats );
+
+
+// std::allocator that reports to a category, e.g.
+// std::vector<float, TrackedAllocator<float, HOST_MEMORY_OUTPUT> >.
+template<typename T, HostMemoryCategory Category>
+class TrackedAllocator
+{
+public:
+  typedef T value_type;
+
+  template<typename U>
+  struct rebind
+  {
+    typedef TrackedAllocator<U, Category> other;
+  };
+
+  TrackedAllocator() {}
+  template<typename U>
+  TrackedAllocator( const TrackedAllocator<U, Category>& ) {}
+
+  T* allocate( size_t n )
+  {
+    T* ptr = static_cast<T*>( ::operator new( n * sizeof( T ) ) );
+    hostMemoryAllocated( Category, n * sizeof( T ) );
+    return ptr;
+  }
+
+  void deallocate( T* ptr, size_t n )
+  {
+    hostMemoryReleased( Category, n * sizeof( T ) );
+    ::operator delete( ptr );
+  }
+};
+
+template<typename T, typename U, HostMemoryCategory Category>
+bool operator==( const TrackedAllocator<T, Category>&, const TrackedAllocator<U, Category>& ) { return true; }
+
+template<typename T, typename U, HostMemoryCategory Category>
+bool operator!=( const TrackedAllocator<T, Category>&, const TrackedAllocator<U, Category>& ) { return false; }
+
+} // end namespace sutil
@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <string>
+
+#if defined( _WIN32 )
+#  ifndef WIN32_LEAN_AND_MEAN
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+
+//------------------------------------------------------------------------------
+//
+// Memory mapped input for the mesh loaders
+//
+//------------------------------------------------------------------------------
+
+namespace sutil
+{
+
+// Read-only view of a whole file
+class MappedFile
+{
+public:
+  MappedFile() : m_data( 0 ), m_size( 0 ), m_file( 0 ), m_mapping( 0 ) {}
+  ~MappedFile() { unmap(); }
+
+  // Returns false if the file cannot be opened.  An empty file maps to size 0.
+  bool map( const std::string& filename )
+  {
+#if defined( _WIN32 )
+    HANDLE file = CreateFileA( filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                               FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+    if( file == INVALID_HANDLE_VALUE )
+      return false;
+
+    LARGE_INTEGER size;
+    if( !GetFileSizeEx( file, &size ) )
+    {
+      CloseHandle( file );
+      return false;
+    }
+    if( size.QuadPart == 0 )
+    {
+      CloseHandle( file );
+      return true;
+    }
+
+    HANDLE mapping = CreateFileMappingA( file, NULL, PAGE_READONLY, 0, 0, NULL );
+    const void* data = mapping ? MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 ) : NULL;
+    if( !data )
+    {
+      if( mapping )
+        CloseHandle( mapping );
+      CloseHandle( file );
+      return false;
+    }
+
+    m_file    = file;
+    m_mapping = mapping;
+    m_data    = static_cast<const char*>( data );
+    m_size    = static_cast<size_t>( size.QuadPart );
+#else
+    const int fd = open( filename.c_str(), O_RDONLY );
+    if( fd < 0 )
+      return false;
+
+    struct stat st;
+    if( fstat( fd, &st ) != 0 )
+    {
+      close( fd );
+      return false;
+    }
+    if( st.st_size == 0 )
+    {
+      close( fd );
+      return true;
+    }
+
+    void* data = mmap( NULL, static_cast<size_t>( st.st_size ), PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if( data == MAP_FAILED )
+      return false;
+    madvise( data, static_cast<size_t>( st.st_size ), MADV_SEQUENTIAL );
+
+    m_data = static_cast<const char*>( data );
+    m_size = static_cast<size_t>( st.st_size );
+#endif
+    return true;
+  }
+
+  void unmap()
+  {
+    if( !m_data )
+      return;
+#if defined( _WIN32 )
+    UnmapViewOfFile( m_data );
+    CloseHandle( static_cast<HANDLE>( m_mapping ) );
+    CloseHandle( static_cast<HANDLE>( m_file ) );
+#else
+    munmap( const_cast<char*>( m_data ), m_size );
+#endif
+    m_data    = 0;
+    m_size    = 0;
+    m_file    = 0;
+    m_mapping = 0;
+  }
+
+  const char* data() const { return m_data; }
+  size_t      size() const { return m_size; }
+
+private:
+  MappedFile( const MappedFile& );
+  MappedFile& operator=( const MappedFile& );
+
+  const char* m_data;
+  size_t      m_size;
+  void*       m_file;
+  void*       m_mapping;
+};
+
+} // end namespace sutil
@@ -31,11 +31,20 @@
 #include <optixu/optixu_math_stream_namespace.h>
 
 #include "Mesh.h" 
+#include "GltfReader.h"
+#include "HostMemory.h"
+#include "MappedFile.h"
+#include "ObjReader.h"
+#include "ParallelFor.h"
+#include "Trace.h"
 #include "rply-1.01/rply.h"
-#include "tinyobjloader/tiny_obj_loader.h"
 #include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
 #include <iostream>
 #include <locale>
+#include <sstream>
 #include <stdexcept>
 #include <stdint.h>
 #include <vector>
@@ -154,12 +163,18 @@ bool fileIsPLY( const std::string& filename )
 {                                                                              
   return getExtension( filename ) == "ply";                                    
 }
+
+
+bool fileIsGLTF( const std::string& filename )
+{
+  const std::string ext = getExtension( filename );
+  return ext == "glb" || ext == "gltf";
+}
   
 
 struct PlyData
 {
   Mesh* mesh;
-  int32_t cur_vertex;
   int32_t cur_index;
 };
 
@@ -170,39 +185,33 @@ int plyLoadVertex( p_ply_argument argument )
   PlyData* data;
   ply_get_argument_user_data( argument, reinterpret_cast<void**>( &data ), &coord_index );
 
+  int vertex;
+  ply_get_argument_element( argument, NULL, &vertex );
+
   float value = static_cast<float>( ply_get_argument_value( argument ) );
 
   switch( coord_index )
   {
     // Vertex property
     case 0: 
-      data->mesh->positions[3*data->cur_vertex+0] = value;
-      data->mesh->bbox_min[0] = std::min( data->mesh->bbox_min[0], value );
-      data->mesh->bbox_max[0] = std::max( data->mesh->bbox_max[0], value );
-      break;
     case 1: 
-      data->mesh->positions[3*data->cur_vertex+1] = value;
-      data->mesh->bbox_min[1] = std::min( data->mesh->bbox_min[1], value );
-      data->mesh->bbox_max[1] = std::max( data->mesh->bbox_max[1], value );
-      break;
     case 2:
-      data->mesh->positions[3*data->cur_vertex+2] = value;
-      data->mesh->bbox_min[2] = std::min( data->mesh->bbox_min[2], value );
-      data->mesh->bbox_max[2] = std::max( data->mesh->bbox_max[2], value );
-      if( !data->mesh->has_normals )
-        ++data->cur_vertex;
+      data->mesh->positions[3*vertex+coord_index] = value;
+      data->mesh->bbox_min[coord_index] = std::min( data->mesh->bbox_min[coord_index], value );
+      data->mesh->bbox_max[coord_index] = std::max( data->mesh->bbox_max[coord_index], value );
       break;
 
     // Normal property
     case 3: 
-      data->mesh->normals[3*data->cur_vertex+0] = value;
-      break;
     case 4:
-      data->mesh->normals[3*data->cur_vertex+1] = value;
-      break;
     case 5: 
-      data->mesh->normals[3*data->cur_vertex+2] = value;
-      ++data->cur_vertex;
+      data->mesh->normals[3*vertex+coord_index-3] = value;
+      break;
+
+    // Texcoord property
+    case 6:
+    case 7:
+      data->mesh->texcoords[2*vertex+coord_index-6] = value;
       break;
 
       // Silently ignore other coord_index values
@@ -241,7 +250,276 @@ int plyLoadFace( p_ply_argument argument )
   return 1;
 }
 
-  
+
+// Texcoord property names in use, tried in order
+const char* const PLY_TEXCOORD_NAMES[][2] = 
+{
+  { "u",         "v"         },
+  { "s",         "t"         },
+  { "texture_u", "texture_v" },
+  { "texture_s", "texture_t" }
+};
+
+
+//
+// Binary PLY fast path.  Files whose vertices are fixed size records followed
+// by a face element holding only triangle index lists are read straight from
+// the mapped file instead of one rply callback per value.
+//
+
+struct PlyBinaryLayout
+{
+  bool        swap;                 // file endianness differs from the host
+  size_t      vertex_offset;        // first vertex record in the file
+  size_t      vertex_stride;
+  size_t      face_offset;
+  size_t      face_stride;          // list length plus three indices
+  int32_t     num_vertices;
+  int32_t     num_faces;
+  e_ply_type  count_type;
+  e_ply_type  index_type;
+  int         attrib_offset[8];     // x y z nx ny nz u v within a record, -1 if missing
+  e_ply_type  attrib_type[8];
+};
+
+
+// Canonical scalar type of a PLY type name, false for unknown names
+bool plyScalarType( const std::string& name, e_ply_type& type )
+{
+  static const char* const names[] =
+  {
+    "int8", "uint8", "int16", "uint16", "int32", "uint32", "float32", "float64",
+    "char", "uchar", "short", "ushort", "int",   "uint",   "float",   "double"
+  };
+  for( int i = 0; i < 16; ++i )
+  {
+    if( name == names[i] )
+    {
+      type = static_cast<e_ply_type>( PLY_INT8 + i % 8 );
+      return true;
+    }
+  }
+  return false;
+}
+
+
+size_t plyScalarSize( e_ply_type type )
+{
+  static const size_t sizes[] = { 1, 1, 2, 2, 4, 4, 4, 8 };
+  return sizes[type - PLY_INT8];
+}
+
+
+bool hostIsBigEndian()
+{
+  const uint16_t one = 1;
+  uint8_t first;
+  memcpy( &first, &one, 1 );
+  return first == 0;
+}
+
+
+inline double plyReadScalar( const char* p, e_ply_type type, bool swap )
+{
+  unsigned char b[8];
+  const size_t size = plyScalarSize( type );
+  memcpy( b, p, size );
+  if( swap )
+    std::reverse( b, b + size );
+
+  switch( type )
+  {
+    case PLY_INT8:    { int8_t   v; memcpy( &v, b, 1 ); return v; }
+    case PLY_UINT8:   { uint8_t  v; memcpy( &v, b, 1 ); return v; }
+    case PLY_INT16:   { int16_t  v; memcpy( &v, b, 2 ); return v; }
+    case PLY_UINT16:  { uint16_t v; memcpy( &v, b, 2 ); return v; }
+    case PLY_INT32:   { int32_t  v; memcpy( &v, b, 4 ); return v; }
+    case PLY_UIN32:   { uint32_t v; memcpy( &v, b, 4 ); return v; }
+    case PLY_FLOAT32: { float    v; memcpy( &v, b, 4 ); return v; }
+    default:          { double   v; memcpy( &v, b, 8 ); return v; }
+  }
+}
+
+
+// Fills layout from the header of a mapped PLY file.  Returns false for ASCII
+// files and every layout the fast path does not cover.
+bool readPlyBinaryLayout( const char* data, size_t size, PlyBinaryLayout& layout )
+{
+  const char  end_header[] = "end_header";
+  const char* header_end   = 0;
+  for( const char* p = data; p + sizeof( end_header ) <= data + size && p < data + 4096; ++p )
+  {
+    if( ( p == data || p[-1] == '\n' ) && memcmp( p, end_header, sizeof( end_header ) - 1 ) == 0 )
+    {
+      header_end = static_cast<const char*>( memchr( p, '\n', data + size - p ) );
+      break;
+    }
+  }
+  if( !header_end || size < 4 || memcmp( data, "ply", 3 ) != 0 )
+    return false;
+
+  struct Property
+  {
+    std::string name;
+    bool        list;
+    e_ply_type  type;
+    e_ply_type  count_type;
+  };
+  struct Element
+  {
+    std::string           name;
+    long long             count;
+    std::vector<Property> properties;
+  };
+
+  std::vector<Element> elements;
+  bool                 big_endian = false;
+
+  std::istringstream header( std::string( data, header_end ) );
+  std::string        line;
+  while( std::getline( header, line ) )
+  {
+    std::istringstream tokens( line );
+    std::string keyword;
+    tokens >> keyword;
+
+    if( keyword == "format" )
+    {
+      std::string format;
+      tokens >> format;
+      if( format == "binary_big_endian" )
+        big_endian = true;
+      else if( format != "binary_little_endian" )
+        return false;
+    }
+    else if( keyword == "element" )
+    {
+      Element element;
+      if( !( tokens >> element.name >> element.count ) || element.count < 0 || element.count >= 0x7fffffff )
+        return false;
+      elements.push_back( element );
+    }
+    else if( keyword == "property" )
+    {
+      if( elements.empty() )
+        return false;
+
+      Property property;
+      std::string type;
+      tokens >> type;
+      property.list = type == "list";
+      if( property.list )
+      {
+        std::string count_type, value_type;
+        tokens >> count_type >> value_type;
+        if( !plyScalarType( count_type, property.count_type ) || !plyScalarType( value_type, property.type ) )
+          return false;
+      }
+      else if( !plyScalarType( type, property.type ) )
+        return false;
+      tokens >> property.name;
+      elements.back().properties.push_back( property );
+    }
+  }
+
+  // vertex, then face with nothing but integer index lists, then nothing else
+  if( elements.size() != 2 || elements[0].name != "vertex" || elements[1].name != "face" )
+    return false;
+
+  const std::vector<Property>& face = elements[1].properties;
+  if( face.size() != 1 || !face[0].list ||
+      ( face[0].name != "vertex_indices" && face[0].name != "vertex_index" ) ||
+      face[0].type >= PLY_FLOAT32 || face[0].count_type >= PLY_FLOAT32 )
+    return false;
+
+  const char* attrib_names[8] = { "x", "y", "z", "nx", "ny", "nz", 0, 0 };
+  const std::vector<Property>& vertex = elements[0].properties;
+  for( size_t t = 0; t < sizeof( PLY_TEXCOORD_NAMES ) / sizeof( PLY_TEXCOORD_NAMES[0] ) && !attrib_names[6]; ++t )
+  {
+    bool found[2] = { false, false };
+    for( size_t i = 0; i < vertex.size(); ++i )
+      for( int k = 0; k < 2; ++k )
+        found[k] = found[k] || vertex[i].name == PLY_TEXCOORD_NAMES[t][k];
+    if( found[0] && found[1] )
+    {
+      attrib_names[6] = PLY_TEXCOORD_NAMES[t][0];
+      attrib_names[7] = PLY_TEXCOORD_NAMES[t][1];
+    }
+  }
+
+  for( int k = 0; k < 8; ++k )
+  {
+    layout.attrib_offset[k] = -1;
+    layout.attrib_type[k]   = PLY_FLOAT32;
+  }
+
+  size_t stride = 0;
+  for( size_t i = 0; i < vertex.size(); ++i )
+  {
+    if( vertex[i].list )
+      return false;
+    for( int k = 0; k < 8; ++k )
+    {
+      if( attrib_names[k] && vertex[i].name == attrib_names[k] )
+      {
+        layout.attrib_offset[k] = static_cast<int>( stride );
+        layout.attrib_type[k]   = vertex[i].type;
+      }
+    }
+    stride += plyScalarSize( vertex[i].type );
+  }
+  if( layout.attrib_offset[0] < 0 || layout.attrib_offset[1] < 0 || layout.attrib_offset[2] < 0 )
+    return false;
+
+  layout.swap          = big_endian != hostIsBigEndian();
+  layout.vertex_offset = header_end + 1 - data;
+  layout.vertex_stride = stride;
+  layout.num_vertices  = static_cast<int32_t>( elements[0].count );
+  layout.face_offset   = layout.vertex_offset + stride * layout.num_vertices;
+  layout.face_stride   = plyScalarSize( face[0].count_type ) + 3 * plyScalarSize( face[0].type );
+  layout.num_faces     = static_cast<int32_t>( elements[1].count );
+  layout.count_type    = face[0].count_type;
+  layout.index_type    = face[0].type;
+
+  // All faces are triangles exactly when the face records fill the rest of the file
+  return layout.face_offset + layout.face_stride * layout.num_faces == size;
+}
+
+
+// Copies width attributes of every record in [begin, end) to dst, a plain
+// strided copy when they are consecutive native floats
+void plyGather(
+    const char*              records,
+    const PlyBinaryLayout&   layout,
+    int                      first,
+    int                      width,
+    size_t                   begin,
+    size_t                   end,
+    float*                   dst
+    )
+{
+  const int*        offsets = layout.attrib_offset + first;
+  const e_ply_type* types   = layout.attrib_type   + first;
+  const size_t      stride  = layout.vertex_stride;
+
+  bool packed = !layout.swap;
+  for( int k = 0; k < width; ++k )
+    packed = packed && types[k] == PLY_FLOAT32 && offsets[k] == offsets[0] + 4*k;
+
+  if( packed )
+  {
+    for( size_t i = begin; i < end; ++i )
+      memcpy( dst + width*i, records + stride*i + offsets[0], width*sizeof( float ) );
+  }
+  else
+  {
+    for( size_t i = begin; i < end; ++i )
+      for( int k = 0; k < width; ++k )
+        dst[width*i + k] = static_cast<float>( plyReadScalar( records + stride*i + offsets[k], types[k], layout.swap ) );
+  }
+}
+
+
 void applyLoadXForm( Mesh& mesh, const float* load_xform )
 {
   if( !load_xform )
@@ -293,58 +571,103 @@ void applyLoadXForm( Mesh& mesh, const float* load_xform )
 class MeshLoader::Impl
 {
 public:
-  Impl( const std::string& filename );
+  Impl( const std::string& filename, unsigned int flags );
+  ~Impl();
   
   void scanMesh( Mesh& mesh );
   void loadMesh( Mesh& mesh, const float* load_xform );
 
+  void loadFile( Mesh& mesh );
+  void cleanupFile( Mesh& mesh );
+
+  const MeshCleanupStats& getCleanupStats() const { return m_cleanup_stats; }
+
   void scanMeshOBJ( Mesh& mesh );
   void scanMeshPLY( Mesh& mesh );
+  void scanMeshGLTF( Mesh& mesh );
 
   void loadMeshOBJ( Mesh& mesh );
   void loadMeshPLY( Mesh& mesh );
+  void loadMeshPLYBinary( Mesh& mesh );
+  void loadMeshGLTF( Mesh& mesh );
 private:
   enum FileType
   {
     OBJ = 0,
     PLY,
+    GLTF,
     UNKNOWN
   };
   std::string                         m_filename;
   FileType                            m_filetype;
   
-  std::vector<tinyobj::shape_t>       m_shapes;
-  std::vector<tinyobj::material_t>    m_materials;
+  ObjReader                           m_obj;
+  bool                                m_obj_read;
+
+  sutil::MappedFile                   m_ply_file;
+  PlyBinaryLayout                     m_ply_layout;
+  bool                                m_ply_binary;
+
+  GltfReader                          m_gltf;
+  bool                                m_gltf_read;
+
+  unsigned int                        m_flags;           // MeshLoaderFlags
+  Mesh                                m_cleaned;         // whole file after cleanupMesh
+  MeshCleanupStats                    m_cleanup_stats;
 };
 
 
-MeshLoader::Impl::Impl( const std::string& filename )
-  : m_filename( filename )
+MeshLoader::Impl::Impl( const std::string& filename, unsigned int flags )
+  : m_filename( filename ),
+    m_obj_read( false ),
+    m_ply_binary( false ),
+    m_gltf_read( false ),
+    m_flags( flags )
 {
    if( fileIsOBJ( m_filename ) )
      m_filetype = OBJ;
    else if( fileIsPLY( m_filename ) )
      m_filetype = PLY;
+   else if( fileIsGLTF( m_filename ) )
+     m_filetype = GLTF;
    else 
      m_filetype = UNKNOWN;
+
+   clearMesh( m_cleaned );
+   memset( &m_cleanup_stats, 0, sizeof( m_cleanup_stats ) );
+}
+
+
+MeshLoader::Impl::~Impl()
+{
+  freeMesh( m_cleaned );
 }
 
 
 void MeshLoader::Impl::scanMesh( Mesh& mesh )
 {
+  sutil::TraceScope trace( "scanMesh", m_filename );
+
   clearMesh( mesh );
 
   if( m_filetype == OBJ )
     scanMeshOBJ( mesh );
   else if( m_filetype == PLY )
     scanMeshPLY( mesh );
+  else if( m_filetype == GLTF )
+    scanMeshGLTF( mesh );
   else
     throw std::runtime_error( "MeshLoader: Unsupported file type for '" + m_filename + "'" );
+
+  if( m_flags & MESH_LOADER_CLEANUP )
+    cleanupFile( mesh );
 }
 
 
 void MeshLoader::Impl::loadMesh( Mesh& mesh, const float* load_xform )
 {
+  sutil::TraceScope trace( "loadMesh", m_filename );
+
   if( !checkValid( mesh ) )
   {
     std::cerr << "MeshLoader - ERROR: Attempted to load mesh '" << m_filename
@@ -352,7 +675,34 @@ void MeshLoader::Impl::loadMesh( Mesh& mesh, const float* load_xform )
     printMeshInfo( mesh, std::cerr );
     return;
   }
-  
+
+  if( m_cleaned.positions )
+  {
+    // Cleaned at scan time, hand out the copy
+    const Mesh& src = m_cleaned;
+    std::copy( src.positions,   src.positions   + 3*src.num_vertices,  mesh.positions );
+    if( mesh.has_normals )
+      std::copy( src.normals,   src.normals     + 3*src.num_vertices,  mesh.normals );
+    if( mesh.has_texcoords )
+      std::copy( src.texcoords, src.texcoords   + 2*src.num_vertices,  mesh.texcoords );
+    std::copy( src.tri_indices, src.tri_indices + 3*src.num_triangles, mesh.tri_indices );
+    std::copy( src.mat_indices, src.mat_indices + 1*src.num_triangles, mesh.mat_indices );
+    std::copy( src.mat_params,  src.mat_params  + src.num_materials,   mesh.mat_params );
+    std::copy( src.bbox_min,    src.bbox_min    + 3,                   mesh.bbox_min );
+    std::copy( src.bbox_max,    src.bbox_max    + 3,                   mesh.bbox_max );
+  }
+  else
+    loadFile( mesh );
+
+  if( m_flags & MESH_LOADER_REORDER )
+    reorderMesh( mesh );
+
+  applyLoadXForm( mesh, load_xform );
+}
+
+
+void MeshLoader::Impl::loadFile( Mesh& mesh )
+{
   mesh.bbox_min[0] = mesh.bbox_min[1] = mesh.bbox_min[2] =  1e16f;
   mesh.bbox_max[0] = mesh.bbox_max[1] = mesh.bbox_max[2] = -1e16f;
 
@@ -360,15 +710,63 @@ void MeshLoader::Impl::loadMesh( Mesh& mesh, const float* load_xform )
     loadMeshOBJ( mesh );
   else if( m_filetype == PLY )
     loadMeshPLY( mesh );
+  else if( m_filetype == GLTF )
+    loadMeshGLTF( mesh );
   else
     throw std::runtime_error( "MeshLoader: Unsupported file type for '" + m_filename + "'" );
+}
 
-  applyLoadXForm( mesh, load_xform );
+
+void MeshLoader::Impl::cleanupFile( Mesh& mesh )
+{
+  if( !m_cleaned.positions )
+  {
+    m_cleaned = mesh;
+    allocMesh( m_cleaned );
+    if( !m_cleaned.positions )
+      return;
+
+    loadFile( m_cleaned );
+    cleanupMesh( m_cleaned, &m_cleanup_stats );
+
+    // The parsed OBJ and the mapped glTF buffers are not needed anymore
+    m_obj = ObjReader();
+    m_gltf.clear();
+
+    const MeshCleanupStats& s = m_cleanup_stats;
+    if( s.vertices_after != s.vertices_before || s.triangles_after != s.triangles_before )
+      std::cerr << "MeshLoader - cleanup '" << m_filename << "': "
+                << s.vertices_before  << " -> " << s.vertices_after  << " vertices, "
+                << s.triangles_before << " -> " << s.triangles_after << " triangles ("
+                << s.degenerate << " degenerate, " << s.duplicate << " duplicate)" << std::endl;
+  }
+
+  mesh.num_vertices  = m_cleaned.num_vertices;
+  mesh.num_triangles = m_cleaned.num_triangles;
 }
 
 
 void MeshLoader::Impl::scanMeshPLY( Mesh& mesh )
 {
+  if( !m_ply_binary && m_ply_file.map( m_filename ) )
+  {
+    m_ply_binary = readPlyBinaryLayout( m_ply_file.data(), m_ply_file.size(), m_ply_layout );
+    if( !m_ply_binary )
+      m_ply_file.unmap();
+  }
+
+  if( m_ply_binary )
+  {
+    mesh.num_vertices  = m_ply_layout.num_vertices;
+    mesh.has_normals   = m_ply_layout.attrib_offset[3] >= 0 &&
+                         m_ply_layout.attrib_offset[4] >= 0 &&
+                         m_ply_layout.attrib_offset[5] >= 0;
+    mesh.has_texcoords = m_ply_layout.attrib_offset[6] >= 0;
+    mesh.num_triangles = m_ply_layout.num_faces;
+    mesh.num_materials = 1; // default material
+    return;
+  }
+
   p_ply ply = ply_open( m_filename.c_str(), 0 );                       
 
   if( !ply )
@@ -383,6 +781,9 @@ void MeshLoader::Impl::scanMeshPLY( Mesh& mesh )
   mesh.num_triangles = ply_set_read_cb( ply, "face",   "vertex_indices", NULL, NULL, 0 );
   
   mesh.has_texcoords = false;
+  for( size_t t = 0; t < sizeof( PLY_TEXCOORD_NAMES ) / sizeof( PLY_TEXCOORD_NAMES[0] ) && !mesh.has_texcoords; ++t )
+    mesh.has_texcoords = ply_set_read_cb( ply, "vertex", PLY_TEXCOORD_NAMES[t][0], NULL, NULL, 6 ) != 0 &&
+                         ply_set_read_cb( ply, "vertex", PLY_TEXCOORD_NAMES[t][1], NULL, NULL, 7 ) != 0;
   
   mesh.num_materials = 1; // default material
 
@@ -392,28 +793,43 @@ void MeshLoader::Impl::scanMeshPLY( Mesh& mesh )
 
 void MeshLoader::Impl::loadMeshPLY( Mesh& mesh )
 {
-  p_ply ply = ply_open( m_filename.c_str(), 0 );                       
+  if( m_ply_binary )
+  {
+    loadMeshPLYBinary( mesh );
+  }
+  else
+  {
+    p_ply ply = ply_open( m_filename.c_str(), 0 );                       
 
-  if( !ply )
-    throw std::runtime_error( "MeshLoader: Unable to open '" + m_filename + "'" );
+    if( !ply )
+      throw std::runtime_error( "MeshLoader: Unable to open '" + m_filename + "'" );
 
-  if( !ply_read_header( ply ) )
-    throw std::runtime_error( "MeshLoader: Unable to read PLY header '" + m_filename + "'" );
-  
-  PlyData ply_data = {0};
-  ply_data.mesh = &mesh;
-
-  ply_set_read_cb( ply, "vertex", "x",  plyLoadVertex, &ply_data, 0 );
-  ply_set_read_cb( ply, "vertex", "y",  plyLoadVertex, &ply_data, 1 );
-  ply_set_read_cb( ply, "vertex", "z",  plyLoadVertex, &ply_data, 2 );
-  ply_set_read_cb( ply, "vertex", "nx", plyLoadVertex, &ply_data, 3 );
-  ply_set_read_cb( ply, "vertex", "ny", plyLoadVertex, &ply_data, 4 );
-  ply_set_read_cb( ply, "vertex", "nz", plyLoadVertex, &ply_data, 5 );
-  ply_set_read_cb( ply, "face", "vertex_indices", plyLoadFace, &ply_data, 0);
-
-  if( !ply_read( ply ) ) 
-    throw std::runtime_error( "MeshLoader: Error parsing ply file (" + m_filename + ")" );
-  ply_close( ply );
+    if( !ply_read_header( ply ) )
+      throw std::runtime_error( "MeshLoader: Unable to read PLY header '" + m_filename + "'" );
+    
+    PlyData ply_data = { &mesh, 0 };
+
+    ply_set_read_cb( ply, "vertex", "x",  plyLoadVertex, &ply_data, 0 );
+    ply_set_read_cb( ply, "vertex", "y",  plyLoadVertex, &ply_data, 1 );
+    ply_set_read_cb( ply, "vertex", "z",  plyLoadVertex, &ply_data, 2 );
+    if( mesh.has_normals )
+    {
+      ply_set_read_cb( ply, "vertex", "nx", plyLoadVertex, &ply_data, 3 );
+      ply_set_read_cb( ply, "vertex", "ny", plyLoadVertex, &ply_data, 4 );
+      ply_set_read_cb( ply, "vertex", "nz", plyLoadVertex, &ply_data, 5 );
+    }
+    for( size_t t = 0; t < sizeof( PLY_TEXCOORD_NAMES ) / sizeof( PLY_TEXCOORD_NAMES[0] ) && mesh.has_texcoords; ++t )
+    {
+      if( ply_set_read_cb( ply, "vertex", PLY_TEXCOORD_NAMES[t][0], plyLoadVertex, &ply_data, 6 ) != 0 &&
+          ply_set_read_cb( ply, "vertex", PLY_TEXCOORD_NAMES[t][1], plyLoadVertex, &ply_data, 7 ) != 0 )
+        break;
+    }
+    ply_set_read_cb( ply, "face", "vertex_indices", plyLoadFace, &ply_data, 0);
+
+    if( !ply_read( ply ) ) 
+      throw std::runtime_error( "MeshLoader: Error parsing ply file (" + m_filename + ")" );
+    ply_close( ply );
+  }
 
 
   // Fill in default white matte material
@@ -432,155 +848,149 @@ void MeshLoader::Impl::loadMeshPLY( Mesh& mesh )
 }
 
 
-void MeshLoader::Impl::scanMeshOBJ( Mesh& mesh )
+void MeshLoader::Impl::loadMeshPLYBinary( Mesh& mesh )
 {
-  if( m_shapes.empty() )
+  const PlyBinaryLayout& layout   = m_ply_layout;
+  const char*            vertices = m_ply_file.data() + layout.vertex_offset;
+  const char*            faces    = m_ply_file.data() + layout.face_offset;
+  const size_t           grain    = 1u << 16;
+
+  // Vertex records, with bounds per block of vertices
+  const size_t num_vertices = layout.num_vertices;
+  std::vector<float> bounds( 6 * ( ( num_vertices + grain - 1 ) / grain ) );
+  sutil::parallelForRange( num_vertices, grain, [&]( size_t begin, size_t end )
   {
-    std::string err;
-    bool ret = tinyobj::LoadObj( 
-        m_shapes,
-        m_materials,
-        err, 
-        m_filename.c_str(),
-        directoryOfFilePath( m_filename ).c_str()
-        );
-
-    if( !err.empty() )
-      std::cerr << err << std::endl;
+    plyGather( vertices, layout, 0, 3, begin, end, mesh.positions );
+    if( mesh.has_normals )
+      plyGather( vertices, layout, 3, 3, begin, end, mesh.normals );
+    if( mesh.has_texcoords )
+      plyGather( vertices, layout, 6, 2, begin, end, mesh.texcoords );
 
-    if( !ret )
-      throw std::runtime_error( "MeshLoader: " + err );
-  }
+    float* bbox = &bounds[6 * ( begin / grain )];
+    bbox[0] = bbox[1] = bbox[2] =  1e16f;
+    bbox[3] = bbox[4] = bbox[5] = -1e16f;
+    for( size_t i = begin; i < end; ++i )
+    {
+      for( int k = 0; k < 3; ++k )
+      {
+        bbox[k]   = std::min( bbox[k],   mesh.positions[3*i + k] );
+        bbox[k+3] = std::max( bbox[k+3], mesh.positions[3*i + k] );
+      }
+    }
+  } );
 
-  //
-  // Iterate over all shapes and sum up number of vertices and triangles
-  //
-  uint64_t num_groups_with_normals   = 0;
-  uint64_t num_groups_with_texcoords = 0;
-  for( std::vector<tinyobj::shape_t>::const_iterator it = m_shapes.begin();
-       it < m_shapes.end();
-       ++it )
+  for( size_t b = 0; b < bounds.size(); b += 6 )
   {
-    const tinyobj::shape_t & shape = *it;
-
-    mesh.num_triangles += static_cast<int32_t>(shape.mesh.indices.size()) / 3;
-    mesh.num_vertices  += static_cast<int32_t>(shape.mesh.positions.size()) / 3;
-
-    if( !shape.mesh.normals.empty() )
-      ++num_groups_with_normals; 
-
-    if( !shape.mesh.texcoords.empty() )
-      ++num_groups_with_texcoords; 
+    for( int k = 0; k < 3; ++k )
+    {
+      mesh.bbox_min[k] = std::min( mesh.bbox_min[k], bounds[b + k] );
+      mesh.bbox_max[k] = std::max( mesh.bbox_max[k], bounds[b + k + 3] );
+    }
   }
 
-  //
-  // We ignore normals and texcoords unless they are present for all shapes
-  //
+  // Triangle records: list length 3 and three indices
+  const size_t count_size = plyScalarSize( layout.count_type );
+  const size_t index_size = plyScalarSize( layout.index_type );
+  const bool   native     = !layout.swap && ( layout.index_type == PLY_INT32 || layout.index_type == PLY_UIN32 );
 
-  if( num_groups_with_normals != 0 )
+  std::atomic<bool> all_triangles( true );
+  sutil::parallelForRange( layout.num_faces, grain, [&]( size_t begin, size_t end )
   {
-    if( num_groups_with_normals != m_shapes.size() )
-      std::cerr << "MeshLoader - WARNING: mesh '" << m_filename 
-                << "' has normals for some groups but not all.  "
-                << "Ignoring all normals." << std::endl;
-    else
-      mesh.has_normals = true;
+    for( size_t f = begin; f < end; ++f )
+    {
+      const char* record = faces + layout.face_stride*f;
+      if( plyReadScalar( record, layout.count_type, layout.swap ) != 3.0 )
+        all_triangles = false;
+
+      if( native )
+        memcpy( mesh.tri_indices + 3*f, record + count_size, 3*sizeof( int32_t ) );
+      else
+        for( int k = 0; k < 3; ++k )
+          mesh.tri_indices[3*f + k] = static_cast<int32_t>(
+              plyReadScalar( record + count_size + k*index_size, layout.index_type, layout.swap ) );
+    }
+  } );
 
-  }
-  
-  if( num_groups_with_texcoords != 0 )
+  if( !all_triangles )
+    throw std::runtime_error( "MeshLoader: PLY file '" + m_filename + "' has faces that are not triangles" );
+}
+
+
+void MeshLoader::Impl::scanMeshOBJ( Mesh& mesh )
+{
+  if( !m_obj_read )
   {
-    if( num_groups_with_texcoords != m_shapes.size() )
-      std::cerr << "MeshLoader - WARNING: mesh '" << m_filename 
-                << "' has texcoords for some groups but not all.  "
-                << "Ignoring all texcoords." << std::endl;
-    else
-      mesh.has_texcoords = true;
+    m_obj.read( m_filename, directoryOfFilePath( m_filename ) );
+    m_obj_read = true;
   }
 
-  mesh.num_materials = (int32_t) m_materials.size();
+  mesh.num_vertices  = m_obj.getNumVertices();
+  mesh.num_triangles = m_obj.getNumTriangles();
+  mesh.has_normals   = m_obj.hasNormals();
+  mesh.has_texcoords = m_obj.hasTexcoords();
+  mesh.num_materials = (int32_t) m_obj.getMaterials().size();
 }
 
 
 void MeshLoader::Impl::loadMeshOBJ( Mesh& mesh )
 {
-  uint32_t vrt_offset = 0;
-  uint32_t tri_offset = 0;
-  for( std::vector<tinyobj::shape_t>::const_iterator it = m_shapes.begin();
-       it < m_shapes.end();
-       ++it )
-  {
-    const tinyobj::shape_t & shape = *it;
-    for( uint64_t i = 0; i < shape.mesh.positions.size() / 3; ++i )
-    {
-      const float x = shape.mesh.positions[i*3+0];
-      const float y = shape.mesh.positions[i*3+1];
-      const float z = shape.mesh.positions[i*3+2];
+  m_obj.copyTo( mesh );
 
-      mesh.bbox_min[0] = std::min<float>( mesh.bbox_min[0], x );
-      mesh.bbox_min[1] = std::min<float>( mesh.bbox_min[1], y );
-      mesh.bbox_min[2] = std::min<float>( mesh.bbox_min[2], z );
+  const std::vector<tinyobj::material_t>& materials = m_obj.getMaterials();
+  for( uint64_t i = 0; i < materials.size(); ++i )
+  {
+    MaterialParams mat_params;
 
-      mesh.bbox_max[0] = std::max<float>( mesh.bbox_max[0], x );
-      mesh.bbox_max[1] = std::max<float>( mesh.bbox_max[1], y );
-      mesh.bbox_max[2] = std::max<float>( mesh.bbox_max[2], z );
+    mat_params.name   = materials[i].name;
 
-      mesh.positions[ vrt_offset*3 + i*3+0 ] = x; 
-      mesh.positions[ vrt_offset*3 + i*3+1 ] = y; 
-      mesh.positions[ vrt_offset*3 + i*3+2 ] = z; 
-    }
+    mat_params.Kd_map = materials[i].diffuse_texname.empty() ? "" :
+                        directoryOfFilePath( m_filename ) + materials[i].diffuse_texname;
 
-    if( mesh.has_normals )
-      for( uint64_t i = 0; i < shape.mesh.normals.size(); ++i )
-        mesh.normals[ vrt_offset*3 + i ] = shape.mesh.normals[i];
-    
-    if( mesh.has_texcoords )
-      for( uint64_t i = 0; i < shape.mesh.texcoords.size(); ++i )
-        mesh.texcoords[ vrt_offset*2 + i ] = shape.mesh.texcoords[i];
+    mat_params.Kd[0]  = materials[i].diffuse[0];
+    mat_params.Kd[1]  = materials[i].diffuse[1];
+    mat_params.Kd[2]  = materials[i].diffuse[2];
     
-    for( uint64_t i = 0; i < shape.mesh.indices.size() / 3; ++i )
-    {
-      mesh.tri_indices[ tri_offset*3 + i*3+0 ] = shape.mesh.indices[i*3+0] + vrt_offset;
-      mesh.tri_indices[ tri_offset*3 + i*3+1 ] = shape.mesh.indices[i*3+1] + vrt_offset;
-      mesh.tri_indices[ tri_offset*3 + i*3+2 ] = shape.mesh.indices[i*3+2] + vrt_offset;
-      mesh.mat_indices[ tri_offset + i ] = shape.mesh.material_ids[i] >= 0 ? 
-                                           shape.mesh.material_ids[i]      :
-                                           0; 
-    }
+    mat_params.Ks[0]  = materials[i].specular[0];
+    mat_params.Ks[1]  = materials[i].specular[1];
+    mat_params.Ks[2]  = materials[i].specular[2];
 
-    vrt_offset += static_cast<uint32_t>(shape.mesh.positions.size()) / 3;
-    tri_offset += static_cast<uint32_t>(shape.mesh.indices.size()) / 3;
-  }
+    mat_params.Ka[0]  = materials[i].ambient[0];
+    mat_params.Ka[1]  = materials[i].ambient[1];
+    mat_params.Ka[2]  = materials[i].ambient[2];
 
-  for( uint64_t i = 0; i < m_materials.size(); ++i )
-  {
-    MaterialParams mat_params;
+    mat_params.Kr[0]  = materials[i].specular[0];
+    mat_params.Kr[1]  = materials[i].specular[1];
+    mat_params.Kr[2]  = materials[i].specular[2];
 
-    mat_params.name   = m_materials[i].name;
+    mat_params.exp    = materials[i].shininess;
 
-    mat_params.Kd_map = m_materials[i].diffuse_texname.empty() ? "" :
-                        directoryOfFilePath( m_filename ) + m_materials[i].diffuse_texname;
+    mesh.mat_params[i] = mat_params;
+  }
+}
 
-    mat_params.Kd[0]  = m_materials[i].diffuse[0];
-    mat_params.Kd[1]  = m_materials[i].diffuse[1];
-    mat_params.Kd[2]  = m_materials[i].diffuse[2];
-    
-    mat_params.Ks[0]  = m_materials[i].specular[0];
-    mat_params.Ks[1]  = m_materials[i].specular[1];
-    mat_params.Ks[2]  = m_materials[i].specular[2];
 
-    mat_params.Ka[0]  = m_materials[i].ambient[0];
-    mat_params.Ka[1]  = m_materials[i].ambient[1];
-    mat_params.Ka[2]  = m_materials[i].ambient[2];
+void MeshLoader::Impl::scanMeshGLTF( Mesh& mesh )
+{
+  if( !m_gltf_read )
+  {
+    m_gltf.read( m_filename );
+    m_gltf_read = true;
+  }
 
-    mat_params.Kr[0]  = m_materials[i].specular[0];
-    mat_params.Kr[1]  = m_materials[i].specular[1];
-    mat_params.Kr[2]  = m_materials[i].specular[2];
+  mesh.num_vertices  = m_gltf.getNumVertices();
+  mesh.num_triangles = m_gltf.getNumTriangles();
+  mesh.has_normals   = m_gltf.hasNormals();
+  mesh.has_texcoords = m_gltf.hasTexcoords();
+  mesh.num_materials = (int32_t) m_gltf.getMaterials().size();
+}
 
-    mat_params.exp    = m_materials[i].shininess;
 
-    mesh.mat_params[i] = mat_params;
-  }
+void MeshLoader::Impl::loadMeshGLTF( Mesh& mesh )
+{
+  m_gltf.copyTo( mesh );
+
+  const std::vector<MaterialParams>& materials = m_gltf.getMaterials();
+  std::copy( materials.begin(), materials.end(), mesh.mat_params );
 }
 
 
@@ -663,11 +1073,27 @@ SUTILAPI void allocMesh( Mesh& mesh )
   mesh.mat_indices = new int32_t[ 1*mesh.num_triangles ]; 
 
   mesh.mat_params  = new MaterialParams[ mesh.num_materials ];
+
+  // Tracked per array, the cleanup shrinks the counts in place
+  const sutil::HostMemoryCategory category = sutil::HOST_MEMORY_MESH;
+  sutil::hostMemoryTrack( mesh.positions,   3*mesh.num_vertices*sizeof( float ),         category );
+  sutil::hostMemoryTrack( mesh.normals,     3*mesh.num_vertices*sizeof( float ),         category );
+  sutil::hostMemoryTrack( mesh.texcoords,   2*mesh.num_vertices*sizeof( float ),         category );
+  sutil::hostMemoryTrack( mesh.tri_indices, 3*mesh.num_triangles*sizeof( int32_t ),      category );
+  sutil::hostMemoryTrack( mesh.mat_indices, 1*mesh.num_triangles*sizeof( int32_t ),      category );
+  sutil::hostMemoryTrack( mesh.mat_params,  mesh.num_materials*sizeof( MaterialParams ), category );
 }
 
 
 SUTILAPI void freeMesh( Mesh& mesh )
 {
+  sutil::hostMemoryUntrack( mesh.positions );
+  sutil::hostMemoryUntrack( mesh.normals );
+  sutil::hostMemoryUntrack( mesh.texcoords );
+  sutil::hostMemoryUntrack( mesh.tri_indices );
+  sutil::hostMemoryUntrack( mesh.mat_indices );
+  sutil::hostMemoryUntrack( mesh.mat_params );
+
   delete [] mesh.positions;
   delete [] mesh.normals;
   delete [] mesh.texcoords;
@@ -685,8 +1111,8 @@ SUTILAPI void freeMesh( Mesh& mesh )
 //
 //------------------------------------------------------------------------------
 
-MeshLoader::MeshLoader( const std::string& filename )
-  : p_impl( new Impl( filename ) )
+MeshLoader::MeshLoader( const std::string& filename, unsigned int flags )
+  : p_impl( new Impl( filename, flags ) )
 {
 }
 
@@ -708,6 +1134,49 @@ void MeshLoader::loadMesh( Mesh& mesh, const float* load_xform )
   p_impl->loadMesh( mesh, load_xform );
 }
 
+
+void MeshLoader::scanMesh( QuantizedMesh& mesh )
+{
+  Mesh counts;
+  p_impl->scanMesh( counts );
+
+  memset( &mesh, 0, sizeof( mesh ) );
+  mesh.num_vertices  = counts.num_vertices;
+  mesh.has_normals   = counts.has_normals;
+  mesh.has_texcoords = counts.has_texcoords;
+  mesh.num_triangles = counts.num_triangles;
+  mesh.num_materials = counts.num_materials;
+}
+
+
+void MeshLoader::loadMesh( QuantizedMesh& mesh, const float* load_xform )
+{
+  // Staged in floats, the encoding needs the transformed bbox
+  Mesh staged;
+  clearMesh( staged );
+  staged.num_vertices  = mesh.num_vertices;
+  staged.has_normals   = mesh.has_normals;
+  staged.has_texcoords = mesh.has_texcoords;
+  staged.num_triangles = mesh.num_triangles;
+  staged.num_materials = mesh.num_materials;
+  allocMesh( staged );
+
+  p_impl->loadMesh( staged, load_xform );
+  if( staged.positions )
+  {
+    quantizeMesh( staged, mesh );
+    std::copy( staged.mat_params, staged.mat_params + staged.num_materials, mesh.mat_params );
+  }
+
+  freeMesh( staged );
+}
+
+
+const MeshCleanupStats& MeshLoader::getCleanupStats() const
+{
+  return p_impl->getCleanupStats();
+}
+
 //------------------------------------------------------------------------------
 //
 // Mesh Loader convenience  functions
@@ -715,10 +1184,66 @@ void MeshLoader::loadMesh( Mesh& mesh, const float* load_xform )
 //------------------------------------------------------------------------------
 
 
-void loadMesh( const std::string& filename, Mesh& mesh, const float* xform )
+void loadMesh( const std::string& filename, Mesh& mesh, const float* xform, unsigned int flags )
 {
-    MeshLoader loader( filename );
+    MeshLoader loader( filename, flags );
     loader.scanMesh( mesh );
     allocMesh( mesh );
     loader.loadMesh( mesh, xform );
 }
+
+
+void saveMeshPLY( const std::string& filename, const Mesh& mesh )
+{
+  std::ofstream out( filename.c_str(), std::ios::binary | std::ios::trunc );
+  if( !out )
+    throw std::runtime_error( "MeshLoader: Failed to open '" + filename + "' for writing" );
+
+  out << "ply\n"
+      << "format " << ( hostIsBigEndian() ? "binary_big_endian" : "binary_little_endian" ) << " 1.0\n"
+      << "element vertex " << mesh.num_vertices << "\n"
+      << "property float x\nproperty float y\nproperty float z\n";
+  if( mesh.has_normals )
+    out << "property float nx\nproperty float ny\nproperty float nz\n";
+  if( mesh.has_texcoords )
+    out << "property float u\nproperty float v\n";
+  out << "element face " << mesh.num_triangles << "\n"
+      << "property list uchar int vertex_indices\n"
+      << "end_header\n";
+
+  // Vertex records interleaved, one block at a time
+  const int32_t floats = 3 + ( mesh.has_normals ? 3 : 0 ) + ( mesh.has_texcoords ? 2 : 0 );
+  const int32_t block  = 1 << 16;
+  std::vector<float> vertices( size_t( floats ) * block );
+  for( int32_t begin = 0; begin < mesh.num_vertices; begin += block )
+  {
+    const int32_t end = std::min( begin + block, mesh.num_vertices );
+    float* dst = vertices.data();
+    for( int32_t v = begin; v < end; ++v )
+    {
+      dst = std::copy( mesh.positions + 3*v, mesh.positions + 3*v + 3, dst );
+      if( mesh.has_normals )
+        dst = std::copy( mesh.normals + 3*v, mesh.normals + 3*v + 3, dst );
+      if( mesh.has_texcoords )
+        dst = std::copy( mesh.texcoords + 2*v, mesh.texcoords + 2*v + 2, dst );
+    }
+    out.write( reinterpret_cast<const char*>( vertices.data() ), ( dst - vertices.data() ) * sizeof( float ) );
+  }
+
+  std::vector<char> faces( size_t( 13 ) * block );
+  for( int32_t begin = 0; begin < mesh.num_triangles; begin += block )
+  {
+    const int32_t end = std::min( begin + block, mesh.num_triangles );
+    char* dst = faces.data();
+    for( int32_t t = begin; t < end; ++t )
+    {
+      *dst++ = 3;
+      memcpy( dst, mesh.tri_indices + 3*t, 3 * sizeof( int32_t ) );
+      dst += 3 * sizeof( int32_t );
+    }
+    out.write( faces.data(), dst - faces.data() );
+  }
+
+  if( !out )
+    throw std::runtime_error( "MeshLoader: Failed to write '" + filename + "'" );
+}
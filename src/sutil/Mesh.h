@@ -101,19 +101,134 @@ SUTILAPI void printMaterialInfo( const MaterialParams& mat, std::ostream& out =
 SUTILAPI void printMeshInfo    ( const Mesh& mesh,          std::ostream& out = std::cout );
 
 
+//------------------------------------------------------------------------------
+//
+// Mesh cleanup
+//
+//------------------------------------------------------------------------------
+struct MeshCleanupStats
+{
+  int32_t             vertices_before;
+  int32_t             vertices_after;
+  int32_t             triangles_before;
+  int32_t             triangles_after;
+  int32_t             degenerate;     // Repeated or invalid vertex, or zero area
+  int32_t             duplicate;      // Same vertices, winding and material as an earlier one
+};
+
+// Welds vertices with identical position, normal and texcoord, drops degenerate
+// and duplicate triangles and vertices no triangle uses, and recomputes the
+// bbox.  Compacts the arrays in place, only the counts shrink.
+SUTILAPI void cleanupMesh( Mesh& mesh, MeshCleanupStats* stats = 0 );
+
+SUTILAPI void printMeshCleanupStats( const MeshCleanupStats& stats, std::ostream& out = std::cout );
+
+
+//------------------------------------------------------------------------------
+//
+// Mesh reordering
+//
+//------------------------------------------------------------------------------
+
+// Sorts the triangles by the Morton code of their centroid and renumbers the
+// vertices in order of first use, so that triangles close in space are close
+// in memory.  Attributes and mat_indices are permuted along.
+SUTILAPI void reorderMesh( Mesh& mesh );
+
+
+//------------------------------------------------------------------------------
+//
+// Mesh simplification
+//
+//------------------------------------------------------------------------------
+
+// Collapses edges in order of their quadric error until at most
+// target_triangles are left or no collapse is possible without flipping a
+// triangle or pinching the surface.  Vertices keep their position, normal and
+// texcoord; collapses between different attributes cost more and both sides of
+// an attribute seam are kept.  Compacts the arrays in place, only the counts
+// shrink.  Returns the largest error of a collapse as an RMS distance.
+SUTILAPI float simplifyMesh( Mesh& mesh, int32_t target_triangles );
+
+
+//------------------------------------------------------------------------------
+//
+// Quantized mesh
+//
+//------------------------------------------------------------------------------
+
+// Mesh with 16 instead of 32 bytes of attributes per vertex.  Encoded and
+// decoded with the helpers in device_include/quantization.h, which also lists
+// the error bounds.
+struct QuantizedMesh
+{
+  int32_t             num_vertices;   // Number of triangle vertices
+  uint16_t*           positions;      // x, y, z, 0 over the bbox (len 4*num_vertices)
+
+  bool                has_normals;    //
+  uint32_t*           normals;        // Octahedral, 2 x 16 bit snorm (len 0 or num_vertices)
+
+  bool                has_texcoords;  //
+  uint32_t*           texcoords;      // u, v as half floats (len 0 or num_vertices)
+
+
+  int32_t             num_triangles;  // Number of triangles
+  int32_t*            tri_indices;    // Indices into positions, normals, texcoords
+  int32_t*            mat_indices;    // Indices into mat_params (len num_triangles)
+
+  float               bbox_min[3];    // Scene BBox, also the position origin
+  float               bbox_max[3];    //
+  float               position_scale[3]; // (bbox_max - bbox_min) / 65535
+
+  int32_t             num_materials;
+  MaterialParams*     mat_params;     // Material params
+};
+
+// Allocates memory for mesh using std lib new.
+// Assumes num_vertices, has_normals, has_texcoords, num_triangles initialized.
+SUTILAPI void allocQuantizedMesh( QuantizedMesh& mesh );
+
+// Calls std lib delete on non-null arrays in mesh
+SUTILAPI void freeQuantizedMesh( QuantizedMesh& mesh );
+
+// Encodes the arrays of mesh into those of quantized, which is allocated with
+// the same counts.  Materials are not copied.
+SUTILAPI void quantizeMesh( const Mesh& mesh, QuantizedMesh& quantized );
+
+// Decodes back into a mesh allocated with the same counts
+SUTILAPI void dequantizeMesh( const QuantizedMesh& quantized, Mesh& mesh );
+
+
 //------------------------------------------------------------------------------
 //
 // Mesh Loader
 //
 //------------------------------------------------------------------------------
+
+// Passes MeshLoader runs on every mesh it loads
+enum MeshLoaderFlags
+{
+  MESH_LOADER_CLEANUP = 1 << 0,   // cleanupMesh() at scan time, the counts are those of the cleaned mesh
+  MESH_LOADER_REORDER = 1 << 1,   // reorderMesh() before the load transform
+
+  MESH_LOADER_DEFAULT = MESH_LOADER_CLEANUP
+};
+
+
 class MeshLoader
 {
 public:
-  SUTILAPI MeshLoader( const std::string& filename );
+  SUTILAPI MeshLoader( const std::string& filename, unsigned int flags=MESH_LOADER_DEFAULT );
   SUTILAPI ~MeshLoader();
   SUTILAPI void scanMesh( Mesh& mesh );
   SUTILAPI void loadMesh( Mesh& mesh, const float* load_xform=0 );
 
+  // Same counts as above, the attributes are encoded after the load transform
+  SUTILAPI void scanMesh( QuantizedMesh& mesh );
+  SUTILAPI void loadMesh( QuantizedMesh& mesh, const float* load_xform=0 );
+
+  SUTILAPI const MeshCleanupStats& getCleanupStats() const;
+
 private:
   class Impl;
   Impl* p_impl;
@@ -127,8 +242,14 @@ private:
 //------------------------------------------------------------------------------
 
 
+// Writes positions, normals, texcoords and triangles as binary PLY, which
+// MeshLoader reads straight from the mapped file.  Materials are not written.
+// Throws std::runtime_error when the file cannot be written.
+SUTILAPI void saveMeshPLY( const std::string& filename, const Mesh& mesh );
+
 // Load mesh using std lib new for allocations
-SUTILAPI void loadMesh( const std::string& filename, Mesh& mesh, const float* load_xform=0 );
+SUTILAPI void loadMesh( const std::string& filename, Mesh& mesh, const float* load_xform=0,
+                        unsigned int flags=MESH_LOADER_DEFAULT );
 
 
 
@@ -141,9 +262,9 @@ SUTILAPI void loadMesh( const std::string& filename, Mesh& mesh, const float* lo
 class HostMesh : public Mesh
 {
 public:
-  HostMesh( const std::string& filename, const float* xform=0 )
+  HostMesh( const std::string& filename, const float* xform=0, unsigned int flags=MESH_LOADER_DEFAULT )
   { 
-    loadMesh( filename, *this, xform ); 
+    loadMesh( filename, *this, xform, flags ); 
   }
 
   ~HostMesh()
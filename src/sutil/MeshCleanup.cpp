@@ -0,0 +1,415 @@
+/*
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "Mesh.h"
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+//------------------------------------------------------------------------------
+//
+// Helpers
+//
+//------------------------------------------------------------------------------
+
+namespace
+{
+
+const uint32_t EMPTY_SLOT = 0xffffffffu;
+
+// Elements per block of the parallel loops
+const size_t GRAIN = 1u << 16;
+
+
+inline uint64_t mix( uint64_t h, uint64_t value )
+{
+  // splitmix64 finalizer over the running hash
+  h ^= value + 0x9e3779b97f4a7c15ull + ( h << 6 ) + ( h >> 2 );
+  h ^= h >> 30;
+  h *= 0xbf58476d1ce4e5b9ull;
+  h ^= h >> 27;
+  h *= 0x94d049bb133111ebull;
+  h ^= h >> 31;
+  return h;
+}
+
+
+// Bit pattern for exact comparison, with -0 and +0 folded together
+inline uint32_t floatKey( float f )
+{
+  if( f == 0.0f )
+    return 0;
+  uint32_t bits;
+  memcpy( &bits, &f, sizeof( bits ) );
+  return bits;
+}
+
+
+inline size_t nextPow2( size_t n )
+{
+  size_t p = 1;
+  while( p < n )
+    p <<= 1;
+  return p;
+}
+
+
+// Groups element ids by the top bits of their hash.  Ids stay ascending within
+// a bucket, so the first occurrence of a key is always found first.
+struct Buckets
+{
+  std::vector<uint32_t> offsets;    // num_buckets + 1
+  std::vector<uint32_t> ids;
+
+  void build( const std::vector<uint64_t>& hashes, const std::vector<uint8_t>* skip )
+  {
+    int bits = 1;
+    while( bits < 16 && ( size_t( 1 ) << bits ) * 4096 < hashes.size() )
+      ++bits;
+    const size_t num_buckets = size_t( 1 ) << bits;
+
+    offsets.assign( num_buckets + 1, 0 );
+    for( size_t i = 0; i < hashes.size(); ++i )
+      if( !skip || !( *skip )[i] )
+        ++offsets[( hashes[i] >> ( 64 - bits ) ) + 1];
+    for( size_t b = 0; b < num_buckets; ++b )
+      offsets[b + 1] += offsets[b];
+
+    std::vector<uint32_t> fill( offsets.begin(), offsets.end() - 1 );
+    ids.resize( offsets.back() );
+    for( size_t i = 0; i < hashes.size(); ++i )
+      if( !skip || !( *skip )[i] )
+        ids[fill[hashes[i] >> ( 64 - bits )]++] = static_cast<uint32_t>( i );
+  }
+
+  size_t size() const { return offsets.size() - 1; }
+};
+
+
+// For every element of every bucket finds the first earlier element with an
+// equal key, using a per thread open addressing table.  first[i] is i itself
+// for the first occurrence.
+template<typename Equal>
+void findFirstOccurrences(
+    const Buckets&               buckets,
+    const std::vector<uint64_t>& hashes,
+    Equal                        equal,
+    std::vector<uint32_t>&       first
+    )
+{
+  std::vector<std::vector<uint32_t> > tables( sutil::numThreads() );
+
+  sutil::parallelFor( buckets.size(), [&]( size_t b, unsigned int thread )
+  {
+    const uint32_t begin = buckets.offsets[b];
+    const uint32_t end   = buckets.offsets[b + 1];
+    if( begin == end )
+      return;
+
+    std::vector<uint32_t>& table = tables[thread];
+    const size_t size = nextPow2( 2 * ( end - begin ) );
+    const size_t mask = size - 1;
+    if( table.size() < size )
+      table.resize( size );
+    std::fill( table.begin(), table.begin() + size, EMPTY_SLOT );
+
+    for( uint32_t k = begin; k < end; ++k )
+    {
+      const uint32_t i = buckets.ids[k];
+      size_t slot = static_cast<size_t>( hashes[i] ) & mask;
+      while( table[slot] != EMPTY_SLOT )
+      {
+        const uint32_t j = table[slot];
+        if( hashes[j] == hashes[i] && equal( i, j ) )
+          break;
+        slot = ( slot + 1 ) & mask;
+      }
+      if( table[slot] == EMPTY_SLOT )
+        table[slot] = i;
+      first[i] = table[slot];
+    }
+  } );
+}
+
+} // namespace
+
+
+//------------------------------------------------------------------------------
+//
+// Mesh cleanup
+//
+//------------------------------------------------------------------------------
+
+void cleanupMesh( Mesh& mesh, MeshCleanupStats* stats )
+{
+  const size_t num_vertices  = mesh.num_vertices  > 0 ? mesh.num_vertices  : 0;
+  const size_t num_triangles = mesh.num_triangles > 0 ? mesh.num_triangles : 0;
+
+  MeshCleanupStats s;
+  s.vertices_before  = mesh.num_vertices;
+  s.triangles_before = mesh.num_triangles;
+  s.degenerate       = 0;
+  s.duplicate        = 0;
+
+  const bool   has_normals   = mesh.has_normals   && mesh.normals;
+  const bool   has_texcoords = mesh.has_texcoords && mesh.texcoords;
+  const int    num_keys      = 3 + ( has_normals ? 3 : 0 ) + ( has_texcoords ? 2 : 0 );
+  const float* positions     = mesh.positions;
+  const float* normals       = mesh.normals;
+  const float* texcoords     = mesh.texcoords;
+
+  // Position, normal and texcoord of a vertex as comparable bits
+  auto vertexKeys = [&]( size_t v, uint32_t* keys )
+  {
+    int k = 0;
+    for( int i = 0; i < 3; ++i )
+      keys[k++] = floatKey( positions[3 * v + i] );
+    if( has_normals )
+      for( int i = 0; i < 3; ++i )
+        keys[k++] = floatKey( normals[3 * v + i] );
+    if( has_texcoords )
+      for( int i = 0; i < 2; ++i )
+        keys[k++] = floatKey( texcoords[2 * v + i] );
+  };
+
+  //
+  // Weld: every vertex maps to the first vertex with the same attributes
+  //
+  std::vector<uint64_t> hashes( num_vertices );
+  sutil::parallelForRange( num_vertices, GRAIN, [&]( size_t begin, size_t end )
+  {
+    uint32_t keys[8];
+    for( size_t v = begin; v < end; ++v )
+    {
+      vertexKeys( v, keys );
+      uint64_t h = 0;
+      for( int k = 0; k < num_keys; ++k )
+        h = mix( h, keys[k] );
+      hashes[v] = h;
+    }
+  } );
+
+  std::vector<uint32_t> weld( num_vertices );
+  {
+    Buckets buckets;
+    buckets.build( hashes, 0 );
+    findFirstOccurrences( buckets, hashes, [&]( uint32_t a, uint32_t b )
+    {
+      uint32_t ka[8], kb[8];
+      vertexKeys( a, ka );
+      vertexKeys( b, kb );
+      return memcmp( ka, kb, num_keys * sizeof( uint32_t ) ) == 0;
+    }, weld );
+  }
+
+  //
+  // Remap triangles and flag the degenerate ones, with the same area test as
+  // mesh_bounds in triangle_mesh.cu
+  //
+  std::vector<int32_t> triangles( 3 * num_triangles );
+  std::vector<uint8_t> dropped( num_triangles, 0 );
+  sutil::parallelForRange( num_triangles, GRAIN, [&]( size_t begin, size_t end )
+  {
+    for( size_t t = begin; t < end; ++t )
+    {
+      int32_t* tri   = &triangles[3 * t];
+      bool     valid = true;
+      for( int i = 0; i < 3; ++i )
+      {
+        const int32_t v = mesh.tri_indices[3 * t + i];
+        valid  = valid && v >= 0 && static_cast<size_t>( v ) < num_vertices;
+        tri[i] = valid ? static_cast<int32_t>( weld[v] ) : -1;
+      }
+
+      if( !valid || tri[0] == tri[1] || tri[1] == tri[2] || tri[0] == tri[2] )
+      {
+        dropped[t] = 1;
+        continue;
+      }
+
+      const float* p0 = &positions[3 * tri[0]];
+      const float* p1 = &positions[3 * tri[1]];
+      const float* p2 = &positions[3 * tri[2]];
+      const float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+      const float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+      const float n[3]  = { e1[1] * e2[2] - e1[2] * e2[1],
+                            e1[2] * e2[0] - e1[0] * e2[2],
+                            e1[0] * e2[1] - e1[1] * e2[0] };
+      const float area2 = n[0] * n[0] + n[1] * n[1] + n[2] * n[2];
+      if( !( area2 > 0.0f ) || std::isinf( area2 ) )
+        dropped[t] = 1;
+    }
+  } );
+
+  for( size_t t = 0; t < num_triangles; ++t )
+    s.degenerate += dropped[t];
+
+  //
+  // Duplicates: same vertices in the same cyclic order and same material
+  //
+  auto rotated = [&]( size_t t, int32_t* key )
+  {
+    const int32_t* tri = &triangles[3 * t];
+    const int      m   = tri[1] < tri[0] ? ( tri[2] < tri[1] ? 2 : 1 ) : ( tri[2] < tri[0] ? 2 : 0 );
+    key[0] = tri[m];
+    key[1] = tri[( m + 1 ) % 3];
+    key[2] = tri[( m + 2 ) % 3];
+    key[3] = mesh.mat_indices[t];
+  };
+
+  std::vector<uint64_t> tri_hashes( num_triangles );
+  sutil::parallelForRange( num_triangles, GRAIN, [&]( size_t begin, size_t end )
+  {
+    int32_t key[4];
+    for( size_t t = begin; t < end; ++t )
+    {
+      rotated( t, key );
+      uint64_t h = 0;
+      for( int k = 0; k < 4; ++k )
+        h = mix( h, static_cast<uint32_t>( key[k] ) );
+      tri_hashes[t] = h;
+    }
+  } );
+
+  {
+    std::vector<uint32_t> first( num_triangles );
+    Buckets buckets;
+    buckets.build( tri_hashes, &dropped );
+    findFirstOccurrences( buckets, tri_hashes, [&]( uint32_t a, uint32_t b )
+    {
+      int32_t ka[4], kb[4];
+      rotated( a, ka );
+      rotated( b, kb );
+      return memcmp( ka, kb, sizeof( ka ) ) == 0;
+    }, first );
+
+    for( size_t k = 0; k < buckets.ids.size(); ++k )
+    {
+      const uint32_t t = buckets.ids[k];
+      if( first[t] != t )
+      {
+        dropped[t] = 2;
+        ++s.duplicate;
+      }
+    }
+  }
+
+  //
+  // Compact: vertices still used by a triangle, then the triangles
+  //
+  std::vector<int32_t> new_index( num_vertices, -1 );
+  for( size_t t = 0; t < num_triangles; ++t )
+    if( !dropped[t] )
+      for( int i = 0; i < 3; ++i )
+        new_index[triangles[3 * t + i]] = 0;
+
+  std::vector<uint32_t> kept_vertices;
+  kept_vertices.reserve( num_vertices );
+  for( size_t v = 0; v < num_vertices; ++v )
+  {
+    if( new_index[v] == 0 )
+    {
+      new_index[v] = static_cast<int32_t>( kept_vertices.size() );
+      kept_vertices.push_back( static_cast<uint32_t>( v ) );
+    }
+  }
+
+  std::vector<uint32_t> kept_triangles;
+  kept_triangles.reserve( num_triangles );
+  for( size_t t = 0; t < num_triangles; ++t )
+    if( !dropped[t] )
+      kept_triangles.push_back( static_cast<uint32_t>( t ) );
+
+  // Gather into scratch arrays first, the compaction reads what it overwrites
+  auto compact = [&]( float* data, int width )
+  {
+    if( !data )
+      return;
+    std::vector<float> scratch( width * kept_vertices.size() );
+    sutil::parallelForRange( kept_vertices.size(), GRAIN, [&]( size_t begin, size_t end )
+    {
+      for( size_t i = begin; i < end; ++i )
+        for( int k = 0; k < width; ++k )
+          scratch[width * i + k] = data[width * kept_vertices[i] + k];
+    } );
+    std::copy( scratch.begin(), scratch.end(), data );
+  };
+  compact( mesh.positions, 3 );
+  compact( has_normals   ? mesh.normals   : 0, 3 );
+  compact( has_texcoords ? mesh.texcoords : 0, 2 );
+
+  std::vector<int32_t> materials( kept_triangles.size() );
+  sutil::parallelForRange( kept_triangles.size(), GRAIN, [&]( size_t begin, size_t end )
+  {
+    for( size_t i = begin; i < end; ++i )
+    {
+      const uint32_t t = kept_triangles[i];
+      for( int k = 0; k < 3; ++k )
+        triangles[3 * i + k] = new_index[triangles[3 * t + k]];
+      materials[i] = mesh.mat_indices[t];
+    }
+  } );
+  std::copy( triangles.begin(), triangles.begin() + 3 * kept_triangles.size(), mesh.tri_indices );
+  std::copy( materials.begin(), materials.end(), mesh.mat_indices );
+
+  mesh.num_vertices  = static_cast<int32_t>( kept_vertices.size() );
+  mesh.num_triangles = static_cast<int32_t>( kept_triangles.size() );
+
+  //
+  // Bounds of what is left
+  //
+  mesh.bbox_min[0] = mesh.bbox_min[1] = mesh.bbox_min[2] =  1e16f;
+  mesh.bbox_max[0] = mesh.bbox_max[1] = mesh.bbox_max[2] = -1e16f;
+  for( int32_t v = 0; v < mesh.num_vertices; ++v )
+  {
+    for( int k = 0; k < 3; ++k )
+    {
+      mesh.bbox_min[k] = std::min( mesh.bbox_min[k], mesh.positions[3 * v + k] );
+      mesh.bbox_max[k] = std::max( mesh.bbox_max[k], mesh.positions[3 * v + k] );
+    }
+  }
+
+  s.vertices_after  = mesh.num_vertices;
+  s.triangles_after = mesh.num_triangles;
+  if( stats )
+    *stats = s;
+}
+
+
+void printMeshCleanupStats( const MeshCleanupStats& stats, std::ostream& out )
+{
+  out << "MeshCleanup:" << std::endl
+      << "\tvertices  : " << stats.vertices_before  << " -> " << stats.vertices_after  << std::endl
+      << "\ttriangles : " << stats.triangles_before << " -> " << stats.triangles_after << std::endl
+      << "\tdegenerate: " << stats.degenerate << std::endl
+      << "\tduplicate : " << stats.duplicate  << std::endl;
+}
@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "Mesh.h"
+#include "HostMemory.h"
+#include "ParallelFor.h"
+#include "quantization.h"
+
+#include <algorithm>
+
+//------------------------------------------------------------------------------
+//
+// Quantized mesh
+//
+//------------------------------------------------------------------------------
+
+namespace
+{
+
+// Vertices per block of the parallel loops
+const size_t GRAIN = 1u << 16;
+
+} // namespace
+
+
+void allocQuantizedMesh( QuantizedMesh& mesh )
+{
+  if( mesh.num_vertices == 0 || mesh.num_triangles == 0 )
+  {
+    memset( &mesh, 0, sizeof( mesh ) );
+    return;
+  }
+
+  mesh.positions   = new uint16_t[ 4*mesh.num_vertices ];
+  mesh.normals     = mesh.has_normals   ? new uint32_t[ mesh.num_vertices ] : 0;
+  mesh.texcoords   = mesh.has_texcoords ? new uint32_t[ mesh.num_vertices ] : 0;
+  mesh.tri_indices = new int32_t[ 3*mesh.num_triangles ];
+  mesh.mat_indices = new int32_t[ 1*mesh.num_triangles ];
+
+  mesh.mat_params  = new MaterialParams[ mesh.num_materials ];
+
+  const sutil::HostMemoryCategory category = sutil::HOST_MEMORY_MESH;
+  sutil::hostMemoryTrack( mesh.positions,   4*mesh.num_vertices*sizeof( uint16_t ),      category );
+  sutil::hostMemoryTrack( mesh.normals,     mesh.num_vertices*sizeof( uint32_t ),        category );
+  sutil::hostMemoryTrack( mesh.texcoords,   mesh.num_vertices*sizeof( uint32_t ),        category );
+  sutil::hostMemoryTrack( mesh.tri_indices, 3*mesh.num_triangles*sizeof( int32_t ),      category );
+  sutil::hostMemoryTrack( mesh.mat_indices, 1*mesh.num_triangles*sizeof( int32_t ),      category );
+  sutil::hostMemoryTrack( mesh.mat_params,  mesh.num_materials*sizeof( MaterialParams ), category );
+}
+
+
+void freeQuantizedMesh( QuantizedMesh& mesh )
+{
+  sutil::hostMemoryUntrack( mesh.positions );
+  sutil::hostMemoryUntrack( mesh.normals );
+  sutil::hostMemoryUntrack( mesh.texcoords );
+  sutil::hostMemoryUntrack( mesh.tri_indices );
+  sutil::hostMemoryUntrack( mesh.mat_indices );
+  sutil::hostMemoryUntrack( mesh.mat_params );
+
+  delete [] mesh.positions;
+  delete [] mesh.normals;
+  delete [] mesh.texcoords;
+  delete [] mesh.tri_indices;
+  delete [] mesh.mat_indices;
+  delete [] mesh.mat_params;
+
+  memset( &mesh, 0, sizeof( mesh ) );
+}
+
+
+void quantizeMesh( const Mesh& mesh, QuantizedMesh& quantized )
+{
+  const size_t num_vertices = mesh.num_vertices;
+
+  float inv_scale[3];
+  for( int k = 0; k < 3; ++k )
+  {
+    const float extent = mesh.bbox_max[k] - mesh.bbox_min[k];
+    quantized.bbox_min[k]       = mesh.bbox_min[k];
+    quantized.bbox_max[k]       = mesh.bbox_max[k];
+    quantized.position_scale[k] = extent > 0.0f ? extent / 65535.0f : 0.0f;
+    inv_scale[k]                = extent > 0.0f ? 65535.0f / extent : 0.0f;
+  }
+
+  sutil::parallelForRange( num_vertices, GRAIN, [&]( size_t begin, size_t end )
+  {
+    for( size_t v = begin; v < end; ++v )
+    {
+      for( int k = 0; k < 3; ++k )
+        quantized.positions[4*v + k] = encode_position( mesh.positions[3*v + k], mesh.bbox_min[k], inv_scale[k] );
+      quantized.positions[4*v + 3] = 0;
+
+      if( mesh.has_normals )
+      {
+        const float* n = &mesh.normals[3*v];
+        quantized.normals[v] = encode_octahedral_normal( optix::make_float3( n[0], n[1], n[2] ) );
+      }
+      if( mesh.has_texcoords )
+        quantized.texcoords[v] = encode_texcoord( mesh.texcoords[2*v], mesh.texcoords[2*v + 1] );
+    }
+  } );
+
+  std::copy( mesh.tri_indices, mesh.tri_indices + 3*mesh.num_triangles, quantized.tri_indices );
+  std::copy( mesh.mat_indices, mesh.mat_indices + 1*mesh.num_triangles, quantized.mat_indices );
+}
+
+
+void dequantizeMesh( const QuantizedMesh& quantized, Mesh& mesh )
+{
+  const optix::float3 origin = optix::make_float3( quantized.bbox_min[0], quantized.bbox_min[1], quantized.bbox_min[2] );
+  const optix::float3 scale  = optix::make_float3( quantized.position_scale[0], quantized.position_scale[1], quantized.position_scale[2] );
+
+  sutil::parallelForRange( quantized.num_vertices, GRAIN, [&]( size_t begin, size_t end )
+  {
+    for( size_t v = begin; v < end; ++v )
+    {
+      const uint16_t* q = &quantized.positions[4*v];
+      const optix::float3 p = decode_position( optix::make_ushort4( q[0], q[1], q[2], q[3] ), origin, scale );
+      mesh.positions[3*v + 0] = p.x;
+      mesh.positions[3*v + 1] = p.y;
+      mesh.positions[3*v + 2] = p.z;
+
+      if( quantized.has_normals )
+      {
+        const optix::float3 n = decode_octahedral_normal( quantized.normals[v] );
+        mesh.normals[3*v + 0] = n.x;
+        mesh.normals[3*v + 1] = n.y;
+        mesh.normals[3*v + 2] = n.z;
+      }
+      if( quantized.has_texcoords )
+      {
+        const optix::float2 uv = decode_texcoord( quantized.texcoords[v] );
+        mesh.texcoords[2*v + 0] = uv.x;
+        mesh.texcoords[2*v + 1] = uv.y;
+      }
+    }
+  } );
+
+  std::copy( quantized.tri_indices, quantized.tri_indices + 3*quantized.num_triangles, mesh.tri_indices );
+  std::copy( quantized.mat_indices, quantized.mat_indices + 1*quantized.num_triangles, mesh.mat_indices );
+  std::copy( quantized.bbox_min, quantized.bbox_min + 3, mesh.bbox_min );
+  std::copy( quantized.bbox_max, quantized.bbox_max + 3, mesh.bbox_max );
+}
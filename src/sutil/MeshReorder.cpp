@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "Mesh.h"
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+//------------------------------------------------------------------------------
+//
+// Helpers
+//
+//------------------------------------------------------------------------------
+
+namespace
+{
+
+// Elements per block of the parallel loops
+const size_t GRAIN = 1u << 16;
+
+
+// Spreads the low 21 bits of x to every third bit
+inline uint64_t expandBits( uint64_t x )
+{
+  x &= 0x1fffff;
+  x = ( x | x << 32 ) & 0x1f00000000ffffull;
+  x = ( x | x << 16 ) & 0x1f0000ff0000ffull;
+  x = ( x | x <<  8 ) & 0x100f00f00f00f00full;
+  x = ( x | x <<  4 ) & 0x10c30c30c30c30c3ull;
+  x = ( x | x <<  2 ) & 0x1249249249249249ull;
+  return x;
+}
+
+
+inline uint64_t morton3D( float x, float y, float z )
+{
+  const float scale = static_cast<float>( ( 1 << 21 ) - 1 );
+  const uint64_t ix = static_cast<uint64_t>( std::min( std::max( x, 0.0f ), 1.0f ) * scale );
+  const uint64_t iy = static_cast<uint64_t>( std::min( std::max( y, 0.0f ), 1.0f ) * scale );
+  const uint64_t iz = static_cast<uint64_t>( std::min( std::max( z, 0.0f ), 1.0f ) * scale );
+  return expandBits( ix ) << 2 | expandBits( iy ) << 1 | expandBits( iz );
+}
+
+
+// Moves width values per element to position i from order[i]
+template<typename T>
+void permute( T* data, int width, const std::vector<uint32_t>& order )
+{
+  if( !data )
+    return;
+  std::vector<T> scratch( width * order.size() );
+  sutil::parallelForRange( order.size(), GRAIN, [&]( size_t begin, size_t end )
+  {
+    for( size_t i = begin; i < end; ++i )
+      for( int k = 0; k < width; ++k )
+        scratch[width * i + k] = data[width * order[i] + k];
+  } );
+  std::copy( scratch.begin(), scratch.end(), data );
+}
+
+} // namespace
+
+
+//------------------------------------------------------------------------------
+//
+// Mesh reordering
+//
+//------------------------------------------------------------------------------
+
+void reorderMesh( Mesh& mesh )
+{
+  const size_t num_vertices  = mesh.num_vertices  > 0 ? mesh.num_vertices  : 0;
+  const size_t num_triangles = mesh.num_triangles > 0 ? mesh.num_triangles : 0;
+  if( num_triangles < 2 )
+    return;
+
+  //
+  // Centroids, quantized in their own bounds
+  //
+  std::vector<float> centroids( 3 * num_triangles );
+  sutil::parallelForRange( num_triangles, GRAIN, [&]( size_t begin, size_t end )
+  {
+    for( size_t t = begin; t < end; ++t )
+    {
+      for( int k = 0; k < 3; ++k )
+      {
+        float sum = 0.0f;
+        for( int i = 0; i < 3; ++i )
+        {
+          const int32_t v = mesh.tri_indices[3 * t + i];
+          sum += v >= 0 && static_cast<size_t>( v ) < num_vertices ? mesh.positions[3 * v + k] : 0.0f;
+        }
+        centroids[3 * t + k] = sum / 3.0f;
+      }
+    }
+  } );
+
+  float lo[3] = {  1e37f,  1e37f,  1e37f };
+  float hi[3] = { -1e37f, -1e37f, -1e37f };
+  for( size_t t = 0; t < num_triangles; ++t )
+  {
+    for( int k = 0; k < 3; ++k )
+    {
+      lo[k] = std::min( lo[k], centroids[3 * t + k] );
+      hi[k] = std::max( hi[k], centroids[3 * t + k] );
+    }
+  }
+  float inv_extent[3];
+  for( int k = 0; k < 3; ++k )
+    inv_extent[k] = hi[k] > lo[k] ? 1.0f / ( hi[k] - lo[k] ) : 0.0f;
+
+  //
+  // Triangles in Morton order of their centroid, file order among equal codes
+  //
+  std::vector<std::pair<uint64_t, uint32_t> > keys( num_triangles );
+  sutil::parallelForRange( num_triangles, GRAIN, [&]( size_t begin, size_t end )
+  {
+    for( size_t t = begin; t < end; ++t )
+    {
+      const float* c = &centroids[3 * t];
+      keys[t].first  = morton3D( ( c[0] - lo[0] ) * inv_extent[0],
+                                 ( c[1] - lo[1] ) * inv_extent[1],
+                                 ( c[2] - lo[2] ) * inv_extent[2] );
+      keys[t].second = static_cast<uint32_t>( t );
+    }
+  } );
+  std::vector<float>().swap( centroids );
+  std::sort( keys.begin(), keys.end() );
+
+  std::vector<uint32_t> triangle_order( num_triangles );
+  for( size_t i = 0; i < num_triangles; ++i )
+    triangle_order[i] = keys[i].second;
+  std::vector<std::pair<uint64_t, uint32_t> >().swap( keys );
+
+  permute( mesh.tri_indices, 3, triangle_order );
+  permute( mesh.mat_indices, 1, triangle_order );
+
+  //
+  // Vertices in order of first use, unused ones keep their order at the end
+  //
+  const uint32_t unused = 0xffffffffu;
+  std::vector<uint32_t> new_index( num_vertices, unused );
+  std::vector<uint32_t> vertex_order;
+  vertex_order.reserve( num_vertices );
+  for( size_t i = 0; i < 3 * num_triangles; ++i )
+  {
+    const int32_t v = mesh.tri_indices[i];
+    if( v >= 0 && static_cast<size_t>( v ) < num_vertices && new_index[v] == unused )
+    {
+      new_index[v] = static_cast<uint32_t>( vertex_order.size() );
+      vertex_order.push_back( v );
+    }
+  }
+  for( size_t v = 0; v < num_vertices; ++v )
+  {
+    if( new_index[v] == unused )
+    {
+      new_index[v] = static_cast<uint32_t>( vertex_order.size() );
+      vertex_order.push_back( static_cast<uint32_t>( v ) );
+    }
+  }
+
+  permute( mesh.positions, 3, vertex_order );
+  permute( mesh.has_normals   ? mesh.normals   : 0, 3, vertex_order );
+  permute( mesh.has_texcoords ? mesh.texcoords : 0, 2, vertex_order );
+
+  sutil::parallelForRange( 3 * num_triangles, GRAIN, [&]( size_t begin, size_t end )
+  {
+    for( size_t i = begin; i < end; ++i )
+    {
+      const int32_t v = mesh.tri_indices[i];
+      if( v >= 0 && static_cast<size_t>( v ) < num_vertices )
+        mesh.tri_indices[i] = static_cast<int32_t>( new_index[v] );
+    }
+  } );
+}
@@ -0,0 +1,545 @@
+/*
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "Mesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <queue>
+#include <vector>
+
+//------------------------------------------------------------------------------
+//
+// Helpers
+//
+//------------------------------------------------------------------------------
+
+namespace
+{
+
+const uint32_t REMOVED = 0xffffffffu;
+
+// Boundary edges are held in place by a plane perpendicular to their triangle
+const double BOUNDARY_WEIGHT = 10.0;
+
+// A unit of normal or texcoord difference costs like a geometric error of 1%
+// of the bbox diagonal over the area around the removed vertex
+const double ATTRIBUTE_WEIGHT = 1e-4;
+
+// Collapses may rotate a triangle by up to ~78 degrees
+const double MIN_NORMAL_COSINE = 0.2;
+
+
+// Symmetric 4x4 matrix of a sum of squared plane distances
+struct Quadric
+{
+  double a[10];   // aa ab ac ad bb bc bd cc cd dd
+
+  void clear() { std::fill( a, a + 10, 0.0 ); }
+
+  void addPlane( double nx, double ny, double nz, double d, double w )
+  {
+    a[0] += w*nx*nx; a[1] += w*nx*ny; a[2] += w*nx*nz; a[3] += w*nx*d;
+    a[4] += w*ny*ny; a[5] += w*ny*nz; a[6] += w*ny*d;
+    a[7] += w*nz*nz; a[8] += w*nz*d;
+    a[9] += w*d*d;
+  }
+
+  void add( const Quadric& q )
+  {
+    for( int i = 0; i < 10; ++i )
+      a[i] += q.a[i];
+  }
+
+  double eval( const float* p ) const
+  {
+    const double x = p[0], y = p[1], z = p[2];
+    return   a[0]*x*x + 2.0*a[1]*x*y + 2.0*a[2]*x*z + 2.0*a[3]*x
+           + a[4]*y*y + 2.0*a[5]*y*z + 2.0*a[6]*y
+           + a[7]*z*z + 2.0*a[8]*z
+           + a[9];
+  }
+};
+
+
+struct Collapse
+{
+  double   cost;
+  uint32_t from;
+  uint32_t to;
+  uint32_t from_version;
+  uint32_t to_version;
+
+  bool operator<( const Collapse& other ) const { return cost > other.cost; }   // min heap
+};
+
+
+inline void cross( const double* a, const double* b, double* c )
+{
+  c[0] = a[1]*b[2] - a[2]*b[1];
+  c[1] = a[2]*b[0] - a[0]*b[2];
+  c[2] = a[0]*b[1] - a[1]*b[0];
+}
+
+
+inline double dot( const double* a, const double* b )
+{
+  return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+}
+
+
+// Unnormalized normal, twice the area long
+inline void triangleNormal( const float* p0, const float* p1, const float* p2, double* n )
+{
+  const double e1[3] = { double( p1[0] ) - p0[0], double( p1[1] ) - p0[1], double( p1[2] ) - p0[2] };
+  const double e2[3] = { double( p2[0] ) - p0[0], double( p2[1] ) - p0[1], double( p2[2] ) - p0[2] };
+  cross( e1, e2, n );
+}
+
+
+class Simplifier
+{
+public:
+  explicit Simplifier( Mesh& mesh );
+
+  double run( int32_t target_triangles );
+
+private:
+  void   computeQuadrics();
+  void   lockSeams();
+  void   pushBestCollapse( uint32_t a, uint32_t b );
+  double collapseCost( uint32_t from, uint32_t to ) const;
+  bool   canCollapse( uint32_t from, uint32_t to );
+  void   collapse( uint32_t from, uint32_t to );
+  void   compact();
+
+  const float* position( uint32_t v ) const { return &m_mesh.positions[3*v]; }
+  bool live( uint32_t t ) const { return m_mesh.tri_indices[3*t] != int32_t( REMOVED ); }
+
+  Mesh&                               m_mesh;
+  std::vector<Quadric>                m_quadrics;
+  std::vector<double>                 m_areas;       // around each vertex, weights the attribute cost
+  std::vector<std::vector<uint32_t> > m_triangles;   // per vertex, may hold removed ones
+  std::vector<uint32_t>               m_versions;
+  std::vector<char>                   m_locked;
+  std::vector<char>                   m_removed;
+  std::priority_queue<Collapse>       m_heap;
+  std::vector<uint32_t>               m_scratch;
+  double                              m_attribute_scale;
+  int32_t                             m_live_triangles;
+};
+
+
+Simplifier::Simplifier( Mesh& mesh )
+  : m_mesh( mesh ),
+    m_quadrics( mesh.num_vertices ),
+    m_areas( mesh.num_vertices, 0.0 ),
+    m_triangles( mesh.num_vertices ),
+    m_versions( mesh.num_vertices, 0 ),
+    m_locked( mesh.num_vertices, 0 ),
+    m_removed( mesh.num_vertices, 0 ),
+    m_live_triangles( mesh.num_triangles )
+{
+  double diagonal2 = 0.0;
+  for( int k = 0; k < 3; ++k )
+  {
+    const double d = double( mesh.bbox_max[k] ) - mesh.bbox_min[k];
+    diagonal2 += d > 0.0 ? d*d : 0.0;
+  }
+  m_attribute_scale = ATTRIBUTE_WEIGHT * diagonal2;
+}
+
+
+void Simplifier::computeQuadrics()
+{
+  for( size_t v = 0; v < m_quadrics.size(); ++v )
+    m_quadrics[v].clear();
+
+  // Sorted undirected edges, with the triangle that has them
+  std::vector<uint64_t> edges;
+  edges.reserve( 3 * size_t( m_mesh.num_triangles ) );
+
+  for( int32_t t = 0; t < m_mesh.num_triangles; ++t )
+  {
+    const int32_t* tri = &m_mesh.tri_indices[3*t];
+    double n[3];
+    triangleNormal( position( tri[0] ), position( tri[1] ), position( tri[2] ), n );
+    const double length = std::sqrt( dot( n, n ) );
+    if( !( length > 0.0 ) )
+      continue;
+    const double area = 0.5 * length;
+    n[0] /= length; n[1] /= length; n[2] /= length;
+    const float* p = position( tri[0] );
+    const double d = -( n[0]*p[0] + n[1]*p[1] + n[2]*p[2] );
+
+    for( int i = 0; i < 3; ++i )
+    {
+      m_quadrics[tri[i]].addPlane( n[0], n[1], n[2], d, area );
+      m_areas[tri[i]] += area;
+      m_triangles[tri[i]].push_back( t );
+
+      const uint32_t a = tri[i], b = tri[( i + 1 ) % 3];
+      edges.push_back( uint64_t( std::min( a, b ) ) << 32 | std::max( a, b ) );
+    }
+  }
+  std::sort( edges.begin(), edges.end() );
+
+  // Edges of a single triangle are on the boundary
+  std::vector<uint64_t> boundary;
+  for( size_t i = 0; i < edges.size(); )
+  {
+    size_t j = i + 1;
+    while( j < edges.size() && edges[j] == edges[i] )
+      ++j;
+    if( j - i == 1 )
+      boundary.push_back( edges[i] );
+    i = j;
+  }
+
+  for( int32_t t = 0; t < m_mesh.num_triangles && !boundary.empty(); ++t )
+  {
+    const int32_t* tri = &m_mesh.tri_indices[3*t];
+    for( int i = 0; i < 3; ++i )
+    {
+      const uint32_t a = tri[i], b = tri[( i + 1 ) % 3];
+      const uint64_t key = uint64_t( std::min( a, b ) ) << 32 | std::max( a, b );
+      if( !std::binary_search( boundary.begin(), boundary.end(), key ) )
+        continue;
+
+      double n[3];
+      triangleNormal( position( tri[0] ), position( tri[1] ), position( tri[2] ), n );
+      const float* pa = position( a );
+      const float* pb = position( b );
+      const double e[3] = { double( pb[0] ) - pa[0], double( pb[1] ) - pa[1], double( pb[2] ) - pa[2] };
+      double side[3];
+      cross( e, n, side );
+      const double length = std::sqrt( dot( side, side ) );
+      if( !( length > 0.0 ) )
+        continue;
+      side[0] /= length; side[1] /= length; side[2] /= length;
+      const double d = -( side[0]*pa[0] + side[1]*pa[1] + side[2]*pa[2] );
+      const double w = BOUNDARY_WEIGHT * dot( e, e );
+      m_quadrics[a].addPlane( side[0], side[1], side[2], d, w );
+      m_quadrics[b].addPlane( side[0], side[1], side[2], d, w );
+    }
+  }
+
+  // Candidate collapses, once per edge
+  for( size_t i = 0; i < edges.size(); ++i )
+  {
+    if( i > 0 && edges[i] == edges[i - 1] )
+      continue;
+    pushBestCollapse( uint32_t( edges[i] >> 32 ), uint32_t( edges[i] & 0xffffffffu ) );
+  }
+}
+
+
+// Vertices at the same position with other attributes stay, so both sides of
+// a normal or uv seam keep matching.
+void Simplifier::lockSeams()
+{
+  std::vector<uint32_t> order( m_mesh.num_vertices );
+  for( size_t v = 0; v < order.size(); ++v )
+    order[v] = uint32_t( v );
+  const float* positions = m_mesh.positions;
+  std::sort( order.begin(), order.end(), [positions]( uint32_t a, uint32_t b )
+  {
+    return std::lexicographical_compare( positions + 3*a, positions + 3*a + 3, positions + 3*b, positions + 3*b + 3 );
+  } );
+
+  for( size_t i = 0; i < order.size(); )
+  {
+    size_t j = i + 1;
+    while( j < order.size() && std::equal( positions + 3*order[i], positions + 3*order[i] + 3, positions + 3*order[j] ) )
+      ++j;
+    if( j - i > 1 )
+      for( size_t k = i; k < j; ++k )
+        m_locked[order[k]] = 1;
+    i = j;
+  }
+}
+
+
+double Simplifier::collapseCost( uint32_t from, uint32_t to ) const
+{
+  if( m_locked[from] )
+    return std::numeric_limits<double>::infinity();
+
+  Quadric q = m_quadrics[from];
+  q.add( m_quadrics[to] );
+  double cost = std::max( q.eval( position( to ) ), 0.0 );
+
+  double attribute = 0.0;
+  if( m_mesh.has_normals )
+    for( int k = 0; k < 3; ++k )
+    {
+      const double d = double( m_mesh.normals[3*from + k] ) - m_mesh.normals[3*to + k];
+      attribute += d*d;
+    }
+  if( m_mesh.has_texcoords )
+    for( int k = 0; k < 2; ++k )
+    {
+      const double d = double( m_mesh.texcoords[2*from + k] ) - m_mesh.texcoords[2*to + k];
+      attribute += d*d;
+    }
+  cost += m_attribute_scale * m_areas[from] * attribute;
+  return cost;
+}
+
+
+void Simplifier::pushBestCollapse( uint32_t a, uint32_t b )
+{
+  const double ab = collapseCost( a, b );
+  const double ba = collapseCost( b, a );
+  Collapse c;
+  c.cost = std::min( ab, ba );
+  if( c.cost == std::numeric_limits<double>::infinity() )
+    return;
+  c.from = ab <= ba ? a : b;
+  c.to   = ab <= ba ? b : a;
+  c.from_version = m_versions[c.from];
+  c.to_version   = m_versions[c.to];
+  m_heap.push( c );
+}
+
+
+bool Simplifier::canCollapse( uint32_t from, uint32_t to )
+{
+  // Link condition: the only neighbours both vertices share are the opposite
+  // corners of the triangles on the edge, otherwise the surface pinches.
+  int shared_triangles = 0;
+  m_scratch.clear();
+  for( size_t i = 0; i < m_triangles[from].size(); ++i )
+  {
+    const uint32_t t = m_triangles[from][i];
+    if( !live( t ) )
+      continue;
+    const int32_t* tri = &m_mesh.tri_indices[3*t];
+    if( tri[0] == int32_t( to ) || tri[1] == int32_t( to ) || tri[2] == int32_t( to ) )
+      ++shared_triangles;
+    for( int k = 0; k < 3; ++k )
+      if( tri[k] != int32_t( from ) && tri[k] != int32_t( to ) )
+        m_scratch.push_back( tri[k] );
+  }
+  if( shared_triangles == 0 )
+    return false;
+  std::sort( m_scratch.begin(), m_scratch.end() );
+  m_scratch.erase( std::unique( m_scratch.begin(), m_scratch.end() ), m_scratch.end() );
+
+  int shared_neighbours = 0;
+  for( size_t i = 0; i < m_triangles[to].size(); ++i )
+  {
+    const uint32_t t = m_triangles[to][i];
+    if( !live( t ) )
+      continue;
+    const int32_t* tri = &m_mesh.tri_indices[3*t];
+    for( int k = 0; k < 3; ++k )
+    {
+      if( tri[k] == int32_t( from ) || tri[k] == int32_t( to ) )
+        continue;
+      std::vector<uint32_t>::iterator it = std::lower_bound( m_scratch.begin(), m_scratch.end(), uint32_t( tri[k] ) );
+      if( it != m_scratch.end() && *it == uint32_t( tri[k] ) )
+      {
+        ++shared_neighbours;
+        *it = REMOVED;   // count once
+        std::sort( m_scratch.begin(), m_scratch.end() );
+      }
+    }
+  }
+  if( shared_neighbours > shared_triangles )
+    return false;
+
+  // No triangle may flip or turn too far
+  for( size_t i = 0; i < m_triangles[from].size(); ++i )
+  {
+    const uint32_t t = m_triangles[from][i];
+    if( !live( t ) )
+      continue;
+    const int32_t* tri = &m_mesh.tri_indices[3*t];
+    if( tri[0] == int32_t( to ) || tri[1] == int32_t( to ) || tri[2] == int32_t( to ) )
+      continue;
+
+    const float* p[3];
+    for( int k = 0; k < 3; ++k )
+      p[k] = position( tri[k] == int32_t( from ) ? to : tri[k] );
+    double before[3], after[3];
+    triangleNormal( position( tri[0] ), position( tri[1] ), position( tri[2] ), before );
+    triangleNormal( p[0], p[1], p[2], after );
+    const double lengths = std::sqrt( dot( before, before ) * dot( after, after ) );
+    if( !( lengths > 0.0 ) || dot( before, after ) < MIN_NORMAL_COSINE * lengths )
+      return false;
+  }
+  return true;
+}
+
+
+void Simplifier::collapse( uint32_t from, uint32_t to )
+{
+  std::vector<uint32_t>& to_triangles = m_triangles[to];
+  for( size_t i = 0; i < m_triangles[from].size(); ++i )
+  {
+    const uint32_t t = m_triangles[from][i];
+    if( !live( t ) )
+      continue;
+    int32_t* tri = &m_mesh.tri_indices[3*t];
+    if( tri[0] == int32_t( to ) || tri[1] == int32_t( to ) || tri[2] == int32_t( to ) )
+    {
+      tri[0] = int32_t( REMOVED );
+      --m_live_triangles;
+      continue;
+    }
+    for( int k = 0; k < 3; ++k )
+      if( tri[k] == int32_t( from ) )
+        tri[k] = int32_t( to );
+    to_triangles.push_back( t );
+  }
+  std::vector<uint32_t>().swap( m_triangles[from] );
+
+  // Drop the removed triangles so the lists stay short
+  size_t n = 0;
+  for( size_t i = 0; i < to_triangles.size(); ++i )
+    if( live( to_triangles[i] ) )
+      to_triangles[n++] = to_triangles[i];
+  to_triangles.resize( n );
+
+  m_quadrics[to].add( m_quadrics[from] );
+  m_areas[to] += m_areas[from];
+  m_removed[from] = 1;
+  ++m_versions[to];
+
+  m_scratch.clear();
+  for( size_t i = 0; i < to_triangles.size(); ++i )
+  {
+    const int32_t* tri = &m_mesh.tri_indices[3*to_triangles[i]];
+    for( int k = 0; k < 3; ++k )
+      if( tri[k] != int32_t( to ) )
+        m_scratch.push_back( tri[k] );
+  }
+  std::sort( m_scratch.begin(), m_scratch.end() );
+  m_scratch.erase( std::unique( m_scratch.begin(), m_scratch.end() ), m_scratch.end() );
+  const std::vector<uint32_t> neighbours( m_scratch );
+  for( size_t i = 0; i < neighbours.size(); ++i )
+    pushBestCollapse( to, neighbours[i] );
+}
+
+
+void Simplifier::compact()
+{
+  std::vector<uint32_t> remap( m_mesh.num_vertices, REMOVED );
+  int32_t num_triangles = 0;
+  for( int32_t t = 0; t < m_mesh.num_triangles; ++t )
+  {
+    if( !live( t ) )
+      continue;
+    for( int k = 0; k < 3; ++k )
+    {
+      m_mesh.tri_indices[3*num_triangles + k] = m_mesh.tri_indices[3*t + k];
+      remap[m_mesh.tri_indices[3*t + k]] = 0;
+    }
+    m_mesh.mat_indices[num_triangles] = m_mesh.mat_indices[t];
+    ++num_triangles;
+  }
+
+  int32_t num_vertices = 0;
+  for( int k = 0; k < 3; ++k )
+  {
+    m_mesh.bbox_min[k] =  1e16f;
+    m_mesh.bbox_max[k] = -1e16f;
+  }
+  for( int32_t v = 0; v < m_mesh.num_vertices; ++v )
+  {
+    if( remap[v] == REMOVED )
+      continue;
+    remap[v] = num_vertices;
+    for( int k = 0; k < 3; ++k )
+    {
+      const float p = m_mesh.positions[3*v + k];
+      m_mesh.positions[3*num_vertices + k] = p;
+      m_mesh.bbox_min[k] = std::min( m_mesh.bbox_min[k], p );
+      m_mesh.bbox_max[k] = std::max( m_mesh.bbox_max[k], p );
+    }
+    if( m_mesh.has_normals )
+      std::copy( m_mesh.normals + 3*v, m_mesh.normals + 3*v + 3, m_mesh.normals + 3*num_vertices );
+    if( m_mesh.has_texcoords )
+      std::copy( m_mesh.texcoords + 2*v, m_mesh.texcoords + 2*v + 2, m_mesh.texcoords + 2*num_vertices );
+    ++num_vertices;
+  }
+
+  for( int32_t i = 0; i < 3*num_triangles; ++i )
+    m_mesh.tri_indices[i] = remap[m_mesh.tri_indices[i]];
+
+  m_mesh.num_vertices  = num_vertices;
+  m_mesh.num_triangles = num_triangles;
+}
+
+
+double Simplifier::run( int32_t target_triangles )
+{
+  lockSeams();
+  computeQuadrics();
+
+  double max_error = 0.0;
+  while( m_live_triangles > target_triangles && !m_heap.empty() )
+  {
+    const Collapse c = m_heap.top();
+    m_heap.pop();
+    if( m_removed[c.from] || m_removed[c.to] ||
+        m_versions[c.from] != c.from_version || m_versions[c.to] != c.to_version )
+      continue;
+    if( !canCollapse( c.from, c.to ) )
+      continue;
+
+    collapse( c.from, c.to );
+    if( m_areas[c.to] > 0.0 )
+      max_error = std::max( max_error, std::sqrt( m_quadrics[c.to].eval( position( c.to ) ) / m_areas[c.to] ) );
+  }
+
+  compact();
+  return max_error;
+}
+
+} // namespace
+
+
+//------------------------------------------------------------------------------
+//
+// Mesh simplification
+//
+//------------------------------------------------------------------------------
+
+float simplifyMesh( Mesh& mesh, int32_t target_triangles )
+{
+  if( mesh.num_triangles <= target_triangles || mesh.num_vertices <= 0 )
+    return 0.0f;
+
+  Simplifier simplifier( mesh );
+  return static_cast<float>( simplifier.run( std::max( target_triangles, 0 ) ) );
+}
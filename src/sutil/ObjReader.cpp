@@ -0,0 +1,771 @@
+/*
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "ObjReader.h"
+#include "MappedFile.h"
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+
+//------------------------------------------------------------------------------
+//
+// Helpers
+//
+//------------------------------------------------------------------------------
+
+namespace
+{
+
+const uint32_t NO_VERTEX = 0xffffffffu;
+
+// Smallest chunk handed to a thread, smaller files are parsed in one piece
+const size_t MIN_CHUNK_SIZE = 1u << 20;
+
+
+//
+// Token parsing on [p, end) of one line.  Lines in a mapped file are not null
+// terminated, so every helper is bounded by end.
+//
+
+inline bool isSpace( char c )
+{
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+
+inline bool isDigit( char c )
+{
+  return c >= '0' && c <= '9';
+}
+
+
+inline const char* skipSpace( const char* p, const char* end )
+{
+  while( p < end && isSpace( *p ) )
+    ++p;
+  return p;
+}
+
+
+inline const char* skipToken( const char* p, const char* end )
+{
+  while( p < end && !isSpace( *p ) )
+    ++p;
+  return p;
+}
+
+
+// Matches a keyword followed by white space
+inline bool isKeyword( const char* p, const char* end, const char* keyword, size_t length )
+{
+  return static_cast<size_t>( end - p ) > length && memcmp( p, keyword, length ) == 0 && isSpace( p[length] );
+}
+
+
+// Decimal float without going through the C locale.  Up to 19 significant
+// digits are accumulated into an integer and scaled once, which is exact for
+// the typical exported value.  Anything else (inf, nan, hex) goes to strtod.
+// Like tinyobj, an unparsable token reads as 0 and is skipped.
+const char* parseFloat( const char* p, const char* end, float& value )
+{
+  static const double POW10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+
+  p = skipSpace( p, end );
+  const char* token = p;
+
+  bool negative = false;
+  if( p < end && ( *p == '-' || *p == '+' ) )
+  {
+    negative = *p == '-';
+    ++p;
+  }
+
+  uint64_t mantissa = 0;
+  int      digits   = 0;
+  int      exponent = 0;
+  bool     valid    = false;
+
+  for( ; p < end && isDigit( *p ); ++p, valid = true )
+  {
+    if( digits < 19 )
+    {
+      mantissa = mantissa * 10 + ( *p - '0' );
+      digits  += mantissa != 0;
+    }
+    else
+      ++exponent;
+  }
+
+  if( p < end && *p == '.' )
+  {
+    for( ++p; p < end && isDigit( *p ); ++p, valid = true )
+    {
+      if( digits < 19 )
+      {
+        mantissa = mantissa * 10 + ( *p - '0' );
+        digits  += mantissa != 0;
+        --exponent;
+      }
+    }
+  }
+
+  if( valid && p < end && ( *p == 'e' || *p == 'E' ) )
+  {
+    const char* q = p + 1;
+    bool negative_exponent = false;
+    if( q < end && ( *q == '-' || *q == '+' ) )
+    {
+      negative_exponent = *q == '-';
+      ++q;
+    }
+    if( q < end && isDigit( *q ) )
+    {
+      int e = 0;
+      for( ; q < end && isDigit( *q ); ++q )
+        e = std::min( e * 10 + ( *q - '0' ), 100000 );
+      exponent += negative_exponent ? -e : e;
+      p = q;
+    }
+  }
+
+  const char* token_end = skipToken( p, end );
+  if( !valid || p != token_end )
+  {
+    // Rare syntax, hand a copy of the token to the C library
+    char buffer[64];
+    const size_t length = std::min<size_t>( token_end - token, sizeof( buffer ) - 1 );
+    memcpy( buffer, token, length );
+    buffer[length] = '\0';
+    value = static_cast<float>( strtod( buffer, NULL ) );
+    return token_end;
+  }
+
+  double result = static_cast<double>( mantissa );
+  if( mantissa == 0 )
+    result = 0.0;
+  else if( exponent >= 0 && exponent <= 22 && mantissa < ( 1ull << 53 ) )
+    result *= POW10[exponent];
+  else if( exponent < 0 && exponent >= -22 && mantissa < ( 1ull << 53 ) )
+    result /= POW10[-exponent];
+  else
+    result *= std::pow( 10.0, static_cast<double>( exponent ) );
+
+  value = static_cast<float>( negative ? -result : result );
+  return token_end;
+}
+
+
+inline const char* parseInt( const char* p, const char* end, int32_t& value )
+{
+  bool negative = false;
+  if( p < end && ( *p == '-' || *p == '+' ) )
+  {
+    negative = *p == '-';
+    ++p;
+  }
+
+  int64_t result = 0;
+  for( ; p < end && isDigit( *p ); ++p )
+    result = std::min<int64_t>( result * 10 + ( *p - '0' ), 0x7fffffff );
+
+  value = static_cast<int32_t>( negative ? -result : result );
+  return p;
+}
+
+
+// OBJ indices are 1-based, negative ones count back from the last element
+// read so far.  Those are resolved against the chunk's own count here and
+// offset by the preceding chunks once their sizes are known.
+inline int32_t fixIndex( int32_t idx, size_t n, bool& relative )
+{
+  if( idx > 0 )
+    return idx - 1;
+  if( idx == 0 )
+    return 0;
+  relative = true;
+  return static_cast<int32_t>( n ) + idx;
+}
+
+
+inline const char* nameToken( const char* p, const char* end, std::string& name )
+{
+  p = skipSpace( p, end );
+  const char* token_end = skipToken( p, end );
+  name.assign( p, token_end );
+  return token_end;
+}
+
+} // namespace
+
+
+//------------------------------------------------------------------------------
+//
+// ObjReader implementation
+//
+//------------------------------------------------------------------------------
+
+struct ObjReader::Chunk
+{
+  // A 'g', 'o' or 'usemtl' line, which starts a new group at corner
+  struct Event
+  {
+    uint64_t    corner;
+    bool        usemtl;
+    std::string material;
+  };
+
+  const char*              begin;
+  const char*              end;
+
+  std::vector<float>       positions;
+  std::vector<float>       normals;
+  std::vector<float>       texcoords;
+  std::vector<Corner>      corners;      // three per triangle
+  std::vector<uint64_t>    relative;     // corner * 3 + component of negative indices
+  std::vector<Event>       events;
+  std::vector<std::string> mtllibs;
+
+  // Totals of the chunks before this one
+  uint64_t                 first_position;
+  uint64_t                 first_normal;
+  uint64_t                 first_texcoord;
+  uint64_t                 first_corner;
+};
+
+
+ObjReader::ObjReader()
+  : m_num_vertices( 0 ),
+    m_num_triangles( 0 ),
+    m_has_normals( false ),
+    m_has_texcoords( false )
+{
+}
+
+
+ObjReader::~ObjReader()
+{
+}
+
+
+void ObjReader::parseChunk( Chunk& chunk ) const
+{
+  std::vector<Corner>  face;
+  std::vector<uint8_t> face_relative;
+
+  const char* line = chunk.begin;
+  while( line < chunk.end )
+  {
+    const char* line_start = line;
+    const char* eol        = static_cast<const char*>( memchr( line, '\n', chunk.end - line ) );
+    if( !eol )
+      eol = chunk.end;
+    line = eol + 1;
+    if( eol > line_start && eol[-1] == '\r' )
+      --eol;
+
+    const char* p = skipSpace( line_start, eol );
+    if( p == eol || *p == '#' )
+      continue;
+
+    if( p[0] == 'v' && eol - p > 1 && isSpace( p[1] ) )
+    {
+      float x, y, z;
+      p = parseFloat( p + 2, eol, x );
+      p = parseFloat( p, eol, y );
+      p = parseFloat( p, eol, z );
+      chunk.positions.push_back( x );
+      chunk.positions.push_back( y );
+      chunk.positions.push_back( z );
+    }
+    else if( isKeyword( p, eol, "vn", 2 ) )
+    {
+      float x, y, z;
+      p = parseFloat( p + 3, eol, x );
+      p = parseFloat( p, eol, y );
+      p = parseFloat( p, eol, z );
+      chunk.normals.push_back( x );
+      chunk.normals.push_back( y );
+      chunk.normals.push_back( z );
+    }
+    else if( isKeyword( p, eol, "vt", 2 ) )
+    {
+      float u, v;
+      p = parseFloat( p + 3, eol, u );
+      p = parseFloat( p, eol, v );
+      chunk.texcoords.push_back( u );
+      chunk.texcoords.push_back( v );
+    }
+    else if( p[0] == 'f' && eol - p > 1 && isSpace( p[1] ) )
+    {
+      face.clear();
+      face_relative.clear();
+
+      const size_t num_positions = chunk.positions.size() / 3;
+      const size_t num_normals   = chunk.normals.size()   / 3;
+      const size_t num_texcoords = chunk.texcoords.size() / 2;
+
+      p = skipSpace( p + 2, eol );
+      while( p < eol )
+      {
+        // v, v/vt, v//vn or v/vt/vn
+        bool    relative[3] = { false, false, false };
+        Corner  corner      = { 0, -1, -1 };
+        int32_t idx;
+
+        const char* start = p;
+        p = parseInt( p, eol, idx );
+        corner.v = fixIndex( idx, num_positions, relative[0] );
+        if( p < eol && *p == '/' )
+        {
+          ++p;
+          if( p < eol && *p == '/' )
+          {
+            p = parseInt( p + 1, eol, idx );
+            corner.vn = fixIndex( idx, num_normals, relative[2] );
+          }
+          else
+          {
+            p = parseInt( p, eol, idx );
+            corner.vt = fixIndex( idx, num_texcoords, relative[1] );
+            if( p < eol && *p == '/' )
+            {
+              p = parseInt( p + 1, eol, idx );
+              corner.vn = fixIndex( idx, num_normals, relative[2] );
+            }
+          }
+        }
+
+        face.push_back( corner );
+        face_relative.push_back( static_cast<uint8_t>( relative[0] | relative[1] << 1 | relative[2] << 2 ) );
+
+        if( p == start )
+          p = skipToken( p, eol );
+        p = skipSpace( p, eol );
+      }
+
+      // Polygon -> triangle fan
+      for( size_t k = 2; k < face.size(); ++k )
+      {
+        const size_t fan[3] = { 0, k - 1, k };
+        for( int i = 0; i < 3; ++i )
+        {
+          const uint8_t mask = face_relative[fan[i]];
+          for( int c = 0; c < 3; ++c )
+            if( mask & ( 1 << c ) )
+              chunk.relative.push_back( chunk.corners.size() * 3 + c );
+          chunk.corners.push_back( face[fan[i]] );
+        }
+      }
+    }
+    else if( isKeyword( p, eol, "usemtl", 6 ) )
+    {
+      Chunk::Event event;
+      event.corner = chunk.corners.size();
+      event.usemtl = true;
+      nameToken( p + 7, eol, event.material );
+      chunk.events.push_back( event );
+    }
+    else if( isKeyword( p, eol, "mtllib", 6 ) )
+    {
+      std::string name;
+      nameToken( p + 7, eol, name );
+      chunk.mtllibs.push_back( name );
+    }
+    else if( ( p[0] == 'g' || p[0] == 'o' ) && eol - p > 1 && isSpace( p[1] ) )
+    {
+      Chunk::Event event;
+      event.corner = chunk.corners.size();
+      event.usemtl = false;
+      chunk.events.push_back( event );
+    }
+
+    // Ignore unknown commands
+  }
+}
+
+
+// Assigns one vertex to each distinct ( v, vt, vn ) triple of the group, in
+// order of first use like tinyobj.  heads maps a position, relative to the
+// lowest one used by the group, to the last vertex created for it; vertices
+// sharing a position are chained.
+void ObjReader::weldGroup( Group& group, const std::vector<Corner>& corners, std::vector<uint32_t>& heads ) const
+{
+  const int32_t num_positions = static_cast<int32_t>( m_positions.size() / 3 );
+  const int32_t num_normals   = static_cast<int32_t>( m_normals.size()   / 3 );
+  const int32_t num_texcoords = static_cast<int32_t>( m_texcoords.size() / 2 );
+
+  int32_t min_v = num_positions;
+  int32_t max_v = -1;
+  for( uint64_t i = group.begin; i < group.end; ++i )
+  {
+    const Corner& c = corners[i];
+    if( c.v  < 0  || c.v  >= num_positions ||
+        c.vt < -1 || c.vt >= num_texcoords ||
+        c.vn < -1 || c.vn >= num_normals )
+    {
+      std::ostringstream msg;
+      msg << "ObjReader: face index " << c.v + 1 << "/" << c.vt + 1 << "/" << c.vn + 1
+          << " out of range in '" << m_filename << "'";
+      throw std::runtime_error( msg.str() );
+    }
+    min_v = std::min( min_v, c.v );
+    max_v = std::max( max_v, c.v );
+  }
+
+  const size_t span = static_cast<size_t>( max_v - min_v + 1 );
+  if( heads.size() < span )
+    heads.resize( span, NO_VERTEX );
+
+  std::vector<uint32_t> chain;
+  group.indices.reserve( group.end - group.begin );
+  group.has_normals   = false;
+  group.has_texcoords = false;
+
+  for( uint64_t i = group.begin; i < group.end; ++i )
+  {
+    const Corner& c    = corners[i];
+    uint32_t&     head = heads[c.v - min_v];
+
+    uint32_t vertex = head;
+    while( vertex != NO_VERTEX && ( group.vertices[vertex].vt != c.vt || group.vertices[vertex].vn != c.vn ) )
+      vertex = chain[vertex];
+
+    if( vertex == NO_VERTEX )
+    {
+      vertex = static_cast<uint32_t>( group.vertices.size() );
+      group.vertices.push_back( c );
+      chain.push_back( head );
+      head = vertex;
+
+      group.has_normals   |= c.vn >= 0;
+      group.has_texcoords |= c.vt >= 0;
+    }
+    group.indices.push_back( vertex );
+  }
+
+  // Leave the scratch array cleared for the thread's next group
+  for( size_t i = 0; i < group.vertices.size(); ++i )
+    heads[group.vertices[i].v - min_v] = NO_VERTEX;
+}
+
+
+void ObjReader::read( const std::string& filename, const std::string& mtl_basepath )
+{
+  m_filename = filename;
+
+  sutil::MappedFile file;
+  if( !file.map( filename ) )
+    throw std::runtime_error( "ObjReader: Cannot open file [" + filename + "]" );
+
+  //
+  // Split into chunks that end on a line break and parse them in parallel
+  //
+  const char*  data = file.data();
+  const size_t size = file.size();
+
+  const size_t num_chunks = std::max<size_t>( 1, std::min<size_t>( 4 * sutil::numThreads(), size / MIN_CHUNK_SIZE ) );
+  std::vector<Chunk> chunks( num_chunks );
+
+  size_t offset = 0;
+  for( size_t i = 0; i < num_chunks; ++i )
+  {
+    size_t stop = i + 1 == num_chunks ? size : std::max( offset, size / num_chunks * ( i + 1 ) );
+    const void* eol = stop < size ? memchr( data + stop, '\n', size - stop ) : NULL;
+    stop = eol ? static_cast<const char*>( eol ) - data + 1 : size;
+
+    chunks[i].begin = data + offset;
+    chunks[i].end   = data + stop;
+    offset = stop;
+  }
+
+  sutil::parallelFor( num_chunks, [&]( size_t i, unsigned int ) { parseChunk( chunks[i] ); } );
+
+  //
+  // Offsets of every chunk into the file's totals
+  //
+  uint64_t num_positions = 0;
+  uint64_t num_normals   = 0;
+  uint64_t num_texcoords = 0;
+  uint64_t num_corners   = 0;
+  for( size_t i = 0; i < num_chunks; ++i )
+  {
+    Chunk& chunk = chunks[i];
+    chunk.first_position = num_positions;
+    chunk.first_normal   = num_normals;
+    chunk.first_texcoord = num_texcoords;
+    chunk.first_corner   = num_corners;
+
+    num_positions += chunk.positions.size() / 3;
+    num_normals   += chunk.normals.size()   / 3;
+    num_texcoords += chunk.texcoords.size() / 2;
+    num_corners   += chunk.corners.size();
+  }
+
+  if( num_positions >= 0x7fffffffu || num_corners / 3 >= 0x7fffffffu )
+    throw std::runtime_error( "ObjReader: '" + filename + "' is too large for 32 bit indices" );
+
+  //
+  // Merge into the file arrays, fixing up relative indices on the way
+  //
+  m_positions.resize( 3 * num_positions );
+  m_normals.resize( 3 * num_normals );
+  m_texcoords.resize( 2 * num_texcoords );
+  std::vector<Corner> corners( num_corners );
+
+  sutil::parallelFor( num_chunks, [&]( size_t i, unsigned int )
+  {
+    Chunk& chunk = chunks[i];
+    std::copy( chunk.positions.begin(), chunk.positions.end(), m_positions.begin() + 3 * chunk.first_position );
+    std::copy( chunk.normals.begin(),   chunk.normals.end(),   m_normals.begin()   + 3 * chunk.first_normal );
+    std::copy( chunk.texcoords.begin(), chunk.texcoords.end(), m_texcoords.begin() + 2 * chunk.first_texcoord );
+
+    for( size_t r = 0; r < chunk.relative.size(); ++r )
+    {
+      Corner& c = chunk.corners[chunk.relative[r] / 3];
+      switch( chunk.relative[r] % 3 )
+      {
+        case 0: c.v  += static_cast<int32_t>( chunk.first_position ); break;
+        case 1: c.vt += static_cast<int32_t>( chunk.first_texcoord ); break;
+        case 2: c.vn += static_cast<int32_t>( chunk.first_normal );   break;
+      }
+    }
+    std::copy( chunk.corners.begin(), chunk.corners.end(), corners.begin() + chunk.first_corner );
+
+    std::vector<float>().swap( chunk.positions );
+    std::vector<float>().swap( chunk.normals );
+    std::vector<float>().swap( chunk.texcoords );
+    std::vector<Corner>().swap( chunk.corners );
+  } );
+
+  //
+  // Materials, in the order their libraries appear
+  //
+  std::map<std::string, int> material_map;
+  tinyobj::MaterialFileReader material_reader( mtl_basepath );
+  m_materials.clear();
+  for( size_t i = 0; i < num_chunks; ++i )
+  {
+    for( size_t j = 0; j < chunks[i].mtllibs.size(); ++j )
+    {
+      std::string err;
+      material_reader( chunks[i].mtllibs[j], m_materials, material_map, err );
+      if( !err.empty() )
+        std::cerr << err << std::endl;
+    }
+  }
+  if( m_materials.empty() )
+  {
+    // An empty library yields tinyobj's default material
+    std::istringstream empty;
+    std::map<std::string, int> default_map;
+    tinyobj::LoadMtl( default_map, m_materials, empty );
+  }
+
+  //
+  // Groups start at every 'g', 'o' and 'usemtl', the material carries over
+  //
+  m_groups.clear();
+  Group group = Group();
+  group.material = -1;
+  group.begin    = 0;
+  for( size_t i = 0; i < num_chunks; ++i )
+  {
+    for( size_t j = 0; j < chunks[i].events.size(); ++j )
+    {
+      const Chunk::Event& event = chunks[i].events[j];
+
+      group.end = chunks[i].first_corner + event.corner;
+      if( group.end > group.begin )
+        m_groups.push_back( group );
+      group.begin = group.end;
+
+      if( event.usemtl )
+      {
+        std::map<std::string, int>::const_iterator it = material_map.find( event.material );
+        group.material = it != material_map.end() ? it->second : -1;
+      }
+    }
+  }
+  group.end = num_corners;
+  if( group.end > group.begin )
+    m_groups.push_back( group );
+
+  chunks.clear();
+  file.unmap();
+
+  //
+  // Weld each group in parallel, then lay the groups out back to back
+  //
+  std::vector<std::vector<uint32_t> > heads( sutil::numThreads() );
+  sutil::parallelFor( m_groups.size(), [&]( size_t i, unsigned int thread )
+  {
+    weldGroup( m_groups[i], corners, heads[thread] );
+  } );
+
+  m_num_vertices  = 0;
+  m_num_triangles = 0;
+  size_t num_groups_with_normals   = 0;
+  size_t num_groups_with_texcoords = 0;
+  for( size_t i = 0; i < m_groups.size(); ++i )
+  {
+    Group& g = m_groups[i];
+    g.first_vertex   = m_num_vertices;
+    g.first_triangle = m_num_triangles;
+
+    m_num_vertices  += static_cast<uint32_t>( g.vertices.size() );
+    m_num_triangles += static_cast<uint32_t>( g.indices.size() / 3 );
+
+    num_groups_with_normals   += g.has_normals;
+    num_groups_with_texcoords += g.has_texcoords;
+  }
+
+  //
+  // We ignore normals and texcoords unless they are present for all groups
+  //
+  m_has_normals   = false;
+  m_has_texcoords = false;
+
+  if( num_groups_with_normals != 0 )
+  {
+    if( num_groups_with_normals != m_groups.size() )
+      std::cerr << "MeshLoader - WARNING: mesh '" << m_filename
+                << "' has normals for some groups but not all.  "
+                << "Ignoring all normals." << std::endl;
+    else
+      m_has_normals = true;
+  }
+
+  if( num_groups_with_texcoords != 0 )
+  {
+    if( num_groups_with_texcoords != m_groups.size() )
+      std::cerr << "MeshLoader - WARNING: mesh '" << m_filename
+                << "' has texcoords for some groups but not all.  "
+                << "Ignoring all texcoords." << std::endl;
+    else
+      m_has_texcoords = true;
+  }
+}
+
+
+int32_t ObjReader::getNumVertices() const
+{
+  return static_cast<int32_t>( m_num_vertices );
+}
+
+
+int32_t ObjReader::getNumTriangles() const
+{
+  return static_cast<int32_t>( m_num_triangles );
+}
+
+
+bool ObjReader::hasNormals() const
+{
+  return m_has_normals;
+}
+
+
+bool ObjReader::hasTexcoords() const
+{
+  return m_has_texcoords;
+}
+
+
+const std::vector<tinyobj::material_t>& ObjReader::getMaterials() const
+{
+  return m_materials;
+}
+
+
+void ObjReader::copyTo( Mesh& mesh ) const
+{
+  std::vector<float> bounds( 6 * m_groups.size() );
+
+  sutil::parallelFor( m_groups.size(), [&]( size_t i, unsigned int )
+  {
+    const Group& group = m_groups[i];
+
+    float* bbox = &bounds[6 * i];
+    bbox[0] = bbox[1] = bbox[2] =  1e16f;
+    bbox[3] = bbox[4] = bbox[5] = -1e16f;
+
+    for( size_t j = 0; j < group.vertices.size(); ++j )
+    {
+      const Corner&  c   = group.vertices[j];
+      const uint64_t dst = group.first_vertex + j;
+
+      for( int k = 0; k < 3; ++k )
+      {
+        const float x = m_positions[3 * c.v + k];
+        mesh.positions[3 * dst + k] = x;
+        bbox[k]     = std::min( bbox[k], x );
+        bbox[k + 3] = std::max( bbox[k + 3], x );
+      }
+
+      // Corners without a normal or texcoord in a group that has some read as 0
+      if( mesh.has_normals && m_has_normals )
+        for( int k = 0; k < 3; ++k )
+          mesh.normals[3 * dst + k] = c.vn >= 0 ? m_normals[3 * c.vn + k] : 0.0f;
+
+      if( mesh.has_texcoords && m_has_texcoords )
+        for( int k = 0; k < 2; ++k )
+          mesh.texcoords[2 * dst + k] = c.vt >= 0 ? m_texcoords[2 * c.vt + k] : 0.0f;
+    }
+
+    const int32_t material = group.material >= 0 ? group.material : 0;
+    for( size_t j = 0; j < group.indices.size() / 3; ++j )
+    {
+      const uint64_t tri = group.first_triangle + j;
+      mesh.tri_indices[3 * tri + 0] = static_cast<int32_t>( group.first_vertex + group.indices[3 * j + 0] );
+      mesh.tri_indices[3 * tri + 1] = static_cast<int32_t>( group.first_vertex + group.indices[3 * j + 1] );
+      mesh.tri_indices[3 * tri + 2] = static_cast<int32_t>( group.first_vertex + group.indices[3 * j + 2] );
+      mesh.mat_indices[tri]         = material;
+    }
+  } );
+
+  for( size_t i = 0; i < m_groups.size(); ++i )
+  {
+    for( int k = 0; k < 3; ++k )
+    {
+      mesh.bbox_min[k] = std::min( mesh.bbox_min[k], bounds[6 * i + k] );
+      mesh.bbox_max[k] = std::max( mesh.bbox_max[k], bounds[6 * i + k + 3] );
+    }
+  }
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "Mesh.h"
+#include "tinyobjloader/tiny_obj_loader.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+
+//------------------------------------------------------------------------------
+//
+// Parallel Wavefront OBJ reader used by MeshLoader
+//
+// The file is memory mapped and split into line aligned chunks which are parsed
+// on all cores.  Chunks are then stitched together by offsetting their indices,
+// and faces are triangulated and welded per group the same way tinyobj::LoadObj
+// does, so the resulting Mesh is identical.  Only the .mtl files still go
+// through tinyobj.
+//
+//------------------------------------------------------------------------------
+class ObjReader
+{
+public:
+  ObjReader();
+  ~ObjReader();
+
+  // Parses the file and its material libraries, which are looked up in
+  // mtl_basepath.  Throws std::runtime_error when the file cannot be read or
+  // a face references a missing vertex.
+  void read( const std::string& filename, const std::string& mtl_basepath );
+
+  int32_t getNumVertices() const;
+  int32_t getNumTriangles() const;
+  bool    hasNormals() const;     // every group has normals
+  bool    hasTexcoords() const;   // every group has texcoords
+
+  const std::vector<tinyobj::material_t>& getMaterials() const;
+
+  // Fills the arrays of a mesh allocated from the counts above and grows its
+  // bounding box.
+  void copyTo( Mesh& mesh ) const;
+
+private:
+  struct Corner
+  {
+    int32_t v;
+    int32_t vt;
+    int32_t vn;
+  };
+
+  // Faces of one 'g', 'o' or 'usemtl' block, welded into their own vertices
+  struct Group
+  {
+    int32_t               material;
+    uint64_t              begin;          // range of the file's corners
+    uint64_t              end;
+    std::vector<Corner>   vertices;
+    std::vector<uint32_t> indices;
+    bool                  has_normals;
+    bool                  has_texcoords;
+    uint32_t              first_vertex;
+    uint32_t              first_triangle;
+  };
+
+  struct Chunk;
+
+  void parseChunk( Chunk& chunk ) const;
+  void weldGroup( Group& group, const std::vector<Corner>& corners, std::vector<uint32_t>& heads ) const;
+
+  std::string                      m_filename;
+  std::vector<float>               m_positions;
+  std::vector<float>               m_normals;
+  std::vector<float>               m_texcoords;
+  std::vector<Group>               m_groups;
+  std::vector<tinyobj::material_t> m_materials;
+  uint32_t                         m_num_vertices;
+  uint32_t                         m_num_triangles;
+  bool                             m_has_normals;
+  bool                             m_has_texcoords;
+};
@@ -80,7 +80,33 @@ void setupMeshLoaderInputs(
 }
 
 
-void unmap( MeshBuffers& buffers, Mesh& mesh )
+void setupQuantizedMeshLoaderInputs(
+    optix::Context            context, 
+    MeshBuffers&              buffers,
+    QuantizedMesh&            mesh
+    )
+{
+  buffers.tri_indices = context->createBuffer( RT_BUFFER_INPUT, RT_FORMAT_INT3,            mesh.num_triangles );
+  buffers.mat_indices = context->createBuffer( RT_BUFFER_INPUT, RT_FORMAT_INT,             mesh.num_triangles );
+  buffers.positions   = context->createBuffer( RT_BUFFER_INPUT, RT_FORMAT_UNSIGNED_SHORT4, mesh.num_vertices );
+  buffers.normals     = context->createBuffer( RT_BUFFER_INPUT, RT_FORMAT_UNSIGNED_INT,
+                                               mesh.has_normals ? mesh.num_vertices : 0);
+  buffers.texcoords   = context->createBuffer( RT_BUFFER_INPUT, RT_FORMAT_UNSIGNED_INT,
+                                               mesh.has_texcoords ? mesh.num_vertices : 0);
+
+  mesh.tri_indices = reinterpret_cast<int32_t*> ( buffers.tri_indices->map() );
+  mesh.mat_indices = reinterpret_cast<int32_t*> ( buffers.mat_indices->map() );
+  mesh.positions   = reinterpret_cast<uint16_t*>( buffers.positions->map() );
+  mesh.normals     = reinterpret_cast<uint32_t*>( mesh.has_normals   ? buffers.normals->map()   : 0 );
+  mesh.texcoords   = reinterpret_cast<uint32_t*>( mesh.has_texcoords ? buffers.texcoords->map() : 0 );
+
+  mesh.mat_params = new MaterialParams[ mesh.num_materials ];
+}
+
+
+// Mesh or QuantizedMesh
+template<typename MeshType>
+void unmap( MeshBuffers& buffers, MeshType& mesh )
 {
   buffers.tri_indices->unmap();
   buffers.mat_indices->unmap();
@@ -165,8 +191,9 @@ optix::Program createIntersectionProgram( optix::Context context )
 }
 
 
+template<typename MeshType>
 void translateMeshToOptiX(
-    const Mesh&        mesh,
+    const MeshType&    mesh,
     const MeshBuffers& buffers,
     OptiXMesh&         optix_mesh
     )
@@ -232,7 +259,8 @@ void translateMeshToOptiX(
 void loadMesh(
     const std::string&          filename,
     OptiXMesh&                  optix_mesh, 
-    const optix::Matrix4x4&     load_xform
+    const optix::Matrix4x4&     load_xform,
+    unsigned int                load_flags
     )
 {
   if( !optix_mesh.context )
@@ -243,7 +271,7 @@ void loadMesh(
   optix::Context context = optix_mesh.context;
 
   Mesh mesh;
-  MeshLoader loader( filename );
+  MeshLoader loader( filename, load_flags );
   loader.scanMesh( mesh );
 
   MeshBuffers buffers;
@@ -255,3 +283,40 @@ void loadMesh(
 
   unmap( buffers, mesh );
 }
+
+
+void loadQuantizedMesh(
+    const std::string&          filename,
+    OptiXMesh&                  optix_mesh, 
+    const optix::Matrix4x4&     load_xform,
+    unsigned int                load_flags
+    )
+{
+  if( !optix_mesh.context )
+  {
+    throw std::runtime_error( "OptiXMesh: loadQuantizedMesh() requires valid OptiX context" );
+  }
+  if( !optix_mesh.intersection || !optix_mesh.bounds )
+  {
+    throw std::runtime_error( "OptiXMesh: loadQuantizedMesh() requires intersection and bounds programs" );
+  }
+
+  optix::Context context = optix_mesh.context;
+
+  QuantizedMesh mesh;
+  MeshLoader loader( filename, load_flags );
+  loader.scanMesh( mesh );
+
+  MeshBuffers buffers;
+  setupQuantizedMeshLoaderInputs( context, buffers, mesh );
+
+  loader.loadMesh( mesh, load_xform.getData() );
+
+  translateMeshToOptiX( mesh, buffers, optix_mesh );
+
+  optix::Geometry geometry = optix_mesh.geom_instance->getGeometry();
+  geometry[ "position_origin" ]->set3fv( mesh.bbox_min );
+  geometry[ "position_scale"  ]->set3fv( mesh.position_scale );
+
+  unmap( buffers, mesh );
+}
@@ -72,5 +72,19 @@ struct OptiXMesh
 SUTILAPI void loadMesh(
     const std::string&        filename,
     OptiXMesh&                mesh, 
-    const optix::Matrix4x4&   load_xform = optix::Matrix4x4::identity()
+    const optix::Matrix4x4&   load_xform = optix::Matrix4x4::identity(),
+    unsigned int              load_flags = MESH_LOADER_DEFAULT   // MeshLoaderFlags
+    );
+
+
+// Same with the vertex attributes of a QuantizedMesh: vertex_buffer holds
+// ushort4 positions decoded with the float3 variables position_origin and
+// position_scale, normal_buffer and texcoord_buffer hold uint codes.  See
+// device_include/quantization.h.  There are no default programs for this
+// layout, intersection and bounds are required.
+SUTILAPI void loadQuantizedMesh(
+    const std::string&        filename,
+    OptiXMesh&                mesh, 
+    const optix::Matrix4x4&   load_xform = optix::Matrix4x4::identity(),
+    unsigned int              load_flags = MESH_LOADER_DEFAULT   // MeshLoaderFlags
     );
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+//------------------------------------------------------------------------------
+//
+// Minimal thread pool free loops for the mesh loaders
+//
+//------------------------------------------------------------------------------
+
+namespace sutil
+{
+
+inline unsigned int numThreads()
+{
+  return std::max( 1u, std::thread::hardware_concurrency() );
+}
+
+
+// Runs body( item, thread ) for every item in [0, count), handing items out
+// one at a time so that uneven work balances.  The first exception thrown by
+// a worker is rethrown on the calling thread.
+inline void parallelFor( size_t count, const std::function<void( size_t, unsigned int )>& body )
+{
+  const unsigned int num_threads = static_cast<unsigned int>(
+      std::max<size_t>( 1, std::min<size_t>( numThreads(), count ) ) );
+
+  std::atomic<size_t> next( 0 );
+  std::exception_ptr  error;
+  std::mutex          error_mutex;
+
+  std::function<void( unsigned int )> worker = [&]( unsigned int thread )
+  {
+    try
+    {
+      for( size_t i = next++; i < count; i = next++ )
+        body( i, thread );
+    }
+    catch( ... )
+    {
+      std::lock_guard<std::mutex> lock( error_mutex );
+      if( !error )
+        error = std::current_exception();
+      next = count;
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for( unsigned int t = 1; t < num_threads; ++t )
+    workers.push_back( std::thread( worker, t ) );
+  worker( 0 );
+
+  for( size_t i = 0; i < workers.size(); ++i )
+    workers[i].join();
+
+  if( error )
+    std::rethrow_exception( error );
+}
+
+
+// Runs body( begin, end ) over [0, count) in blocks of grain elements.
+inline void parallelForRange( size_t count, size_t grain, const std::function<void( size_t, size_t )>& body )
+{
+  const size_t num_blocks = ( count + grain - 1 ) / grain;
+  parallelFor( num_blocks, [&]( size_t block, unsigned int )
+  {
+    body( block * grain, std::min( count, ( block + 1 ) * grain ) );
+  } );
+}
+
+} // end namespace sutil
@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Trace.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+//------------------------------------------------------------------------------
+//
+// Trace buffers
+//
+//------------------------------------------------------------------------------
+
+namespace
+{
+
+struct TraceEvent
+{
+  const char* name;
+  std::string detail;
+  double      begin;  // microseconds
+  double      end;
+};
+
+struct TraceBuffer
+{
+  unsigned int            tid;
+  std::vector<TraceEvent> events;
+};
+
+std::atomic<bool>                         g_enabled( false );
+std::chrono::steady_clock::time_point     g_start;
+std::mutex                                g_buffers_mutex;  // registration and traceWrite() only
+std::vector<std::unique_ptr<TraceBuffer> > g_buffers;
+
+// VS2013 has no thread_local, a plain pointer works with the compiler specific storage classes.
+#if defined( _MSC_VER )
+#  define TRACE_THREAD_LOCAL __declspec( thread )
+#else
+#  define TRACE_THREAD_LOCAL __thread
+#endif
+
+// Owned by g_buffers, so the spans of finished threads stay around.
+TRACE_THREAD_LOCAL TraceBuffer* t_buffer = 0;
+
+
+TraceBuffer* threadBuffer()
+{
+  if( !t_buffer )
+  {
+    std::lock_guard<std::mutex> lock( g_buffers_mutex );
+    g_buffers.push_back( std::unique_ptr<TraceBuffer>( new TraceBuffer ) );
+    t_buffer = g_buffers.back().get();
+    t_buffer->tid = static_cast<unsigned int>( g_buffers.size() );
+    t_buffer->events.reserve( 1024 );
+  }
+  return t_buffer;
+}
+
+
+void writeString( FILE* file, const std::string& s )
+{
+  fputc( '"', file );
+  for( size_t i = 0; i < s.size(); ++i )
+  {
+    const unsigned char c = static_cast<unsigned char>( s[i] );
+    if( c == '"' || c == '\\' )
+      fprintf( file, "\\%c", c );
+    else if( c < 0x20 )
+      fprintf( file, "\\u%04x", c );
+    else
+      fputc( c, file );
+  }
+  fputc( '"', file );
+}
+
+} // namespace
+
+
+namespace sutil
+{
+
+void traceBegin()
+{
+  g_start = std::chrono::steady_clock::now();
+  g_enabled.store( true );
+  threadBuffer();
+}
+
+
+bool traceEnabled()
+{
+  return g_enabled.load( std::memory_order_relaxed );
+}
+
+
+double traceTime()
+{
+  return std::chrono::duration<double, std::micro>( std::chrono::steady_clock::now() - g_start ).count();
+}
+
+
+void traceSpan( const char* name, const std::string& detail, double begin, double end )
+{
+  TraceBuffer* buffer = threadBuffer();
+  buffer->events.push_back( TraceEvent() );
+  TraceEvent& event = buffer->events.back();
+  event.name   = name;
+  event.detail = detail;
+  event.begin  = begin;
+  event.end    = end;
+}
+
+
+bool traceWrite( const std::string& filename )
+{
+  FILE* file = fopen( filename.c_str(), "w" );
+  if( !file )
+    return false;
+
+  std::lock_guard<std::mutex> lock( g_buffers_mutex );
+  fprintf( file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n" );
+  bool first = true;
+  for( size_t b = 0; b < g_buffers.size(); ++b )
+  {
+    const TraceBuffer& buffer = *g_buffers[b];
+    fprintf( file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":",
+             first ? "" : ",\n", buffer.tid );
+    writeString( file, buffer.tid == 1 ? std::string( "main" ) : "worker " + std::to_string( buffer.tid - 1 ) );
+    fprintf( file, "}}" );
+    first = false;
+
+    for( size_t i = 0; i < buffer.events.size(); ++i )
+    {
+      const TraceEvent& event = buffer.events[i];
+      fprintf( file, ",\n{\"name\":" );
+      writeString( file, event.name );
+      fprintf( file, ",\"cat\":\"optagen\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f",
+               buffer.tid, event.begin, event.end - event.begin );
+      if( !event.detail.empty() )
+      {
+        fprintf( file, ",\"args\":{\"detail\":" );
+        writeString( file, event.detail );
+        fputc( '}', file );
+      }
+      fputc( '}', file );
+    }
+  }
+  fprintf( file, "\n]}\n" );
+
+  const bool ok = !ferror( file );
+  return fclose( file ) == 0 && ok;
+}
+
+} // end namespace sutil
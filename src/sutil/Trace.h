@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2016, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <sutilapi.h>
+
+#include <string>
+
+
+//------------------------------------------------------------------------------
+//
+// Scoped trace spans, written as Chrome trace event JSON (chrome://tracing,
+// ui.perfetto.dev).  Every thread records into its own buffer without locks,
+// only its first span registers the buffer.  While recording is off a span
+// costs one relaxed atomic load.
+//
+//------------------------------------------------------------------------------
+
+namespace sutil
+{
+
+// Starts recording, the calling thread is shown as the main thread.
+SUTILAPI void traceBegin();
+
+SUTILAPI bool traceEnabled();
+
+// Microseconds since traceBegin().
+SUTILAPI double traceTime();
+
+// Records a complete span on the calling thread.  name must outlive the
+// trace (a string literal), detail is copied.
+SUTILAPI void traceSpan( const char* name, const std::string& detail, double begin, double end );
+
+// Writes every span recorded so far.  Threads must not record while this
+// runs, call it after the workers have been joined.
+SUTILAPI bool traceWrite( const std::string& filename );
+
+
+class TraceScope
+{
+public:
+  explicit TraceScope( const char* name )
+    : m_name( traceEnabled() ? name : 0 ), m_begin( m_name ? traceTime() : 0.0 )
+  {
+  }
+
+  TraceScope( const char* name, const std::string& detail )
+    : m_name( traceEnabled() ? name : 0 ), m_begin( m_name ? traceTime() : 0.0 )
+  {
+    if( m_name )
+      m_detail = detail;
+  }
+
+  ~TraceScope()
+  {
+    if( m_name )
+      traceSpan( m_name, m_detail, m_begin, traceTime() );
+  }
+
+private:
+  TraceScope( const TraceScope& );
+  TraceScope& operator=( const TraceScope& );
+
+  const char* m_name;
+  double      m_begin;
+  std::string m_detail;
+};
+
+} // end namespace sutil